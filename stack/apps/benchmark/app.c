@@ -0,0 +1,440 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Micro-benchmarks of the hot paths of the stack: the AES modes used by the network layer security,
+// FEC encoding/decoding, the CRC and the complete packet assembly/disassembly for every NLS method.
+// Every measurement repeats the operation until it took at least BENCHMARK_MIN_DURATION, the results
+// are printed as CSV (one line per operation, NLS method and payload length) with the columns:
+//
+//   op,nls_method,backend,payload_len,iterations,ns_per_frame,ns_per_byte,cycles_per_byte,frames_per_sec
+//
+// backend is "hw" when the AES block cipher is offloaded to the hw_aes_* functions of the platform.
+// cycles_per_byte is derived from the measured time and APP_BENCHMARK_CPU_FREQUENCY, and is left empty
+// when the CPU frequency is not configured. The per byte columns are empty for an empty payload.
+// Every measurement is executed as a separate task, so the rest of the system is not starved for a long time.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scheduler.h"
+#include "timer.h"
+#include "debug.h"
+#include "platform.h"
+#include "aes.h"
+#include "fec.h"
+#include "crc.h"
+#include "d7ap_stack.h"
+#include "packet.h"
+#include "fs.h"
+#include "MODULE_D7AP_defs.h"
+
+#ifdef POSIX_VIRTUAL_TIME
+    #error Benchmarks require a real time clock, disable the virtual time mode of the platform
+#endif
+
+#ifndef BENCHMARK_CPU_FREQUENCY
+    #define BENCHMARK_CPU_FREQUENCY 0
+#endif
+
+#define BENCHMARK_MIN_DURATION  (TIMER_TICKS_PER_SEC / 4)
+#define BENCHMARK_START_DELAY   (TIMER_TICKS_PER_SEC)
+
+// the largest payload fec_encode() and fec_decode_packet() can process, the encoded frame has to fit in 255 bytes
+#define FEC_MAX_PAYLOAD_LENGTH  124
+
+// frame length byte + DLL header (broadcast) + D7ANP ctrl + origin access class + UID origin + D7ATP header + CRC
+#define PACKET_OVERHEAD         (1 + 2 + 1 + 1 + 8 + 3 + 2)
+#define PACKET_SECURITY_HEADER  5
+#define PACKET_MAX_LENGTH       255
+
+#ifdef AES_HARDWARE_SUPPORT
+    #define AES_BACKEND "hw"
+#else
+    #define AES_BACKEND "sw"
+#endif
+
+#ifdef MODULE_D7AP_NLS_ENABLED
+    #define PACKET_NLS_METHOD_MAX AES_CCM_32
+#else
+    #define PACKET_NLS_METHOD_MAX AES_NONE
+#endif
+
+typedef struct {
+    const char* name;
+    const char* backend;
+    uint8_t nls_method_min;
+    uint8_t nls_method_max;
+    bool (*prepare)(uint8_t nls_method, uint8_t length); // returns false when the combination is not supported
+    void (*run)(uint8_t nls_method, uint8_t length);
+} benchmark_t;
+
+static const uint8_t payload_lengths[] = { 0, 1, 8, 16, 32, 48, 64, 96, 128, 160, 192, 224, 239 };
+
+// the AES benchmarks use their own key, the packet benchmarks the NWL security key loaded by the stack
+static const uint8_t key[AES_BLOCK_SIZE] = {
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+static aes_ctx_t aes_ctx;
+
+static const uint8_t iv[AES_BLOCK_SIZE] = {
+    0x20, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x00, 0x00
+};
+
+static uint8_t data[PACKET_MAX_LENGTH];
+static uint8_t work[PACKET_MAX_LENGTH + AES_BLOCK_SIZE];
+static uint8_t reference[PACKET_MAX_LENGTH + AES_BLOCK_SIZE];
+static uint8_t reference_length;
+static uint8_t ctr_blk[AES_BLOCK_SIZE];
+static uint8_t auth[AES_BLOCK_SIZE];
+
+// the packets are not allocated from the packet queue, so they use their own frame buffers
+typedef struct
+{
+    hw_radio_packet_t hw_radio_packet;
+    uint8_t __data[256];
+} frame_buffer_t;
+
+static frame_buffer_t tx_frame;
+static frame_buffer_t rx_frame;
+static packet_t tx_packet;
+static packet_t rx_packet;
+static d7anp_addressee_t addressee = {
+    .ctrl = {
+        .nls_method = AES_NONE,
+        .id_type = ID_TYPE_NOID,
+    },
+    .access_class = 0x01,
+    .id = { 0 }
+};
+
+static uint8_t current_benchmark = 0;
+static uint8_t current_nls_method = 0;
+static uint8_t current_length_index = 0;
+
+static uint8_t get_auth_len(uint8_t nls_method)
+{
+    switch(nls_method)
+    {
+        case AES_CBC_MAC_128:
+        case AES_CCM_128:
+            return 16;
+        case AES_CBC_MAC_64:
+        case AES_CCM_64:
+            return 8;
+        case AES_CBC_MAC_32:
+        case AES_CCM_32:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static bool prepare_none(uint8_t nls_method, uint8_t length)
+{
+    return true;
+}
+
+static void run_aes_ctr(uint8_t nls_method, uint8_t length)
+{
+    memcpy(ctr_blk, iv, AES_BLOCK_SIZE);
+    AES128_CTR_encrypt(&aes_ctx, work, data, length, ctr_blk);
+}
+
+static bool prepare_aes_cbc_mac(uint8_t nls_method, uint8_t length)
+{
+    return AES128_CBC_MAC(&aes_ctx, auth, data, length, iv, NULL, 0, get_auth_len(nls_method)) == SUCCESS;
+}
+
+static void run_aes_cbc_mac(uint8_t nls_method, uint8_t length)
+{
+    AES128_CBC_MAC(&aes_ctx, auth, data, length, iv, NULL, 0, get_auth_len(nls_method));
+}
+
+static void run_aes_ccm_encrypt(uint8_t nls_method, uint8_t length)
+{
+    memcpy(work, data, length);
+    memcpy(ctr_blk, iv, AES_BLOCK_SIZE);
+    AES128_CCM_encrypt(&aes_ctx, work, length, iv, NULL, 0, ctr_blk, get_auth_len(nls_method));
+}
+
+static bool prepare_aes_ccm_encrypt(uint8_t nls_method, uint8_t length)
+{
+    memcpy(reference, data, length);
+    memcpy(ctr_blk, iv, AES_BLOCK_SIZE);
+    return AES128_CCM_encrypt(&aes_ctx, reference, length, iv, NULL, 0, ctr_blk, get_auth_len(nls_method)) == SUCCESS;
+}
+
+static void run_aes_ccm_decrypt(uint8_t nls_method, uint8_t length)
+{
+    memcpy(work, reference, length);
+    memcpy(ctr_blk, iv, AES_BLOCK_SIZE);
+    AES128_CCM_decrypt(&aes_ctx, work, length, iv, NULL, 0, ctr_blk, reference + length, get_auth_len(nls_method));
+}
+
+static bool prepare_aes_ccm_decrypt(uint8_t nls_method, uint8_t length)
+{
+    if (!prepare_aes_ccm_encrypt(nls_method, length))
+        return false;
+
+    memcpy(work, reference, length);
+    memcpy(ctr_blk, iv, AES_BLOCK_SIZE);
+    return AES128_CCM_decrypt(&aes_ctx, work, length, iv, NULL, 0, ctr_blk, reference + length, get_auth_len(nls_method)) == SUCCESS;
+}
+
+static bool prepare_fec_encode(uint8_t nls_method, uint8_t length)
+{
+    return length <= FEC_MAX_PAYLOAD_LENGTH;
+}
+
+static void run_fec_encode(uint8_t nls_method, uint8_t length)
+{
+    memcpy(work, data, length);
+    fec_encode(work, length);
+}
+
+static bool prepare_fec_decode(uint8_t nls_method, uint8_t length)
+{
+    if (length > FEC_MAX_PAYLOAD_LENGTH)
+        return false;
+
+    memcpy(reference, data, length);
+    reference_length = fec_encode(reference, length);
+    return true;
+}
+
+static void run_fec_decode(uint8_t nls_method, uint8_t length)
+{
+    memcpy(work, reference, reference_length);
+    fec_decode_packet(work, reference_length, PACKET_MAX_LENGTH);
+}
+
+static void run_crc(uint8_t nls_method, uint8_t length)
+{
+    crc_calculate(data, length);
+}
+
+static bool prepare_packet_assemble(uint8_t nls_method, uint8_t length)
+{
+    uint8_t overhead = PACKET_OVERHEAD + get_auth_len(nls_method);
+    if (nls_method == AES_CTR || nls_method >= AES_CCM_128)
+        overhead += PACKET_SECURITY_HEADER;
+
+    if (overhead + length > PACKET_MAX_LENGTH)
+        return false;
+
+    packet_init(&tx_packet);
+    memset(&tx_frame, 0, sizeof(tx_frame));
+    tx_packet.hw_radio_packet = &tx_frame.hw_radio_packet;
+    addressee.ctrl.nls_method = nls_method;
+    tx_packet.d7anp_addressee = &addressee;
+    tx_packet.dll_header.subnet = 0xFF;
+    tx_packet.dll_header.control_target_id_type = ID_TYPE_NOID;
+    tx_packet.d7anp_ctrl.nls_method = nls_method;
+    tx_packet.d7anp_ctrl.origin_id_type = ID_TYPE_UID;
+    tx_packet.d7anp_ctrl.origin_void = false;
+    tx_packet.origin_access_class = addressee.access_class;
+    tx_packet.d7atp_ctrl.ctrl_is_start = true;
+    tx_packet.payload_offset = PACKET_TX_PAYLOAD_OFFSET;
+    tx_packet.payload_length = length;
+    memcpy(packet_payload(&tx_packet), data, length);
+    tx_packet.hw_radio_packet->tx_meta.tx_cfg.syncword_class = PHY_SYNCWORD_CLASS1;
+    // FEC coding makes packet_assemble() always append a software CRC, so the frames can be disassembled on all platforms
+    tx_packet.hw_radio_packet->tx_meta.tx_cfg.channel_id.channel_header.ch_coding = PHY_CODING_FEC_PN9;
+    return true;
+}
+
+static void run_packet_assemble(uint8_t nls_method, uint8_t length)
+{
+    // the payload is secured in place, so write the plaintext payload in the frame before every run like D7ASP does
+    tx_packet.payload_offset = PACKET_TX_PAYLOAD_OFFSET;
+    memcpy(packet_payload(&tx_packet), data, length);
+    packet_assemble(&tx_packet);
+}
+
+static void run_packet_disassemble(uint8_t nls_method, uint8_t length)
+{
+    // the frame is decrypted in place, so restore the received frame before every run
+    memcpy(rx_packet.hw_radio_packet->data, reference, reference_length);
+    rx_packet.hw_radio_packet->length = reference[0];
+    rx_packet.hw_radio_packet->rx_meta.crc_status = HW_CRC_UNAVAILABLE;
+    rx_packet.hw_radio_packet->rx_meta.rx_cfg.syncword_class = PHY_SYNCWORD_CLASS1;
+    packet_parse(&rx_packet);
+}
+
+static bool prepare_packet_disassemble(uint8_t nls_method, uint8_t length)
+{
+    if (!prepare_packet_assemble(nls_method, length))
+        return false;
+
+    packet_assemble(&tx_packet);
+    reference_length = tx_packet.hw_radio_packet->length + 1;
+    memcpy(reference, tx_packet.hw_radio_packet->data, reference_length);
+
+    packet_init(&rx_packet);
+    rx_packet.hw_radio_packet = &rx_frame.hw_radio_packet;
+    run_packet_disassemble(nls_method, length);
+    assert(rx_packet.payload_length == length);
+    assert(memcmp(packet_payload(&rx_packet), data, length) == 0);
+    return true;
+}
+
+static const benchmark_t benchmarks[] = {
+    { "aes_ctr", AES_BACKEND, AES_CTR, AES_CTR, &prepare_none, &run_aes_ctr },
+    { "aes_cbc_mac", AES_BACKEND, AES_CBC_MAC_128, AES_CBC_MAC_32, &prepare_aes_cbc_mac, &run_aes_cbc_mac },
+    { "aes_ccm_encrypt", AES_BACKEND, AES_CCM_128, AES_CCM_32, &prepare_aes_ccm_encrypt, &run_aes_ccm_encrypt },
+    { "aes_ccm_decrypt", AES_BACKEND, AES_CCM_128, AES_CCM_32, &prepare_aes_ccm_decrypt, &run_aes_ccm_decrypt },
+    { "fec_encode", "sw", AES_NONE, AES_NONE, &prepare_fec_encode, &run_fec_encode },
+    { "fec_decode_packet", "sw", AES_NONE, AES_NONE, &prepare_fec_decode, &run_fec_decode },
+    { "crc_calculate", "sw", AES_NONE, AES_NONE, &prepare_none, &run_crc },
+    { "packet_assemble", AES_BACKEND, AES_NONE, PACKET_NLS_METHOD_MAX, &prepare_packet_assemble, &run_packet_assemble },
+    { "packet_disassemble", AES_BACKEND, AES_NONE, PACKET_NLS_METHOD_MAX, &prepare_packet_disassemble, &run_packet_disassemble },
+};
+
+#define BENCHMARKS_COUNT (sizeof(benchmarks) / sizeof(benchmark_t))
+
+static void print_result(const benchmark_t* benchmark, uint8_t nls_method, uint8_t length, uint32_t iterations, timer_tick_t duration)
+{
+    uint64_t duration_ns = (uint64_t) duration * 1000000000 / TIMER_TICKS_PER_SEC;
+    uint64_t bytes = (uint64_t) iterations * length;
+
+    printf("%s,%d,%s,%d,%lu,%lu,", benchmark->name, nls_method, benchmark->backend, length,
+           (unsigned long) iterations, (unsigned long) (duration_ns / iterations));
+
+    // the per byte figures are printed with 2 decimals
+    if (length)
+    {
+        uint32_t ns_per_byte = duration_ns * 100 / bytes;
+        printf("%lu.%02lu", (unsigned long) (ns_per_byte / 100), (unsigned long) (ns_per_byte % 100));
+    }
+
+    printf(",");
+
+    if (length && BENCHMARK_CPU_FREQUENCY)
+    {
+        uint32_t cycles_per_byte = (uint64_t) duration * BENCHMARK_CPU_FREQUENCY * 100 / TIMER_TICKS_PER_SEC / bytes;
+        printf("%lu.%02lu", (unsigned long) (cycles_per_byte / 100), (unsigned long) (cycles_per_byte % 100));
+    }
+
+    printf(",%lu\n", (unsigned long) ((uint64_t) iterations * TIMER_TICKS_PER_SEC / duration));
+    fflush(stdout);
+}
+
+static bool next_measurement()
+{
+    const benchmark_t* benchmark = &benchmarks[current_benchmark];
+
+    if (++current_length_index < sizeof(payload_lengths))
+        return true;
+
+    current_length_index = 0;
+    if (++current_nls_method <= benchmark->nls_method_max)
+        return true;
+
+    if (++current_benchmark == BENCHMARKS_COUNT)
+        return false;
+
+    current_nls_method = benchmarks[current_benchmark].nls_method_min;
+    return true;
+}
+
+static void run_measurement()
+{
+    const benchmark_t* benchmark = &benchmarks[current_benchmark];
+    uint8_t length = payload_lengths[current_length_index];
+
+    if (benchmark->prepare(current_nls_method, length))
+    {
+        uint32_t iterations = 1;
+        timer_tick_t duration;
+
+        while (true)
+        {
+            timer_tick_t start = timer_get_counter_value();
+            for (uint32_t i = 0; i < iterations; i++)
+                benchmark->run(current_nls_method, length);
+
+            duration = timer_get_counter_value() - start;
+            if (duration >= BENCHMARK_MIN_DURATION)
+                break;
+
+            iterations *= 2;
+        }
+
+        print_result(benchmark, current_nls_method, length, iterations, duration);
+    }
+
+    if (next_measurement())
+        sched_post_task(&run_measurement);
+    else
+    {
+        // terminate so the benchmark can be scripted, the embedded platforms halt in _exit()
+        printf("# done\n");
+        exit(0);
+    }
+}
+
+static void start_benchmarks()
+{
+    printf("\nop,nls_method,backend,payload_len,iterations,ns_per_frame,ns_per_byte,cycles_per_byte,frames_per_sec\n");
+    sched_post_task(&run_measurement);
+}
+
+void bootstrap()
+{
+    dae_access_profile_t access_classes[1] = {
+        {
+            .channel_header = {
+                .ch_coding = PHY_CODING_PN9,
+                .ch_class = PHY_CLASS_NORMAL_RATE,
+                .ch_freq_band = PHY_BAND_868
+            },
+            .subprofiles[0] = {
+                .subband_bitmap = 0x00, // void scan automation channel list, the radio stays idle
+                .scan_automation_period = 0,
+            },
+            .subbands[0] = (subband_t){
+                .channel_index_start = 0,
+                .channel_index_end = 0,
+                .eirp = 10,
+                .cca = -86,
+                .duty = 0,
+            }
+        }
+    };
+
+    fs_init_args_t fs_init_args = (fs_init_args_t){
+        .access_profiles_count = 1,
+        .access_profiles = access_classes,
+        .access_class = 0x01
+    };
+
+    d7ap_stack_init(&fs_init_args, NULL, false, NULL);
+
+    for (uint16_t i = 0; i < sizeof(data); i++)
+        data[i] = i;
+
+    AES128_init(&aes_ctx, key);
+
+    current_nls_method = benchmarks[0].nls_method_min;
+
+    sched_register_task(&start_benchmarks);
+    sched_register_task(&run_measurement);
+    timer_post_task_delay(&start_benchmarks, BENCHMARK_START_DELAY);
+}
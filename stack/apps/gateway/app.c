@@ -38,6 +38,17 @@
 #include "fifo.h"
 #include "version.h"
 
+#ifdef PLATFORM_LINUX_HOST
+#include "file_blockdevice.h"
+
+// the permanent and restorable files are kept in this file, so the configuration survives a restart
+#define NVM_PATH "gateway.nvm"
+#define NVM_ERASE_BLOCK_SIZE 4096
+#define NVM_ERASE_BLOCK_COUNT 4
+
+static file_blockdevice_t nvm;
+#endif
+
 #if HW_NUM_LEDS > 0
 #include "hwleds.h"
 
@@ -50,7 +61,8 @@ void led_blink()
 {
 	led_on(0);
 
-	timer_post_task_delay(&led_blink_off, TIMER_TICKS_PER_SEC * 0.2);
+	// the blink duration is not critical, allow it to share a wakeup with another timer
+	timer_post_task_delay_slack(&led_blink_off, TIMER_TICKS_PER_SEC * 0.2, TIMER_TICKS_PER_SEC * 0.05);
 }
 
 #endif
@@ -65,126 +77,25 @@ static void on_unsolicited_response_received(d7asp_result_t d7asp_result, uint8_
 
 static alp_init_args_t alp_init_args;
 
+// generated from fs_image.json
+extern const fs_image_t gateway_fs_image;
+
 void bootstrap()
 {
-    dae_access_profile_t access_profiles[6] = {
-        {
-            .channel_header = {
-                .ch_coding = PHY_CODING_PN9,
-                .ch_class = PHY_CLASS_NORMAL_RATE,
-                .ch_freq_band = PHY_BAND_868
-            },
-            .subprofiles[0] = {
-                .subband_bitmap = 0x01, // only the first subband is selectable
-                .scan_automation_period = 0,
-            },
-            .subbands[0] = (subband_t){
-                .channel_index_start = 0,
-                .channel_index_end = 0,
-                .eirp = 10,
-                .cca = -86,
-                .duty = 0,
-            }
-        },
-        {
-            .channel_header = {
-                .ch_coding = PHY_CODING_PN9,
-                .ch_class = PHY_CLASS_HI_RATE,
-                .ch_freq_band = PHY_BAND_868
-            },
-            .subprofiles[0] = {
-                .subband_bitmap = 0x01, // only the first subband is selectable
-                .scan_automation_period = 0,
-            },
-            .subbands[0] = (subband_t){
-                .channel_index_start = 0,
-                .channel_index_end = 0,
-                .eirp = 10,
-                .cca = -86,
-                .duty = 0,
-            }
-        },
-        {
-            .channel_header = {
-                .ch_coding = PHY_CODING_PN9,
-                .ch_class = PHY_CLASS_LO_RATE,
-                .ch_freq_band = PHY_BAND_868
-            },
-            .subprofiles[0] = {
-                .subband_bitmap = 0x01, // only the first subband is selectable
-                .scan_automation_period = 0,
-            },
-            .subbands[0] = (subband_t){
-                .channel_index_start = 0,
-                .channel_index_end = 0,
-                .eirp = 10,
-                .cca = -86,
-                .duty = 0,
-            }
-        },
-        {
-            .channel_header = {
-                .ch_coding = PHY_CODING_PN9,
-                .ch_class = PHY_CLASS_NORMAL_RATE,
-                .ch_freq_band = PHY_BAND_433
-            },
-            .subprofiles[0] = {
-                .subband_bitmap = 0x01, // only the first subband is selectable
-                .scan_automation_period = 0,
-            },
-            .subbands[0] = (subband_t){
-                .channel_index_start = 0,
-                .channel_index_end = 0,
-                .eirp = 10,
-                .cca = -86,
-                .duty = 0,
-            }
-        },
-        {
-            .channel_header = {
-                .ch_coding = PHY_CODING_PN9,
-                .ch_class = PHY_CLASS_HI_RATE,
-                .ch_freq_band = PHY_BAND_433
-            },
-            .subprofiles[0] = {
-                .subband_bitmap = 0x01, // only the first subband is selectable
-                .scan_automation_period = 0,
-            },
-            .subbands[0] = (subband_t){
-                .channel_index_start = 0,
-                .channel_index_end = 0,
-                .eirp = 10,
-                .cca = -86,
-                .duty = 0,
-            }
-        },
-        {
-            .channel_header = {
-                .ch_coding = PHY_CODING_PN9,
-                .ch_class = PHY_CLASS_LO_RATE,
-                .ch_freq_band = PHY_BAND_433
-            },
-            .subprofiles[0] = {
-                .subband_bitmap = 0x01, // only the first subband is selectable
-                .scan_automation_period = 0,
-            },
-            .subbands[0] = (subband_t){
-                .channel_index_start = 0,
-                .channel_index_end = 0,
-                .eirp = 10,
-                .cca = -86,
-                .duty = 0,
-            }
-        }
-    };
-
+    // the access profiles and the active access class (0x01: use access profile 0 and select the first subprofile)
+    // are defined in fs_image.json
     fs_init_args_t fs_init_args = (fs_init_args_t){
         .fs_user_files_init_cb = NULL,
-        .access_profiles_count = sizeof(access_profiles) / sizeof(dae_access_profile_t),
-        .access_profiles = access_profiles,
-        .access_class = 0x01 // use access profile 0 and select the first subprofile
+        .image = &gateway_fs_image
     };
 
+#ifdef PLATFORM_LINUX_HOST
+    if(file_blockdevice_init(&nvm, NVM_PATH, NVM_ERASE_BLOCK_SIZE, NVM_ERASE_BLOCK_COUNT) == SUCCESS)
+        fs_init_args.nvm = &nvm.base;
+    else
+        log_print_string("could not open %s, the files are not stored", NVM_PATH);
+#endif
+
     alp_init_args.alp_received_unsolicited_data_cb = &on_unsolicited_response_received;
     d7ap_stack_init(&fs_init_args, &alp_init_args, true, NULL);
 
@@ -148,7 +148,7 @@ static void transmit_packet() {
     hw_radio_send_packet(tx_packet, &packet_transmitted);
 }
 
-static hw_radio_packet_t* alloc_new_packet(uint8_t length) {
+static hw_radio_packet_t* alloc_new_packet(uint16_t length) {
     return rx_packet;
 }
 
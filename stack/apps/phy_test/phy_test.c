@@ -130,7 +130,7 @@ void userbutton_callback(button_id_t button_id) {
 }
 
 
-hw_radio_packet_t* alloc_new_packet(uint8_t length)
+hw_radio_packet_t* alloc_new_packet(uint16_t length)
 {
     return rx_packet;
 }
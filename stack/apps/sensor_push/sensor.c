@@ -59,6 +59,7 @@
 #define SENSOR_FILE_ID           0x40
 #define SENSOR_FILE_SIZE         8
 #define SENSOR_INTERVAL_SEC	TIMER_TICKS_PER_SEC * 10
+#define SENSOR_INTERVAL_SLACK	TIMER_TICKS_PER_SEC / 4 // the measurement may be delayed to share a wakeup with another timer
 
 // Define the D7 interface configuration used for sending the ALP command on
 static d7asp_master_session_config_t session_config = {
@@ -150,7 +151,7 @@ void execute_sensor_measurement()
   memcpy(alp_command + 4, sensor_values, SENSOR_FILE_SIZE);
 
   alp_execute_command(alp_command, sizeof(alp_command), &session_config);
-  timer_post_task_delay(&execute_sensor_measurement, SENSOR_INTERVAL_SEC);
+  timer_post_task_delay_slack(&execute_sensor_measurement, SENSOR_INTERVAL_SEC, SENSOR_INTERVAL_SLACK);
 
 #ifdef PLATFORM_EZR32LG_OCTA
   led_flash_green();
@@ -213,7 +214,7 @@ void bootstrap()
 #endif
 
     sched_register_task(&execute_sensor_measurement);
-    timer_post_task_delay(&execute_sensor_measurement, SENSOR_INTERVAL_SEC);
+    timer_post_task_delay_slack(&execute_sensor_measurement, SENSOR_INTERVAL_SEC, SENSOR_INTERVAL_SLACK);
 
     LCD_WRITE_STRING("Sensor push\n");
 }
@@ -0,0 +1,248 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Simulation scenario for the linux_host platform using the sim radio. Node 0 is a gateway
+// which continuously scans the channel, all other nodes are sensors which periodically push
+// a file to the gateway(s), like the sensor_push application. The gateway periodically
+// logs the channel utilization, the share of the requests which got through CSMA-CA,
+// the number of acknowledged requests and their end-to-end latency.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "scheduler.h"
+#include "timer.h"
+#include "debug.h"
+#include "ng.h"
+#include "random.h"
+#include "platform.h"
+#include "d7ap_stack.h"
+#include "fs.h"
+#include "sim_radio.h"
+
+#ifndef NODE_GLOBALS
+    #error This application requires a simulation platform (NODE_GLOBALS)
+#endif
+
+#define GATEWAY_NODE            0
+#define SENSOR_FILE_ID          0x40
+#define SENSOR_FILE_SIZE        8
+#define SENSOR_INTERVAL         (TIMER_TICKS_PER_SEC * 60)
+#define REPORT_INTERVAL         (TIMER_TICKS_PER_SEC * 60)
+
+#ifdef SIM_NETWORK_FEC
+    #define CHANNEL_CODING      PHY_CODING_FEC_PN9
+#else
+    #define CHANNEL_CODING      PHY_CODING_PN9
+#endif
+
+static d7asp_master_session_config_t session_config = {
+    .qos = {
+        .qos_resp_mode = SESSION_RESP_MODE_ANY,
+        .qos_retry_mode = SESSION_RETRY_MODE_NO,
+        .qos_stop_on_error       = false,
+        .qos_record              = false
+    },
+    .dormant_timeout = 0,
+    .addressee = {
+        .ctrl = {
+            .nls_method = AES_NONE,
+            .id_type = ID_TYPE_NOID,
+        },
+        .access_class = 0x01,
+        .id = 0
+    }
+};
+
+// the request of the sensor which is in progress
+static timer_tick_t NGDEF(_request_start);
+#define request_start NG(_request_start)
+
+static uint32_t NGDEF(_request_tx_frames);
+#define request_tx_frames NG(_request_tx_frames)
+
+// other sessions, like the version broadcast on boot, are not taken into account
+static bool NGDEF(_request_pending);
+#define request_pending NG(_request_pending)
+
+// statistics of all sensors together
+static uint32_t requests_completed = 0;
+static uint32_t requests_transmitted = 0;
+static uint32_t requests_acked = 0;
+static uint64_t latency_sum = 0;
+static timer_tick_t latency_max = 0;
+
+static alp_init_args_t gateway_alp_init_args;
+static alp_init_args_t sensor_alp_init_args;
+
+static uint32_t ticks_to_ms(timer_tick_t ticks)
+{
+    return (((uint64_t) ticks) * 1000) / TIMER_TICKS_PER_SEC;
+}
+
+void report_statistics()
+{
+    // printed directly, so the statistics are available without FRAMEWORK_LOG_ENABLED
+    sim_radio_stats_t stats;
+    sim_radio_get_medium_stats(&stats);
+    uint64_t elapsed = sim_radio_get_elapsed_ns();
+
+    printf("%lu frames sent, %lu received (%lu with bit errors), %lu lost in collisions, channel utilization %i.%02i%%\n",
+           (unsigned long) stats.tx_frames, (unsigned long) stats.rx_frames, (unsigned long) stats.rx_bit_errors,
+           (unsigned long) stats.rx_collisions,
+           (int) (stats.airtime_ns * 100 / elapsed), (int) ((stats.airtime_ns * 10000 / elapsed) % 100));
+
+    if(requests_completed > 0)
+        printf("%lu requests completed: %lu%% passed CSMA-CA, %lu%% acked\n",
+               (unsigned long) requests_completed, (unsigned long) (requests_transmitted * 100 / requests_completed),
+               (unsigned long) (requests_acked * 100 / requests_completed));
+
+    if(requests_acked > 0)
+        printf("end-to-end latency: avg %lu ms, max %lu ms\n",
+               (unsigned long) ticks_to_ms(latency_sum / requests_acked), (unsigned long) ticks_to_ms(latency_max));
+
+    timer_post_task_delay(&report_statistics, REPORT_INTERVAL);
+}
+
+void execute_sensor_measurement()
+{
+    // the payload is the current timestamp, the gateway does not interpret it
+    timer_tick_t t = timer_get_counter_value();
+    uint8_t alp_command[4 + SENSOR_FILE_SIZE] = {
+        ALP_OP_RETURN_FILE_DATA,
+        SENSOR_FILE_ID,
+        0,
+        SENSOR_FILE_SIZE
+    };
+
+    memcpy(alp_command + 4, (uint8_t*) &t, sizeof(timer_tick_t));
+
+    sim_radio_stats_t stats;
+    sim_radio_get_node_stats(get_node_global_id(), &stats);
+    request_tx_frames = stats.tx_frames;
+    request_start = t;
+    request_pending = true;
+    alp_execute_command(alp_command, sizeof(alp_command), &session_config);
+    timer_post_task_delay(&execute_sensor_measurement, SENSOR_INTERVAL);
+}
+
+void on_alp_command_completed_cb(uint8_t tag_id, bool success)
+{
+    if(!request_pending)
+        return;
+
+    // the request is transmitted when CSMA-CA found the channel free, failures after that are lost acks
+    request_pending = false;
+    sim_radio_stats_t stats;
+    sim_radio_get_node_stats(get_node_global_id(), &stats);
+
+    requests_completed++;
+    if(stats.tx_frames != request_tx_frames)
+        requests_transmitted++;
+
+    if(success)
+    {
+        timer_tick_t latency = timer_get_counter_value() - request_start;
+        requests_acked++;
+        latency_sum += latency;
+        if(latency > latency_max)
+            latency_max = latency;
+    }
+}
+
+static void init_gateway()
+{
+    dae_access_profile_t access_profiles[1] = {
+        {
+            .channel_header = {
+                .ch_coding = CHANNEL_CODING,
+                .ch_class = PHY_CLASS_NORMAL_RATE,
+                .ch_freq_band = PHY_BAND_868
+            },
+            .subprofiles[0] = {
+                .subband_bitmap = 0x01, // only the first subband is selectable
+                .scan_automation_period = 0,
+            },
+            .subbands[0] = (subband_t){
+                .channel_index_start = 0,
+                .channel_index_end = 0,
+                .eirp = 10,
+                .cca = -86,
+                .duty = 0,
+            }
+        }
+    };
+
+    fs_init_args_t fs_init_args = (fs_init_args_t){
+        .fs_user_files_init_cb = NULL,
+        .access_profiles_count = 1,
+        .access_profiles = access_profiles,
+        .access_class = 0x01
+    };
+
+    d7ap_stack_init(&fs_init_args, &gateway_alp_init_args, false, NULL);
+
+    sched_register_task(&report_statistics);
+    timer_post_task_delay(&report_statistics, REPORT_INTERVAL);
+}
+
+static void init_sensor()
+{
+    dae_access_profile_t access_profiles[1] = {
+        {
+            .channel_header = {
+                .ch_coding = CHANNEL_CODING,
+                .ch_class = PHY_CLASS_NORMAL_RATE,
+                .ch_freq_band = PHY_BAND_868
+            },
+            .subprofiles[0] = {
+                .subband_bitmap = 0x00, // void scan automation channel list
+                .scan_automation_period = 0,
+            },
+            .subbands[0] = (subband_t){
+                .channel_index_start = 0,
+                .channel_index_end = 0,
+                .eirp = 10,
+                .cca = -86,
+                .duty = 0,
+            }
+        }
+    };
+
+    fs_init_args_t fs_init_args = (fs_init_args_t){
+        .fs_user_files_init_cb = NULL,
+        .access_profiles_count = 1,
+        .access_profiles = access_profiles,
+        .access_class = 0x01
+    };
+
+    sensor_alp_init_args.alp_command_completed_cb = &on_alp_command_completed_cb;
+    d7ap_stack_init(&fs_init_args, &sensor_alp_init_args, false, NULL);
+
+    // spread the sensors over the interval
+    sched_register_task(&execute_sensor_measurement);
+    timer_post_task_delay(&execute_sensor_measurement, get_rnd() % SENSOR_INTERVAL);
+}
+
+void bootstrap()
+{
+    if(get_node_global_id() == GATEWAY_NODE)
+        init_gateway();
+    else
+        init_sensor();
+}
@@ -0,0 +1,31 @@
+# 
+# OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+# lowpower wireless sensor communication
+#
+# Copyright 2015 University of Antwerp
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+#######################################
+# Toolchain setup native (host) gcc
+#######################################
+
+# This toolchain builds the stack as an ordinary executable for the build host
+# (see the 'linux_host' platform). No cross compilation is involved, so the
+# compiler is the regular host gcc and the usual system headers and libraries
+# are used.
+SET(CMAKE_C_COMPILER   "gcc")
+SET(CMAKE_CXX_COMPILER "g++")
+
+MESSAGE(STATUS "Compiling for the build host using the native gcc toolchain")
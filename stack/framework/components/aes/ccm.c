@@ -47,6 +47,7 @@
  * block cipher mode
  */
 
+#ifndef AES_HARDWARE_SUPPORT
 static void xor_aes_block(uint8_t *dst, const uint8_t *src)
 {
     uint8_t i;
@@ -56,6 +57,62 @@ static void xor_aes_block(uint8_t *dst, const uint8_t *src)
         dst[i] ^= src[i];
     }
 }
+#endif
+
+/*
+ * When the cipher is offloaded, the key of the context is loaded into the peripheral once per CCM operation, the
+ * CBC-MAC and CTR passes below use it without loading it again.
+ */
+static void load_key(const aes_ctx_t *ctx)
+{
+#ifdef AES_HARDWARE_SUPPORT
+    hw_aes_load_key128((const uint8_t *)ctx->key);
+#endif
+}
+
+/*
+ * Continues the CBC-MAC in tag over length bytes of data, a last partial block is zero padded.
+ *
+ * When the cipher is offloaded, the blocks are streamed to the peripheral in one call and the intermediate cipher
+ * blocks never leave it.
+ */
+static void cbc_mac_update(const aes_ctx_t *ctx, uint8_t *tag, const uint8_t *data, uint8_t length)
+{
+#ifdef AES_HARDWARE_SUPPORT
+    hw_aes_cbc_mac128_loaded(tag, data, length);
+#else
+    uint8_t i;
+    uint8_t remainders = length % AES_BLOCK_SIZE; /* Remaining bytes in the last non-full block */
+
+    for (i = 0; i < length / AES_BLOCK_SIZE; i++)
+    {
+        /* X_i+1 = E(K, X_i XOR B_i) */
+        xor_aes_block(tag, data);
+        data += AES_BLOCK_SIZE;
+
+        AES128_ECB_encrypt(ctx, tag, tag);
+    }
+
+    if (remainders)
+    {
+        /* XOR zero-padded last block */
+        for (i = 0; i < remainders; i++)
+            tag[i] ^= *data++;
+
+        AES128_ECB_encrypt(ctx, tag, tag);
+    }
+#endif
+}
+
+/* Encrypts (or decrypts) length bytes with the key stream of the counter mode, starting from counter block ctr_blk */
+static void ctr_update(const aes_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint8_t length, uint8_t *ctr_blk)
+{
+#ifdef AES_HARDWARE_SUPPORT
+    hw_aes_ctr128_loaded(output, input, length, ctr_blk);
+#else
+    AES128_CTR_encrypt(ctx, output, (uint8_t *)input, length, ctr_blk);
+#endif
+}
 
 /*
  * Authentication
@@ -65,12 +122,12 @@ static void xor_aes_block(uint8_t *dst, const uint8_t *src)
  * 
  */
 
-error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
+static error_t cbc_mac( const aes_ctx_t *ctx, uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
                         const uint8_t *add, uint8_t add_len, uint8_t auth_len )
 {
-    uint8_t blk[AES_BLOCK_SIZE];
-    uint8_t i;
-    uint8_t remainders;
+    /* B_0 followed by the additional data blocks */
+    uint8_t blk[3 * AES_BLOCK_SIZE];
+    uint8_t blk_len = AES_BLOCK_SIZE;
     uint8_t tag[AES_BLOCK_SIZE];
 
     /* sanity checks */
@@ -89,109 +146,59 @@ error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const u
      * X_1 := E( K, B_0 )
      * X_i+1 := E( K, X_i XOR B_i )  for i=1, ..., n
      * T := first-M-bytes( X_n+1 )
+     *
+     * which is CBC encryption with a zero IV, of which only the last block is kept.
      */
-
-    /* X_1 = E(K, B_0) */
+    memcpy(blk, iv, AES_BLOCK_SIZE);
     DPRINT("Blk0");
-    DPRINT_DATA((uint8_t *)iv, AES_BLOCK_SIZE);
-    AES128_ECB_encrypt((uint8_t *)iv, tag);
-    DPRINT("X_1 = AES(B_0)");
-    DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    DPRINT_DATA(blk, AES_BLOCK_SIZE);
 
     // if add_len > 0, add more blocks of authentication data
     if (add_len > 0)
     {
-        uint8_t use_len = add_len < AES_BLOCK_SIZE - 1 ? add_len : AES_BLOCK_SIZE - 1;
-        uint8_t remainders = add_len - use_len;
-
-        memset(blk, 0, AES_BLOCK_SIZE);
         // For DASH7, the additional data length shall be encoded in a field of 1 octet.
-        blk[0] = add_len;
-
-        memcpy( blk + 1, add, use_len );
-
-        DPRINT("Blk1");
-        DPRINT_DATA(blk, AES_BLOCK_SIZE);
+        blk[AES_BLOCK_SIZE] = add_len;
+        memcpy(blk + AES_BLOCK_SIZE + 1, add, add_len);
+        blk_len += 1 + add_len;
 
-        xor_aes_block(blk, tag);
-        DPRINT("X_1 XOR B_1");
-        DPRINT_DATA(blk, AES_BLOCK_SIZE);
-        /* X_2 = E(K, X_1 XOR B_1) */
-        AES128_ECB_encrypt(blk, tag);
-        DPRINT("X_2 = AES(X_1 XOR B_1)");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
-
-        if (remainders)
+        // zero pad the last block of additional data, the payload starts in a new block
+        if (blk_len % AES_BLOCK_SIZE)
         {
-            memset(blk, 0, AES_BLOCK_SIZE);
-            memcpy(blk, add + use_len, remainders);
-
-            DPRINT("blk2");
-            DPRINT_DATA(blk, AES_BLOCK_SIZE);
-
-            DPRINT("X_2 XOR B_2");
-            xor_aes_block(blk, tag);
-             /* X_3 = E(K, X_2 XOR B_2) */
-            AES128_ECB_encrypt(blk, tag);
-            DPRINT("X_3 = AES(X_1 XOR B_1)");
-            DPRINT_DATA(tag, AES_BLOCK_SIZE);
+            memset(blk + blk_len, 0, AES_BLOCK_SIZE - blk_len % AES_BLOCK_SIZE);
+            blk_len += AES_BLOCK_SIZE - blk_len % AES_BLOCK_SIZE;
         }
-    }
-
-    remainders = length % AES_BLOCK_SIZE; /* Remaining bytes in the last non-full block */
-    DPRINT("Remainders %d length %d", remainders, length);
-
-    for (i = 0; i < length / AES_BLOCK_SIZE; i++)
-    {
-        DPRINT("Xi");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
-
-        DPRINT("B_i");
-        DPRINT_DATA(payload, AES_BLOCK_SIZE);
-
-        /* X_i+1 = E(K, X_i XOR B_i) */
-        xor_aes_block(tag, payload);
-        DPRINT("X_i XOR B_i");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
-
-        payload += AES_BLOCK_SIZE;
 
-        AES128_ECB_encrypt(tag, tag);
-        DPRINT("X_i+1 = E(K, X_i XOR B_i)");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+        DPRINT("Blk1..");
+        DPRINT_DATA(blk + AES_BLOCK_SIZE, blk_len - AES_BLOCK_SIZE);
     }
 
-    if (remainders)
-    {
-        /* XOR zero-padded last block */
-        DPRINT("Xi");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
-
-        DPRINT("B_i");
-        DPRINT_DATA(payload, AES_BLOCK_SIZE);
-
-        for (i = 0; i < remainders; i++)
-            tag[i] ^= *payload++;
-        DPRINT("X_i XOR B_i");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    memset(tag, 0, AES_BLOCK_SIZE);
+    cbc_mac_update(ctx, tag, blk, blk_len);
 
-        AES128_ECB_encrypt(tag, tag);
-        DPRINT("X_i+1 = E(K, X_i XOR B_i)");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
-    }
+    DPRINT("length %d", length);
+    cbc_mac_update(ctx, tag, payload, length);
+    DPRINT("X_n+1");
+    DPRINT_DATA(tag, AES_BLOCK_SIZE);
 
     memcpy(auth, tag, auth_len);
 
     return SUCCESS;
 }
 
+error_t AES128_CBC_MAC( const aes_ctx_t *ctx, uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                        const uint8_t *add, uint8_t add_len, uint8_t auth_len )
+{
+    load_key(ctx);
+    return cbc_mac(ctx, auth, payload, length, iv, add, add_len, auth_len);
+}
+
 /*
  * Authenticated encryption
  *
  * Ensure that the output is sized to contain the encrypted message payload
  * + the encrypted authentication Tag.
  */
-error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
+error_t AES128_CCM_encrypt( const aes_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
                             const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
                             uint8_t auth_len )
 {
@@ -210,8 +217,10 @@ error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
     if (add_len > (2 * AES_BLOCK_SIZE - 1))
         return EINVAL;
 
+    load_key(ctx);
+
     /* Authentication */
-    ret = AES128_CBC_MAC(auth, payload, length, iv, add, add_len, auth_len);
+    ret = cbc_mac(ctx, auth, payload, length, iv, add, add_len, auth_len);
     if (ret != SUCCESS)
         return ret;
 
@@ -225,13 +234,13 @@ error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
     DPRINT("ctr0");
     DPRINT_DATA(ctr_blk, AES_BLOCK_SIZE);
 
-    AES128_CTR_encrypt(payload, payload, length, ctr_blk);
+    ctr_update(ctx, payload, payload, length, ctr_blk);
     DPRINT("CTR output:");
     DPRINT_DATA(payload, length);
 
     /* Encryption of the authentication tag , reset counter to 0*/
     ctr_blk[0] = (ctr_blk[0] & 0xF0);
-    AES128_CTR_encrypt(auth_crypted, auth, auth_len, ctr_blk);
+    ctr_update(ctx, auth_crypted, auth, auth_len, ctr_blk);
     DPRINT("Encrypted authentication tag:");
     DPRINT_DATA(auth_crypted, auth_len);
     // the 4, 8 or 16 MSB of the MAC are then appended to the payload
@@ -243,7 +252,7 @@ error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
 /*
  * Authenticated decryption
  */
-error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
+error_t AES128_CCM_decrypt( const aes_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
                             const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
                             const uint8_t *auth, uint8_t auth_len )
 {
@@ -261,18 +270,20 @@ error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
     if (add_len > (2 * AES_BLOCK_SIZE - 1))
         return EINVAL;
 
+    load_key(ctx);
+
     /* Decryption of the encrypted authentication Tag */
     ctr_blk[0] = (ctr_blk[0] & 0xF0);
-    AES128_CTR_encrypt(auth_decrypted, (uint8_t *)auth, auth_len, ctr_blk);
+    ctr_update(ctx, auth_decrypted, auth, auth_len, ctr_blk);
     DPRINT("Decrypted authentication tag:");
     DPRINT_DATA(auth_decrypted, auth_len);
 
     /* Decryption of the message payload, counter set to 1 */
     ctr_blk[0] = (ctr_blk[0] & 0xF0) + 1;
-    AES128_CTR_encrypt(payload, payload, length, ctr_blk);
+    ctr_update(ctx, payload, payload, length, ctr_blk);
 
     /* Recompute the CBC-MAC and check the authentication Tag */
-    AES128_CBC_MAC(T, payload, length, iv, add, add_len, auth_len);
+    cbc_mac(ctx, T, payload, length, iv, add, add_len, auth_len);
     DPRINT("Computed authentication tag:");
     DPRINT_DATA(T, auth_len);
 
@@ -31,7 +31,6 @@
 
 #define INITIAL_FECSTATE 0x00
 #define TRELLIS_TERMINATOR 0x0B
-#define FEC_BUFFER_SIZE 128
 
 #define INTERLEAVING
 
@@ -41,22 +40,19 @@ const static uint8_t fec_lut[16] = {0, 3, 1, 2, 3, 0, 2, 1, 3, 0, 2, 1, 0, 3, 1,
 const static uint8_t trellis0_lut[8] = {0, 1, 3, 2, 3, 2, 0, 1};
 const static uint8_t trellis1_lut[8] = {3, 2, 0, 1, 0, 1, 3, 2};
 
-static uint8_t data_buffer[FEC_BUFFER_SIZE];
-static uint8_t* input_buffer;
-static uint8_t* output_buffer;
+// the hard decision branch metrics: the number of bits in which the received symbol (first index) and the expected
+// symbol (second index) differ
+const static uint8_t hard_branch_metric_lut[4][4] = {
+	{0, 1, 1, 2},
+	{1, 0, 2, 1},
+	{1, 2, 0, 1},
+	{2, 1, 1, 0}
+};
 
-static uint8_t packetlength;
-static uint16_t fecpacketlength;
-static uint16_t output_packet_length;
+#define VITERBI_UNREACHABLE_COST 100
 
-static uint8_t processedbytes;
-static uint16_t fecprocessedbytes;
-
-static uint16_t pn9;
-static uint16_t fecstate;
-static VITERBISTATE vstate;
-
-static bool fec_decode(uint8_t* input);
+static bool fec_decode(fec_ctx_t* ctx, const uint8_t* input);
+static bool fec_decode_soft(fec_ctx_t* ctx, const uint8_t* soft);
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_PHY_LOG_ENABLED) // TODO more granular (LOG_PHY_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_PHY, __VA_ARGS__)
@@ -97,7 +93,7 @@ const char *int_to_binary(uint16_t x)
     return b;
 }
 
-static void print_vstate()
+static void print_vstate(VITERBISTATE* vstate)
 {
 //	typedef struct {
 //		uint8_t cost;
@@ -112,12 +108,12 @@ static void print_vstate()
 //	} VITERBISTATE;
 
 	printf("VSTATE:\n");
-	printf(" - path_size: %d\n", vstate.path_size);
-	//printf(" - old: %03d - %s\n", vstate.old->cost, int_to_binary(vstate.old->path));
-	//printf(" - new: %03d - %s\n", vstate.new->cost, int_to_binary(vstate.new->path));
+	printf(" - path_size: %d\n", vstate->path_size);
+	//printf(" - old: %03d - %s\n", vstate->old->cost, int_to_binary(vstate->old->path));
+	//printf(" - new: %03d - %s\n", vstate->new->cost, int_to_binary(vstate->new->path));
 	int i;
 	for (i=0;i<8;i++)
-		printf(" - states - %d: %03d - %s\n", i, vstate.old[i].cost, int_to_binary(vstate.old[i].path));
+		printf(" - states - %d: %03d - %s\n", i, vstate->old[i].cost, int_to_binary(vstate->old[i].path));
 
 }
 
@@ -130,8 +126,10 @@ uint16_t fec_calculated_decoded_length(uint8_t packet_length)
 /* Convolutional encoder */
 uint16_t fec_encode(uint8_t *data, uint16_t nbytes)
 {
-	memcpy(data_buffer, data, nbytes);
-	uint8_t *input = data_buffer;
+	// the encoded data overtakes the input, so encode from a copy (on the stack, to be reentrant)
+	uint8_t input_buffer[nbytes + 3]; // room for the trellis terminator
+	memcpy(input_buffer, data, nbytes);
+	uint8_t *input = input_buffer;
 	unsigned int encstate = 0;
 	int i;
 
@@ -212,9 +210,105 @@ uint16_t fec_encode(uint8_t *data, uint16_t nbytes)
 	return length;
 }
 
+void fec_decode_begin(fec_ctx_t* ctx, uint8_t* output, uint16_t output_length, uint16_t input_length)
+{
+	ctx->output = output;
+	ctx->output_length = output_length;
+	ctx->input_length = input_length;
+	ctx->processed_bytes = 0;
+	ctx->fec_processed_bytes = 0;
+	ctx->decoded_length = 0;
+	ctx->chunk_length = 0;
+
+	ctx->vstate.path_size = 0;
+	ctx->vstate.states1[0].cost = 0;
+	for (uint8_t i = 1; i < 8; i++)
+		ctx->vstate.states1[i].cost = VITERBI_UNREACHABLE_COST;
+
+	ctx->vstate.old = ctx->vstate.states1;
+	ctx->vstate.new = ctx->vstate.states2;
+}
+
+uint16_t fec_decode_feed(fec_ctx_t* ctx, const uint8_t* data, uint16_t length)
+{
+	// complete a chunk which was split over the previous calls first
+	if (ctx->chunk_length > 0)
+	{
+		while (ctx->chunk_length < 4 && length > 0)
+		{
+			ctx->chunk[ctx->chunk_length++] = *data++;
+			length--;
+		}
+
+		if (ctx->chunk_length < 4)
+			return ctx->decoded_length;
+
+		if (!fec_decode(ctx, ctx->chunk))
+			DPRINT("FEC decoding error\n");
+
+		ctx->decoded_length += 2;
+		ctx->chunk_length = 0;
+	}
+
+	for (; length >= 4; length -= 4, data += 4)
+	{
+		if (!fec_decode(ctx, data))
+			DPRINT("FEC decoding error\n");
+
+		ctx->decoded_length += 2;
+	}
+
+	memcpy(ctx->chunk, data, length);
+	ctx->chunk_length = length;
+	return ctx->decoded_length;
+}
+
+uint16_t fec_decode_end(fec_ctx_t* ctx)
+{
+	if (ctx->chunk_length > 0)
+		DPRINT("FEC decoding error: %d trailing bytes are not 32 bit aligned\n", ctx->chunk_length);
+
+	return ctx->decoded_length;
+}
+
+uint16_t fec_decode_soft_feed(fec_ctx_t* ctx, const uint8_t* soft, uint16_t length)
+{
+	if (length % FEC_SOFT_CHUNK_SIZE != 0)
+		DPRINT("FEC decoding error: %d soft values are not 32 bit aligned\n", length);
+
+	for (; length >= FEC_SOFT_CHUNK_SIZE; length -= FEC_SOFT_CHUNK_SIZE, soft += FEC_SOFT_CHUNK_SIZE)
+	{
+		if (!fec_decode_soft(ctx, soft))
+			DPRINT("FEC decoding error\n");
+
+		ctx->decoded_length += 2;
+	}
+
+	return ctx->decoded_length;
+}
+
+uint8_t fec_decode_packet_soft(const uint8_t* soft, uint8_t* output, uint8_t packet_length, uint8_t output_length)
+{
+	if(output_length < packet_length)
+	{
+		DPRINT("FEC decoding error: buffer to small\n");
+		return 0;
+	}
+
+	if(packet_length % 4 != 0)
+	{
+		DPRINT("FEC decoding error: data 32 bit aligned\n");
+		return 0;
+	}
+
+	fec_ctx_t ctx;
+	fec_decode_begin(&ctx, output, packet_length, ((packet_length & 0xFE) + 2) << 1);
+	fec_decode_soft_feed(&ctx, soft, packet_length * 8);
+	return fec_decode_end(&ctx);
+}
+
 uint8_t fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_length)
 {
-	uint8_t* output = data_buffer;
 	if(output_length < packet_length)
 	{
 		DPRINT("FEC decoding error: buffer to small\n");
@@ -227,52 +321,106 @@ uint8_t fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_l
 		return 0;
 	}
 
-	output_buffer = output;
-	packetlength = packet_length;
-	fecpacketlength = ((packet_length & 0xFE) + 2) << 1;
-	output_packet_length = output_length;
+	// the decoded data is written behind the encoded data which is still to be decoded, so this can be done in place
+	fec_ctx_t ctx;
+	fec_decode_begin(&ctx, data, packet_length, ((packet_length & 0xFE) + 2) << 1);
+	fec_decode_feed(&ctx, data, packet_length);
+	return fec_decode_end(&ctx);
+}
 
-	processedbytes = 0;
-	fecprocessedbytes = 0;
+// processes one received symbol, given the branch metric for each of the 4 symbols which could have been sent
+static void viterbi_add_compare_select(VITERBISTATE* vstate, const uint8_t* branch_metric)
+{
+	uint8_t k;
+	VITERBIPATH* vstate_tmp;
 
-	vstate.path_size = 0;
+	for(k = 0; k < 8; k++) {
+		uint16_t cost0, cost1;
+		uint8_t state0, state1;
+		uint16_t metric0, metric1;
 
-	vstate.states1[0].cost = 0;
-	int16_t i;
-	for (i=1;i<8;i++)
-			vstate.states1[i].cost = 100;
+		state0 = k >> 1;
+		state1 = state0 + 4;
 
-	vstate.old = vstate.states1;
-	vstate.new = vstate.states2;
+		cost0  = vstate->old[state0].cost;
+		cost1  = vstate->old[state1].cost;
 
-	uint8_t decoded_length = 0;
+		//butterfly operation for 0
+		metric0 = cost0 + branch_metric[trellis0_lut[state0]];
+		metric1 = cost1 + branch_metric[trellis0_lut[state1]];
 
-	for(i = 0; i < packet_length; i =i+4)
-	{
-		//printf("FEC encoding i = %d\n", i);
+		if(metric0 <= metric1) {
+			vstate->new[k].cost = metric0;
+			vstate->new[k].path = vstate->old[state0].path << 1;
+		} else {
+			vstate->new[k].cost = metric1;
+			vstate->new[k].path = vstate->old[state1].path << 1;
+		}
+
+		k++;
+
+		//butterfly operation for 1
+		metric0 = cost0 + branch_metric[trellis1_lut[state0]];
+		metric1 = cost1 + branch_metric[trellis1_lut[state1]];
 
-		bool err = fec_decode(&data[i]);
-		decoded_length+=2;
-		if (!err)
-			DPRINT("FEC encoding error\n");
+		if(metric0 <= metric1) {
+			vstate->new[k].cost = metric0;
+			vstate->new[k].path = vstate->old[state0].path << 1 | 0x01;
+		} else {
+			vstate->new[k].cost = metric1;
+			vstate->new[k].path = vstate->old[state1].path << 1 | 0x01;
+		}
 	}
 
-	memcpy(data, data_buffer, decoded_length);
+	//Swap Viterbi paths
+	vstate_tmp = vstate->new;
+	vstate->new = vstate->old;
+	vstate->old = vstate_tmp;
+}
+
+// called after every 8 symbols, writes out the oldest decoded byte once the path holds 2 bytes
+static void viterbi_output_byte(fec_ctx_t* ctx)
+{
+	VITERBISTATE* vstate = &(ctx->vstate);
+	uint8_t min_state;
+	uint16_t min_cost;
+	int8_t j;
+
+	vstate->path_size++;
 
-	return decoded_length;
+	//Flush out byte if path is full
+	if ((vstate->path_size == 2) && (ctx->processed_bytes < ctx->output_length)) {
+		//Calculate path with lowest cost
+		min_state = 0;
+		for (j = 7; j != 0; j--) {
+			if(vstate->old[j].cost < vstate->old[min_state].cost)
+				min_state = j;
+		}
+
+		//Normalize costs (the minimum is kept aside, the cost of min_state itself becomes 0 halfway the loop)
+		min_cost = vstate->old[min_state].cost;
+		if (min_cost > 0)
+			for (j = 0; j < 8; j++) vstate->old[j].cost -= min_cost;
+
+		*ctx->output++ = vstate->old[min_state].path >> 8;
+		vstate->path_size--;
+
+		ctx->processed_bytes++;
+
+		if (ctx->processed_bytes + 2 == ctx->output_length)
+			*ctx->output = (uint8_t) (vstate->old[min_state].path);
+	}
 }
 
-static bool fec_decode(uint8_t* input)
+static bool fec_decode(fec_ctx_t* ctx, const uint8_t* input)
 {
-	uint8_t i, k;
+	uint8_t i;
 	int8_t j;
-	uint8_t min_state;
 	uint8_t symbol;
 	uint16_t tmppn9;
 	uint8_t fecbuffer[4];
-	VITERBIPATH* vstate_tmp;
 
-	if(fecprocessedbytes >= fecpacketlength)
+	if(ctx->fec_processed_bytes >= ctx->input_length)
 		return false;
 
 	//Deinterleaving (symbols are stored in reverse as this is easier for Viterbi decoding)
@@ -303,101 +451,54 @@ static bool fec_decode(uint8_t* input)
 	fecbuffer[3] = input[3];
 #endif
 	//printf(" input = %04X%04X\n", fecbuffer[0],fecbuffer[1]);
-	fecprocessedbytes +=4;
+	ctx->fec_processed_bytes +=4;
 
 	for (i = 0; i < 3; i=i+2) {
 		//Viterbi decoding
-		//printf(" Encode i  %d -> %04X %s\n", i, fecbuffer[i], int_to_binary(fecbuffer[i]));
-
-		// todo: fix for loop
 		for (j = 7; j >= 0; j--) {
 			if (j>3)
 				symbol = (fecbuffer[i] >> (j-4)*2) & 0x03;
 			else
 				symbol = (fecbuffer[i+1] >> j*2) & 0x03;
-			//printf(" Symbol %d %x - %s\n", j, symbol, int_to_binary(symbol));
-			//fecbuffer[i] >>= 2;
-
-			for(k = 0; k < 8; k++) {
-				uint8_t cost0, cost1;
-				uint8_t state0, state1;
-				uint8_t hamming0, hamming1;
-
-				state0 = k >> 1;
-				state1 = state0 + 4;
-
-				cost0  = vstate.old[state0].cost;
-				cost1  = vstate.old[state1].cost;
-
-				//butterfly operation for 0
-				hamming0 = cost0 + (((trellis0_lut[state0] ^ symbol) + 1) >> 1);
-				hamming1 = cost1 + (((trellis0_lut[state1] ^ symbol) + 1) >> 1);
-
-				if(hamming0 <= hamming1) {
-					vstate.new[k].cost = hamming0;
-					vstate.new[k].path = vstate.old[state0].path << 1;
-				} else {
-					vstate.new[k].cost = hamming1;
-					vstate.new[k].path = vstate.old[state1].path << 1;
-				}
-
-				//printf("k %d part 1\n");
-				//print_vstate();
-
-				k++;
-
-				//butterfly operation for 1
-				hamming0 = cost0 + (((trellis1_lut[state0] ^ symbol) + 1) >> 1);
-				hamming1 = cost1 + (((trellis1_lut[state1] ^ symbol) + 1) >> 1);
-
-				if(hamming0 <= hamming1) {
-					vstate.new[k].cost = hamming0;
-					vstate.new[k].path = vstate.old[state0].path << 1 | 0x01;
-				} else {
-					vstate.new[k].cost = hamming1;
-					vstate.new[k].path = vstate.old[state1].path << 1 | 0x01;
-				}
-
-				//printf("k %d part 2\n");
-				//print_vstate();
-			}
-
-			//Swap Viterbi paths
-			vstate_tmp = vstate.new;
-			vstate.new = vstate.old;
-			vstate.old = vstate_tmp;
 
-			//print_vstate();
+			viterbi_add_compare_select(&(ctx->vstate), hard_branch_metric_lut[symbol]);
 		}
 
-		vstate.path_size++;
+		viterbi_output_byte(ctx);
+	}
 
-		//Flush out byte if path is full
-		if ((vstate.path_size == 2) && (processedbytes < packetlength)) {
-			//Calculate path with lowest cost
-			min_state = 0;
-			for (j = 7; j != 0; j--) {
-				if(vstate.old[j].cost < vstate.old[min_state].cost)
-					min_state = j;
-			}
+	return true;
+}
 
-	        //Normalize costs
-			if (vstate.old[min_state].cost > 0)
-				for (j = 0; j < 8; j++) vstate.old[j].cost -= vstate.old[min_state].cost;
+static bool fec_decode_soft(fec_ctx_t* ctx, const uint8_t* soft)
+{
+	uint8_t branch_metric[4];
+	uint8_t i;
 
-			*output_buffer++ = vstate.old[min_state].path >> 8;
-			vstate.path_size--;
+	if(ctx->fec_processed_bytes >= ctx->input_length)
+		return false;
 
-			processedbytes++;
+	ctx->fec_processed_bytes +=4;
 
-			if (processedbytes+ 2 == packetlength)
-				*output_buffer = (uint8_t) (vstate.old[min_state].path);
-		}
-	}
+	for (i = 0; i < 16; i++) {
+		// the soft values of the 2 bits of the i-th symbol, deinterleaved the same way as in fec_decode()
+#ifdef INTERLEAVING
+		const uint8_t* symbol = &soft[((3 - (i & 0x03)) << 3) + 6 - ((i >> 2) << 1)];
+#else
+		const uint8_t* symbol = &soft[i << 1];
+#endif
 
-	//print_vstate();
+		// the branch metric is the distance between the received soft values and the expected symbol
+		branch_metric[0] = symbol[0] + symbol[1];
+		branch_metric[1] = symbol[0] + (FEC_SOFT_MAX - symbol[1]);
+		branch_metric[2] = (FEC_SOFT_MAX - symbol[0]) + symbol[1];
+		branch_metric[3] = (FEC_SOFT_MAX - symbol[0]) + (FEC_SOFT_MAX - symbol[1]);
 
+		viterbi_add_compare_select(&(ctx->vstate), branch_metric);
 
+		if ((i & 0x07) == 0x07)
+			viterbi_output_byte(ctx);
+	}
 
 	return true;
 }
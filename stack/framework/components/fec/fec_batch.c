@@ -0,0 +1,305 @@
+/*! \file fec_batch.c
+ *
+ *  \copyright (C) Copyright 2015 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Multi frame FEC decoding and PN9 (de)whitening, for gateways which process the raw frames of many channels on
+ * the host. The Viterbi decoder runs the trellis of one frame per 16 bit SIMD lane: 16 frames at once with AVX2,
+ * 8 with SSE2. Without either instruction set every frame is decoded by fec_decode_packet().
+ * The results are identical to fec_decode_packet().
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "framework_defs.h"
+#include "fec.h"
+
+#ifdef FRAMEWORK_FEC_BATCH_ENABLED
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+#define FEC_BATCH_LANES 16
+typedef __m256i vec_t;
+#define VEC_LOAD(p) _mm256_loadu_si256((const vec_t*) (p))
+#define VEC_STORE(p, a) _mm256_storeu_si256((vec_t*) (p), a)
+#define VEC_SET1(x) _mm256_set1_epi16(x)
+#define VEC_ADD(a, b) _mm256_add_epi16(a, b)
+#define VEC_SUB(a, b) _mm256_sub_epi16(a, b)
+#define VEC_MIN(a, b) _mm256_min_epi16(a, b)
+#define VEC_CMPGT(a, b) _mm256_cmpgt_epi16(a, b)
+#define VEC_CMPEQ(a, b) _mm256_cmpeq_epi16(a, b)
+#define VEC_AND(a, b) _mm256_and_si256(a, b)
+#define VEC_ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define VEC_OR(a, b) _mm256_or_si256(a, b)
+#define VEC_XOR(a, b) _mm256_xor_si256(a, b)
+#define VEC_SLLI(a, n) _mm256_slli_epi16(a, n)
+#define VEC_SRLI(a, n) _mm256_srli_epi16(a, n)
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define FEC_BATCH_LANES 8
+typedef __m128i vec_t;
+#define VEC_LOAD(p) _mm_loadu_si128((const vec_t*) (p))
+#define VEC_STORE(p, a) _mm_storeu_si128((vec_t*) (p), a)
+#define VEC_SET1(x) _mm_set1_epi16(x)
+#define VEC_ADD(a, b) _mm_add_epi16(a, b)
+#define VEC_SUB(a, b) _mm_sub_epi16(a, b)
+#define VEC_MIN(a, b) _mm_min_epi16(a, b)
+#define VEC_CMPGT(a, b) _mm_cmpgt_epi16(a, b)
+#define VEC_CMPEQ(a, b) _mm_cmpeq_epi16(a, b)
+#define VEC_AND(a, b) _mm_and_si128(a, b)
+#define VEC_ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define VEC_OR(a, b) _mm_or_si128(a, b)
+#define VEC_XOR(a, b) _mm_xor_si128(a, b)
+#define VEC_SLLI(a, n) _mm_slli_epi16(a, n)
+#define VEC_SRLI(a, n) _mm_srli_epi16(a, n)
+#endif
+
+#define PN9_PERIOD 511
+
+// the PN9 sequence (x^9 + x^5 + 1, seeded with 0x1FF) as it is XOR-ed byte per byte with the data, it repeats
+// itself after PN9_PERIOD bytes
+const static uint8_t pn9_lut[PN9_PERIOD] = {
+	0xFF, 0xE1, 0x1D, 0x9A, 0xED, 0x85, 0x33, 0x24, 0xEA, 0x7A, 0xD2, 0x39, 0x70, 0x97, 0x57, 0x0A,
+	0x54, 0x7D, 0x2D, 0xD8, 0x6D, 0x0D, 0xBA, 0x8F, 0x67, 0x59, 0xC7, 0xA2, 0xBF, 0x34, 0xCA, 0x18,
+	0x30, 0x53, 0x93, 0xDF, 0x92, 0xEC, 0xA7, 0x15, 0x8A, 0xDC, 0xF4, 0x86, 0x55, 0x4E, 0x18, 0x21,
+	0x40, 0xC4, 0xC4, 0xD5, 0xC6, 0x91, 0x8A, 0xCD, 0xE7, 0xD1, 0x4E, 0x09, 0x32, 0x17, 0xDF, 0x83,
+	0xFF, 0xF0, 0x0E, 0xCD, 0xF6, 0xC2, 0x19, 0x12, 0x75, 0x3D, 0xE9, 0x1C, 0xB8, 0xCB, 0x2B, 0x05,
+	0xAA, 0xBE, 0x16, 0xEC, 0xB6, 0x06, 0xDD, 0xC7, 0xB3, 0xAC, 0x63, 0xD1, 0x5F, 0x1A, 0x65, 0x0C,
+	0x98, 0xA9, 0xC9, 0x6F, 0x49, 0xF6, 0xD3, 0x0A, 0x45, 0x6E, 0x7A, 0xC3, 0x2A, 0x27, 0x8C, 0x10,
+	0x20, 0x62, 0xE2, 0x6A, 0xE3, 0x48, 0xC5, 0xE6, 0xF3, 0x68, 0xA7, 0x04, 0x99, 0x8B, 0xEF, 0xC1,
+	0x7F, 0x78, 0x87, 0x66, 0x7B, 0xE1, 0x0C, 0x89, 0xBA, 0x9E, 0x74, 0x0E, 0xDC, 0xE5, 0x95, 0x02,
+	0x55, 0x5F, 0x0B, 0x76, 0x5B, 0x83, 0xEE, 0xE3, 0x59, 0xD6, 0xB1, 0xE8, 0x2F, 0x8D, 0x32, 0x06,
+	0xCC, 0xD4, 0xE4, 0xB7, 0x24, 0xFB, 0x69, 0x85, 0x22, 0x37, 0xBD, 0x61, 0x95, 0x13, 0x46, 0x08,
+	0x10, 0x31, 0x71, 0xB5, 0x71, 0xA4, 0x62, 0xF3, 0x79, 0xB4, 0x53, 0x82, 0xCC, 0xC5, 0xF7, 0xE0,
+	0x3F, 0xBC, 0x43, 0xB3, 0xBD, 0x70, 0x86, 0x44, 0x5D, 0x4F, 0x3A, 0x07, 0xEE, 0xF2, 0x4A, 0x81,
+	0xAA, 0xAF, 0x05, 0xBB, 0xAD, 0x41, 0xF7, 0xF1, 0x2C, 0xEB, 0x58, 0xF4, 0x97, 0x46, 0x19, 0x03,
+	0x66, 0x6A, 0xF2, 0x5B, 0x92, 0xFD, 0xB4, 0x42, 0x91, 0x9B, 0xDE, 0xB0, 0xCA, 0x09, 0x23, 0x04,
+	0x88, 0x98, 0xB8, 0xDA, 0x38, 0x52, 0xB1, 0xF9, 0x3C, 0xDA, 0x29, 0x41, 0xE6, 0xE2, 0x7B, 0xF0,
+	0x1F, 0xDE, 0xA1, 0xD9, 0x5E, 0x38, 0x43, 0xA2, 0xAE, 0x27, 0x9D, 0x03, 0x77, 0x79, 0xA5, 0x40,
+	0xD5, 0xD7, 0x82, 0xDD, 0xD6, 0xA0, 0xFB, 0x78, 0x96, 0x75, 0x2C, 0xFA, 0x4B, 0xA3, 0x8C, 0x01,
+	0x33, 0x35, 0xF9, 0x2D, 0xC9, 0x7E, 0x5A, 0xA1, 0xC8, 0x4D, 0x6F, 0x58, 0xE5, 0x84, 0x11, 0x02,
+	0x44, 0x4C, 0x5C, 0x6D, 0x1C, 0xA9, 0xD8, 0x7C, 0x1E, 0xED, 0x94, 0x20, 0x73, 0xF1, 0x3D, 0xF8,
+	0x0F, 0xEF, 0xD0, 0x6C, 0x2F, 0x9C, 0x21, 0x51, 0xD7, 0x93, 0xCE, 0x81, 0xBB, 0xBC, 0x52, 0xA0,
+	0xEA, 0x6B, 0xC1, 0x6E, 0x6B, 0xD0, 0x7D, 0x3C, 0xCB, 0x3A, 0x16, 0xFD, 0xA5, 0x51, 0xC6, 0x80,
+	0x99, 0x9A, 0xFC, 0x96, 0x64, 0x3F, 0xAD, 0x50, 0xE4, 0xA6, 0x37, 0xAC, 0x72, 0xC2, 0x08, 0x01,
+	0x22, 0x26, 0xAE, 0x36, 0x8E, 0x54, 0x6C, 0x3E, 0x8F, 0x76, 0x4A, 0x90, 0xB9, 0xF8, 0x1E, 0xFC,
+	0x87, 0x77, 0x68, 0xB6, 0x17, 0xCE, 0x90, 0xA8, 0xEB, 0x49, 0xE7, 0xC0, 0x5D, 0x5E, 0x29, 0x50,
+	0xF5, 0xB5, 0x60, 0xB7, 0x35, 0xE8, 0x3E, 0x9E, 0x65, 0x1D, 0x8B, 0xFE, 0xD2, 0x28, 0x63, 0xC0,
+	0x4C, 0x4D, 0x7E, 0x4B, 0xB2, 0x9F, 0x56, 0x28, 0x72, 0xD3, 0x1B, 0x56, 0x39, 0x61, 0x84, 0x00,
+	0x11, 0x13, 0x57, 0x1B, 0x47, 0x2A, 0x36, 0x9F, 0x47, 0x3B, 0x25, 0xC8, 0x5C, 0x7C, 0x0F, 0xFE,
+	0xC3, 0x3B, 0x34, 0xDB, 0x0B, 0x67, 0x48, 0xD4, 0xF5, 0xA4, 0x73, 0xE0, 0x2E, 0xAF, 0x14, 0xA8,
+	0xFA, 0x5A, 0xB0, 0xDB, 0x1A, 0x74, 0x1F, 0xCF, 0xB2, 0x8E, 0x45, 0x7F, 0x69, 0x94, 0x31, 0x60,
+	0xA6, 0x26, 0xBF, 0x25, 0xD9, 0x4F, 0x2B, 0x14, 0xB9, 0xE9, 0x0D, 0xAB, 0x9C, 0x30, 0x42, 0x80,
+	0x88, 0x89, 0xAB, 0x8D, 0x23, 0x15, 0x9B, 0xCF, 0xA3, 0x9D, 0x12, 0x64, 0x2E, 0xBE, 0x07
+};
+
+#ifdef FEC_BATCH_LANES
+
+#define VITERBI_UNREACHABLE_COST 100
+
+const static uint8_t trellis0_lut[8] = {0, 1, 3, 2, 3, 2, 0, 1};
+const static uint8_t trellis1_lut[8] = {3, 2, 0, 1, 0, 1, 3, 2};
+
+// decodes up to FEC_BATCH_LANES frames in place, one per lane, the same way as fec_decode_packet()
+static void decode_lanes(uint8_t** frames, const uint8_t* packet_lengths, uint8_t* decoded_lengths, uint8_t count)
+{
+	int16_t symbols[16][FEC_BATCH_LANES];
+	int16_t lane_path[FEC_BATCH_LANES];
+	uint8_t chunks[FEC_BATCH_LANES];
+	uint8_t processed_bytes[FEC_BATCH_LANES];
+	uint8_t max_chunks = 0;
+	vec_t states1[2][8];
+	vec_t states2[2][8];
+	vec_t (*old)[8] = states1;
+	vec_t (*new)[8] = states2;
+	vec_t (*tmp)[8];
+	vec_t branch_metric[4];
+	uint8_t path_size = 0;
+	uint8_t lane, chunk, i, k;
+
+	for (lane = 0; lane < FEC_BATCH_LANES; lane++)
+	{
+		chunks[lane] = 0;
+		processed_bytes[lane] = 0;
+		if (lane >= count)
+			continue;
+
+		if (packet_lengths[lane] % 4 != 0)
+		{
+			decoded_lengths[lane] = 0;
+			continue;
+		}
+
+		chunks[lane] = packet_lengths[lane] / 4;
+		decoded_lengths[lane] = chunks[lane] * 2;
+		if (chunks[lane] > max_chunks)
+			max_chunks = chunks[lane];
+	}
+
+	// old[0] holds the costs and old[1] the paths of the 8 trellis states
+	for (k = 0; k < 8; k++)
+	{
+		old[0][k] = VEC_SET1(k == 0 ? 0 : VITERBI_UNREACHABLE_COST);
+		old[1][k] = VEC_SET1(0);
+	}
+
+	for (chunk = 0; chunk < max_chunks; chunk++)
+	{
+		// deinterleave the next 4 encoded bytes of every lane into its next 16 symbols
+		for (lane = 0; lane < FEC_BATCH_LANES; lane++)
+		{
+			uint8_t fecbuffer[4] = {0, 0, 0, 0};
+			if (chunk < chunks[lane])
+			{
+				const uint8_t* input = frames[lane] + chunk * 4;
+				for (i = 0; i < 4; i++)
+					fecbuffer[i] = (((input[0] >> (i * 2)) & 0x03)) |\
+							(((input[1] >> (i * 2)) & 0x03) << 2) |\
+							(((input[2] >> (i * 2)) & 0x03) << 4) |\
+							(((input[3] >> (i * 2)) & 0x03) << 6);
+			}
+
+			for (i = 0; i < 16; i++)
+				symbols[i][lane] = (fecbuffer[i >> 2] >> ((3 - (i & 0x03)) << 1)) & 0x03;
+		}
+
+		for (i = 0; i < 16; i++)
+		{
+			vec_t symbol = VEC_LOAD(symbols[i]);
+
+			// the branch metric of an expected symbol is the number of bits in which it differs from the received one
+			for (k = 0; k < 4; k++)
+			{
+				vec_t diff = VEC_XOR(symbol, VEC_SET1(k));
+				branch_metric[k] = VEC_ADD(VEC_AND(diff, VEC_SET1(1)), VEC_SRLI(diff, 1));
+			}
+
+			for (k = 0; k < 8; k++)
+			{
+				uint8_t state0 = k >> 1;
+				uint8_t state1 = state0 + 4;
+				vec_t metric0, metric1, select_state1;
+
+				//butterfly operation for 0
+				metric0 = VEC_ADD(old[0][state0], branch_metric[trellis0_lut[state0]]);
+				metric1 = VEC_ADD(old[0][state1], branch_metric[trellis0_lut[state1]]);
+				select_state1 = VEC_CMPGT(metric0, metric1);
+				new[0][k] = VEC_MIN(metric0, metric1);
+				new[1][k] = VEC_SLLI(VEC_OR(VEC_ANDNOT(select_state1, old[1][state0]), VEC_AND(select_state1, old[1][state1])), 1);
+
+				k++;
+
+				//butterfly operation for 1
+				metric0 = VEC_ADD(old[0][state0], branch_metric[trellis1_lut[state0]]);
+				metric1 = VEC_ADD(old[0][state1], branch_metric[trellis1_lut[state1]]);
+				select_state1 = VEC_CMPGT(metric0, metric1);
+				new[0][k] = VEC_MIN(metric0, metric1);
+				new[1][k] = VEC_OR(VEC_SLLI(VEC_OR(VEC_ANDNOT(select_state1, old[1][state0]), VEC_AND(select_state1, old[1][state1])), 1), VEC_SET1(1));
+			}
+
+			//Swap Viterbi paths
+			tmp = new;
+			new = old;
+			old = tmp;
+
+			if ((i & 0x07) != 0x07)
+				continue;
+
+			path_size++;
+			if (path_size < 2)
+				continue;
+
+			// flush out the oldest byte of the path with the lowest cost. On equal costs the state with the
+			// highest index is taken, except for state 0, like fec_decode_packet() does
+			vec_t min_cost = old[0][0];
+			for (k = 1; k < 8; k++)
+				min_cost = VEC_MIN(min_cost, old[0][k]);
+
+			vec_t path = VEC_SET1(0);
+			for (k = 1; k <= 8; k++)
+			{
+				vec_t is_min = VEC_CMPEQ(old[0][k & 0x07], min_cost);
+				path = VEC_OR(VEC_ANDNOT(is_min, path), VEC_AND(is_min, old[1][k & 0x07]));
+			}
+
+			//Normalize costs
+			for (k = 0; k < 8; k++)
+				old[0][k] = VEC_SUB(old[0][k], min_cost);
+
+			VEC_STORE(lane_path, path);
+			for (lane = 0; lane < FEC_BATCH_LANES; lane++)
+			{
+				if (chunk >= chunks[lane])
+					continue;
+
+				frames[lane][processed_bytes[lane]++] = (uint16_t) lane_path[lane] >> 8;
+				if (processed_bytes[lane] + 2 == packet_lengths[lane])
+					frames[lane][processed_bytes[lane]] = (uint8_t) lane_path[lane];
+			}
+
+			path_size--;
+		}
+	}
+}
+
+#endif /* FEC_BATCH_LANES */
+
+void fec_decode_packet_batch(uint8_t** frames, const uint8_t* packet_lengths, uint8_t* decoded_lengths, uint16_t count)
+{
+#ifdef FEC_BATCH_LANES
+	for (; count > 0; )
+	{
+		uint8_t lanes = count < FEC_BATCH_LANES ? count : FEC_BATCH_LANES;
+		decode_lanes(frames, packet_lengths, decoded_lengths, lanes);
+		frames += lanes;
+		packet_lengths += lanes;
+		decoded_lengths += lanes;
+		count -= lanes;
+	}
+#else
+	uint16_t i;
+	for (i = 0; i < count; i++)
+		decoded_lengths[i] = fec_decode_packet(frames[i], packet_lengths[i], packet_lengths[i]);
+#endif
+}
+
+void fec_pn9(uint8_t* data, uint16_t length)
+{
+	uint16_t i = 0;
+
+#ifdef FEC_BATCH_LANES
+	for (; i + sizeof(vec_t) <= length && i + sizeof(vec_t) <= PN9_PERIOD; i += sizeof(vec_t))
+		VEC_STORE(data + i, VEC_XOR(VEC_LOAD(data + i), VEC_LOAD(pn9_lut + i)));
+#endif
+
+	for (; i < length; i++)
+		data[i] ^= pn9_lut[i % PN9_PERIOD];
+}
+
+void fec_pn9_batch(uint8_t** frames, const uint16_t* lengths, uint16_t count)
+{
+	uint16_t i;
+	for (i = 0; i < count; i++)
+		fec_pn9(frames[i], lengths[i]);
+}
+
+#endif /* FRAMEWORK_FEC_BATCH_ENABLED */
@@ -41,6 +41,12 @@
 
 static uint32_t NGDEF(counter);
 
+#ifdef NODE_GLOBALS
+// prefix the messages with the node that logged them
+#define print_log_prefix() printf("\n\r[%03d|%03d]", (int) get_node_global_id(), NG(counter)++)
+#else
+#define print_log_prefix() printf("\n\r[%03d]", NG(counter)++)
+#endif
 
 __LINK_C void log_counter_reset()
 {
@@ -51,7 +57,8 @@ __LINK_C void log_print_string(char* format, ...)
 {
     va_list args;
     va_start(args, format);
-    printf("\n\r[%03d] ", NG(counter)++);
+    print_log_prefix();
+    printf(" ");
     vprintf(format, args);
     va_end(args);
 }
@@ -60,14 +67,15 @@ __LINK_C void log_print_stack_string(log_stack_layer_t type, char* format, ...)
 {
     va_list args;
     va_start(args, format);
-    printf("\n\r[%03d] ", NG(counter)++);
+    print_log_prefix();
+    printf(" ");
     vprintf(format, args);
     va_end(args);
 }
 
 __LINK_C void log_print_data(uint8_t* message, uint32_t length)
 {
-    printf("\n\r[%03d]", NG(counter)++);
+    print_log_prefix();
     for( uint32_t i=0 ; i<length ; i++ )
     {
         printf(" %02X", message[i]);
@@ -36,17 +36,21 @@
 
 #include "framework_defs.h"
 #define SCHEDULER_MAX_TASKS FRAMEWORK_SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_ARG_TASKS FRAMEWORK_SCHEDULER_MAX_ARG_TASKS
 
-#ifdef NODE_GLOBALS
-    #warning NODE_GLOBALS is defined when using the default scheduler. Are you sure this is what you want ?
+#if SCHEDULER_MAX_TASKS + SCHEDULER_MAX_ARG_TASKS >= INVALID_TASK_HANDLE
+    #error SCHEDULER_MAX_TASKS + SCHEDULER_MAX_ARG_TASKS should be smaller than INVALID_TASK_HANDLE
 #endif
 
+
 enum
 {
 	NUM_PRIORITIES = MIN_PRIORITY+1,
 	NUM_TASKS = SCHEDULER_MAX_TASKS,
+	//the slots of the pending tasks carrying an argument follow the registered tasks in m_info
+	NUM_SLOTS = SCHEDULER_MAX_TASKS + SCHEDULER_MAX_ARG_TASKS,
 	NOT_SCHEDULED = NUM_PRIORITIES,
-	NO_TASK = SCHEDULER_MAX_TASKS,
+	NO_TASK = NUM_SLOTS,
 };
 
 typedef struct
@@ -66,19 +70,77 @@ typedef struct
 } taskindex_info_t;
 
 taskindex_info_t NGDEF(m_index)[NUM_TASKS];
-task_info_t NGDEF(m_info)[NUM_TASKS];
+task_info_t NGDEF(m_info)[NUM_SLOTS];
+void* NGDEF(m_arg)[SCHEDULER_MAX_ARG_TASKS];
+//the unused argument slots, linked through m_info[].next
+uint8_t NGDEF(m_free_arg_slots);
+uint8_t NGDEF(m_free_arg_slot_count);
+//the number of unused argument slots which can only be taken by sched_post_reserved_task_arg_prio()
+uint8_t NGDEF(m_reserved_arg_slots);
 
 uint8_t NGDEF(m_head)[NUM_PRIORITIES];
 uint8_t NGDEF(m_tail)[NUM_PRIORITIES];
-volatile uint8_t NGDEF(current_priority);
 unsigned int NGDEF(num_registered_tasks);
+
+//bitmap of the priorities which have tasks waiting. The bit of MAX_PRIORITY is the most significant bit,
+//so the highest priority with waiting tasks is found by counting the leading zeros
+volatile unsigned int NGDEF(ready_priorities);
+
+#define PRIORITY_BIT(priority) ((1U << (sizeof(unsigned int) * 8 - 1)) >> (priority))
+
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+#include "timer.h"
+
+sched_task_stats_t NGDEF(m_stats)[NUM_TASKS];
+timer_tick_t NGDEF(m_posted_at)[NUM_TASKS];
+timer_tick_t NGDEF(stats_start);
+uint32_t NGDEF(lowpower_time);
+
+static inline void profile_post(uint8_t id)
+{
+	NG(m_stats)[id].post_count++;
+	NG(m_posted_at)[id] = timer_get_counter_value();
+}
+
+static inline timer_tick_t profile_run_start(uint8_t id)
+{
+	timer_tick_t start = timer_get_counter_value();
+	uint32_t latency = start - NG(m_posted_at)[id];
+	uint8_t bin = latency == 0 ? 0 : 32 - __builtin_clz(latency);
+	if(bin >= SCHED_LATENCY_HISTOGRAM_BINS)
+		bin = SCHED_LATENCY_HISTOGRAM_BINS - 1;
+
+	if(NG(m_stats)[id].latency_histogram[bin] != UINT16_MAX)
+		NG(m_stats)[id].latency_histogram[bin]++;
+	if(latency > NG(m_stats)[id].max_latency)
+		NG(m_stats)[id].max_latency = latency;
+	return start;
+}
+
+static inline void profile_run_end(uint8_t id, timer_tick_t start)
+{
+	uint32_t run_time = timer_get_counter_value() - start;
+	NG(m_stats)[id].run_count++;
+	NG(m_stats)[id].total_run_time += run_time;
+	if(run_time > NG(m_stats)[id].max_run_time)
+		NG(m_stats)[id].max_run_time = run_time;
+}
+
+static void reset_stats()
+{
+	memset(NG(m_stats), 0, sizeof(NG(m_stats)));
+	NG(lowpower_time) = 0;
+}
+#else
+static inline void profile_post(uint8_t id){}
+#endif
 #ifdef SCHEDULER_DEBUG
 void check_structs_are_valid()
 {
 	start_atomic();
 	assert(NG(num_registered_tasks) <= NUM_TASKS);
-	bool visited[NUM_TASKS];
-	memset(visited, false, NUM_TASKS);
+	bool visited[NUM_SLOTS];
+	memset(visited, false, NUM_SLOTS);
 	for(int i = 0; i < NG(num_registered_tasks); i++)
 	{
 		assert(NG(m_index)[i].task != 0x0);
@@ -97,13 +159,13 @@ void check_structs_are_valid()
 		assert(visited[i] || NG(m_info)[i].task == 0x0);
 
 
-	memset(visited, false, NUM_TASKS);
+	memset(visited, false, NUM_SLOTS);
 	for(int prio = 0; prio < NUM_PRIORITIES;prio++)
 	{
 		uint8_t prev_ind=NO_TASK;
 		for(uint8_t cur_ind = NG(m_head)[prio]; cur_ind != NO_TASK; cur_ind = NG(m_info)[cur_ind].next)
 		{
-			assert(cur_ind < NUM_TASKS);
+			assert(cur_ind < NUM_SLOTS);
 			assert(!visited[cur_ind]);
 			visited[cur_ind] = true;
 			assert(NG(m_info)[cur_ind].prev == prev_ind);
@@ -119,14 +181,24 @@ void check_structs_are_valid()
 		}
 		assert(NG(m_tail)[prio] == prev_ind);
 	}
-	for(int i = 0; i < NUM_TASKS; i++)
+	for(int i = 0; i < NUM_SLOTS; i++)
 	{
 		assert((visited[i]) || NG(m_info)[i].priority == NOT_SCHEDULED);
 	}
 
-	assert(NG(current_priority) <= NUM_PRIORITIES);
-	for(int i = 0; i < NG(current_priority); i++)
-		assert(NG(m_head)[i] == NO_TASK);
+	uint8_t free_arg_slot_count = 0;
+	for(uint8_t cur_ind = NG(m_free_arg_slots); cur_ind != NO_TASK; cur_ind = NG(m_info)[cur_ind].next)
+	{
+		assert(cur_ind >= NUM_TASKS && cur_ind < NUM_SLOTS);
+		assert(!visited[cur_ind]);
+		visited[cur_ind] = true;
+		free_arg_slot_count++;
+	}
+	assert(free_arg_slot_count == NG(m_free_arg_slot_count));
+	assert(NG(m_reserved_arg_slots) <= NG(m_free_arg_slot_count));
+
+	for(int prio = 0; prio < NUM_PRIORITIES; prio++)
+		assert(((NG(ready_priorities) & PRIORITY_BIT(prio)) != 0) == (NG(m_head)[prio] != NO_TASK));
 	//INT_Enable();
 	end_atomic();
 }
@@ -135,20 +207,35 @@ static inline void check_structs_are_valid(){}
 #endif
 __LINK_C void scheduler_init()
 {
-	for(unsigned int i = 0; i < NUM_TASKS; i++)
+	for(unsigned int i = 0; i < NUM_SLOTS; i++)
 	{
 		NG(m_info)[i].next = NO_TASK;
 		NG(m_info)[i].prev = NO_TASK;
 		NG(m_info)[i].task = 0x0;
 		NG(m_info)[i].priority = NOT_SCHEDULED;
-
+	}
+	for(unsigned int i = 0; i < NUM_TASKS; i++)
+	{
 		NG(m_index)[i].index = NO_TASK;
 		NG(m_index)[i].task = 0x0;
 	}
+	NG(m_free_arg_slots) = NO_TASK;
+	for(unsigned int i = NUM_SLOTS; i > NUM_TASKS; i--)
+	{
+		NG(m_info)[i - 1].next = NG(m_free_arg_slots);
+		NG(m_free_arg_slots) = i - 1;
+	}
+	NG(m_free_arg_slot_count) = SCHEDULER_MAX_ARG_TASKS;
+	NG(m_reserved_arg_slots) = 0;
 	memset(NG(m_head), NO_TASK, sizeof(NG(m_head)));
 	memset(NG(m_tail), NO_TASK, sizeof(NG(m_tail)));
-	NG(current_priority) = NUM_PRIORITIES;
+	NG(ready_priorities) = 0;
 	NG(num_registered_tasks) = 0;
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+	//the timer is not initialised yet, but it starts counting from 0
+	reset_stats();
+	NG(stats_start) = 0;
+#endif
 	check_structs_are_valid();
 }
 
@@ -177,11 +264,17 @@ __LINK_C uint8_t get_task_id(task_t task)
 	return NO_TASK;
 }
 
-__LINK_C error_t sched_register_task(task_t task)
+__LINK_C task_handle_t sched_get_task_handle(task_t task)
 {
-    assert(NG(num_registered_tasks) <= NUM_TASKS);
+	uint8_t id = get_task_id(task);
+	return id == NO_TASK ? INVALID_TASK_HANDLE : id;
+}
+
+__LINK_C task_handle_t sched_register_task_handle(task_t task)
+{
+    assert(NG(num_registered_tasks) < NUM_TASKS);
     assert(get_task_id(task) == NO_TASK);
-	error_t retVal;
+	task_handle_t handle;
 	check_structs_are_valid();
 	//INT_Disable();
 	start_atomic();
@@ -200,13 +293,20 @@ __LINK_C error_t sched_register_task(task_t task)
             NG(m_index)[i] = NG(m_index)[i-1];
         }
     }
+    //the handle is the index in m_info, which does not change when other tasks are registered
+    handle = NG(num_registered_tasks);
     NG(num_registered_tasks)++;
-    retVal = SUCCESS;
 
 	//INT_Enable();
 	end_atomic();
 	check_structs_are_valid();
-	return retVal;
+	return handle;
+}
+
+__LINK_C error_t sched_register_task(task_t task)
+{
+	sched_register_task_handle(task);
+	return SUCCESS;
 }
 
 static inline bool is_scheduled(uint8_t id)
@@ -216,26 +316,83 @@ static inline bool is_scheduled(uint8_t id)
 	return NG(m_info)[id].priority != NOT_SCHEDULED;
 }
 
-__LINK_C bool sched_is_scheduled(task_t task)
+static inline bool is_registered(task_handle_t handle)
+{
+	return handle < NG(num_registered_tasks);
+}
+
+//appends the slot to the list of its priority, should be called from an atomic context
+static void enqueue(uint8_t id, uint8_t priority)
+{
+	if(NG(m_head)[priority] == NO_TASK)
+	{
+		NG(m_head)[priority] = id;
+		NG(m_tail)[priority] = id;
+		NG(ready_priorities) |= PRIORITY_BIT(priority);
+	}
+	else
+	{
+		NG(m_info)[NG(m_tail)[priority]].next = id;
+		NG(m_info)[id].prev = NG(m_tail)[priority];
+		NG(m_tail)[priority] = id;
+	}
+	NG(m_info)[id].priority = priority;
+}
+
+//removes a scheduled slot from the list of its priority, should be called from an atomic context
+static void unlink(uint8_t id)
+{
+	if (NG(m_info)[id].prev == NO_TASK)
+		NG(m_head)[NG(m_info)[id].priority] = NG(m_info)[id].next;
+	else
+		NG(m_info)[NG(m_info)[id].prev].next = NG(m_info)[id].next;
+
+	if (NG(m_info)[id].next == NO_TASK)
+		NG(m_tail)[NG(m_info)[id].priority] = NG(m_info)[id].prev;
+	else
+		NG(m_info)[NG(m_info)[id].next].prev = NG(m_info)[id].prev;
+
+	if (NG(m_head)[NG(m_info)[id].priority] == NO_TASK)
+		NG(ready_priorities) &= ~PRIORITY_BIT(NG(m_info)[id].priority);
+
+	NG(m_info)[id].prev = NO_TASK;
+	NG(m_info)[id].next = NO_TASK;
+	NG(m_info)[id].priority = NOT_SCHEDULED;
+}
+
+//returns an argument slot to the free list, should be called from an atomic context
+static void free_arg_slot(uint8_t id)
+{
+	NG(m_info)[id].task = 0x0;
+	NG(m_info)[id].next = NG(m_free_arg_slots);
+	NG(m_free_arg_slots) = id;
+	NG(m_free_arg_slot_count)++;
+}
+
+__LINK_C bool sched_is_handle_scheduled(task_handle_t handle)
 {
 	//INT_Disable();
 	start_atomic();
-	uint8_t task_id = get_task_id(task);
 	bool retVal = false;
-	if(task_id != NO_TASK)
-		retVal = is_scheduled(task_id);
+	if(is_registered(handle))
+		retVal = is_scheduled(handle);
 	//INT_Enable();
 	end_atomic();
 	return retVal;
 }
 
-__LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority)
+__LINK_C bool sched_is_scheduled(task_t task)
+{
+	//the lookup is done before entering the atomic section, tasks are not registered from interrupt context
+	return sched_is_handle_scheduled(sched_get_task_handle(task));
+}
+
+__LINK_C error_t sched_post_handle_prio(task_handle_t task_id, uint8_t priority)
 {
 	error_t retVal;
 	start_atomic();
 	check_structs_are_valid();
-	uint8_t task_id = get_task_id(task);
-	if(task_id == NO_TASK)
+	if(!is_registered(task_id))
 		retVal = EINVAL;
 	else if(priority > MIN_PRIORITY || priority < MAX_PRIORITY)
 		retVal = ESIZE;
@@ -243,21 +400,8 @@ __LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority)
 		retVal = EALREADY;
 	else
 	{
-		if(NG(m_head)[priority] == NO_TASK)
-		{
-			NG(m_head)[priority] = task_id;
-			NG(m_tail)[priority] = task_id;
-		}
-		else
-		{
-			NG(m_info)[NG(m_tail)[priority]].next = task_id;
-			NG(m_info)[task_id].prev = NG(m_tail)[priority];
-			NG(m_tail)[priority] = task_id;
-		}
-		NG(m_info)[task_id].priority = priority;
-		//if our priority is higher than the currently known maximum priority
-		if((priority < NG(current_priority)))
-			NG(current_priority) = priority;
+		enqueue(task_id, priority);
+		profile_post(task_id);
 		check_structs_are_valid();
 		retVal = SUCCESS;
 	}
@@ -266,50 +410,151 @@ __LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority)
 	return retVal;
 }
 
-__LINK_C error_t sched_cancel_task(task_t task)
+__LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority)
+{
+	return sched_post_handle_prio(sched_get_task_handle(task), priority);
+}
+
+__LINK_C error_t sched_cancel_handle(task_handle_t id)
 {
 	check_structs_are_valid();
 	error_t retVal;
 
 	start_atomic();
-	uint8_t id = get_task_id(task);
-	if(id == NO_TASK)
+	if(!is_registered(id))
 		retVal = EINVAL;
 	else if(!is_scheduled(id))
 		retVal = EALREADY;
 	else
 	{
-		if (NG(m_info)[id].prev == NO_TASK)
-			NG(m_head)[NG(m_info)[id].priority] = NG(m_info)[id].next;
-		else
-			NG(m_info)[NG(m_info)[id].prev].next = NG(m_info)[id].next;
+		unlink(id);
+		check_structs_are_valid();
+		retVal = SUCCESS;
+	}
+	end_atomic();
+	return retVal;
+}
 
-		if (NG(m_info)[id].next == NO_TASK)
-			NG(m_tail)[NG(m_info)[id].priority] = NG(m_info)[id].prev;
-		else
-			NG(m_info)[NG(m_info)[id].next].prev = NG(m_info)[id].prev;
+__LINK_C error_t sched_cancel_task(task_t task)
+{
+	return sched_cancel_handle(sched_get_task_handle(task));
+}
 
-		NG(m_info)[id].prev = NO_TASK;
-		NG(m_info)[id].next = NO_TASK;
-		NG(m_info)[id].priority = NOT_SCHEDULED;
-		check_structs_are_valid();
+//takes a free argument slot for the task and enqueues it, should be called from an atomic context
+static void post_arg_slot(task_arg_t task, void* arg, uint8_t priority)
+{
+	uint8_t id = NG(m_free_arg_slots);
+	NG(m_free_arg_slots) = NG(m_info)[id].next;
+	NG(m_free_arg_slot_count)--;
+	NG(m_info)[id].next = NO_TASK;
+	NG(m_info)[id].task = (task_t)task;
+	NG(m_arg)[id - NUM_TASKS] = arg;
+	enqueue(id, priority);
+}
+
+__LINK_C error_t sched_post_task_arg_prio(task_arg_t task, void* arg, uint8_t priority)
+{
+	error_t retVal;
+	start_atomic();
+	check_structs_are_valid();
+	if(priority > MIN_PRIORITY || priority < MAX_PRIORITY)
+		retVal = ESIZE;
+	else if(NG(m_free_arg_slot_count) <= NG(m_reserved_arg_slots))
+		retVal = ENOMEM;
+	else
+	{
+		post_arg_slot(task, arg, priority);
 		retVal = SUCCESS;
 	}
 	end_atomic();
+	check_structs_are_valid();
+	return retVal;
+}
+
+__LINK_C error_t sched_reserve_arg_slot()
+{
+	error_t retVal = SUCCESS;
+	start_atomic();
+	if(NG(m_free_arg_slot_count) <= NG(m_reserved_arg_slots))
+		retVal = ENOMEM;
+	else
+		NG(m_reserved_arg_slots)++;
+	end_atomic();
 	return retVal;
 }
 
-static uint8_t pop_task(int priority)
+__LINK_C void sched_release_arg_slot()
+{
+	start_atomic();
+	assert(NG(m_reserved_arg_slots) > 0);
+	NG(m_reserved_arg_slots)--;
+	end_atomic();
+}
+
+__LINK_C error_t sched_post_reserved_task_arg_prio(task_arg_t task, void* arg, uint8_t priority)
+{
+	error_t retVal;
+	start_atomic();
+	check_structs_are_valid();
+	assert(NG(m_reserved_arg_slots) > 0);
+	if(priority > MIN_PRIORITY || priority < MAX_PRIORITY)
+		retVal = ESIZE;
+	else
+	{
+		NG(m_reserved_arg_slots)--;
+		post_arg_slot(task, arg, priority);
+		retVal = SUCCESS;
+	}
+	end_atomic();
+	check_structs_are_valid();
+	return retVal;
+}
+
+__LINK_C error_t sched_cancel_task_arg(task_arg_t task, void* arg)
+{
+	error_t retVal = EALREADY;
+	start_atomic();
+	for(uint8_t id = NUM_TASKS; id < NUM_SLOTS; id++)
+	{
+		if(NG(m_info)[id].priority != NOT_SCHEDULED && NG(m_info)[id].task == (task_t)task && NG(m_arg)[id - NUM_TASKS] == arg)
+		{
+			unlink(id);
+			free_arg_slot(id);
+			retVal = SUCCESS;
+		}
+	}
+	end_atomic();
+	check_structs_are_valid();
+	return retVal;
+}
+
+__LINK_C bool sched_is_task_arg_scheduled(task_arg_t task, void* arg)
+{
+	bool retVal = false;
+	start_atomic();
+	for(uint8_t id = NUM_TASKS; id < NUM_SLOTS && !retVal; id++)
+		retVal = NG(m_info)[id].priority != NOT_SCHEDULED && NG(m_info)[id].task == (task_t)task && NG(m_arg)[id - NUM_TASKS] == arg;
+
+	end_atomic();
+	return retVal;
+}
+
+//pops the first task of the highest priority with waiting tasks, or returns NO_TASK when the scheduler is idle
+static uint8_t pop_task()
 {
 	uint8_t id = NO_TASK;
 	check_structs_are_valid();
 	start_atomic();
-	if (NG(m_head)[priority] != NO_TASK)
+	if (NG(ready_priorities) != 0)
 	{
+		uint8_t priority = __builtin_clz(NG(ready_priorities));
 		id = NG(m_head)[priority];
-		NG(m_head)[priority] = NG(m_info)[NG(m_head)[priority]].next;
+		NG(m_head)[priority] = NG(m_info)[id].next;
 		if(NG(m_head)[priority] == NO_TASK)
+		{
 			NG(m_tail)[priority] = NO_TASK;
+			NG(ready_priorities) &= ~PRIORITY_BIT(priority);
+		}
 		else
 			NG(m_info)[NG(m_head)[priority]].prev = NO_TASK;
 
@@ -322,11 +567,6 @@ static uint8_t pop_task(int priority)
 	return id;
 }
 
-static inline bool tasks_waiting(int priority)
-{
-	return NG(m_head)[priority] != NO_TASK;
-}
-
 static uint8_t low_power_mode = FRAMEWORK_SCHEDULER_LP_MODE;
 
 uint8_t sched_get_low_power_mode(void) {
@@ -337,30 +577,111 @@ void sched_set_low_power_mode(uint8_t mode) {
   low_power_mode = mode;
 }
 
-__LINK_C void scheduler_run()
+static void run_pending_tasks()
 {
-	while(1)
+	//the priority is re-evaluated after every task, so tasks posted by the running task
+	//(or by an interrupt) at a higher priority are executed first
+	for(uint8_t id = pop_task(); id != NO_TASK; id = pop_task())
 	{
-		while(NG(current_priority) < NUM_PRIORITIES)
+		check_structs_are_valid();
+		if(id >= NUM_TASKS)
 		{
-			check_structs_are_valid();
-			for(uint8_t id = pop_task((NG(current_priority))); id != NO_TASK; id = pop_task(NG(current_priority)))
-			{
-				check_structs_are_valid();
-				NG(m_info)[id].task();
-			}
-			//this needs to be done atomically since otherwise we risk decrementing the current priority
-			//while a higher priority task is waiting in the queue
+			//free the slot before running the task, so the task can post itself again
 			start_atomic();
-			if (!tasks_waiting(NG(current_priority)))
-				NG(current_priority)++;
-#ifndef NDEBUG
-			for(int i = 0; i < NG(current_priority); i++)
-				assert(!tasks_waiting(i));
-#endif
+			task_arg_t task = (task_arg_t)NG(m_info)[id].task;
+			void* arg = NG(m_arg)[id - NUM_TASKS];
+			free_arg_slot(id);
 			end_atomic();
+			task(arg);
+			continue;
+		}
+
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+		timer_tick_t start = profile_run_start(id);
+		NG(m_info)[id].task();
+		profile_run_end(id, start);
+#else
+		NG(m_info)[id].task();
+#endif
+	}
+}
+
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+__LINK_C uint8_t sched_get_registered_task_count()
+{
+	return NG(num_registered_tasks);
+}
+
+__LINK_C error_t sched_get_task_stats(task_handle_t handle, sched_task_stats_t* stats)
+{
+	if(!is_registered(handle))
+		return EINVAL;
+
+	start_atomic();
+	*stats = NG(m_stats)[handle];
+	end_atomic();
+	stats->task = NG(m_info)[handle].task;
+	return SUCCESS;
+}
+
+__LINK_C uint32_t sched_get_stats_elapsed_time()
+{
+	return timer_get_counter_value() - NG(stats_start);
+}
+
+__LINK_C uint32_t sched_get_lowpower_time()
+{
+	return NG(lowpower_time);
+}
+
+__LINK_C void sched_reset_stats()
+{
+	start_atomic();
+	reset_stats();
+	NG(stats_start) = timer_get_counter_value();
+	end_atomic();
+}
+
+static void enter_lowpower_mode()
+{
+	timer_tick_t start = timer_get_counter_value();
+	hw_enter_lowpower_mode(low_power_mode);
+	uint32_t lowpower_time = timer_get_counter_value() - start;
+#ifdef NODE_GLOBALS
+	//the nodes share the processor, so they all slept
+	for(size_t node = 0; node < __ng_max_nodes__; node++)
+	{
+		set_node_global_id(node);
+		NG(lowpower_time) += lowpower_time;
+	}
+#else
+	NG(lowpower_time) += lowpower_time;
+#endif
+}
+#else
+static inline void enter_lowpower_mode()
+{
+	hw_enter_lowpower_mode(low_power_mode);
+}
+#endif
+
+__LINK_C void scheduler_run()
+{
+	while(1)
+	{
+#ifdef NODE_GLOBALS
+		//all nodes share the processor: run the pending tasks of every node in turn.
+		//hw_enter_lowpower_mode() returns immediately when an interrupt posted a task
+		//for a node that was already visited
+		for(size_t node = 0; node < __ng_max_nodes__; node++)
+		{
+			set_node_global_id(node);
+			run_pending_tasks();
 		}
-		hw_enter_lowpower_mode(low_power_mode);
+#else
+		run_pending_tasks();
+#endif
+		enter_lowpower_mode();
 	}
 
 }
@@ -54,6 +54,27 @@ static cmd_handler_registration_t NGDEF(_cmd_handler_registrations)[CMD_HANDLER_
 
 static bool echo = false;
 
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+static void print_scheduler_stats()
+{
+    uint32_t elapsed = sched_get_stats_elapsed_time();
+    console_printf("elapsed %lu ticks, low power %lu ticks\r\n", (unsigned long)elapsed, (unsigned long)sched_get_lowpower_time());
+    console_printf("handle,task,posts,runs,total_run_time,max_run_time,max_latency,latency_histogram\r\n");
+    for(task_handle_t handle = 0; handle < sched_get_registered_task_count(); handle++)
+    {
+        sched_task_stats_t stats;
+        sched_get_task_stats(handle, &stats);
+        console_printf("%d,%p,%lu,%lu,%lu,%lu,%lu,", handle, (void*)stats.task,
+                       (unsigned long)stats.post_count, (unsigned long)stats.run_count, (unsigned long)stats.total_run_time,
+                       (unsigned long)stats.max_run_time, (unsigned long)stats.max_latency);
+        for(uint8_t bin = 0; bin < SCHED_LATENCY_HISTOGRAM_BINS; bin++)
+            console_printf(bin == 0 ? "%u" : " %u", stats.latency_histogram[bin]);
+
+        console_printf("\r\n");
+    }
+}
+#endif
+
 static void process_shell_cmd(char cmd)
 {
     switch(cmd)
@@ -66,6 +87,15 @@ static void process_shell_cmd(char cmd)
         case 'R':
             hw_reset();
             break;
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+        case 'S':
+            print_scheduler_stats();
+            break;
+        case 'Z':
+            sched_reset_stats();
+            console_printf("scheduler statistics reset\r\n");
+            break;
+#endif
         default:
             // TODO log
             break;
@@ -93,6 +123,8 @@ static cmd_handler_t get_cmd_handler_callback(int8_t id)
 // ATx\r : shell command, where x is a char which maps to a command.
 // List of supported commands:
 // - R: reboot device
+// - S: print the scheduler statistics (only when FRAMEWORK_SCHEDULER_PROFILING_ENABLED is set)
+// - Z: reset the scheduler statistics (only when FRAMEWORK_SCHEDULER_PROFILING_ENABLED is set)
 // AT$<command handler id> : command to be handled by the command handler specified. The command handler id is a byte < 65 (non ASCII)
 // The handlers are passed the command fifo (including the header) and are responsible for pop()-ing the bytes which are processed by the handler.
 // When the fifo does not yet contain a full command which can be processed by the specific handler nothing should be popped and the handler will
@@ -31,7 +31,7 @@
 #endif
 
 
-#ifdef NODE_GLOBALS
+#if defined(NODE_GLOBALS) && !defined(HWTIMER_NODE_GLOBALS)
     #warning Default Timer implementation used when NODE_GLOBALS is active. Are you sure this is what you want ??
 #endif
 
@@ -39,8 +39,32 @@
 
 #define COUNTER_OVERFLOW_INCREASE (UINT32_C(1) << (8*sizeof(hwtimer_tick_t)))
 
-static timer_event NGDEF(timers)[FRAMEWORK_TIMER_STACK_SIZE];
-static volatile timer_tick_t NGDEF(next_event);
+#if FRAMEWORK_TIMER_STACK_SIZE >= 0xFF
+    #error FRAMEWORK_TIMER_STACK_SIZE should be smaller than 255
+#endif
+
+//the pending events are kept in a binary min-heap ordered on next_event, so the next event
+//to fire is always at index 0. m_heap_index maps the handle of the task to its position in
+//the heap, which makes finding a task O(1) and inserting or cancelling an event O(log n).
+//An event may fire anywhere between earliest and next_event (= earliest + slack): the hw timer
+//is scheduled for the next_event of the root and when it fires all the other events that have
+//reached their earliest fire time are posted as well, which coalesces the wakeups. Since the heap
+//is not ordered on earliest, these events can be anywhere in the heap.
+//Events of tasks carrying an argument have no handle (INVALID_TASK_HANDLE), f is a task_arg_t.
+//Each of them holds a scheduler slot reserved with sched_reserve_arg_slot(), so it is never lost when it fires.
+typedef struct
+{
+    timer_tick_t next_event;
+    timer_tick_t earliest;
+    task_t f;
+    void* arg;
+    task_handle_t handle;
+    uint8_t priority;
+} timer_heap_entry_t;
+
+static timer_heap_entry_t NGDEF(timers)[FRAMEWORK_TIMER_STACK_SIZE];
+static uint8_t NGDEF(timer_count);
+static uint8_t NGDEF(m_heap_index)[FRAMEWORK_SCHEDULER_MAX_TASKS];
 static volatile bool NGDEF(hw_event_scheduled);
 static volatile timer_tick_t NGDEF(timer_offset);
 enum
@@ -53,10 +77,10 @@ static void timer_fired();
 
 __LINK_C void timer_init()
 {
-    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
-	NG(timers)[i].f = 0x0;
+    NG(timer_count) = 0;
+    for(uint32_t i = 0; i < FRAMEWORK_SCHEDULER_MAX_TASKS; i++)
+        NG(m_heap_index)[i] = NO_EVENT;
 
-    NG(next_event) = NO_EVENT;
     NG(timer_offset) = 0;
     NG(hw_event_scheduled) = false;
 
@@ -65,124 +89,289 @@ __LINK_C void timer_init()
 
 }
 
-static void configure_next_event();
-__LINK_C error_t timer_post_task_prio(task_t task, timer_tick_t fire_time, uint8_t priority)
+//trick borrowed from AODV: by using signed integers in this way the events are sorted correctly
+//regardless of any (pending) overflows, as long as they are less than 2^31 ticks apart
+static inline bool fires_before(timer_tick_t a, timer_tick_t b)
 {
-    error_t status = ENOMEM;
-    if (priority > MIN_PRIORITY)
-        return EINVAL;
+    return ((int32_t)(a - b)) < 0;
+}
 
-    DPRINT("fire_time  <%lu>" , fire_time);
+static inline void heap_set(uint8_t pos, const timer_heap_entry_t* entry)
+{
+    NG(timers)[pos] = *entry;
+    if(entry->handle != INVALID_TASK_HANDLE)
+        NG(m_heap_index)[entry->handle] = pos;
+}
 
-    start_atomic();
-    uint32_t empty_index = FRAMEWORK_TIMER_STACK_SIZE;
-    for (uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
+//moves the entry at pos towards the root until the heap property holds, returns its new position
+static uint8_t heap_sift_up(uint8_t pos)
+{
+    timer_heap_entry_t entry = NG(timers)[pos];
+    while(pos > 0)
+    {
+        uint8_t parent = (pos - 1) / 2;
+        if(!fires_before(entry.next_event, NG(timers)[parent].next_event))
+            break;
+
+        heap_set(pos, &NG(timers)[parent]);
+        pos = parent;
+    }
+
+    heap_set(pos, &entry);
+    return pos;
+}
+
+//moves the entry at pos towards the leaves until the heap property holds, returns its new position
+static uint8_t heap_sift_down(uint8_t pos)
+{
+    timer_heap_entry_t entry = NG(timers)[pos];
+    while(true)
+    {
+        uint8_t child = 2 * pos + 1;
+        if(child >= NG(timer_count))
+            break;
+
+        if(child + 1 < NG(timer_count) && fires_before(NG(timers)[child + 1].next_event, NG(timers)[child].next_event))
+            child++;
+
+        if(!fires_before(NG(timers)[child].next_event, entry.next_event))
+            break;
+
+        heap_set(pos, &NG(timers)[child]);
+        pos = child;
+    }
+
+    heap_set(pos, &entry);
+    return pos;
+}
+
+static void heap_remove(uint8_t pos)
+{
+    if(NG(timers)[pos].handle != INVALID_TASK_HANDLE)
+        NG(m_heap_index)[NG(timers)[pos].handle] = NO_EVENT;
+
+    NG(timer_count)--;
+    if(pos == NG(timer_count))
+        return;
+
+    //fill the gap with the last entry
+    heap_set(pos, &NG(timers)[NG(timer_count)]);
+    if(heap_sift_up(pos) == pos)
+        heap_sift_down(pos);
+}
+
+//posts the task of the event at pos and removes it from the heap
+static void fire_event(uint8_t pos)
+{
+    if(NG(timers)[pos].handle != INVALID_TASK_HANDLE)
+        sched_post_handle_prio(NG(timers)[pos].handle, NG(timers)[pos].priority);
+    else
+        sched_post_reserved_task_arg_prio((task_arg_t)NG(timers)[pos].f, NG(timers)[pos].arg, NG(timers)[pos].priority);
+
+    heap_remove(pos);
+}
+
+//posts all events within their fire window. The whole heap is checked since it is ordered on next_event,
+//an event which reached its earliest fire time can be behind one which did not
+static void fire_due_events(timer_tick_t counter)
+{
+    uint8_t pos = 0;
+    while(pos < NG(timer_count))
     {
-        if (NG(timers)[i].f == 0x0 && empty_index == FRAMEWORK_TIMER_STACK_SIZE)
+        if(((int32_t)(NG(timers)[pos].earliest - counter)) <= 0)
         {
-            empty_index = i;
+            fire_event(pos);
+            //removing the event moves other events, possibly to a position which was already checked
+            pos = 0;
         }
-        else if (NG(timers)[i].f == task)
+        else
+            pos++;
+    }
+}
+
+static void configure_next_event();
+
+//inserts the event in the heap, or updates the fire time of the event at pos when it is already
+//pending (pos != NO_EVENT). Should be called from an atomic context
+static error_t post_event(uint8_t pos, const timer_heap_entry_t* event)
+{
+    bool do_config;
+    if (pos != NO_EVENT)
+    {
+        // it is allowed to update only the fire time
+        if (NG(timers)[pos].priority != event->priority)
         {
-            // it is allowed to update only the fire time
-            if (NG(timers)[i].priority == priority)
-            {
-                NG(timers)[empty_index].next_event = fire_time;
-                goto config;
-            }
-            else
             //for now: do not allow an event to be scheduled more than once
             //otherwise we risk having the same task being scheduled twice and only executed once
             //because the scheduler disallows the same task to be scheduled multiple times
-                status = EALREADY;
-            break;
+            return EALREADY;
         }
-    }
 
-    if (status != EALREADY && empty_index != FRAMEWORK_TIMER_STACK_SIZE)
-    {
-        NG(timers)[empty_index].f = task;
-        NG(timers)[empty_index].next_event = fire_time;
-        NG(timers)[empty_index].priority = priority;
+        NG(timers)[pos].earliest = event->earliest;
+        NG(timers)[pos].next_event = event->next_event;
+        //the hw timer needs to be reconfigured if the first event changed
+        uint8_t new_pos = heap_sift_up(pos);
+        if (new_pos == pos)
+            new_pos = heap_sift_down(pos);
+
+        do_config = (pos == 0 || new_pos == 0);
     }
+    else if (NG(timer_count) == FRAMEWORK_TIMER_STACK_SIZE)
+        return ENOMEM;
     else
-        goto end;
+    {
+        heap_set(NG(timer_count), event);
+        NG(timer_count)++;
+        //if the new event should fire sooner than the old first event --> trigger reconfig
+        do_config = heap_sift_up(NG(timer_count) - 1) == 0;
+    }
+
+    if (do_config)
+        configure_next_event();
 
-config:
+    return SUCCESS;
+}
 
-    //if there is no event scheduled, this event will run before the next scheduled event
+//returns the position of the pending event of a task carrying the given argument, or NO_EVENT.
+//Should be called from an atomic context
+static uint8_t find_arg_event(task_arg_t task, void* arg)
+{
+    for(uint8_t pos = 0; pos < NG(timer_count); pos++)
     {
-        bool do_config = NG(next_event) == NO_EVENT;
+        if(NG(timers)[pos].handle == INVALID_TASK_HANDLE && NG(timers)[pos].f == (task_t)task && NG(timers)[pos].arg == arg)
+            return pos;
+    }
 
-        if (!do_config)
-        {
-            uint32_t counter = timer_get_counter_value();
+    return NO_EVENT;
+}
+
+static void remove_event(uint8_t pos)
+{
+    heap_remove(pos);
+    //if we were the first event to fire --> trigger a reconfiguration
+    if(pos == 0)
+        configure_next_event();
+}
 
-            DPRINT("timer_post_task_prio counter value <%lu>" , counter);
+__LINK_C error_t timer_post_task_prio_slack(task_t task, timer_tick_t fire_time, uint8_t priority, timer_tick_t slack)
+{
+    if (priority > MIN_PRIORITY)
+        return EINVAL;
 
-            //if the new event should fire sooner than the old event --> trigger reconfig
-            //this is done using signed ints (compared to the current counter)
-            //to ensure propper handling of timer overflows
-            int32_t next_fire_delay = ((int32_t)fire_time) - ((int32_t)counter);
+    //the lookup is done before entering the atomic section, tasks are not registered from interrupt context
+    task_handle_t handle = sched_get_task_handle(task);
+    if (handle == INVALID_TASK_HANDLE)
+        return EINVAL;
 
-            DPRINT("next_fire_delay <%lu>" , next_fire_delay);
+    DPRINT("fire_time  <%lu> slack <%lu>" , fire_time, slack);
 
-            int32_t old_fire_delay = ((int32_t)NG(timers)[NG(next_event)].next_event) - ((int32_t)counter);
-            do_config = next_fire_delay < old_fire_delay;
-        }
+    start_atomic();
+    error_t status = post_event(NG(m_heap_index)[handle], &(timer_heap_entry_t){
+        .next_event = fire_time + slack,
+        .earliest = fire_time,
+        .f = task,
+        .arg = NULL,
+        .handle = handle,
+        .priority = priority
+    });
+    end_atomic();
+    return status;
+}
+
+__LINK_C error_t timer_post_task_arg_prio(task_arg_t task, void* arg, timer_tick_t fire_time, uint8_t priority)
+{
+    if (priority > MIN_PRIORITY)
+        return EINVAL;
 
-        if (do_config)
-            configure_next_event();
+    DPRINT("fire_time  <%lu>" , fire_time);
 
-        status = SUCCESS;
-    }
+    //a new event needs a reserved scheduler slot to be posted in when it fires, an updated event keeps its own.
+    //The slot is reserved outside of the atomic section, since the scheduler enters one as well
+    bool reserved = sched_reserve_arg_slot() == SUCCESS;
+    error_t status;
 
-end:
+    start_atomic();
+    uint8_t pos = find_arg_event(task, arg);
+    if (pos == NO_EVENT && !reserved)
+        status = ENOMEM;
+    else
+        status = post_event(pos, &(timer_heap_entry_t){
+            .next_event = fire_time,
+            .earliest = fire_time,
+            .f = (task_t)task,
+            .arg = arg,
+            .handle = INVALID_TASK_HANDLE,
+            .priority = priority
+        });
     end_atomic();
+
+    if (reserved && (pos != NO_EVENT || status != SUCCESS))
+        sched_release_arg_slot();
+
     return status;
 }
 
+__LINK_C error_t timer_post_task_prio(task_t task, timer_tick_t fire_time, uint8_t priority)
+{
+    return timer_post_task_prio_slack(task, fire_time, priority, 0);
+}
+
 __LINK_C error_t timer_cancel_task(task_t task)
 {
     error_t status = EALREADY;
-    
-    start_atomic();
+    task_handle_t handle = sched_get_task_handle(task);
+    if (handle == INVALID_TASK_HANDLE)
+        return status;
 
-    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
+    start_atomic();
+    uint8_t pos = NG(m_heap_index)[handle];
+    if(pos != NO_EVENT)
     {
-      if(NG(timers)[i].f == task)
-      {
-        NG(timers)[i].f = 0x0;
-        //if we were the first event to fire --> trigger a reconfiguration
-        if(NG(next_event) == i)
-          configure_next_event();
+        remove_event(pos);
+        status = SUCCESS;
+    }
+    end_atomic();
+
+    return status;
+}
 
+__LINK_C error_t timer_cancel_task_arg(task_arg_t task, void* arg)
+{
+    error_t status = EALREADY;
+
+    start_atomic();
+    uint8_t pos = find_arg_event(task, arg);
+    if(pos != NO_EVENT)
+    {
+        remove_event(pos);
         status = SUCCESS;
-        break;
-      }
     }
     end_atomic();
 
+    //the event will not be posted anymore
+    if(status == SUCCESS)
+        sched_release_arg_slot();
+
     return status;
 }
 
 __LINK_C bool timer_is_task_scheduled(task_t task)
 {
-    bool present = false;
+    task_handle_t handle = sched_get_task_handle(task);
+    if (handle == INVALID_TASK_HANDLE)
+        return false;
+
+    //reading a single byte is atomic
+    return NG(m_heap_index)[handle] != NO_EVENT;
+}
 
+__LINK_C bool timer_is_task_arg_scheduled(task_arg_t task, void* arg)
+{
     start_atomic();
+    bool present = find_arg_event(task, arg) != NO_EVENT;
+    end_atomic();
 
-     for (uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
-     {
-       if (NG(timers)[i].f == task)
-       {
-          present = true;
-          break;
-       }
-     }
-     end_atomic();
-
-     return present;
+    return present;
 }
 
 __LINK_C timer_tick_t timer_get_counter_value()
@@ -200,101 +389,64 @@ __LINK_C timer_tick_t timer_get_counter_value()
     return counter;
 }
 
-static uint32_t get_next_event()
-{
-    //this function should only be called from an atomic context
-    int32_t min_delay;
-    uint32_t next_fire_event = NO_EVENT;
-    uint32_t counter = timer_get_counter_value();
-
-    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
-    {
-    	if(NG(timers)[i].f == 0x0)
-    		continue;
-    	//trick borrowed from AODV: by using signed integers in this way
-    	//we know that if the event has already passed delay_ticks will be < 0
-    	// --> events are sorted from past -> future regardless of any (pending) overflows
-    	int32_t delay_ticks = ((int32_t)NG(timers)[i].next_event) - ((int32_t)counter);
-    	if(next_fire_event == NO_EVENT || delay_ticks < min_delay)
-		{
-    		min_delay = delay_ticks;
-			next_fire_event = i;
-		}
-    }
-    return next_fire_event;
-}
-
 static void configure_next_event()
 {
     //this function should only be called from an atomic context
-	timer_tick_t next_fire_time;
+    timer_tick_t fire_delay;
     do
     {
-		//find the next event that has not yet passed, and schedule
-		//the 'late' events while we're at it
-		NG(next_event) = get_next_event();
+        //post the 'late' events while finding the next event that has not yet passed
+        fire_due_events(timer_get_counter_value());
 
-		if(NG(next_event) != NO_EVENT)
-		{
-			next_fire_time = NG(timers)[NG(next_event)].next_event;
-			if ( (((int32_t)next_fire_time) - ((int32_t)timer_get_counter_value())) <= 0 )
-			{
-				sched_post_task_prio(NG(timers)[NG(next_event)].f, NG(timers)[NG(next_event)].priority);
-				NG(timers)[NG(next_event)].f = 0x0;
-			}
-		}
+        if(NG(timer_count) == 0)
+        {
+            //cancel the timer in case it is still running (can happen if we're called from timer_cancel_event)
+            NG(hw_event_scheduled) = false;
+            hw_timer_cancel(HW_TIMER_ID);
+            return;
+        }
+
+        //calculate schedule time relative to current time rather than
+        //latest overflow time, to counteract any delays in updating counter_offset
+        //(eg when we're scheduling an event from an interrupt and thereby delaying
+        //the updating of counter_offset)
+        fire_delay = NG(timers)[0].next_event - timer_get_counter_value();
     }
-    while(NG(next_event) != NO_EVENT && ( (((int32_t)next_fire_time) - ((int32_t)timer_get_counter_value())) <= 0  ) );
+    while(((int32_t)fire_delay) <= 0);
 
-    //at this point NG(next_event) is eiter equal to NO_EVENT (no tasks left)
-    //or we have the next event we can schedule
-    if(NG(next_event) == NO_EVENT)
+    //if the timer should fire in less ticks than supported by the HW timer --> schedule it
+    //(otherwise it is scheduled from timer_overflow when needed)
+    if(fire_delay < COUNTER_OVERFLOW_INCREASE)
     {
-		//cancel the timer in case it is still running (can happen if we're called from timer_cancel_event)
-		NG(hw_event_scheduled) = false;
-		hw_timer_cancel(HW_TIMER_ID);
+        NG(hw_event_scheduled) = true;
+        hw_timer_schedule_delay(HW_TIMER_ID, (hwtimer_tick_t)fire_delay);
+#ifndef NDEBUG
+        //check that we didn't try to schedule a timer in the past
+        //normally this shouldn't happen but it IS theoretically possible...
+        fire_delay = (NG(timers)[0].next_event - timer_get_counter_value());
+        //fire_delay should be in [0,COUNTER_OVERFLOW_INCREASE]. if this is not the case, it is because timer_get_counter() is
+        //now larger than next_fire_event, which means we 'missed' the event
+        assert(((int32_t)fire_delay) > 0);
+#endif
     }
     else
     {
-		//calculate schedule time relative to current time rather than
-		//latest overflow time, to counteract any delays in updating counter_offset
-		//(eg when we're scheduling an event from an interrupt and thereby delaying
-		//the updating of counter_offset)
-    	timer_tick_t fire_delay = (next_fire_time - timer_get_counter_value());
-		//if the timer should fire in less ticks than supported by the HW timer --> schedule it
-		//(otherwise it is scheduled from timer_overflow when needed)
-		if(fire_delay < COUNTER_OVERFLOW_INCREASE)
-		{
-			NG(hw_event_scheduled) = true;
-			hw_timer_schedule_delay(HW_TIMER_ID, (hwtimer_tick_t)fire_delay);
-#ifndef NDEBUG	    
-			//check that we didn't try to schedule a timer in the past
-			//normally this shouldn't happen but it IS theoretically possible...
-			fire_delay = (next_fire_time - timer_get_counter_value());
-			//fire_delay should be in [0,COUNTER_OVERFLOW_INCREASE]. if this is not the case, it is because timer_get_counter() is
-			//now larger than next_fire_event, which means we 'missed' the event
-			assert(((int32_t)fire_delay) > 0);
-#endif
-		}
-		else
-		{
-			//set hw_event_scheduled explicitly to false to allow timer_overflow
-			//to schedule the event when needed
-			NG(hw_event_scheduled) = false;
-		}
+        //set hw_event_scheduled explicitly to false to allow timer_overflow
+        //to schedule the event when needed
+        NG(hw_event_scheduled) = false;
     }
 }
 static void timer_overflow()
 {
     NG(timer_offset) += COUNTER_OVERFLOW_INCREASE;
-    if(NG(next_event) != NO_EVENT && 		//there is an event scheduled at THIS timer level
+    if(NG(timer_count) != 0 && 		//there is an event scheduled at THIS timer level
 	(!NG(hw_event_scheduled)) &&		//but NOT at the hw timer level
-		NG(timers)[NG(next_event)].next_event <= (NG(timer_offset) + COUNTER_OVERFLOW_INCREASE) //and the next trigger will happen before the next overflow
+		NG(timers)[0].next_event <= (NG(timer_offset) + COUNTER_OVERFLOW_INCREASE) //and the next trigger will happen before the next overflow
 	)
     {
 		//normally this shouldn't happen. Put an assert here just to make sure
-		assert(NG(timers)[NG(next_event)].next_event >= NG(timer_offset));
-		timer_tick_t fire_time = (NG(timers)[NG(next_event)].next_event - NG(timer_offset));
+		assert(NG(timers)[0].next_event >= NG(timer_offset));
+		timer_tick_t fire_time = (NG(timers)[0].next_event - NG(timer_offset));
 
 		//fire time already passed
 		if(fire_time <= hw_timer_getvalue(HW_TIMER_ID))
@@ -313,9 +465,8 @@ static void timer_overflow()
 
 static void timer_fired()
 {
-    assert(NG(next_event) != NO_EVENT);
-    assert(NG(timers)[NG(next_event)].f != 0x0);
-    sched_post_task_prio(NG(timers)[NG(next_event)].f, NG(timers)[NG(next_event)].priority);
-    NG(timers)[NG(next_event)].f = 0x0;
+    assert(NG(timer_count) != 0);
+    fire_event(0);
+    //the other events for which the current time is within their window are posted by configure_next_event()
     configure_next_event();
 }
@@ -185,6 +185,27 @@ static void ensure_settling_and_calibration_done()
     }
 }
 
+static void flush_rx_fifo()
+{
+    uint8_t status = (cc1101_interface_strobe(RF_SNOP) & 0xF0);
+    if(status == 0x60)
+    {
+        // RX overflow
+        cc1101_interface_strobe(RF_SFRX);
+    }
+    else if(status == 0x10)
+    {
+        // still in RX, switch to idle first
+        cc1101_interface_strobe(RF_SIDLE);
+        cc1101_interface_strobe(RF_SFRX);
+    }
+
+    while(cc1101_interface_strobe(RF_SNOP) != 0x0F); // wait until in idle state
+    cc1101_interface_strobe(RF_SRX);
+    while(cc1101_interface_strobe(RF_SNOP) != 0x1F); // wait until in RX state
+    cc1101_interface_set_interrupts_enabled(true);
+}
+
 static void end_of_packet_isr()
 {
     DPRINT("end of packet ISR");
@@ -197,27 +218,19 @@ static void end_of_packet_isr()
             {
             	// long packets not yet supported or bit error in length byte, don't assert but flush rx
                 DPRINT("Packet size too big, flushing RX");
-                uint8_t status = (cc1101_interface_strobe(RF_SNOP) & 0xF0);
-                if(status == 0x60)
-                {
-                    // RX overflow
-                    cc1101_interface_strobe(RF_SFRX);
-                }
-                else if(status == 0x10)
-                {
-                    // still in RX, switch to idle first
-                    cc1101_interface_strobe(RF_SIDLE);
-                    cc1101_interface_strobe(RF_SFRX);
-                }
-
-                while(cc1101_interface_strobe(RF_SNOP) != 0x0F); // wait until in idle state
-                cc1101_interface_strobe(RF_SRX);
-                while(cc1101_interface_strobe(RF_SNOP) != 0x1F); // wait until in RX state
-                cc1101_interface_set_interrupts_enabled(true);
+                flush_rx_fifo();
                 return;
             }
 
             hw_radio_packet_t* packet = alloc_packet_callback(packet_len);
+            if(packet == NULL)
+            {
+                // the upper layer has no buffer available, drop the frame
+                DPRINT("Could not allocate packet, flushing RX");
+                flush_rx_fifo();
+                return;
+            }
+
             packet->length = packet_len;
             cc1101_interface_read_burst_reg(RXFIFO, packet->data + 1, packet->length);
 
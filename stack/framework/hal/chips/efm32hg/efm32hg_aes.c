@@ -26,6 +26,7 @@
 #include "hwaes.h"
 #include "efm32hg_chip.h"
 #include <em_aes.h>
+#include <string.h>
 
 #define AES_BLOCKSIZE 16
 
@@ -53,7 +54,118 @@ __LINK_C void hw_aes_cbc128(uint8_t *out, const uint8_t *in, unsigned int len, c
 	AES_CBC128(out, in, len, key, iv, encrypt);
 }
 
+#if defined( AES_CTRL_KEYBUFEN )
+#define AES_CTRL_KEY AES_CTRL_KEYBUFEN
+#else
+#define AES_CTRL_KEY 0
+#endif
+
+/* The key used by the *_loaded() functions. The frame data and keys are byte arrays which can start at any address,
+ * so they are only accessed as words after copying them to aligned buffers like this one. */
+static uint32_t loaded_key[4];
+
+/* Writes a block to DATA or XORDATA. Without key buffer the key register is changed by every encryption, so the key is
+ * written again before every block. */
+static void write_block(volatile uint32_t *reg, const uint32_t *block)
+{
+    int i;
+
+#if !defined( AES_CTRL_KEYBUFEN )
+    for (i = 3; i >= 0; i--)
+        AES->KEYLA = __REV(loaded_key[i]);
+#endif
+
+    for (i = 3; i >= 0; i--)
+        *reg = __REV(block[i]);
+
+    while (AES->STATUS & AES_STATUS_RUNNING);
+}
+
+static void read_block(uint32_t *block)
+{
+    int i;
+
+    for (i = 3; i >= 0; i--)
+        block[i] = __REV(AES->DATA);
+}
+
+__LINK_C void hw_aes_load_key128(const uint8_t *key)
+{
+    memcpy(loaded_key, key, sizeof(loaded_key));
+
+#if defined( AES_CTRL_KEYBUFEN )
+    /* the key stays in the key buffer and is restored before every block */
+    int i;
+
+    for (i = 3; i >= 0; i--)
+        AES->KEYHA = __REV(loaded_key[i]);
+#endif
+}
+
+__LINK_C void hw_aes_ctr128_loaded(uint8_t *out, const uint8_t *in, unsigned int len, uint8_t *ctr)
+{
+    unsigned int i, n;
+    uint32_t block[4];
+    const uint8_t *key_stream = (const uint8_t *)block;
+
+    AES->CTRL = AES_CTRL_KEY | AES_CTRL_DATASTART;
+
+    while (len > 0)
+    {
+        n = len < AES_BLOCKSIZE ? len : AES_BLOCKSIZE;
+        memcpy(block, ctr, sizeof(block));
+        write_block(&AES->DATA, block);
+        read_block(block);
+
+        for (i = 0; i < n; i++)
+            out[i] = in[i] ^ key_stream[i];
+
+        /* like the software implementation, the counter is not incremented after a last partial block */
+        if (n == AES_BLOCKSIZE)
+            IncrementAesCounterBlock(ctr);
+
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+
+__LINK_C void hw_aes_cbc_mac128_loaded(uint8_t *mac, const uint8_t *in, unsigned int len)
+{
+    unsigned int n;
+    uint32_t block[4];
+
+    AES->CTRL = AES_CTRL_KEY | AES_CTRL_XORSTART;
+
+    /* writing DATA does not start an encryption */
+    memcpy(block, mac, sizeof(block));
+    write_block(&AES->DATA, block);
+
+    /* every block written to XORDATA is XOR'ed with the previous cipher block still in DATA and encrypted */
+    while (len > 0)
+    {
+        n = len < AES_BLOCKSIZE ? len : AES_BLOCKSIZE;
+        if (n < AES_BLOCKSIZE)
+            memset(block, 0, sizeof(block));
+
+        memcpy(block, in, n);
+        write_block(&AES->XORDATA, block);
+        in += n;
+        len -= n;
+    }
+
+    read_block(block);
+    memcpy(mac, block, sizeof(block));
+}
+
 __LINK_C void hw_aes_ctr128(uint8_t *out, const uint8_t *in, unsigned int len, const uint8_t *key, uint8_t * ctr)
 {
-	AES_CTR128(out, in, len, key, ctr, &IncrementAesCounterBlock);
+    hw_aes_load_key128(key);
+    hw_aes_ctr128_loaded(out, in, len, ctr);
+}
+
+__LINK_C void hw_aes_cbc_mac128(uint8_t *mac, const uint8_t *in, unsigned int len, const uint8_t *key)
+{
+    hw_aes_load_key128(key);
+    hw_aes_cbc_mac128_loaded(mac, in, len);
 }
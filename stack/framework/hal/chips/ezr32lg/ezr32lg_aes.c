@@ -26,11 +26,23 @@
 #include "hwaes.h"
 #include "ezr32lg_chip.h"
 #include <em_aes.h>
+#include <string.h>
+#include <assert.h>
+#include "hal_defs.h"
+
+#ifdef HAL_AES_USE_DMA
+#include <dmadrv.h>
+#endif
 
 #define AES_BLOCKSIZE 16
 
 typedef void (*AES_CtrFuncPtr_TypeDef)(uint8_t *ctr);
 
+#ifdef HAL_AES_USE_DMA
+static unsigned int dma_channel;
+static bool dma_channel_allocated = false;
+#endif
+
 /* Increment AES counter */
 void IncrementAesCounterBlock(uint8_t * ctr_blk)
 {
@@ -53,7 +65,176 @@ __LINK_C void hw_aes_cbc128(uint8_t *out, const uint8_t *in, unsigned int len, c
 	AES_CBC128(out, in, len, key, iv, encrypt);
 }
 
+#if defined( AES_CTRL_KEYBUFEN )
+#define AES_CTRL_KEY AES_CTRL_KEYBUFEN
+#else
+#define AES_CTRL_KEY 0
+#endif
+
+/* The key used by the *_loaded() functions. The frame data and keys are byte arrays which can start at any address,
+ * so they are only accessed as words after copying them to aligned buffers like this one. */
+static uint32_t loaded_key[4];
+
+/* Writes a block to DATA or XORDATA. Without key buffer the key register is changed by every encryption, so the key is
+ * written again before every block. */
+static void write_block(volatile uint32_t *reg, const uint32_t *block)
+{
+    int i;
+
+#if !defined( AES_CTRL_KEYBUFEN )
+    for (i = 3; i >= 0; i--)
+        AES->KEYLA = __REV(loaded_key[i]);
+#endif
+
+    for (i = 3; i >= 0; i--)
+        *reg = __REV(block[i]);
+
+    while (AES->STATUS & AES_STATUS_RUNNING);
+}
+
+static void read_block(uint32_t *block)
+{
+    int i;
+
+    for (i = 3; i >= 0; i--)
+        block[i] = __REV(AES->DATA);
+}
+
+#ifdef HAL_AES_USE_DMA
+/* Streams whole blocks from memory to XORDATA by DMA. The BYTEORDER mode lets the peripheral take the blocks in
+ * memory order, so the buffer does not have to be rearranged first. The source has to be word aligned. */
+static void cbc_mac_dma(uint32_t *mac, const uint32_t *in, unsigned int blocks)
+{
+    int i;
+    bool done = false;
+    Ecode_t e;
+
+    if (!dma_channel_allocated)
+    {
+        // DMADRV is used for allocating a channel, since the UART and ezradio drivers use it as well
+        e = DMADRV_Init();
+        assert(e == ECODE_EMDRV_DMADRV_OK || e == ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED);
+        e = DMADRV_AllocateChannel(&dma_channel, NULL); assert(e == ECODE_EMDRV_DMADRV_OK);
+        dma_channel_allocated = true;
+    }
+
+    AES->CTRL = AES_CTRL_KEYBUFEN | AES_CTRL_XORSTART | AES_CTRL_BYTEORDER;
+
+    for (i = 0; i < 4; i++)
+        AES->KEYHA = loaded_key[i];
+
+    for (i = 0; i < 4; i++)
+        AES->DATA = mac[i];
+
+    e = DMADRV_MemoryPeripheral(dma_channel, dmadrvPeripheralSignal_AES_XORDATAWR, (void*)&AES->XORDATA,
+                                (void*)in, true, blocks * 4, dmadrvDataSize4, NULL, NULL);
+    assert(e == ECODE_EMDRV_DMADRV_OK);
+
+    while (!done)
+        DMADRV_TransferDone(dma_channel, &done);
+
+    while (AES->STATUS & AES_STATUS_RUNNING);
+
+    for (i = 0; i < 4; i++)
+        mac[i] = AES->DATA;
+
+    AES->CTRL = 0;
+
+    /* the key buffer holds the key in the BYTEORDER layout now, restore it for the other functions */
+    for (i = 3; i >= 0; i--)
+        AES->KEYHA = __REV(loaded_key[i]);
+}
+#endif
+
+__LINK_C void hw_aes_load_key128(const uint8_t *key)
+{
+    memcpy(loaded_key, key, sizeof(loaded_key));
+
+#if defined( AES_CTRL_KEYBUFEN )
+    /* the key stays in the key buffer and is restored before every block */
+    int i;
+
+    for (i = 3; i >= 0; i--)
+        AES->KEYHA = __REV(loaded_key[i]);
+#endif
+}
+
+__LINK_C void hw_aes_ctr128_loaded(uint8_t *out, const uint8_t *in, unsigned int len, uint8_t *ctr)
+{
+    unsigned int i, n;
+    uint32_t block[4];
+    const uint8_t *key_stream = (const uint8_t *)block;
+
+    AES->CTRL = AES_CTRL_KEY | AES_CTRL_DATASTART;
+
+    while (len > 0)
+    {
+        n = len < AES_BLOCKSIZE ? len : AES_BLOCKSIZE;
+        memcpy(block, ctr, sizeof(block));
+        write_block(&AES->DATA, block);
+        read_block(block);
+
+        for (i = 0; i < n; i++)
+            out[i] = in[i] ^ key_stream[i];
+
+        /* like the software implementation, the counter is not incremented after a last partial block */
+        if (n == AES_BLOCKSIZE)
+            IncrementAesCounterBlock(ctr);
+
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+
+__LINK_C void hw_aes_cbc_mac128_loaded(uint8_t *mac, const uint8_t *in, unsigned int len)
+{
+    unsigned int n;
+    uint32_t block[4];
+
+    memcpy(block, mac, sizeof(block));
+
+#ifdef HAL_AES_USE_DMA
+    /* a single block is faster by hand than setting up the DMA */
+    if (len >= 2 * AES_BLOCKSIZE && !((uintptr_t)in & 3))
+    {
+        n = len - len % AES_BLOCKSIZE;
+        cbc_mac_dma(block, (const uint32_t *)in, n / AES_BLOCKSIZE);
+        in += n;
+        len -= n;
+    }
+#endif
+
+    AES->CTRL = AES_CTRL_KEY | AES_CTRL_XORSTART;
+
+    /* writing DATA does not start an encryption */
+    write_block(&AES->DATA, block);
+
+    /* every block written to XORDATA is XOR'ed with the previous cipher block still in DATA and encrypted */
+    while (len > 0)
+    {
+        n = len < AES_BLOCKSIZE ? len : AES_BLOCKSIZE;
+        if (n < AES_BLOCKSIZE)
+            memset(block, 0, sizeof(block));
+
+        memcpy(block, in, n);
+        write_block(&AES->XORDATA, block);
+        in += n;
+        len -= n;
+    }
+
+    read_block(block);
+    memcpy(mac, block, sizeof(block));
+}
+
 __LINK_C void hw_aes_ctr128(uint8_t *out, const uint8_t *in, unsigned int len, const uint8_t *key, uint8_t * ctr)
 {
-	AES_CTR128(out, in, len, key, ctr, &IncrementAesCounterBlock);
+    hw_aes_load_key128(key);
+    hw_aes_ctr128_loaded(out, in, len, ctr);
+}
+
+__LINK_C void hw_aes_cbc_mac128(uint8_t *mac, const uint8_t *in, unsigned int len, const uint8_t *key)
+{
+    hw_aes_load_key128(key);
+    hw_aes_cbc_mac128_loaded(mac, in, len);
 }
@@ -0,0 +1,149 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file posix_chip.h
+ *
+ *  \brief Internal interface of the posix 'chip'.
+ *
+ *  The posix chip runs the stack as an ordinary process on top of a POSIX
+ *  operating system. Interrupts are emulated using signals: SIGALRM is raised
+ *  by a single interval timer on which a small number of 'irq timers' are
+ *  multiplexed and SIGIO is raised whenever one of the registered file
+ *  descriptors becomes readable. start_atomic() / end_atomic() block these
+ *  signals, which makes the handlers behave like ISRs towards the rest of
+ *  the stack.
+ *
+ *  The functions below are used by the posix peripheral drivers and by
+ *  drivers of other (virtual) chips that run on top of it, such as the udp radio.
+ *
+ *  When NODE_GLOBALS is defined, several stack instances ('nodes') share the
+ *  process. Every irq timer and file descriptor then belongs to the node which
+ *  registered it and its handler is called with that node selected using
+ *  set_node_global_id(). The hardware timer keeps its state per node as well.
+ *
+ *  When POSIX_VIRTUAL_TIME is defined, the clock is not the monotonic clock of
+ *  the OS but a virtual clock which only advances when the process would go to
+ *  sleep: posix_irq_wait() then jumps straight to the fire time of the first
+ *  irq timer. Since all timing (the hardware timer, virtual radios) derives from
+ *  this clock, the order of all events is kept exactly while a duty-cycled
+ *  network executes many times faster than real time. The simulation ends when
+ *  the clock reaches POSIX_VIRTUAL_TIME_LIMIT seconds (when larger than 0).
+ */
+
+#ifndef __POSIX_CHIP_H
+#define __POSIX_CHIP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "errors.h"
+#include "link_c.h"
+#include "platform.h" // NODE_GLOBALS is defined by the platform
+
+#define PLATFORM_NUM_TIMERS 1
+
+#ifdef NODE_GLOBALS
+/*! \brief The hardware timer keeps separate state for each node, so the default timer can be used */
+#define HWTIMER_NODE_GLOBALS
+
+/*! \brief The number of irq timers that can be registered */
+#define POSIX_IRQ_MAX_TIMERS (4 * NODE_GLOBALS_MAX_NODES)
+#else
+/*! \brief The number of irq timers that can be registered */
+#define POSIX_IRQ_MAX_TIMERS 4
+#endif
+
+/*! \brief The number of file descriptors that can be registered as interrupt source */
+#define POSIX_IRQ_MAX_FDS 4
+
+#define POSIX_NS_PER_SEC UINT64_C(1000000000)
+
+#if defined(POSIX_VIRTUAL_TIME) && !defined(POSIX_VIRTUAL_TIME_LIMIT)
+    #define POSIX_VIRTUAL_TIME_LIMIT 0
+#endif
+
+typedef void (*posix_irq_handler_t)();
+
+typedef uint16_t posix_irq_timer_id_t;
+
+/*! \brief Initialise the posix chip.
+ *
+ * Must be called by the platform before any other function of the HAL is used.
+ * The arguments of the process are kept so hw_reset() can restart it.
+ */
+__LINK_C void __posix_chip_init(int argc, char** argv);
+
+/*! \brief Initialise the signal based interrupt emulation. Called by __posix_chip_init() */
+__LINK_C void __posix_irq_init();
+
+/*! \brief Get the current time of the (monotonic or virtual) clock driving all irq timers, in nanoseconds */
+__LINK_C uint64_t posix_clock_get_ns();
+
+#ifdef POSIX_VIRTUAL_TIME
+/*! \brief Advance the virtual clock, used to let busy waiting take time */
+__LINK_C void posix_clock_advance(uint64_t ns);
+#endif
+
+/*! \brief Register a new irq timer which calls <handler> from interrupt context when it fires.
+ *
+ * \return	SUCCESS if the timer was registered, ENOMEM if POSIX_IRQ_MAX_TIMERS is exceeded
+ */
+__LINK_C error_t posix_irq_timer_register(posix_irq_handler_t handler, posix_irq_timer_id_t* timer_id);
+
+/*! \brief (Re)schedule an irq timer to fire at the absolute time <fire_time_ns> of posix_clock_get_ns().
+ *
+ * A fire time in the past makes the timer fire as soon as interrupts are enabled.
+ */
+__LINK_C void posix_irq_timer_set(posix_irq_timer_id_t timer_id, uint64_t fire_time_ns);
+
+/*! \brief Cancel an irq timer. Cancelling a timer that is not scheduled has no effect */
+__LINK_C void posix_irq_timer_cancel(posix_irq_timer_id_t timer_id);
+
+/*! \brief Register a file descriptor as interrupt source.
+ *
+ * The file descriptor is put in non-blocking mode and <handler> is called from interrupt
+ * context whenever data is available for reading. The handler is expected to read all
+ * available data.
+ *
+ * \return	SUCCESS if the fd was registered
+ *		EALREADY if the fd was already registered
+ *		ENOMEM if POSIX_IRQ_MAX_FDS is exceeded
+ *		FAIL if the fd does not support asynchronous notification
+ */
+__LINK_C error_t posix_irq_fd_register(int fd, posix_irq_handler_t handler);
+
+/*! \brief Stop using a file descriptor as interrupt source (eg. when EOF is reached) */
+__LINK_C void posix_irq_fd_unregister(int fd);
+
+/*! \brief Block or unblock the interrupt signals. Used to implement start_atomic() / end_atomic() */
+__LINK_C void __posix_irq_mask(bool masked);
+
+/*! \brief Mark the start / end of an interrupt handler, so atomic sections inside it
+ *  do not re-enable the interrupts when they end.
+ */
+__LINK_C void __posix_isr_enter();
+__LINK_C void __posix_isr_exit();
+
+/*! \brief Suspend the process until the next interrupt has been handled.
+ *
+ * Returns immediately if an interrupt was handled since the previous call, to avoid missing
+ * wake-ups of interrupts that occur right before the scheduler decides to go to sleep.
+ */
+__LINK_C void posix_irq_wait();
+
+#endif //__POSIX_CHIP_H
@@ -0,0 +1,56 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file posix_atomic.c
+ *
+ *  Atomic sections block the signals used to emulate interrupts.
+ *
+ */
+
+#include <signal.h>
+
+#include "hwatomic.h"
+#include "posix_chip.h"
+#include "debug.h"
+
+static volatile sig_atomic_t nesting = 0;
+
+void start_atomic()
+{
+    if(nesting++ == 0)
+        __posix_irq_mask(true);
+}
+
+void end_atomic()
+{
+    assert(nesting > 0);
+    if(--nesting == 0)
+        __posix_irq_mask(false);
+}
+
+void __posix_isr_enter()
+{
+    // the signals are already blocked while the handler runs, only
+    // make sure atomic sections inside the handler do not unblock them
+    nesting++;
+}
+
+void __posix_isr_exit()
+{
+    nesting--;
+}
@@ -0,0 +1,361 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file posix_irq.c
+ *
+ *  Signal based emulation of interrupts, see posix_chip.h
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "posix_chip.h"
+#include "debug.h"
+#include "ng.h"
+
+typedef struct
+{
+    posix_irq_handler_t handler;
+    uint64_t fire_time;
+    bool scheduled;
+#ifdef NODE_GLOBALS
+    size_t node;
+#endif
+} irq_timer_t;
+
+typedef struct
+{
+    int fd;
+    int orig_flags;
+    posix_irq_handler_t handler;
+#ifdef NODE_GLOBALS
+    size_t node;
+#endif
+} irq_fd_t;
+
+static irq_timer_t irq_timers[POSIX_IRQ_MAX_TIMERS];
+static posix_irq_timer_id_t irq_timer_count = 0;
+static irq_fd_t irq_fds[POSIX_IRQ_MAX_FDS];
+static uint8_t irq_fd_count = 0;
+
+static sigset_t irq_signals;
+#ifndef POSIX_VIRTUAL_TIME
+static timer_t os_timer;
+#endif
+static volatile sig_atomic_t irq_handled = 0;
+
+#ifdef POSIX_VIRTUAL_TIME
+static volatile uint64_t virtual_time = 0;
+#endif
+
+__LINK_C uint64_t posix_clock_get_ns()
+{
+#ifdef POSIX_VIRTUAL_TIME
+    return virtual_time;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * POSIX_NS_PER_SEC + ts.tv_nsec;
+#endif
+}
+
+#ifdef NODE_GLOBALS
+static void call_handler(posix_irq_handler_t handler, size_t node)
+{
+    // the interrupt might have preempted code running for another node
+    size_t interrupted_node = __ng_node_id__;
+    set_node_global_id(node);
+    handler();
+    __ng_node_id__ = interrupted_node;
+}
+#else
+#define call_handler(handler, node) handler()
+#endif
+
+static bool get_next_fire_time(uint64_t* fire_time)
+{
+    bool scheduled = false;
+    for(posix_irq_timer_id_t i = 0; i < irq_timer_count; i++)
+    {
+        if(irq_timers[i].scheduled && (!scheduled || irq_timers[i].fire_time < *fire_time))
+        {
+            *fire_time = irq_timers[i].fire_time;
+            scheduled = true;
+        }
+    }
+
+    return scheduled;
+}
+
+#ifdef POSIX_VIRTUAL_TIME
+static void configure_os_timer()
+{
+    // this function should only be called while the interrupt signals are blocked.
+    // The clock only moves in posix_irq_wait() and posix_clock_advance(), so a timer
+    // only has to be raised here when it is set to a time which has already been reached
+    uint64_t fire_time;
+    if(get_next_fire_time(&fire_time) && fire_time <= virtual_time)
+        raise(SIGALRM);
+}
+#else
+static void configure_os_timer()
+{
+    // this function should only be called while the interrupt signals are blocked
+    struct itimerspec its = { 0 };
+    uint64_t fire_time = 0;
+    bool scheduled = get_next_fire_time(&fire_time);
+    if(scheduled)
+    {
+        // an it_value of 0 disarms the timer, an absolute time in the past fires immediately
+        if(fire_time == 0)
+            fire_time = 1;
+
+        its.it_value.tv_sec = fire_time / POSIX_NS_PER_SEC;
+        its.it_value.tv_nsec = fire_time % POSIX_NS_PER_SEC;
+    }
+
+    timer_settime(os_timer, TIMER_ABSTIME, &its, NULL);
+}
+#endif
+
+static void dispatch_timers()
+{
+    bool fired;
+    do
+    {
+        fired = false;
+        uint64_t now = posix_clock_get_ns();
+        for(posix_irq_timer_id_t i = 0; i < irq_timer_count; i++)
+        {
+            if(irq_timers[i].scheduled && irq_timers[i].fire_time <= now)
+            {
+                irq_timers[i].scheduled = false;
+                call_handler(irq_timers[i].handler, irq_timers[i].node);
+                fired = true;
+            }
+        }
+    }
+    while(fired);
+
+    configure_os_timer();
+}
+
+static void dispatch_fds()
+{
+    struct pollfd pfds[POSIX_IRQ_MAX_FDS];
+    uint8_t count = irq_fd_count;
+    for(uint8_t i = 0; i < count; i++)
+    {
+        pfds[i].fd = irq_fds[i].fd;
+        pfds[i].events = POLLIN;
+    }
+
+    if(poll(pfds, count, 0) <= 0)
+        return;
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+        // the handler of a previous fd might have unregistered this one
+        if(i < irq_fd_count && irq_fds[i].fd == pfds[i].fd && (pfds[i].revents & (POLLIN | POLLHUP)))
+            call_handler(irq_fds[i].handler, irq_fds[i].node);
+    }
+}
+
+static void signal_handler(int signal)
+{
+    int saved_errno = errno;
+    __posix_isr_enter();
+
+    if(signal == SIGALRM)
+        dispatch_timers();
+    else if(signal == SIGIO)
+        dispatch_fds();
+
+    irq_handled = 1;
+    __posix_isr_exit();
+    errno = saved_errno;
+}
+
+static void restore_fd_flags()
+{
+    for(uint8_t i = 0; i < irq_fd_count; i++)
+        fcntl(irq_fds[i].fd, F_SETFL, irq_fds[i].orig_flags);
+}
+
+__LINK_C void __posix_irq_init()
+{
+    sigemptyset(&irq_signals);
+    sigaddset(&irq_signals, SIGALRM);
+    sigaddset(&irq_signals, SIGIO);
+
+    struct sigaction sa = { 0 };
+    sa.sa_handler = &signal_handler;
+    sa.sa_mask = irq_signals; // 'interrupts' do not preempt each other
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &sa, NULL);
+    sigaction(SIGIO, &sa, NULL);
+
+#ifndef POSIX_VIRTUAL_TIME
+    struct sigevent sev = { 0 };
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = SIGALRM;
+    int err = timer_create(CLOCK_MONOTONIC, &sev, &os_timer);
+    assert(err == 0);
+#endif
+
+    atexit(&restore_fd_flags);
+}
+
+__LINK_C error_t posix_irq_timer_register(posix_irq_handler_t handler, posix_irq_timer_id_t* timer_id)
+{
+    if(irq_timer_count >= POSIX_IRQ_MAX_TIMERS)
+        return ENOMEM;
+
+    __posix_irq_mask(true);
+    irq_timers[irq_timer_count].handler = handler;
+    irq_timers[irq_timer_count].scheduled = false;
+#ifdef NODE_GLOBALS
+    irq_timers[irq_timer_count].node = get_node_global_id();
+#endif
+    *timer_id = irq_timer_count++;
+    __posix_irq_mask(false);
+    return SUCCESS;
+}
+
+__LINK_C void posix_irq_timer_set(posix_irq_timer_id_t timer_id, uint64_t fire_time_ns)
+{
+    assert(timer_id < irq_timer_count);
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &irq_signals, &old);
+    irq_timers[timer_id].fire_time = fire_time_ns;
+    irq_timers[timer_id].scheduled = true;
+    configure_os_timer();
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+__LINK_C void posix_irq_timer_cancel(posix_irq_timer_id_t timer_id)
+{
+    assert(timer_id < irq_timer_count);
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &irq_signals, &old);
+    irq_timers[timer_id].scheduled = false;
+    configure_os_timer();
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+__LINK_C error_t posix_irq_fd_register(int fd, posix_irq_handler_t handler)
+{
+    for(uint8_t i = 0; i < irq_fd_count; i++)
+        if(irq_fds[i].fd == fd)
+            return EALREADY;
+
+    if(irq_fd_count >= POSIX_IRQ_MAX_FDS)
+        return ENOMEM;
+
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0 || fcntl(fd, F_SETOWN, getpid()) < 0 || fcntl(fd, F_SETFL, flags | O_ASYNC | O_NONBLOCK) < 0)
+        return FAIL;
+
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &irq_signals, &old);
+    irq_fds[irq_fd_count].fd = fd;
+    irq_fds[irq_fd_count].orig_flags = flags;
+    irq_fds[irq_fd_count].handler = handler;
+#ifdef NODE_GLOBALS
+    irq_fds[irq_fd_count].node = get_node_global_id();
+#endif
+    irq_fd_count++;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    // data might already be waiting, SIGIO is only raised for new data
+    raise(SIGIO);
+    return SUCCESS;
+}
+
+__LINK_C void posix_irq_fd_unregister(int fd)
+{
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &irq_signals, &old);
+    for(uint8_t i = 0; i < irq_fd_count; i++)
+    {
+        if(irq_fds[i].fd == fd)
+        {
+            fcntl(fd, F_SETFL, irq_fds[i].orig_flags);
+            irq_fds[i] = irq_fds[--irq_fd_count];
+            break;
+        }
+    }
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+__LINK_C void __posix_irq_mask(bool masked)
+{
+    sigprocmask(masked ? SIG_BLOCK : SIG_UNBLOCK, &irq_signals, NULL);
+}
+
+__LINK_C void posix_irq_wait()
+{
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &irq_signals, &old);
+    if(!irq_handled)
+    {
+#ifdef POSIX_VIRTUAL_TIME
+        // nothing can happen before the next timer fires, except for fd interrupts
+        // which are only waited for when no timer is scheduled at all
+        uint64_t fire_time;
+        if(get_next_fire_time(&fire_time))
+        {
+#if POSIX_VIRTUAL_TIME_LIMIT > 0
+            if(fire_time >= POSIX_VIRTUAL_TIME_LIMIT * POSIX_NS_PER_SEC)
+                exit(EXIT_SUCCESS);
+#endif
+            if(fire_time > virtual_time)
+                virtual_time = fire_time;
+
+            signal_handler(SIGALRM);
+        }
+        else
+#endif
+        {
+            sigset_t wait_mask = old;
+            sigdelset(&wait_mask, SIGALRM);
+            sigdelset(&wait_mask, SIGIO);
+            sigsuspend(&wait_mask);
+        }
+    }
+
+    irq_handled = 0;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+#ifdef POSIX_VIRTUAL_TIME
+__LINK_C void posix_clock_advance(uint64_t ns)
+{
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &irq_signals, &old);
+    virtual_time += ns;
+    configure_os_timer();
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+#endif
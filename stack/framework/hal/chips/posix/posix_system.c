@@ -0,0 +1,89 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file posix_system.c
+ *
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hwsystem.h"
+#include "posix_chip.h"
+#include "ng.h"
+
+static char** process_argv;
+
+void __posix_chip_init(int argc, char** argv)
+{
+    process_argv = argv;
+    __posix_irq_init();
+}
+
+void hw_enter_lowpower_mode(uint8_t mode)
+{
+    // all 'low power modes' simply suspend the process until the next interrupt
+    posix_irq_wait();
+}
+
+uint64_t hw_get_unique_id()
+{
+#ifdef NODE_GLOBALS
+    // the nodes sharing the process are numbered, which keeps their ids the same
+    // in every run of a simulation
+    return (((uint64_t) gethostid()) << 32) | (uint32_t) get_node_global_id();
+#else
+    // the pid keeps the processes running on one host apart, it is placed in the
+    // least significant bits as recommended in hwsystem.h
+    return (((uint64_t) gethostid()) << 32) | (uint32_t) getpid();
+#endif
+}
+
+void hw_busy_wait(int16_t microseconds)
+{
+    if(microseconds <= 0)
+        return;
+
+#ifdef POSIX_VIRTUAL_TIME
+    posix_clock_advance(((uint64_t) microseconds) * 1000);
+#else
+    uint64_t end = posix_clock_get_ns() + ((uint64_t) microseconds) * 1000;
+    while(posix_clock_get_ns() < end)
+        ;
+#endif
+}
+
+void hw_reset()
+{
+    // restart the process with the same arguments
+    if(process_argv != NULL)
+        execv("/proc/self/exe", process_argv);
+
+    abort();
+}
+
+float hw_get_internal_temperature()
+{
+    return 20.0;
+}
+
+uint32_t hw_get_battery(void)
+{
+    return 3000;
+}
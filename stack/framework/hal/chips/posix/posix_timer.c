@@ -0,0 +1,219 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file posix_timer.c
+ *
+ *  The hardware timer is emulated on top of the monotonic clock. The counter
+ *  runs from the moment the timer is initialised and wraps around like a
+ *  16-bit hardware counter. An irq timer is scheduled at the earliest of
+ *  the compare value and the next counter overflow, so both the compare and
+ *  the overflow callbacks are called from 'interrupt' context, in the order
+ *  in which they would occur on a MCU.
+ *
+ *  The state is kept per node, so when NODE_GLOBALS is defined every node
+ *  has its own counter (see posix_chip.h).
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hwtimer.h"
+#include "hwatomic.h"
+#include "posix_chip.h"
+#include "ng.h"
+
+#define COUNTER_PERIOD (UINT64_C(1) << (8*sizeof(hwtimer_tick_t)))
+
+static timer_callback_t NGDEF(_compare_f);
+#define compare_f NG(_compare_f)
+
+static timer_callback_t NGDEF(_overflow_f);
+#define overflow_f NG(_overflow_f)
+
+static bool NGDEF(_timer_inited);
+#define timer_inited NG(_timer_inited)
+
+static uint32_t NGDEF(_ticks_per_sec);
+#define ticks_per_sec NG(_ticks_per_sec)
+
+// clock time (ns) of counter value 0
+static uint64_t NGDEF(_epoch);
+#define epoch NG(_epoch)
+
+// number of overflows for which overflow_f was called
+static uint64_t NGDEF(_overflows_handled);
+#define overflows_handled NG(_overflows_handled)
+
+// absolute tick at which compare_f is called
+static uint64_t NGDEF(_compare_tick);
+#define compare_tick NG(_compare_tick)
+
+static bool NGDEF(_compare_scheduled);
+#define compare_scheduled NG(_compare_scheduled)
+
+static posix_irq_timer_id_t NGDEF(_irq_timer);
+#define irq_timer NG(_irq_timer)
+
+static uint64_t get_ticks()
+{
+    uint64_t ns = posix_clock_get_ns() - epoch;
+    return (ns / POSIX_NS_PER_SEC) * ticks_per_sec + ((ns % POSIX_NS_PER_SEC) * ticks_per_sec) / POSIX_NS_PER_SEC;
+}
+
+static uint64_t ticks_to_clock(uint64_t ticks)
+{
+    // round up, the counter must have reached 'ticks' when the irq timer fires
+    return epoch + (ticks / ticks_per_sec) * POSIX_NS_PER_SEC
+            + ((ticks % ticks_per_sec) * POSIX_NS_PER_SEC + ticks_per_sec - 1) / ticks_per_sec;
+}
+
+static void configure_irq_timer()
+{
+    uint64_t fire_tick = (overflows_handled + 1) * COUNTER_PERIOD;
+    if(compare_scheduled && compare_tick < fire_tick)
+        fire_tick = compare_tick;
+
+    posix_irq_timer_set(irq_timer, ticks_to_clock(fire_tick));
+}
+
+static void timer_isr()
+{
+    while(true)
+    {
+        uint64_t now = get_ticks();
+        uint64_t overflow_tick = (overflows_handled + 1) * COUNTER_PERIOD;
+        if(compare_scheduled && compare_tick <= now && compare_tick < overflow_tick)
+        {
+            compare_scheduled = false;
+            if(compare_f != 0x0)
+                compare_f();
+        }
+        else if(overflow_tick <= now)
+        {
+            overflows_handled++;
+            if(overflow_f != 0x0)
+                overflow_f();
+        }
+        else
+            break;
+    }
+
+    configure_irq_timer();
+}
+
+error_t hw_timer_init(hwtimer_id_t timer_id, uint8_t frequency, timer_callback_t compare_callback, timer_callback_t overflow_callback)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+    if(timer_inited)
+        return EALREADY;
+    if(frequency != HWTIMER_FREQ_1MS && frequency != HWTIMER_FREQ_32K)
+        return EINVAL;
+
+    error_t err = posix_irq_timer_register(&timer_isr, &irq_timer);
+    if(err != SUCCESS)
+        return err;
+
+    start_atomic();
+    compare_f = compare_callback;
+    overflow_f = overflow_callback;
+    ticks_per_sec = (frequency == HWTIMER_FREQ_1MS) ? HWTIMER_TICKS_1MS : HWTIMER_TICKS_32K;
+    epoch = posix_clock_get_ns();
+    overflows_handled = 0;
+    compare_scheduled = false;
+    timer_inited = true;
+    configure_irq_timer();
+    end_atomic();
+
+    return SUCCESS;
+}
+
+hwtimer_tick_t hw_timer_getvalue(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM || (!timer_inited))
+        return 0;
+
+    return (hwtimer_tick_t) get_ticks();
+}
+
+error_t hw_timer_schedule(hwtimer_id_t timer_id, hwtimer_tick_t tick)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+    if(!timer_inited)
+        return EOFF;
+
+    start_atomic();
+    // like a hardware compare register: fire the next time the counter equals 'tick'
+    uint64_t now = get_ticks();
+    compare_tick = (now - (now % COUNTER_PERIOD)) + tick;
+    if(compare_tick <= now)
+        compare_tick += COUNTER_PERIOD;
+
+    compare_scheduled = true;
+    configure_irq_timer();
+    end_atomic();
+    return SUCCESS;
+}
+
+error_t hw_timer_cancel(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+    if(!timer_inited)
+        return EOFF;
+
+    start_atomic();
+    compare_scheduled = false;
+    configure_irq_timer();
+    end_atomic();
+    return SUCCESS;
+}
+
+error_t hw_timer_counter_reset(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+    if(!timer_inited)
+        return EOFF;
+
+    start_atomic();
+    epoch = posix_clock_get_ns();
+    overflows_handled = 0;
+    compare_scheduled = false;
+    configure_irq_timer();
+    end_atomic();
+    return SUCCESS;
+}
+
+bool hw_timer_is_overflow_pending(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM || (!timer_inited))
+        return false;
+
+    return (get_ticks() / COUNTER_PERIOD) > overflows_handled;
+}
+
+bool hw_timer_is_interrupt_pending(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM || (!timer_inited))
+        return false;
+
+    return compare_scheduled && compare_tick <= get_ticks();
+}
@@ -0,0 +1,184 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file posix_uart.c
+ *
+ *  The process has a single 'uart', used for the console. It is either
+ *  mapped on stdin / stdout or, when POSIX_UART_USE_PTY is defined by the
+ *  platform, on a pseudo terminal so tools which normally talk to a serial
+ *  port (eg. a modem client) can be attached to it.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "hwuart.h"
+#include "platform.h"
+#include "posix_chip.h"
+
+#define UARTS 1
+
+struct uart_handle {
+  int rx_fd;
+  int tx_fd;
+  bool enabled;
+  bool rx_interrupt_enabled;
+  uart_rx_inthandler_t rx_callback;
+};
+
+static uart_handle_t handle[UARTS] = {
+  { .rx_fd = -1, .tx_fd = -1 }
+};
+
+#ifdef POSIX_UART_USE_PTY
+static int open_pty()
+{
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    return -1;
+
+  // keep the slave side open, so the master does not report EOF while no
+  // client is attached, and put it in raw mode like a real serial port
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if(slave < 0)
+    return -1;
+
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  fprintf(stderr, "console available on %s\n", ptsname(master));
+  return master;
+}
+#endif
+
+uart_handle_t* uart_init(uint8_t channel, uint32_t baudrate, uint8_t pins) {
+  if(channel >= UARTS)
+    return NULL;
+
+  if(handle[channel].tx_fd >= 0)
+    return &handle[channel];
+
+#ifdef POSIX_UART_USE_PTY
+  int fd = open_pty();
+  if(fd < 0)
+    return NULL;
+
+  handle[channel].rx_fd = fd;
+  handle[channel].tx_fd = fd;
+#else
+  handle[channel].rx_fd = STDIN_FILENO;
+  handle[channel].tx_fd = STDOUT_FILENO;
+#endif
+  return &handle[channel];
+}
+
+bool uart_enable(uart_handle_t* uart) {
+  uart->enabled = true;
+  return true;
+}
+
+bool uart_disable(uart_handle_t* uart) {
+  uart->enabled = false;
+  return true;
+}
+
+void uart_send_byte(uart_handle_t* uart, uint8_t data) {
+  uart_send_bytes(uart, &data, 1);
+}
+
+void uart_send_bytes(uart_handle_t* uart, void const *data, size_t length) {
+  if(!uart->enabled)
+    return;
+
+  uint8_t const* bytes = data;
+  while(length > 0)
+  {
+    ssize_t written = write(uart->tx_fd, bytes, length);
+    if(written < 0)
+    {
+      if(errno == EINTR)
+        continue;
+
+      if(errno != EAGAIN)
+        return;
+
+      // the fd was put in non-blocking mode for the rx interrupt: wait until it is writable again
+      struct pollfd pfd = { .fd = uart->tx_fd, .events = POLLOUT };
+      poll(&pfd, 1, -1);
+      continue;
+    }
+
+    bytes += written;
+    length -= written;
+  }
+}
+
+void uart_send_string(uart_handle_t* uart, const char *string) {
+  uart_send_bytes(uart, string, strlen(string));
+}
+
+static void uart_rx_isr()
+{
+  uart_handle_t* uart = &handle[0];
+  uint8_t buffer[64];
+  ssize_t len;
+  while((len = read(uart->rx_fd, buffer, sizeof(buffer))) > 0)
+  {
+    if(!uart->rx_interrupt_enabled || uart->rx_callback == NULL)
+      continue;
+
+    for(ssize_t i = 0; i < len; i++)
+      uart->rx_callback(buffer[i]);
+  }
+
+  if(len == 0)
+  {
+    // EOF, eg. stdin is a pipe that was closed
+    posix_irq_fd_unregister(uart->rx_fd);
+  }
+}
+
+error_t uart_rx_interrupt_enable(uart_handle_t* uart) {
+  if(uart->rx_callback == NULL)
+    return EOFF;
+
+  uart->rx_interrupt_enabled = true;
+  error_t err = posix_irq_fd_register(uart->rx_fd, &uart_rx_isr);
+  if(err == EALREADY)
+    err = SUCCESS;
+
+  return err;
+}
+
+void uart_rx_interrupt_disable(uart_handle_t* uart) {
+  uart->rx_interrupt_enabled = false;
+}
+
+void uart_set_rx_interrupt_callback(uart_handle_t* uart, uart_rx_inthandler_t rx_handler)
+{
+  uart->rx_callback = rx_handler;
+}
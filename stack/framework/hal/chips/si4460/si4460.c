@@ -111,6 +111,7 @@ static bool should_rx_after_tx_completed = false;
 static uint16_t tx_fifo_data_length = 0;
 static uint16_t rx_fifo_data_lenght = 0;
 static uint16_t expected_data_length = 0;
+static fec_ctx_t rx_fec_ctx;
 
 static hw_rx_cfg_t current_rx_cfg = {0x0000, PHY_SYNCWORD_CLASS0};
 static syncword_class_t current_syncword_class = PHY_SYNCWORD_CLASS0;
@@ -712,6 +713,17 @@ static inline int16_t convert_rssi(uint8_t rssi_raw)
     return ((int16_t)(rssi_raw >> 1)) - (70 + RSSI_OFFSET);
 }
 
+// reads length bytes from the RX FIFO into the packet being received. FEC encoded data is decoded (in place) as soon as it is
+// read, so only the last chunk remains to be decoded at the end of the packet
+static void read_rx_fifo(uint8_t length)
+{
+	ezradio_read_rx_fifo(length, &(rx_packet->data[rx_fifo_data_lenght]));
+	if (current_rx_cfg.channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+		fec_decode_feed(&rx_fec_ctx, &(rx_packet->data[rx_fifo_data_lenght]), length);
+
+	rx_fifo_data_lenght += length;
+}
+
 static void ezradio_handle_end_of_packet()
 {
 	// fill rx_meta
@@ -729,14 +741,14 @@ static void ezradio_handle_end_of_packet()
 
 	ezradio_fifo_info(EZRADIO_CMD_FIFO_INFO_ARG_FIFO_RX_BIT, NULL);
 
-	DPRINT_DATA(rx_packet->data, expected_data_length);
-
 	if (current_rx_cfg.channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
 	{
-		fec_decode_packet(rx_packet->data, expected_data_length, expected_data_length);
+		fec_decode_end(&rx_fec_ctx);
 		//assert length and data[0] can only differ 1
 	}
 
+	DPRINT_DATA(rx_packet->data, expected_data_length);
+
 	DEBUG_RX_END();
 
 //					if(rx_packet_callback != NULL) // TODO this can happen while doing CCA but we should not be interrupting here (disable packet handler?)
@@ -806,7 +818,22 @@ static void ezradio_int_callback()
 								expected_data_length = buffer[0] + 1;
 							}
 							rx_packet = alloc_packet_callback(expected_data_length);
+							if (rx_packet == NULL)
+							{
+								// the upper layer has no buffer available, drop the frame
+								DPRINT("Could not allocate packet, flushing RX");
+								ezradio_fifo_info(EZRADIO_CMD_FIFO_INFO_ARG_FIFO_RX_BIT, NULL);
+								start_rx(&current_rx_cfg);
+								return;
+							}
+
 							memcpy(rx_packet->data, buffer, 4);
+							if (current_rx_cfg.channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+							{
+								fec_decode_begin(&rx_fec_ctx, rx_packet->data, expected_data_length, ((expected_data_length & 0xFE) + 2) << 1);
+								fec_decode_feed(&rx_fec_ctx, rx_packet->data, 4);
+							}
+
 							rx_fifo_data_lenght += 4;
 							radioReplyLocal.FIFO_INFO.RX_FIFO_COUNT-=4;
 						}
@@ -815,7 +842,7 @@ static void ezradio_int_callback()
 						{
 
 							/* Read out the RX FIFO content. */
-							ezradio_read_rx_fifo(radioReplyLocal.FIFO_INFO.RX_FIFO_COUNT, &(rx_packet->data[rx_fifo_data_lenght]));
+							read_rx_fifo(radioReplyLocal.FIFO_INFO.RX_FIFO_COUNT);
 							//ezradio_read_rx_fifo(radioReplyLocal2.PACKET_INFO.LENGTH, packet->data);
 
 							ezradio_handle_end_of_packet();
@@ -828,8 +855,7 @@ static void ezradio_int_callback()
 							{
 								DPRINT("RX FIFO: %d", radioReplyLocal.FIFO_INFO.RX_FIFO_COUNT);
 								/* Read out the FIFO Count bytes of RX FIFO */
-								ezradio_read_rx_fifo(radioReplyLocal.FIFO_INFO.RX_FIFO_COUNT, &(rx_packet->data[rx_fifo_data_lenght]));
-								rx_fifo_data_lenght += radioReplyLocal.FIFO_INFO.RX_FIFO_COUNT;
+								read_rx_fifo(radioReplyLocal.FIFO_INFO.RX_FIFO_COUNT);
 								//DPRINT("%d of %d bytes collected", rx_fifo_data_lenght, rx_packet->data[0]+1);
 								ezradio_fifo_info(0, &radioReplyLocal);
 
@@ -861,6 +887,14 @@ static void ezradio_int_callback()
 					if (rx_fifo_data_lenght == 0)
 					{
 						rx_packet = alloc_packet_callback(radioReplyLocal.FIFO_INFO.RX_FIFO_COUNT);
+						if (rx_packet == NULL)
+						{
+							// the upper layer has no buffer available, drop the frame
+							DPRINT("Could not allocate packet, flushing RX");
+							ezradio_fifo_info(EZRADIO_CMD_FIFO_INFO_ARG_FIFO_RX_BIT, NULL);
+							start_rx(&current_rx_cfg);
+							return;
+						}
 					}
 
 					/* Read out the RX FIFO content. */
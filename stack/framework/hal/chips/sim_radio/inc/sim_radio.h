@@ -0,0 +1,106 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file sim_radio.h
+ *
+ *  \brief Control interface of the simulated radio medium.
+ *
+ *  The sim radio connects the nodes of an in-process simulation (see NODE_GLOBALS
+ *  in ng.h). Every node has its own radio, all radios share one medium. A frame is
+ *  received by every other node listening on the same channel and syncword class,
+ *  with an RSSI equal to the EIRP of the sender minus the path loss between both
+ *  nodes, once the airtime given by dll_calculate_tx_duration() has elapsed.
+ *  Frames below SIM_RADIO_SENSITIVITY are not received but still occupy the
+ *  channel. A frame is lost when another frame overlapping it at the receiver is
+ *  not at least SIM_RADIO_CAPTURE_THRESHOLD dB weaker.
+ *
+ *  The bits of a received frame pass through an AWGN channel of which the Eb/N0 is
+ *  SIM_RADIO_SENSITIVITY_EBN0 at the sensitivity and rises with the RSSI. Frames
+ *  on PHY_CODING_FEC_PN9 channels are FEC encoded before and decoded after the
+ *  channel, with soft decisions (fec_decode_soft_feed()) unless
+ *  SIM_RADIO_HARD_DECISION is defined. Bit errors which are left are delivered to
+ *  the stack, where the CRC check drops the frame.
+ *
+ *  The functions below are used by simulation scenarios to configure the topology
+ *  and to collect statistics about the medium.
+ */
+
+#ifndef __SIM_RADIO_H
+#define __SIM_RADIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "link_c.h"
+
+/*! \brief The path loss (dB) between all nodes, unless configured otherwise using sim_radio_set_path_loss() */
+#ifndef SIM_RADIO_PATH_LOSS
+    #define SIM_RADIO_PATH_LOSS 70
+#endif
+
+/*! \brief The weakest signal (dBm) a radio can receive */
+#ifndef SIM_RADIO_SENSITIVITY
+    #define SIM_RADIO_SENSITIVITY -100
+#endif
+
+/*! \brief The Eb/N0 (dB) of the channel bits of a frame received at SIM_RADIO_SENSITIVITY, 7 dB gives a bit error rate of about 1e-3 */
+#ifndef SIM_RADIO_SENSITIVITY_EBN0
+    #define SIM_RADIO_SENSITIVITY_EBN0 7
+#endif
+
+/*! \brief The number of dB a frame should be stronger than an overlapping frame to survive the collision */
+#ifndef SIM_RADIO_CAPTURE_THRESHOLD
+    #define SIM_RADIO_CAPTURE_THRESHOLD 6
+#endif
+
+/*! \brief The time (us) it takes before the RSSI is valid after entering RX */
+#ifndef SIM_RADIO_RSSI_SETTLE_TIME
+    #define SIM_RADIO_RSSI_SETTLE_TIME 250
+#endif
+
+typedef struct
+{
+    uint32_t tx_frames;		/**< The number of frames transmitted */
+    uint32_t rx_frames;		/**< The number of frames delivered to the stack */
+    uint32_t rx_collisions;	/**< The number of frames lost due to overlapping frames */
+    uint32_t rx_bit_errors;	/**< The number of delivered frames with bit errors left after (FEC) decoding */
+    uint64_t airtime_ns;	/**< The total time during which a frame was being transmitted */
+} sim_radio_stats_t;
+
+/*! \brief Set the path loss between node_a and node_b, in both directions.
+ *
+ *  Setting a path loss above the EIRP minus SIM_RADIO_SENSITIVITY effectively disconnects both nodes.
+ */
+__LINK_C void sim_radio_set_path_loss(size_t node_a, size_t node_b, uint8_t path_loss);
+
+__LINK_C uint8_t sim_radio_get_path_loss(size_t node_a, size_t node_b);
+
+/*! \brief Get the statistics of the radio of a single node. The airtime is the airtime of the frames it transmitted */
+__LINK_C void sim_radio_get_node_stats(size_t node, sim_radio_stats_t* stats);
+
+/*! \brief Get the statistics of the whole medium.
+ *
+ *  The airtime is the time during which at least one frame was in the air, which makes
+ *  the channel utilization equal to airtime_ns / sim_radio_get_elapsed_ns().
+ */
+__LINK_C void sim_radio_get_medium_stats(sim_radio_stats_t* stats);
+
+/*! \brief The time (ns) since the first radio was initialised */
+__LINK_C uint64_t sim_radio_get_elapsed_ns();
+
+#endif //__SIM_RADIO_H
@@ -0,0 +1,574 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file sim_radio.c
+ *
+ *  A simulated radio for the nodes of an in-process simulation, see sim_radio.h.
+ *  The state of every radio is kept in a table indexed by the node id, since
+ *  the medium needs to access the radios of the other nodes when a frame is
+ *  transmitted. A frame is copied to every receiver at the start of the
+ *  transmission and handed to the stack of the receiver by its own rx timer,
+ *  which runs in the context of that node.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "debug.h"
+#include "fec.h"
+#include "hwatomic.h"
+#include "hwradio.h"
+#include "log.h"
+#include "ng.h"
+#include "platform.h"
+#include "posix_chip.h"
+#include "sim_radio.h"
+#include "timer.h"
+
+#if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_PHY_LOG_ENABLED)
+#define DPRINT(...) log_print_stack_string(LOG_STACK_PHY, __VA_ARGS__)
+#else
+#define DPRINT(...)
+#endif
+
+#ifndef NODE_GLOBALS
+    #error The sim radio can only be used when NODE_GLOBALS is defined
+#endif
+
+#define NOISE_FLOOR -120
+
+// the airtime is calculated the same way the DLL calculates it (provided by the d7ap module)
+extern uint16_t dll_calculate_tx_duration(phy_channel_class_t channel_class, uint8_t packet_length);
+
+typedef enum
+{
+    STATE_OFF,
+    STATE_IDLE,
+    STATE_RX,
+    STATE_TX
+} radio_state_t;
+
+typedef struct
+{
+    radio_state_t state;
+    bool rx_after_tx;
+    alloc_packet_callback_t alloc_packet_callback;
+    release_packet_callback_t release_packet_callback;
+    rx_packet_callback_t rx_packet_callback;
+    tx_packet_callback_t tx_packet_callback;
+    rssi_valid_callback_t rssi_valid_callback;
+    hw_rx_cfg_t rx_cfg;
+    posix_irq_timer_id_t tx_timer;
+    posix_irq_timer_id_t rx_timer;
+    posix_irq_timer_id_t rssi_timer;
+
+    // the frame being received, delivered when rx_timer fires
+    bool rx_pending;
+    bool rx_collision;
+    int16_t rx_rssi;
+    uint64_t rx_end;
+    uint8_t rx_data[256];
+
+    // the frame being transmitted
+    hw_radio_packet_t* tx_packet;
+    channel_id_t tx_channel_id;
+    eirp_t tx_eirp;
+    uint64_t tx_end;
+
+    sim_radio_stats_t stats;
+} sim_node_t;
+
+static sim_node_t nodes[NODE_GLOBALS_MAX_NODES];
+static uint8_t path_loss[NODE_GLOBALS_MAX_NODES][NODE_GLOBALS_MAX_NODES];
+static bool medium_inited = false;
+static uint64_t medium_start;
+static sim_radio_stats_t medium_stats;
+
+// the nodes which are transmitting, and the period during which the medium is busy
+static size_t active_tx[NODE_GLOBALS_MAX_NODES];
+static size_t active_tx_count = 0;
+static uint64_t busy_since;
+static uint64_t busy_until;
+
+// the noise of the channel has its own random sequence (xorshift), so it does not disturb the one of the stack
+static uint32_t noise_state = 1;
+
+static inline sim_node_t* current_node()
+{
+    return &nodes[get_node_global_id()];
+}
+
+static void init_medium()
+{
+    if(medium_inited)
+        return;
+
+    memset(path_loss, SIM_RADIO_PATH_LOSS, sizeof(path_loss));
+    medium_start = posix_clock_get_ns();
+    medium_inited = true;
+}
+
+static uint64_t calculate_airtime(channel_id_t const* channel_id, uint8_t length)
+{
+    uint16_t ticks = dll_calculate_tx_duration(channel_id->channel_header.ch_class, length);
+    return (((uint64_t) ticks) * POSIX_NS_PER_SEC) / TIMER_TICKS_PER_SEC;
+}
+
+// the strongest signal of the frames in the air at <receiver>, except for the one sent by <except>
+static int16_t get_interference(size_t receiver, size_t except, channel_id_t* channel_id, uint64_t now)
+{
+    int16_t strongest = NOISE_FLOOR;
+    for(size_t i = 0; i < active_tx_count; i++)
+    {
+        size_t sender = active_tx[i];
+        if(sender == receiver || sender == except || nodes[sender].tx_end <= now
+                || !hw_radio_channel_ids_equal(&nodes[sender].tx_channel_id, channel_id))
+            continue;
+
+        int16_t rssi = nodes[sender].tx_eirp - path_loss[sender][receiver];
+        if(rssi > strongest)
+            strongest = rssi;
+    }
+
+    return strongest;
+}
+
+// uniformly distributed in the open interval (0, 1)
+static double uniform_noise()
+{
+    noise_state ^= noise_state << 13;
+    noise_state ^= noise_state >> 17;
+    noise_state ^= noise_state << 5;
+    return (noise_state + 1.0) / (UINT32_MAX + 2.0);
+}
+
+// gaussian noise with unit variance (Box-Muller)
+static double gaussian_noise()
+{
+    double u1 = uniform_noise();
+    double u2 = uniform_noise();
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979323846 * u2);
+}
+
+// sends the frame in rx_data through an AWGN channel with the Eb/N0 given by the RSSI, demodulating every bit as a
+// hard decided and a soft value (0 .. FEC_SOFT_MAX). FEC coded frames are encoded before and decoded after the
+// channel. Returns false when bit errors are left.
+static bool receive_through_channel(sim_node_t* node)
+{
+    static uint8_t encoded[2 * sizeof(node->rx_data) + 4];
+    static uint8_t received[sizeof(encoded)];
+    static uint8_t soft[sizeof(encoded) * 8];
+    bool fec = node->rx_cfg.channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9;
+    double sigma = sqrt(1.0 / (2.0 * pow(10.0, (node->rx_rssi - SIM_RADIO_SENSITIVITY + SIM_RADIO_SENSITIVITY_EBN0) / 10.0)));
+    uint16_t length = node->rx_data[0] + 1;
+
+    memcpy(encoded, node->rx_data, length);
+    if(fec)
+        length = fec_encode(encoded, length);
+
+    for(uint16_t i = 0; i < length; i++)
+    {
+        received[i] = 0;
+        for(int b = 7; b >= 0; b--)
+        {
+            double sample = (((encoded[i] >> b) & 1) ? 1.0 : -1.0) + sigma * gaussian_noise();
+            received[i] |= (sample > 0) << b;
+
+            int value = (int) lround((sample + 1.0) * FEC_SOFT_MAX / 2.0);
+            soft[i * 8 + 7 - b] = value < 0 ? 0 : (value > FEC_SOFT_MAX ? FEC_SOFT_MAX : value);
+        }
+    }
+
+    uint8_t decoded[sizeof(node->rx_data)];
+    if(fec)
+    {
+        fec_ctx_t ctx;
+        fec_decode_begin(&ctx, decoded, node->rx_data[0] + 1, length);
+#ifdef SIM_RADIO_HARD_DECISION
+        fec_decode_feed(&ctx, received, length);
+#else
+        fec_decode_soft_feed(&ctx, soft, length * 8);
+#endif
+        fec_decode_end(&ctx);
+    }
+    else
+        memcpy(decoded, received, length);
+
+    length = node->rx_data[0] + 1;
+    bool error_free = memcmp(decoded, node->rx_data, length) == 0;
+    // like on a real radio the stack takes the frame length from the received length byte, even when it is corrupted
+    memcpy(node->rx_data, decoded, length);
+    return error_free;
+}
+
+static void transmit(size_t sender, hw_radio_packet_t* packet, uint64_t now)
+{
+    sim_node_t* tx_node = &nodes[sender];
+    for(size_t receiver = 0; receiver < NODE_GLOBALS_MAX_NODES; receiver++)
+    {
+        sim_node_t* rx_node = &nodes[receiver];
+        if(receiver == sender || rx_node->state != STATE_RX
+                || !hw_radio_channel_ids_equal(&tx_node->tx_channel_id, &rx_node->rx_cfg.channel_id))
+            continue;
+
+        int16_t rssi = tx_node->tx_eirp - path_loss[sender][receiver];
+        if(rx_node->rx_pending)
+        {
+            // the radio stays locked on the frame it is receiving, which survives if it is strong enough.
+            // A frame which has ended but of which the rx timer was not handled yet is not affected
+            if(rx_node->rx_end > now && rx_node->rx_rssi < rssi + SIM_RADIO_CAPTURE_THRESHOLD)
+                rx_node->rx_collision = true;
+
+            continue;
+        }
+
+        if(rssi < SIM_RADIO_SENSITIVITY || packet->tx_meta.tx_cfg.syncword_class != rx_node->rx_cfg.syncword_class)
+            continue;
+
+        if(rssi < get_interference(receiver, sender, &tx_node->tx_channel_id, now) + SIM_RADIO_CAPTURE_THRESHOLD)
+        {
+            rx_node->stats.rx_collisions++;
+            medium_stats.rx_collisions++;
+            continue;
+        }
+
+        rx_node->rx_pending = true;
+        rx_node->rx_collision = false;
+        rx_node->rx_rssi = rssi;
+        rx_node->rx_end = tx_node->tx_end;
+        memcpy(rx_node->rx_data, packet->data, packet->length + 1);
+        posix_irq_timer_set(rx_node->rx_timer, tx_node->tx_end);
+    }
+
+    if(active_tx_count == 0)
+    {
+        busy_since = now;
+        busy_until = tx_node->tx_end;
+    }
+    else if(tx_node->tx_end > busy_until)
+        busy_until = tx_node->tx_end;
+
+    active_tx[active_tx_count++] = sender;
+    tx_node->stats.airtime_ns += tx_node->tx_end - now;
+    tx_node->stats.tx_frames++;
+    medium_stats.tx_frames++;
+}
+
+static void end_transmission(size_t sender)
+{
+    for(size_t i = 0; i < active_tx_count; i++)
+    {
+        if(active_tx[i] == sender)
+        {
+            active_tx[i] = active_tx[--active_tx_count];
+            break;
+        }
+    }
+
+    if(active_tx_count == 0)
+        medium_stats.airtime_ns += busy_until - busy_since;
+}
+
+static void abort_reception()
+{
+    sim_node_t* node = current_node();
+    posix_irq_timer_cancel(node->rx_timer);
+    posix_irq_timer_cancel(node->rssi_timer);
+    node->rx_pending = false;
+}
+
+static void schedule_rssi_valid()
+{
+    // like on a real radio, the RSSI only becomes valid some time after entering RX. This also
+    // makes sure the (virtual) time advances while the DLL keeps retrying CCA on a busy channel
+    sim_node_t* node = current_node();
+    if(node->rssi_valid_callback != NULL)
+        posix_irq_timer_set(node->rssi_timer, posix_clock_get_ns() + SIM_RADIO_RSSI_SETTLE_TIME * UINT64_C(1000));
+}
+
+static void rssi_valid_isr()
+{
+    sim_node_t* node = current_node();
+    if(node->state == STATE_RX && node->rssi_valid_callback != NULL)
+    {
+        rssi_valid_callback_t callback = node->rssi_valid_callback;
+        node->rssi_valid_callback = NULL;
+        callback(hw_radio_get_rssi());
+    }
+}
+
+static void tx_done_isr()
+{
+    sim_node_t* node = current_node();
+    assert(node->state == STATE_TX);
+    end_transmission(get_node_global_id());
+
+    hw_radio_packet_t* packet = node->tx_packet;
+    node->tx_packet = NULL;
+    node->state = node->rx_after_tx ? STATE_RX : STATE_IDLE;
+    node->rx_after_tx = false;
+
+    packet->tx_meta.timestamp = timer_get_counter_value();
+    if(node->tx_packet_callback != NULL)
+        node->tx_packet_callback(packet);
+
+    if(node->state == STATE_RX)
+        schedule_rssi_valid();
+}
+
+static void rx_done_isr()
+{
+    sim_node_t* node = current_node();
+    if(!node->rx_pending)
+        return;
+
+    node->rx_pending = false;
+    if(node->rx_collision)
+    {
+        DPRINT("sim radio: frame lost due to collision");
+        node->stats.rx_collisions++;
+        medium_stats.rx_collisions++;
+        return;
+    }
+
+    if(node->state != STATE_RX || node->rx_packet_callback == NULL)
+        return;
+
+    bool error_free = receive_through_channel(node);
+    hw_radio_packet_t* packet = node->alloc_packet_callback(node->rx_data[0]);
+    if(packet == NULL)
+    {
+        DPRINT("sim radio: could not allocate packet");
+        return;
+    }
+
+    memcpy(packet->data, node->rx_data, node->rx_data[0] + 1);
+    packet->rx_meta.rx_cfg = node->rx_cfg;
+    packet->rx_meta.rssi = node->rx_rssi;
+    // the link margin above the sensitivity
+    packet->rx_meta.lqi = node->rx_rssi - SIM_RADIO_SENSITIVITY;
+    packet->rx_meta.crc_status = HW_CRC_UNAVAILABLE;
+    packet->rx_meta.timestamp = timer_get_counter_value();
+    node->stats.rx_frames++;
+    medium_stats.rx_frames++;
+    if(!error_free)
+    {
+        DPRINT("sim radio: frame received with bit errors");
+        node->stats.rx_bit_errors++;
+        medium_stats.rx_bit_errors++;
+    }
+
+    node->rx_packet_callback(packet);
+}
+
+error_t hw_radio_init(alloc_packet_callback_t p_alloc, release_packet_callback_t p_free)
+{
+    sim_node_t* node = current_node();
+    if(node->state != STATE_OFF)
+        return EALREADY;
+
+    if(p_alloc == NULL || p_free == NULL)
+        return EINVAL;
+
+    init_medium();
+    node->alloc_packet_callback = p_alloc;
+    node->release_packet_callback = p_free;
+    if(posix_irq_timer_register(&tx_done_isr, &node->tx_timer) != SUCCESS
+            || posix_irq_timer_register(&rx_done_isr, &node->rx_timer) != SUCCESS
+            || posix_irq_timer_register(&rssi_valid_isr, &node->rssi_timer) != SUCCESS)
+        return FAIL;
+
+    node->state = STATE_IDLE;
+    return SUCCESS;
+}
+
+error_t hw_radio_set_idle()
+{
+    sim_node_t* node = current_node();
+    if(node->state == STATE_OFF)
+        return EOFF;
+
+    start_atomic();
+    error_t err = SUCCESS;
+    if(node->state == STATE_TX)
+        node->rx_after_tx = false;
+    else if(node->state == STATE_IDLE)
+        err = EALREADY;
+    else
+    {
+        abort_reception();
+        node->state = STATE_IDLE;
+    }
+    end_atomic();
+    return err;
+}
+
+bool hw_radio_is_idle()
+{
+    sim_node_t* node = current_node();
+    return node->state == STATE_IDLE || (node->state == STATE_TX && !node->rx_after_tx);
+}
+
+error_t hw_radio_set_rx(hw_rx_cfg_t const* rx_cfg, rx_packet_callback_t rx_callback, rssi_valid_callback_t rssi_callback)
+{
+    sim_node_t* node = current_node();
+    if(node->state == STATE_OFF)
+        return EOFF;
+
+    start_atomic();
+    // a frame which is being received survives as long as the radio stays tuned to its channel
+    bool rx_cfg_changed = rx_cfg != NULL
+            && (!hw_radio_channel_ids_equal(&rx_cfg->channel_id, &node->rx_cfg.channel_id)
+                || rx_cfg->syncword_class != node->rx_cfg.syncword_class);
+
+    if(rx_cfg != NULL)
+        node->rx_cfg = *rx_cfg;
+
+    node->rx_packet_callback = rx_callback;
+    node->rssi_valid_callback = rssi_callback;
+    if(rx_cfg_changed)
+        abort_reception();
+    else
+        posix_irq_timer_cancel(node->rssi_timer);
+
+    if(node->state == STATE_TX)
+        node->rx_after_tx = true;
+    else
+    {
+        // the RSSI becomes valid after the transmission otherwise
+        node->state = STATE_RX;
+        schedule_rssi_valid();
+    }
+    end_atomic();
+
+    return SUCCESS;
+}
+
+bool hw_radio_is_rx()
+{
+    sim_node_t* node = current_node();
+    return node->state == STATE_RX || (node->state == STATE_TX && node->rx_after_tx);
+}
+
+error_t hw_radio_send_packet(hw_radio_packet_t* packet, tx_packet_callback_t tx_callback)
+{
+    sim_node_t* node = current_node();
+    if(node->state == STATE_OFF)
+        return EOFF;
+
+    if(node->state == STATE_TX)
+        return EBUSY;
+
+    if(packet->length == 0)
+        return ESIZE;
+
+    hw_tx_cfg_t const* tx_cfg = &packet->tx_meta.tx_cfg;
+
+    start_atomic();
+    abort_reception();
+    node->rx_after_tx = false;
+    node->state = STATE_TX;
+    node->tx_packet = packet;
+    node->tx_packet_callback = tx_callback;
+    node->tx_channel_id = tx_cfg->channel_id;
+    node->tx_eirp = tx_cfg->eirp;
+
+    uint64_t now = posix_clock_get_ns();
+    node->tx_end = now + calculate_airtime(&tx_cfg->channel_id, packet->length);
+    transmit(get_node_global_id(), packet, now);
+    posix_irq_timer_set(node->tx_timer, node->tx_end);
+    end_atomic();
+
+    DPRINT("sim radio: sending %i bytes", packet->length + 1);
+    return SUCCESS;
+}
+
+void hw_radio_continuous_tx(hw_tx_cfg_t const* tx_cfg, bool continuous_wave)
+{
+    // not supported: the medium only carries frames
+}
+
+bool hw_radio_tx_busy()
+{
+    return current_node()->state == STATE_TX;
+}
+
+bool hw_radio_rx_busy()
+{
+    return current_node()->rx_pending;
+}
+
+bool hw_radio_rssi_valid()
+{
+    return current_node()->state == STATE_RX;
+}
+
+int16_t hw_radio_get_rssi()
+{
+    sim_node_t* node = current_node();
+    if(node->state != STATE_RX)
+        return HW_RSSI_INVALID;
+
+    start_atomic();
+    int16_t rssi = get_interference(get_node_global_id(), get_node_global_id(), &node->rx_cfg.channel_id, posix_clock_get_ns());
+    end_atomic();
+    return rssi;
+}
+
+void sim_radio_set_path_loss(size_t node_a, size_t node_b, uint8_t loss)
+{
+    assert(node_a < NODE_GLOBALS_MAX_NODES && node_b < NODE_GLOBALS_MAX_NODES);
+    init_medium();
+    path_loss[node_a][node_b] = loss;
+    path_loss[node_b][node_a] = loss;
+}
+
+uint8_t sim_radio_get_path_loss(size_t node_a, size_t node_b)
+{
+    assert(node_a < NODE_GLOBALS_MAX_NODES && node_b < NODE_GLOBALS_MAX_NODES);
+    init_medium();
+    return path_loss[node_a][node_b];
+}
+
+void sim_radio_get_node_stats(size_t node, sim_radio_stats_t* stats)
+{
+    assert(node < NODE_GLOBALS_MAX_NODES);
+    start_atomic();
+    *stats = nodes[node].stats;
+    end_atomic();
+}
+
+void sim_radio_get_medium_stats(sim_radio_stats_t* stats)
+{
+    start_atomic();
+    *stats = medium_stats;
+    // include the part of the current busy period which has already passed
+    if(active_tx_count > 0)
+    {
+        uint64_t now = posix_clock_get_ns();
+        stats->airtime_ns += (now < busy_until ? now : busy_until) - busy_since;
+    }
+    end_atomic();
+}
+
+uint64_t sim_radio_get_elapsed_ns()
+{
+    init_medium();
+    return posix_clock_get_ns() - medium_start;
+}
@@ -0,0 +1,412 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file udp_radio.c
+ *
+ *  A virtual radio for the posix chip. A transmitted frame is broadcasted as a
+ *  UDP datagram on the loopback interface, prefixed with the id of the sender
+ *  and the TX configuration. Every process using the same port receives it
+ *  and delivers it to the stack once the airtime of the frame has elapsed,
+ *  when it is listening on the same channel and syncword class. Frames which
+ *  overlap in time collide and are dropped by the receiver. The RSSI of a
+ *  received frame is the EIRP of the sender minus UDP_RADIO_PATH_LOSS.
+ *
+ */
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "hwatomic.h"
+#include "hwradio.h"
+#include "hwsystem.h"
+#include "log.h"
+#include "platform.h"
+#include "posix_chip.h"
+#include "timer.h"
+
+#if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_PHY_LOG_ENABLED)
+#define DPRINT(...) log_print_stack_string(LOG_STACK_PHY, __VA_ARGS__)
+#else
+#define DPRINT(...)
+#endif
+
+#ifndef UDP_RADIO_PORT
+    #error The platform should define the UDP port used by the udp radio
+#endif
+
+#ifndef UDP_RADIO_PATH_LOSS
+    #define UDP_RADIO_PATH_LOSS 70
+#endif
+
+#define NOISE_FLOOR -120
+#define PREAMBLE_SIZE 4
+#define SYNCWORD_SIZE 2
+
+// sender id (8) + channel header (1) + center freq index (2) + syncword class (1) + eirp (1)
+#define FRAME_HEADER_SIZE 13
+#define MAX_FRAME_SIZE (FRAME_HEADER_SIZE + 256)
+
+typedef enum
+{
+    STATE_OFF,
+    STATE_IDLE,
+    STATE_RX,
+    STATE_TX
+} radio_state_t;
+
+static radio_state_t state = STATE_OFF;
+static bool rx_after_tx = false;
+static uint64_t node_id;
+static int sock = -1;
+static struct sockaddr_in broadcast_addr;
+
+static alloc_packet_callback_t alloc_packet_callback;
+static release_packet_callback_t release_packet_callback;
+static rx_packet_callback_t rx_packet_callback;
+static tx_packet_callback_t tx_packet_callback;
+static rssi_valid_callback_t rssi_valid_callback;
+
+static hw_rx_cfg_t current_rx_cfg;
+static hw_radio_packet_t* current_tx_packet = NULL;
+static hw_radio_packet_t* current_rx_packet = NULL; // frame 'in the air', delivered when rx_timer fires
+static bool rx_collision = false;
+static uint64_t channel_busy_until = 0;
+static int16_t channel_rssi = NOISE_FLOOR;
+
+static posix_irq_timer_id_t tx_timer;
+static posix_irq_timer_id_t rx_timer;
+
+static uint64_t calculate_airtime(channel_id_t const* channel_id, uint8_t length)
+{
+    uint32_t bitrate;
+    switch(channel_id->channel_header.ch_class)
+    {
+        case PHY_CLASS_LO_RATE:
+            bitrate = 9600;
+            break;
+        case PHY_CLASS_HI_RATE:
+            bitrate = 166667;
+            break;
+        case PHY_CLASS_NORMAL_RATE:
+        default:
+            bitrate = 55555;
+    }
+
+    // the length byte itself is also transmitted, FEC doubles the number of encoded bytes
+    uint32_t bytes = length + 1;
+    if(channel_id->channel_header.ch_coding == PHY_CODING_FEC_PN9)
+        bytes *= 2;
+
+    bytes += PREAMBLE_SIZE + SYNCWORD_SIZE;
+    return (((uint64_t) bytes) * 8 * POSIX_NS_PER_SEC) / bitrate;
+}
+
+static void abort_reception()
+{
+    posix_irq_timer_cancel(rx_timer);
+    if(current_rx_packet != NULL)
+    {
+        release_packet_callback(current_rx_packet);
+        current_rx_packet = NULL;
+    }
+}
+
+static void notify_rssi_valid()
+{
+    if(rssi_valid_callback != NULL)
+    {
+        rssi_valid_callback_t callback = rssi_valid_callback;
+        rssi_valid_callback = NULL;
+        callback(hw_radio_get_rssi());
+    }
+}
+
+static void tx_done_isr()
+{
+    assert(state == STATE_TX);
+    hw_radio_packet_t* packet = current_tx_packet;
+    current_tx_packet = NULL;
+    state = rx_after_tx ? STATE_RX : STATE_IDLE;
+    rx_after_tx = false;
+
+    packet->tx_meta.timestamp = timer_get_counter_value();
+    if(tx_packet_callback != NULL)
+        tx_packet_callback(packet);
+
+    if(state == STATE_RX)
+        notify_rssi_valid();
+}
+
+static void rx_done_isr()
+{
+    hw_radio_packet_t* packet = current_rx_packet;
+    current_rx_packet = NULL;
+    if(packet == NULL)
+        return;
+
+    if(rx_collision || state != STATE_RX || rx_packet_callback == NULL)
+    {
+        DPRINT("udp radio: dropping frame (collision=%i)", rx_collision);
+        release_packet_callback(packet);
+        return;
+    }
+
+    packet->rx_meta.timestamp = timer_get_counter_value();
+    rx_packet_callback(packet);
+}
+
+static void process_frame(uint8_t const* frame, size_t frame_len)
+{
+    if(frame_len < FRAME_HEADER_SIZE + 1)
+        return;
+
+    uint64_t sender = 0;
+    for(uint8_t i = 0; i < 8; i++)
+        sender = (sender << 8) | frame[i];
+
+    if(sender == node_id)
+        return; // our own broadcast
+
+    channel_id_t channel_id = {
+        .channel_header_raw = frame[8],
+        .center_freq_index = (frame[9] << 8) | frame[10]
+    };
+    syncword_class_t syncword_class = frame[11];
+    eirp_t eirp = (eirp_t) frame[12];
+    uint8_t const* data = frame + FRAME_HEADER_SIZE;
+    if(frame_len != FRAME_HEADER_SIZE + 1 + data[0])
+        return;
+
+    if(state != STATE_RX || !hw_radio_channel_ids_equal(&channel_id, &current_rx_cfg.channel_id))
+        return;
+
+    uint64_t now = posix_clock_get_ns();
+    uint64_t rx_end = now + calculate_airtime(&channel_id, data[0]);
+    int16_t rssi = eirp - UDP_RADIO_PATH_LOSS;
+    bool channel_busy = channel_busy_until > now;
+    if(!channel_busy || rx_end > channel_busy_until)
+        channel_busy_until = rx_end;
+
+    if(!channel_busy || rssi > channel_rssi)
+        channel_rssi = rssi;
+
+    if(channel_busy)
+    {
+        // overlapping frames: the frame being received (if any) is lost as well
+        rx_collision = true;
+        return;
+    }
+
+    // the previous frame has ended, but its rx timer might not have been handled yet
+    if(current_rx_packet != NULL)
+        rx_done_isr();
+
+    rx_collision = false;
+    if(syncword_class != current_rx_cfg.syncword_class)
+        return;
+
+    hw_radio_packet_t* packet = alloc_packet_callback(data[0]);
+    if(packet == NULL)
+    {
+        DPRINT("udp radio: could not allocate packet");
+        return;
+    }
+
+    memcpy(packet->data, data, data[0] + 1);
+    packet->rx_meta.rx_cfg = current_rx_cfg;
+    packet->rx_meta.rssi = rssi;
+    packet->rx_meta.lqi = 0;
+    packet->rx_meta.crc_status = HW_CRC_UNAVAILABLE;
+    current_rx_packet = packet;
+    posix_irq_timer_set(rx_timer, rx_end);
+}
+
+static void socket_isr()
+{
+    uint8_t frame[MAX_FRAME_SIZE];
+    ssize_t len;
+    while((len = recv(sock, frame, sizeof(frame), 0)) > 0)
+        process_frame(frame, len);
+}
+
+error_t hw_radio_init(alloc_packet_callback_t p_alloc, release_packet_callback_t p_free)
+{
+    if(state != STATE_OFF)
+        return EALREADY;
+
+    if(p_alloc == NULL || p_free == NULL)
+        return EINVAL;
+
+    alloc_packet_callback = p_alloc;
+    release_packet_callback = p_free;
+    node_id = hw_get_unique_id();
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if(sock < 0)
+        return FAIL;
+
+    int enable = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(UDP_RADIO_PORT);
+    if(bind(sock, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+        return FAIL;
+
+    broadcast_addr = addr;
+    broadcast_addr.sin_addr.s_addr = htonl(0x7FFFFFFF); // 127.255.255.255
+
+    if(posix_irq_timer_register(&tx_done_isr, &tx_timer) != SUCCESS
+            || posix_irq_timer_register(&rx_done_isr, &rx_timer) != SUCCESS
+            || posix_irq_fd_register(sock, &socket_isr) != SUCCESS)
+        return FAIL;
+
+    state = STATE_IDLE;
+    return SUCCESS;
+}
+
+error_t hw_radio_set_idle()
+{
+    if(state == STATE_OFF)
+        return EOFF;
+
+    start_atomic();
+    error_t err = SUCCESS;
+    if(state == STATE_TX)
+        rx_after_tx = false;
+    else if(state == STATE_IDLE)
+        err = EALREADY;
+    else
+    {
+        abort_reception();
+        state = STATE_IDLE;
+    }
+    end_atomic();
+    return err;
+}
+
+bool hw_radio_is_idle()
+{
+    return state == STATE_IDLE || (state == STATE_TX && !rx_after_tx);
+}
+
+error_t hw_radio_set_rx(hw_rx_cfg_t const* rx_cfg, rx_packet_callback_t rx_callback, rssi_valid_callback_t rssi_callback)
+{
+    if(state == STATE_OFF)
+        return EOFF;
+
+    start_atomic();
+    if(rx_cfg != NULL)
+        current_rx_cfg = *rx_cfg;
+
+    rx_packet_callback = rx_callback;
+    rssi_valid_callback = rssi_callback;
+    abort_reception();
+    if(state == STATE_TX)
+        rx_after_tx = true;
+    else
+        state = STATE_RX;
+    end_atomic();
+
+    // the RSSI is valid immediately, but not while still transmitting
+    if(state == STATE_RX)
+        notify_rssi_valid();
+
+    return SUCCESS;
+}
+
+bool hw_radio_is_rx()
+{
+    return state == STATE_RX || (state == STATE_TX && rx_after_tx);
+}
+
+error_t hw_radio_send_packet(hw_radio_packet_t* packet, tx_packet_callback_t tx_callback)
+{
+    if(state == STATE_OFF)
+        return EOFF;
+
+    if(state == STATE_TX)
+        return EBUSY;
+
+    if(packet->length == 0)
+        return ESIZE;
+
+    hw_tx_cfg_t const* tx_cfg = &packet->tx_meta.tx_cfg;
+    uint8_t frame[MAX_FRAME_SIZE];
+    for(uint8_t i = 0; i < 8; i++)
+        frame[i] = node_id >> (56 - 8 * i);
+
+    frame[8] = tx_cfg->channel_id.channel_header_raw;
+    frame[9] = tx_cfg->channel_id.center_freq_index >> 8;
+    frame[10] = tx_cfg->channel_id.center_freq_index & 0xFF;
+    frame[11] = tx_cfg->syncword_class;
+    frame[12] = (uint8_t) tx_cfg->eirp;
+    memcpy(frame + FRAME_HEADER_SIZE, packet->data, packet->length + 1);
+
+    start_atomic();
+    abort_reception();
+    rx_after_tx = false;
+    state = STATE_TX;
+    current_tx_packet = packet;
+    tx_packet_callback = tx_callback;
+    sendto(sock, frame, FRAME_HEADER_SIZE + packet->length + 1, 0, (struct sockaddr*) &broadcast_addr, sizeof(broadcast_addr));
+    posix_irq_timer_set(tx_timer, posix_clock_get_ns() + calculate_airtime(&tx_cfg->channel_id, packet->length));
+    end_atomic();
+
+    DPRINT("udp radio: sending %i bytes", packet->length + 1);
+    return SUCCESS;
+}
+
+void hw_radio_continuous_tx(hw_tx_cfg_t const* tx_cfg, bool continuous_wave)
+{
+    // not supported: there is no way to occupy the 'air' of the other processes indefinitely
+}
+
+bool hw_radio_tx_busy()
+{
+    return state == STATE_TX;
+}
+
+bool hw_radio_rx_busy()
+{
+    return current_rx_packet != NULL;
+}
+
+bool hw_radio_rssi_valid()
+{
+    return state == STATE_RX;
+}
+
+int16_t hw_radio_get_rssi()
+{
+    if(state != STATE_RX)
+        return HW_RSSI_INVALID;
+
+    if(channel_busy_until > posix_clock_get_ns())
+        return channel_rssi;
+
+    return NOISE_FLOOR;
+}
@@ -58,12 +58,40 @@ __LINK_C void hw_aes_cbc128(uint8_t *out, const uint8_t *in, unsigned int len, c
  *
  * \param out	Buffer to place encrypted/decrypted data. Must be at least @p len long.
  * \param in	Buffer holding data to encrypt/decrypt. Must be at least @p len long
- * \param len	Number of bytes to encrypt/decrypt. Must be a multiple of 16.
+ * \param len	Number of bytes to encrypt/decrypt. The last block may be partial, the counter is only incremented
+ *		after full blocks.
  * \param key	128 bit encryption key.
  * \param ctr	128 bit initial counter block.
  */
 __LINK_C void hw_aes_ctr128(uint8_t *out, const uint8_t *in, unsigned int len, const uint8_t *key, uint8_t * ctr);
 
+/*! \brief AES CBC-MAC, 128 bit key.
+ *
+ * The key is loaded once and the blocks are chained inside the peripheral, only the last cipher block is read back.
+ * A last partial block is zero padded. The function can be called repeatedly to continue the same MAC.
+ *
+ * \param mac	In: the chaining value to start from, all zeroes for a new MAC. Out: the last cipher block.
+ * \param in	Buffer holding the data to authenticate. Must be at least @p len long.
+ * \param len	Number of bytes to authenticate.
+ * \param key	128 bit encryption key.
+ */
+__LINK_C void hw_aes_cbc_mac128(uint8_t *mac, const uint8_t *in, unsigned int len, const uint8_t *key);
+
+/*! \brief Loads a 128 bit key into the peripheral for the *_loaded() functions below.
+ *
+ * Operations which use the same key one after the other, like the CBC-MAC and CTR passes of CCM, do not have to
+ * load it again. The key stays loaded until another key is loaded or one of the functions above is called.
+ *
+ * \param key	128 bit encryption key.
+ */
+__LINK_C void hw_aes_load_key128(const uint8_t *key);
+
+/*! \brief hw_aes_ctr128() with the key loaded by hw_aes_load_key128() */
+__LINK_C void hw_aes_ctr128_loaded(uint8_t *out, const uint8_t *in, unsigned int len, uint8_t *ctr);
+
+/*! \brief hw_aes_cbc_mac128() with the key loaded by hw_aes_load_key128() */
+__LINK_C void hw_aes_cbc_mac128_loaded(uint8_t *mac, const uint8_t *in, unsigned int len);
+
 #endif //__HW_AES_H_
 #include "platform.h"
 
@@ -255,12 +255,13 @@ typedef struct
  * Once a packet has been allocated, it remains under the control of the PHY driver until it is `released' 
  * by a call to either the release_packet_callback or the rx_packet_callback function.
  *
- * \param length		The length of the packet for which a buffer must be allocated
+ * \param length		The length of the packet for which a buffer must be allocated. This can exceed 255
+ *				for FEC encoded frames.
  * \return hw_radio_packet_t*	The allocated packet buffer. The buffer MUST be large enough for the
  *				data field to contain at least length bytes. If no sufficiently large 
  *				buffer can be allocated, 0x0 is returned.
  */
-typedef hw_radio_packet_t* (*alloc_packet_callback_t)(uint8_t length);
+typedef hw_radio_packet_t* (*alloc_packet_callback_t)(uint16_t length);
 
 /** \brief definition of the callback used by the PHY driver to 'release' control of a previously allocated 
  *	   packet buffer.
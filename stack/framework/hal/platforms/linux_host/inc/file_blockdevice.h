@@ -0,0 +1,51 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* \file
+ *
+ * A block device stored in a file, which stands in for the flash of real hardware so the non volatile
+ * filesystem can be used on the linux host. This file is NOT a part of the 'HAL' interface.
+ *
+ * The flash semantics are emulated: a new file is filled with 0xFF and programming only clears bits, so
+ * code which relies on programming erased memory only shows the same behaviour as on hardware.
+ *
+ */
+#ifndef __PLATFORM_FILE_BLOCKDEVICE_H_
+#define __PLATFORM_FILE_BLOCKDEVICE_H_
+
+#include <stdio.h>
+
+#include "link_c.h"
+#include "types.h"
+#include "blockdevice.h"
+
+typedef struct
+{
+    blockdevice_t base;
+    FILE* file;
+} file_blockdevice_t;
+
+/* \brief Opens the file at path as a block device, the file is created when it does not exist yet.
+ *
+ * \return	error_t		SUCCESS if the file was opened
+ * 						EINVAL if the file exists but does not have the expected size
+ * 						FAIL if the file could not be opened or created
+ */
+__LINK_C error_t file_blockdevice_init(file_blockdevice_t* bd, const char* path, uint32_t erase_block_size, uint16_t erase_block_count);
+
+#endif
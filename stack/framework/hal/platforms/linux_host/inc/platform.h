@@ -0,0 +1,87 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PLATFORM_H_
+#define __PLATFORM_H_
+
+#include "platform_defs.h"
+
+#ifndef PLATFORM_LINUX_HOST
+    #error Mismatch between the configured platform and the actual platform. Expected PLATFORM_LINUX_HOST to be defined
+#endif
+
+/*************************
+ * SIMULATION DEFINITIONS *
+ ************************/
+
+#ifdef PLATFORM_LINUX_HOST_SIMULATION
+// every simulated node runs its own instance of the stack in this process
+#define NODE_GLOBALS
+#define NODE_GLOBALS_MAX_NODES PLATFORM_LINUX_HOST_SIM_NODES
+#define SIM_RADIO_PATH_LOSS PLATFORM_LINUX_HOST_SIM_RADIO_PATH_LOSS
+#ifdef PLATFORM_LINUX_HOST_SIM_RADIO_HARD_DECISION
+#define SIM_RADIO_HARD_DECISION
+#endif
+#endif
+
+#ifdef PLATFORM_LINUX_HOST_VIRTUAL_TIME
+#define POSIX_VIRTUAL_TIME
+#define POSIX_VIRTUAL_TIME_LIMIT PLATFORM_LINUX_HOST_VIRTUAL_TIME_LIMIT
+#endif
+
+#include "posix_chip.h"
+
+/********************
+ * LED DEFINITIONS *
+ *******************/
+
+#define HW_NUM_LEDS 2
+
+/********************
+ * UART DEFINITIONS *
+ *******************/
+
+// console configuration
+#define CONSOLE_UART        0
+#define CONSOLE_LOCATION    0
+#define CONSOLE_BAUDRATE    115200
+
+#ifdef PLATFORM_LINUX_HOST_CONSOLE_PTY
+#define POSIX_UART_USE_PTY
+#endif
+
+/*************************
+ * DEBUG PIN DEFINITIONS *
+ ************************/
+
+#define DEBUG_PIN_NUM 0
+
+/**************************
+ * USERBUTTON DEFINITIONS *
+ *************************/
+
+#define NUM_USERBUTTONS 0
+
+/**************************
+ * UDP RADIO DEFINITIONS *
+ *************************/
+
+#define UDP_RADIO_PORT      PLATFORM_LINUX_HOST_UDP_RADIO_PORT
+#define UDP_RADIO_PATH_LOSS PLATFORM_LINUX_HOST_UDP_RADIO_PATH_LOSS
+
+#endif
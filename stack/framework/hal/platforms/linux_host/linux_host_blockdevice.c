@@ -0,0 +1,153 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file linux_host_blockdevice.c
+ *
+ *  Emulates a NOR flash in a file, every program and erase is flushed to the file immediately so the
+ *  content survives when the process is killed.
+ *
+ */
+
+#include <string.h>
+
+#include "file_blockdevice.h"
+#include "debug.h"
+
+// the number of bytes processed at once when programming or erasing
+#define CHUNK_SIZE 64
+
+static bool is_in_range(blockdevice_t* bd, uint32_t address, uint32_t length)
+{
+    uint32_t size = bd->erase_block_size * bd->erase_block_count;
+    return address <= size && length <= size - address;
+}
+
+static error_t file_read(blockdevice_t* bd, uint8_t* data, uint32_t address, uint32_t length)
+{
+    FILE* file = ((file_blockdevice_t*)bd)->file;
+
+    if(!is_in_range(bd, address, length))
+        return ESIZE;
+
+    if(fseek(file, address, SEEK_SET) != 0 || fread(data, 1, length, file) != length)
+        return FAIL;
+
+    return SUCCESS;
+}
+
+static error_t file_program(blockdevice_t* bd, const uint8_t* data, uint32_t address, uint32_t length)
+{
+    FILE* file = ((file_blockdevice_t*)bd)->file;
+    uint8_t chunk[CHUNK_SIZE];
+
+    if(!is_in_range(bd, address, length))
+        return ESIZE;
+
+    if((address | length) & (bd->program_unit - 1))
+        return EINVAL;
+
+    while(length > 0)
+    {
+        uint32_t chunk_length = length < CHUNK_SIZE ? length : CHUNK_SIZE;
+
+        // programming can only clear bits
+        if(fseek(file, address, SEEK_SET) != 0 || fread(chunk, 1, chunk_length, file) != chunk_length)
+            return FAIL;
+
+        for(uint32_t i = 0; i < chunk_length; i++)
+            chunk[i] &= data[i];
+
+        if(fseek(file, address, SEEK_SET) != 0 || fwrite(chunk, 1, chunk_length, file) != chunk_length)
+            return FAIL;
+
+        data += chunk_length;
+        address += chunk_length;
+        length -= chunk_length;
+    }
+
+    return fflush(file) == 0 ? SUCCESS : FAIL;
+}
+
+static error_t fill_erased(FILE* file, uint32_t address, uint32_t length)
+{
+    uint8_t chunk[CHUNK_SIZE];
+    memset(chunk, 0xFF, CHUNK_SIZE);
+
+    if(fseek(file, address, SEEK_SET) != 0)
+        return FAIL;
+
+    while(length > 0)
+    {
+        uint32_t chunk_length = length < CHUNK_SIZE ? length : CHUNK_SIZE;
+        if(fwrite(chunk, 1, chunk_length, file) != chunk_length)
+            return FAIL;
+
+        length -= chunk_length;
+    }
+
+    return fflush(file) == 0 ? SUCCESS : FAIL;
+}
+
+static error_t file_erase(blockdevice_t* bd, uint32_t address)
+{
+    if(!is_in_range(bd, address, 1))
+        return ESIZE;
+
+    address -= address % bd->erase_block_size;
+    return fill_erased(((file_blockdevice_t*)bd)->file, address, bd->erase_block_size);
+}
+
+static const blockdevice_driver_t file_blockdevice_driver = {
+    .read = file_read,
+    .program = file_program,
+    .erase = file_erase
+};
+
+error_t file_blockdevice_init(file_blockdevice_t* bd, const char* path, uint32_t erase_block_size, uint16_t erase_block_count)
+{
+    uint32_t size = erase_block_size * erase_block_count;
+
+    assert(erase_block_size > 0 && erase_block_count > 0);
+
+    bd->base = (blockdevice_t){
+        .driver = &file_blockdevice_driver,
+        .erase_block_size = erase_block_size,
+        .erase_block_count = erase_block_count,
+        .program_unit = 1
+    };
+
+    bd->file = fopen(path, "r+b");
+    if(bd->file == NULL)
+    {
+        // a new device, which is completely erased
+        bd->file = fopen(path, "w+b");
+        if(bd->file == NULL)
+            return FAIL;
+
+        return fill_erased(bd->file, 0, size);
+    }
+
+    if(fseek(bd->file, 0, SEEK_END) != 0 || ftell(bd->file) != size)
+    {
+        fclose(bd->file);
+        bd->file = NULL;
+        return EINVAL;
+    }
+
+    return SUCCESS;
+}
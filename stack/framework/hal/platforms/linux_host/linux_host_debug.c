@@ -0,0 +1,45 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file linux_host_debug.c
+ *
+ *  The linux host has no debug pins (DEBUG_PIN_NUM == 0), use a debugger or perf instead.
+ *
+ */
+
+#include "hwdebug.h"
+
+void __hw_debug_init()
+{
+}
+
+void hw_debug_set(uint8_t pin_id)
+{
+}
+
+void hw_debug_clr(uint8_t pin_id)
+{
+}
+
+void hw_debug_toggle(uint8_t pin_id)
+{
+}
+
+void hw_debug_mask(uint32_t mask)
+{
+}
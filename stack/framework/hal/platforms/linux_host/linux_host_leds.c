@@ -0,0 +1,52 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file linux_host_leds.c
+ *
+ *  The leds only keep their state, so they can be inspected from a debugger.
+ *
+ */
+
+#include "hwleds.h"
+#include "platform.h"
+
+static bool leds[HW_NUM_LEDS];
+
+void __led_init()
+{
+    for(int i = 0; i < HW_NUM_LEDS; i++)
+        leds[i] = false;
+}
+
+void led_on(uint8_t led_nr)
+{
+    if(led_nr < HW_NUM_LEDS)
+        leds[led_nr] = true;
+}
+
+void led_off(uint8_t led_nr)
+{
+    if(led_nr < HW_NUM_LEDS)
+        leds[led_nr] = false;
+}
+
+void led_toggle(uint8_t led_nr)
+{
+    if(led_nr < HW_NUM_LEDS)
+        leds[led_nr] = !leds[led_nr];
+}
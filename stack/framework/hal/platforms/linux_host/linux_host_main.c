@@ -0,0 +1,66 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "scheduler.h"
+#include "bootstrap.h"
+#include "hwleds.h"
+#include "hwdebug.h"
+#include "hwwatchdog.h"
+#include "platform.h"
+#include "button.h"
+#include "ng.h"
+
+void __platform_init()
+{
+    //the logs are printf'ed while the console writes directly to the fd,
+    //don't buffer stdout so both end up in the right order (and nothing is lost when killed)
+    setvbuf(stdout, NULL, _IONBF, 0);
+    __led_init();
+    __hw_debug_init();
+    __watchdog_init();
+}
+
+void __platform_post_framework_init()
+{
+    __ubutton_init();
+}
+
+int main(int argc, char** argv)
+{
+    //the posix chip emulates the interrupts, so it has to be initialised first
+    __posix_chip_init(argc, argv);
+    //initialise the platform itself
+    __platform_init();
+    //do not initialise the scheduler, this is done by __framework_bootstrap()
+#ifdef NODE_GLOBALS
+    //every simulated node runs the application on its own stack instance
+    for(size_t node = 0; node < NODE_GLOBALS_MAX_NODES; node++)
+    {
+        set_node_global_id(node);
+        __framework_bootstrap();
+    }
+#else
+    __framework_bootstrap();
+#endif
+    //initialise platform functionality that depends on the framework
+    __platform_post_framework_init();
+    scheduler_run();
+    return 0;
+}
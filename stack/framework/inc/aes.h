@@ -2,9 +2,35 @@
 #define _AES_H_
 
 #include <types.h>
+#include "hwaes.h"
+
+// the platforms on which the block cipher is offloaded to the hw_aes_* functions
+#if (defined PLATFORM_EFM32GG_STK3700 || defined PLATFORM_EFM32HG_STK3400 || defined PLATFORM_EZR32LG_WSTK6200A)
+    #define AES_HARDWARE_SUPPORT
+#endif
 
 
 #define AES_BLOCK_SIZE 16
+#define AES_KEY_SIZE 16
+#define AES_ROUND_KEYS_SIZE 176
+
+/*! \brief An AES-128 key, prepared once by AES128_init() and then used for any number of frames.
+ *
+ * For the software cipher the context holds the expanded key schedule, so the key is not expanded again on every
+ * call. When the cipher is offloaded to the hw_aes_* functions, it holds the keys in the form they are loaded into
+ * the peripheral. All state is kept in the context, so multiple keys (for example per access class or per node)
+ * can be used next to each other.
+ */
+typedef struct {
+#ifdef AES_HARDWARE_SUPPORT
+    // stored as words, the peripheral drivers access the keys 32 bit at a time
+    uint32_t key[AES_KEY_SIZE / 4];
+    uint32_t decrypt_key[AES_KEY_SIZE / 4]; // the last round key, used by the peripheral to decrypt
+#else
+    // word i holds bytes 4i up to 4i + 3 of the key schedule, the first one in the least significant byte
+    uint32_t round_key[AES_ROUND_KEYS_SIZE / 4];
+#endif
+} aes_ctx_t;
 
 // #define the macros below to 1/0 to enable/disable the mode of operation.
 //
@@ -24,32 +50,34 @@
   #define CTR 1
 #endif
 
-void AES128_init(const uint8_t *key);
+/*! \brief Prepares the context for the given 128 bit key */
+void AES128_init(aes_ctx_t *ctx, const uint8_t *key);
 
 #if defined(ECB) && ECB
 
 // The two functions AES128_ECB_xxcrypt() do most of the work, and they expect inputs of 128 bit length.
-void AES128_ECB_encrypt(uint8_t *input, uint8_t *output);
-void AES128_ECB_decrypt(uint8_t *input, uint8_t *output);
+void AES128_ECB_encrypt(const aes_ctx_t *ctx, uint8_t *input, uint8_t *output);
+void AES128_ECB_decrypt(const aes_ctx_t *ctx, uint8_t *input, uint8_t *output);
 
 #endif // #if defined(ECB) && ECB
 
 
 #if defined(CBC) && CBC
 
-void AES128_CBC_encrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv);
-void AES128_CBC_decrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv);
+void AES128_CBC_encrypt_buffer(const aes_ctx_t *ctx, uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv);
+void AES128_CBC_decrypt_buffer(const aes_ctx_t *ctx, uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv);
 
 #endif // #if defined(CBC) && CBC
 
 #if defined(CTR) && CTR
-void AES128_CTR_encrypt(uint8_t *output, uint8_t *input, uint32_t length, uint8_t* ctr_blk);
+void AES128_CTR_encrypt(const aes_ctx_t *ctx, uint8_t *output, uint8_t *input, uint32_t length, uint8_t* ctr_blk);
 // Decryption is exactly the same operation as encryption
 
 #endif // #if defined(CTR) && CTR
 
 /*! \brief AES CBC-MAC.
  *
+ * \param ctx		The key, see AES128_init()
  * \param auth		Buffer to place the MAC. Must be at least @p auth_len long.
  * \param payload	Buffer to place the text to authenticate.
  * \param length	Number of bytes to encrypt. Must be a multiple of 16.
@@ -59,12 +87,13 @@ void AES128_CTR_encrypt(uint8_t *output, uint8_t *input, uint32_t length, uint8_
  * \param ctr_blk	128 bit initial counter block to be used for the CTR encryption.
  * \param auth_len	MIC length of 0, 4, 8 or 16 bytes are allowed
  */
-error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
+error_t AES128_CBC_MAC( const aes_ctx_t *ctx, uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
                         const uint8_t *add, uint8_t add_len, uint8_t auth_len );
 
 
 /*! \brief AES Counter with CBC-MAC (CCM), 128 bit key.
  *
+ * \param ctx		The key, see AES128_init()
  * \param payload	Buffer to place the plain text. The encrypted data is overwritten on this buffer. Must be at least @p len long.
  * \param length	Number of bytes to encrypt. Must be a multiple of 16.
  * \param iv		Initialization vector to be used as the first block by CBC-MAC
@@ -73,12 +102,13 @@ error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const u
  * \param ctr_blk	128 bit initial counter block to be used for the CTR encryption.
  * \param auth_len	MIC length of 0, 4, 8 or 16 bytes are allowed
  */
-error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
+error_t AES128_CCM_encrypt( const aes_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
                             const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
                             uint8_t auth_len );
 
 /*! \brief AES Counter with CBC-MAC (CCM), 128 bit key.
  *
+ * \param ctx		The key, see AES128_init()
  * \param payload	Buffer to place the encrypted text. The decrypted data is overwritten on this buffer. Must be at least @p len long.
  * \param length	Number of bytes to decrypt. Must be a multiple of 16.
  * \param iv		Initialization vector to be used as the first block by CBC-MAC
@@ -87,7 +117,7 @@ error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
  * \param ctr_blk	128 bit initial counter block to be used for the CTR encryption.
  * \param auth_len	MIC length of 0, 4, 8 or 16 bytes are allowed
  */
-error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
+error_t AES128_CCM_decrypt( const aes_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
                             const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
                             const uint8_t *auth, uint8_t auth_len );
 
@@ -57,7 +57,7 @@ static inline void bitmap_clear(uint8_t* bitmap, uint8_t pos)
  * @param bitmap    The bitmap. Note: the user is responsible for initializing this.
  * @param pos       The bit number to get. Note: the user is responsible for checking pos is not bigger then the bitmap itself
  */
-static bool bitmap_get(uint8_t* bitmap, uint8_t pos)
+static inline bool bitmap_get(uint8_t* bitmap, uint8_t pos)
 {
     return bitmap[pos / 8] & (1 << (pos & 7))? true : false;
 }
@@ -69,7 +69,7 @@ static bool bitmap_get(uint8_t* bitmap, uint8_t pos)
  * @param size      The max number of bits to search
  * @return The index of the first occurance of flag, or -1 when not found
  */
-static int8_t bitmap_search(uint8_t* bitmap, bool flag, uint8_t size)
+static inline int8_t bitmap_search(uint8_t* bitmap, bool flag, uint8_t size)
 {
     uint8_t i;
     for(i = 0; i < size; i++)
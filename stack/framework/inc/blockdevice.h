@@ -0,0 +1,72 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file blockdevice.h
+ * \addtogroup blockdevice
+ * \ingroup framework
+ * @{
+ * \brief Specifies a generic interface to non volatile memory (internal or external flash, emulated on a file, ...)
+ *
+ * The memory behaves like NOR flash: it is divided in erase blocks which read 0xFF after being erased and
+ * programming can only clear bits. Programming is done in multiples of program_unit bytes, at addresses aligned to
+ * program_unit. Every driver embeds a blockdevice_t as the first member of its own struct, so the driver functions
+ * can cast the blockdevice_t pointer back to the driver specific type.
+ */
+#ifndef __BLOCKDEVICE_H_
+#define __BLOCKDEVICE_H_
+
+#include "types.h"
+#include "link_c.h"
+#include "errors.h"
+
+typedef struct blockdevice blockdevice_t;
+
+/*! \brief The functions implemented by a block device driver, addresses are relative to the start of the device */
+typedef struct
+{
+    error_t (*read)(blockdevice_t* bd, uint8_t* data, uint32_t address, uint32_t length);
+    error_t (*program)(blockdevice_t* bd, const uint8_t* data, uint32_t address, uint32_t length);
+    error_t (*erase)(blockdevice_t* bd, uint32_t address); //!< erases the block containing address
+} blockdevice_driver_t;
+
+struct blockdevice
+{
+    const blockdevice_driver_t* driver;
+    uint32_t erase_block_size;
+    uint16_t erase_block_count;
+    uint8_t program_unit; //!< a power of 2
+};
+
+static inline error_t blockdevice_read(blockdevice_t* bd, uint8_t* data, uint32_t address, uint32_t length)
+{
+    return bd->driver->read(bd, data, address, length);
+}
+
+static inline error_t blockdevice_program(blockdevice_t* bd, const uint8_t* data, uint32_t address, uint32_t length)
+{
+    return bd->driver->program(bd, data, address, length);
+}
+
+static inline error_t blockdevice_erase(blockdevice_t* bd, uint32_t address)
+{
+    return bd->driver->erase(bd, address);
+}
+
+#endif /* __BLOCKDEVICE_H_ */
+
+/** @}*/
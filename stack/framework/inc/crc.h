@@ -25,6 +25,34 @@
 
 #include <stdint.h>
 
-uint16_t crc_calculate(uint8_t* data, uint8_t length);
+/*! \brief The initial value of the CRC-CCITT (polynomial 0x1021) used by D7A */
+#define CRC_INITIAL_VALUE 0xFFFF
+
+/*! \brief Starts a CRC calculation.
+ *
+ * The CRC can be calculated incrementally, for example while draining a radio FIFO:
+ * crc = crc_init(); crc = crc_update(crc, part1, len1); crc = crc_update(crc, part2, len2); crc = crc_final(crc);
+ * The state is kept by the caller so the functions are reentrant.
+ */
+static inline uint16_t crc_init()
+{
+    return CRC_INITIAL_VALUE;
+}
+
+/*! \brief Updates the CRC with length bytes of data.
+ *
+ * The implementation (bitwise, a 512 byte lookup table or slicing-by-4 using 2kB of tables) is selected using
+ * the FRAMEWORK_CRC_IMPLEMENTATION CMake property.
+ */
+uint16_t crc_update(uint16_t crc, const uint8_t* data, uint16_t length);
+
+/*! \brief Returns the CRC value after all data is processed. */
+static inline uint16_t crc_final(uint16_t crc)
+{
+    return crc; // no final XOR
+}
+
+/*! \brief Calculates the CRC of a buffer in one go */
+uint16_t crc_calculate(uint8_t* data, uint16_t length);
 
 #endif /* CRC_H_ */
@@ -30,8 +30,16 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "framework_defs.h"
+
+/*! \brief The highest soft decision value, a soft value of 0 is a certain 0 bit and FEC_SOFT_MAX a certain 1 bit */
+#define FEC_SOFT_MAX 7
+
+/*! \brief The number of soft values the soft decoder processes at once (4 encoded bytes) */
+#define FEC_SOFT_CHUNK_SIZE 32
+
 typedef struct {
-	uint8_t cost;
+	uint16_t cost;
 	uint16_t path;
 } VITERBIPATH;
 
@@ -43,12 +51,87 @@ typedef struct {
 	VITERBIPATH states2[8];
 } VITERBISTATE;
 
+/*! \brief The state of a streaming FEC decoder.
+ *
+ * All decoder state is kept in the context, so multiple frames can be decoded concurrently and encoding
+ * is possible while a frame is being decoded. The context should not be copied while decoding.
+ */
+typedef struct {
+	VITERBISTATE vstate;
+	uint8_t* output;
+	uint16_t output_length;
+	uint16_t input_length;
+	uint16_t processed_bytes;
+	uint16_t fec_processed_bytes;
+	uint16_t decoded_length;
+	uint8_t chunk[4];
+	uint8_t chunk_length;
+} fec_ctx_t;
+
 //void print_array(uint8_t* buffer, uint8_t length);
 
 uint16_t fec_encode(uint8_t *data, uint16_t nbytes);
 uint8_t fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_length);
 uint16_t fec_calculated_decoded_length(uint8_t packet_length);
 
+/*! \brief Starts decoding a frame incrementally.
+ *
+ * \param output		The buffer the decoded data is written to. This may be the buffer the encoded data is
+ *			received in, since the decoded data never overtakes the encoded data which is not fed yet.
+ * \param output_length	The maximum number of decoded bytes.
+ * \param input_length	The maximum number of encoded bytes which will be decoded.
+ */
+void fec_decode_begin(fec_ctx_t* ctx, uint8_t* output, uint16_t output_length, uint16_t input_length);
+
+/*! \brief Decodes the next length bytes of encoded data, for example as they are read from the radio FIFO.
+ *
+ * The data can be fed in chunks of any size, every 4 encoded bytes are decoded as soon as they are available.
+ * \return The number of decoded bytes so far.
+ */
+uint16_t fec_decode_feed(fec_ctx_t* ctx, const uint8_t* data, uint16_t length);
+
+/*! \brief Finishes decoding and returns the number of decoded bytes */
+uint16_t fec_decode_end(fec_ctx_t* ctx);
+
+/*! \brief Decodes the next soft decided encoded bits of a frame started with fec_decode_begin().
+ *
+ * The soft decoder weighs every received bit by its reliability instead of only counting the bit errors, which
+ * gives about 2 dB of extra coding gain over the hard decision decoder on a noisy channel (see tests/fec). The
+ * radio driver has to supply the soft values, the sim radio of the linux_host platform does.
+ * \param soft		One soft value per encoded bit, in the order the bits are received (MSB first). A value
+ *			of 0 is a certain 0, FEC_SOFT_MAX a certain 1 and values in between are increasingly
+ *			likely to be a 1.
+ * \param length	The number of soft values, which should be a multiple of FEC_SOFT_CHUNK_SIZE.
+ * \return The number of decoded bytes so far.
+ */
+uint16_t fec_decode_soft_feed(fec_ctx_t* ctx, const uint8_t* soft, uint16_t length);
+
+/*! \brief Soft decision variant of fec_decode_packet().
+ *
+ * \param soft		The packet_length * 8 soft values of the encoded packet, see fec_decode_soft_feed().
+ * \param output	The buffer the decoded packet is written to.
+ * \return The number of decoded bytes.
+ */
+uint8_t fec_decode_packet_soft(const uint8_t* soft, uint8_t* output, uint8_t packet_length, uint8_t output_length);
+
+#ifdef FRAMEWORK_FEC_BATCH_ENABLED
+/*! \brief Decodes multiple frames in place, like calling fec_decode_packet() on every frame.
+ *
+ * Meant for host side gateways which receive the raw frames of many channels. When built with SSE2 or AVX2
+ * support, 8 or 16 frames are decoded in parallel. Only available when FRAMEWORK_FEC_BATCH_ENABLED is set.
+ * \param frames		The encoded frames, which are overwritten with the decoded data.
+ * \param packet_lengths	The encoded length of each frame.
+ * \param decoded_lengths	Returns the decoded length of each frame, 0 when it could not be decoded.
+ */
+void fec_decode_packet_batch(uint8_t** frames, const uint8_t* packet_lengths, uint8_t* decoded_lengths, uint16_t count);
+
+/*! \brief (De)whitens the data in place with the PN9 sequence, which starts over at the first byte */
+void fec_pn9(uint8_t* data, uint16_t length);
+
+/*! \brief Calls fec_pn9() on all frames */
+void fec_pn9_batch(uint8_t** frames, const uint16_t* lengths, uint16_t count);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
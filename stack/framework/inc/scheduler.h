@@ -31,12 +31,34 @@
 #include "link_c.h"
 #include "types.h"
 #include "errors.h"
+#include "framework_defs.h"
 
 /*! \brief Type definition for tasks
  *
  */
 typedef void (*task_t)();
 
+/*! \brief Type definition for tasks carrying an argument
+ *
+ * Tasks carrying an argument do not need to be registered. Every post creates a new pending instance,
+ * so the same task can be pending several times with different arguments (for example one for
+ * every session or transaction in progress).
+ */
+typedef void (*task_arg_t)(void* arg);
+
+/*! \brief Handle of a registered task
+ *
+ * Posting or cancelling a task by its handle does not require looking up the task, which keeps the time spent
+ * with interrupts disabled short. This is useful for tasks which are posted often, or from interrupt context.
+ * The task_t based functions remain available and are implemented on top of the handle based functions.
+ */
+typedef uint8_t task_handle_t;
+
+/*! \brief The handle of a task which is not registered with the scheduler
+ *
+ */
+#define INVALID_TASK_HANDLE 0xFF
+
 /*! \brief Initialise the scheduler sub system. 
  *
  * This function is called while bootstrapping the framework. On no account should you call this function 
@@ -78,6 +100,7 @@ enum
  *
  *  If the task could not be registered due to memory constraints (This problem can be alleviated by increasing the SCHEDULER_MAX_TASKS CMake parameter) this will assert
  *	Also, when the task was already registered this function will assert.
+ *  Tasks should not be registered from interrupt context.
  *
  * \param task		The task to register
  *
@@ -85,6 +108,25 @@ enum
  */
 __LINK_C error_t sched_register_task(task_t task);
 
+/*! \brief Register a task with the task scheduler and return its handle.
+ *
+ *  This behaves like sched_register_task(), but returns the handle of the task which can then be passed to
+ *  sched_post_handle_prio(), sched_cancel_handle() and sched_is_handle_scheduled().
+ *
+ * \param task		The task to register
+ *
+ * \return task_handle_t	The handle of the registered task
+ */
+__LINK_C task_handle_t sched_register_task_handle(task_t task);
+
+/*! \brief Look up the handle of a registered task
+ *
+ * \param task		The task to look up
+ *
+ * \return task_handle_t	The handle of the task, or INVALID_TASK_HANDLE if the task is not registered
+ */
+__LINK_C task_handle_t sched_get_task_handle(task_t task);
+
 /*! \brief Post a task with the given priority
  *
  * \param task		The task to be executed by the scheduler
@@ -125,6 +167,165 @@ __LINK_C error_t sched_cancel_task(task_t task);
  */
 __LINK_C bool sched_is_scheduled(task_t task);
 
+/*! \brief Post a task, identified by its handle, with the given priority
+ *
+ * \param handle	The handle of the task, as returned by sched_register_task_handle()
+ * \param priority	The priority of the task
+ *
+ * \return error_t	The same return values as sched_post_task_prio()
+ */
+__LINK_C error_t sched_post_handle_prio(task_handle_t handle, uint8_t priority);
+
+/*! \brief Post a task, identified by its handle, at the default priority
+ *
+ * \param handle	The handle of the task, as returned by sched_register_task_handle()
+ *
+ * \return error_t	The same return values as sched_post_task()
+ */
+static inline error_t sched_post_handle(task_handle_t handle) { return sched_post_handle_prio(handle, DEFAULT_PRIORITY);}
+
+/*! \brief Cancel an already scheduled task, identified by its handle
+ *
+ * \param handle	The handle of the task, as returned by sched_register_task_handle()
+ *
+ * \return error_t	The same return values as sched_cancel_task()
+ */
+__LINK_C error_t sched_cancel_handle(task_handle_t handle);
+
+/*! \brief Check whether a task, identified by its handle, is scheduled to be executed
+ *
+ * \return bool		TRUE if the task is scheduled, FALSE otherwise
+ */
+__LINK_C bool sched_is_handle_scheduled(task_handle_t handle);
+
+/*! \brief Post a task carrying an argument with the given priority
+ *
+ * The task will be executed once with the given argument. Unlike sched_post_task_prio() the task can
+ * be posted again (with the same or another argument) before it is executed, in which case it is
+ * executed once for every post.
+ * The number of pending instances is limited by the FRAMEWORK_SCHEDULER_MAX_ARG_TASKS CMake parameter.
+ *
+ * \param task		The task to be executed by the scheduler
+ * \param arg		The argument passed to the task
+ * \param priority	The priority of the task
+ *
+ * \return error_t	SUCCESS if the task was successfully scheduled
+ *			ESIZE if the priority is not between MAX_PRIORITY and MIN_PRIORITY
+ *			ENOMEM if there are already FRAMEWORK_SCHEDULER_MAX_ARG_TASKS instances pending, including
+ *			the slots reserved by sched_reserve_arg_slot()
+ */
+__LINK_C error_t sched_post_task_arg_prio(task_arg_t task, void* arg, uint8_t priority);
+
+/*! \brief Reserve one of the FRAMEWORK_SCHEDULER_MAX_ARG_TASKS slots for a task carrying an argument
+ *
+ * A reserved slot can not be taken by sched_post_task_arg_prio(), so a later call of
+ * sched_post_reserved_task_arg_prio() can not fail because the slots are in use. This allows posting a
+ * task from a context where the failure can not be handled, for example when a timer fires.
+ *
+ * \return error_t	SUCCESS if a slot was reserved
+ *			ENOMEM if all unused slots are already reserved
+ */
+__LINK_C error_t sched_reserve_arg_slot();
+
+/*! \brief Give back a slot reserved by sched_reserve_arg_slot() without posting a task
+ */
+__LINK_C void sched_release_arg_slot();
+
+/*! \brief Post a task carrying an argument in a slot reserved by sched_reserve_arg_slot()
+ *
+ * The reservation is used up by this call.
+ *
+ * \param task		The task to be executed by the scheduler
+ * \param arg		The argument passed to the task
+ * \param priority	The priority of the task
+ *
+ * \return error_t	SUCCESS if the task was successfully scheduled
+ *			ESIZE if the priority is not between MAX_PRIORITY and MIN_PRIORITY, the slot stays reserved
+ */
+__LINK_C error_t sched_post_reserved_task_arg_prio(task_arg_t task, void* arg, uint8_t priority);
+
+/*! \brief Post a task carrying an argument at the default priority
+ *
+ * \param task		The task to be executed by the scheduler
+ * \param arg		The argument passed to the task
+ *
+ * \return error_t	The same return values as sched_post_task_arg_prio()
+ */
+static inline error_t sched_post_task_arg(task_arg_t task, void* arg) { return sched_post_task_arg_prio(task, arg, DEFAULT_PRIORITY);}
+
+/*! \brief Cancel the pending instances of a task carrying the given argument
+ *
+ * \param task		The task to cancel
+ * \param arg		The argument of the instances to cancel
+ *
+ * \return error_t	SUCCESS if at least one instance was cancelled
+ *			EALREADY if no instance with this argument was pending
+ */
+__LINK_C error_t sched_cancel_task_arg(task_arg_t task, void* arg);
+
+/*! \brief Check whether an instance of a task carrying the given argument is pending
+ *
+ * \return bool		TRUE if the task is scheduled with this argument, FALSE otherwise
+ */
+__LINK_C bool sched_is_task_arg_scheduled(task_arg_t task, void* arg);
+
+
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+
+/*! \brief The number of bins of the post-to-run latency histogram of a task
+ *
+ * Bin 0 counts the runs with a latency of 0 ticks, bin n counts the latencies in [2^(n-1), 2^n[ ticks
+ * and the last bin also counts all longer latencies.
+ */
+#define SCHED_LATENCY_HISTOGRAM_BINS 8
+
+/*! \brief The statistics the scheduler keeps for a task when FRAMEWORK_SCHEDULER_PROFILING_ENABLED is set
+ *
+ * All times are expressed in ticks of the framework timer (see TIMER_TICKS_PER_SEC).
+ */
+typedef struct
+{
+    task_t task;
+    uint32_t post_count;		/**< The number of times the task was posted successfully */
+    uint32_t run_count;			/**< The number of times the task was executed */
+    uint32_t total_run_time;	/**< The cumulative execution time of the task */
+    uint32_t max_run_time;		/**< The longest execution time of the task */
+    uint32_t max_latency;		/**< The longest time between posting and executing the task */
+    uint16_t latency_histogram[SCHED_LATENCY_HISTOGRAM_BINS]; /**< The post-to-run latencies, saturating at UINT16_MAX */
+} sched_task_stats_t;
+
+/*! \brief Get the number of tasks registered with the scheduler
+ *
+ * The handles of the registered tasks range from 0 to the returned value - 1.
+ */
+__LINK_C uint8_t sched_get_registered_task_count();
+
+/*! \brief Get the statistics of a task
+ *
+ * \param handle	The handle of the task
+ * \param stats		The statistics are copied to this struct
+ *
+ * \return error_t	SUCCESS if the statistics were copied
+ *			EINVAL if the handle does not belong to a registered task
+ */
+__LINK_C error_t sched_get_task_stats(task_handle_t handle, sched_task_stats_t* stats);
+
+/*! \brief Get the number of ticks elapsed since the statistics were reset (or since boot)
+ *
+ */
+__LINK_C uint32_t sched_get_stats_elapsed_time();
+
+/*! \brief Get the number of ticks spent in hw_enter_lowpower_mode() since the statistics were reset (or since boot)
+ *
+ */
+__LINK_C uint32_t sched_get_lowpower_time();
+
+/*! \brief Reset the statistics of all tasks and the low power time
+ *
+ */
+__LINK_C void sched_reset_stats();
+
+#endif
 
 __LINK_C uint8_t sched_get_low_power_mode(void);
 __LINK_C void    sched_set_low_power_mode(uint8_t mode);
@@ -110,8 +110,10 @@ __LINK_C timer_tick_t timer_get_counter_value();
  * to overflow.
  *
  * Please note that posting a task with the framework timers does NOT automatically register
- * it with the scheduler. If the posted task is not registered with the scheduler, the task
- * will not be executed.
+ * it with the scheduler. The task has to be registered with the scheduler before it is posted.
+ *
+ * Posting a task that is already waiting for its timer with the same priority updates the
+ * time at which it is scheduled.
  *
  * \param task		The task to be scheduled at the given time.
  * \param time		The time at which to schedule the task for execution.
@@ -120,12 +122,36 @@ __LINK_C timer_tick_t timer_get_counter_value();
  * \returns error_t	SUCCESS if the task was posted successfully
  *					ENOMEM if the task could not be posted there are already too
  *						   many tasks waiting for execution.
- * 					EALREADY if the task was already scheduled.
- *					EINVAL if an invalid priority was specified.
+ * 					EALREADY if the task was already scheduled with a different priority.
+ *					EINVAL if an invalid priority was specified or the task is not registered.
  *
  */
 __LINK_C error_t timer_post_task_prio(task_t task, timer_tick_t time, uint8_t priority);
 
+/*! \brief Post a task to be scheduled in a window starting at a given time with a given priority
+ *
+ * This function behaves in much the same way as timer_post_task_prio, except that the task may be
+ * scheduled at any time between <time> and <time> + <slack>. The framework timer uses this freedom to
+ * coalesce events with overlapping windows into a single wakeup of the hardware timer, which reduces
+ * the number of times the MCU has to leave low power mode. Use it for events that do not need to be
+ * tick accurate (LED blinks, sensor periods, ...).
+ *
+ * timer_post_task_prio() is equivalent to calling this function with a <slack> of 0.
+ *
+ * \param task		The task to be scheduled.
+ * \param time		The earliest time at which to schedule the task for execution.
+ * \param priority	The priority with which the task should be executed
+ * \param slack		The number of ticks the execution of the task may be delayed after <time>.
+ *
+ * \returns error_t	SUCCESS if the task was posted successfully
+ *					ENOMEM if the task could not be posted there are already too
+ *						   many tasks waiting for execution.
+ * 					EALREADY if the task was already scheduled with a different priority.
+ *					EINVAL if an invalid priority was specified or the task is not registered.
+ *
+ */
+__LINK_C error_t timer_post_task_prio_slack(task_t task, timer_tick_t time, uint8_t priority, timer_tick_t slack);
+
 /*! \brief Post a task <task> to be scheduled at a given <time> with the default priority.
  *
  * This function is equivalent to
@@ -189,6 +215,29 @@ static inline error_t timer_post_task_prio_delay(task_t task, timer_tick_t delay
  */
 static inline error_t timer_post_task_delay(task_t task, timer_tick_t time) { return timer_post_task_prio_delay(task,time,DEFAULT_PRIORITY);}
 
+/*! \brief Post a task to be scheduled <delay> ticks into the future with the default priority, allowing it to be delayed by <slack> ticks.
+ *
+ * This function is equivalent to
+ * \code{.c}
+ * 	timer_post_task_prio_slack(task,timer_get_counter_value()+delay,DEFAULT_PRIORITY,slack);
+ * \endcode
+ *
+ * See the comments above 'timer_post_task_prio_slack()' for a more detailed explanation.
+ *
+ * \param task		The task to be executed.
+ * \param delay		The minimum delay with which the task is to be executed.
+ * \param slack		The number of ticks the execution of the task may be delayed further.
+ *
+ * \returns error_t	SUCCESS if the task was posted successfully
+ *					ENOMEM if the task could not be posted there are already too
+ *						   many tasks waiting for execution.
+ * 					EALREADY if the task was already scheduled.
+ */
+static inline error_t timer_post_task_delay_slack(task_t task, timer_tick_t delay, timer_tick_t slack)
+{
+    return timer_post_task_prio_slack(task, timer_get_counter_value() + delay, DEFAULT_PRIORITY, slack);
+}
+
 /*! \brief Schedule a given <timer_event>
  *
  * This function is equivalent to
@@ -226,6 +275,74 @@ __LINK_C error_t timer_cancel_task(task_t task);
  */
 __LINK_C bool timer_is_task_scheduled(task_t task);
 
+/*! \brief Post a task carrying an argument to be scheduled at a given time with a given priority
+ *
+ * This function behaves like timer_post_task_prio(), except that the task is posted with
+ * sched_post_task_arg_prio() when the timer fires. Every (task, argument) pair is a separate timer
+ * event, so the same task can have several timers pending, one for every argument. Posting a pair
+ * which is already pending with the same priority updates its fire time.
+ *
+ * A new event reserves one of the FRAMEWORK_SCHEDULER_MAX_ARG_TASKS scheduler slots until it fires or is
+ * cancelled, so the task can always be posted when the timer fires.
+ *
+ * Looking up a pair requires a scan of the pending events, so prefer timer_post_task_prio() for
+ * tasks with a single instance.
+ *
+ * \param task		The task to be scheduled at the given time.
+ * \param arg		The argument passed to the task.
+ * \param time		The time at which to schedule the task for execution.
+ * \param priority	The priority with which the task should be executed
+ *
+ * \returns error_t	SUCCESS if the task was posted successfully
+ *					ENOMEM if the task could not be posted there are already too
+ *						   many tasks waiting for execution, or all scheduler slots for
+ *						   tasks carrying an argument are in use or reserved.
+ * 					EALREADY if the task was already scheduled with this argument and a different priority.
+ *					EINVAL if an invalid priority was specified.
+ */
+__LINK_C error_t timer_post_task_arg_prio(task_arg_t task, void* arg, timer_tick_t time, uint8_t priority);
+
+/*! \brief Post a task carrying an argument to be scheduled with a certain <delay> with the default priority
+ *
+ * This function is equivalent to
+ * \code{.c}
+ * 	timer_post_task_arg_prio(task,arg,timer_get_counter_value()+delay,DEFAULT_PRIORITY);
+ * \endcode
+ *
+ * \param task		The task to be executed.
+ * \param arg		The argument passed to the task.
+ * \param delay		The delay with which the task is to be executed.
+ *
+ * \returns error_t	The same return values as timer_post_task_arg_prio()
+ */
+static inline error_t timer_post_task_arg_delay(task_arg_t task, void* arg, timer_tick_t delay)
+{
+    return timer_post_task_arg_prio(task, arg, timer_get_counter_value() + delay, DEFAULT_PRIORITY);
+}
+
+/*! \brief Cancel a previously scheduled task carrying the given argument
+ *
+ * Only the timer of the given (task, argument) pair is cancelled. If the timer already fired, the
+ * posted task can be cancelled with sched_cancel_task_arg().
+ *
+ * \param task	The task to cancel.
+ * \param arg	The argument the task was posted with.
+ *
+ * \return error_t	SUCCESS if the task was successfully canceled
+ * 					EALREADY if the task was not scheduled with this argument and therefore not canceled
+ */
+__LINK_C error_t timer_cancel_task_arg(task_arg_t task, void* arg);
+
+/*! \brief check if a task carrying the given argument is already scheduled with a delay
+ *
+ * \param task	The task to verify.
+ * \param arg	The argument the task was posted with.
+ *
+ * \return bool	true if the (task, argument) pair is present in the timer event queue
+ * 				false if it was not scheduled
+ */
+__LINK_C bool timer_is_task_arg_scheduled(task_arg_t task, void* arg);
+
 #endif /* TIMER_H_ */
 
 /** @}*/
@@ -49,7 +49,6 @@ typedef struct {
   alp_command_origin_t origin;
   fifo_t alp_command_fifo;
   fifo_t alp_response_fifo;
-  uint8_t alp_command[ALP_PAYLOAD_MAX_SIZE];
   uint8_t alp_response[ALP_PAYLOAD_MAX_SIZE];
 } alp_command_t;
 
@@ -141,6 +140,11 @@ static alp_status_codes_t process_op_read_file_data(alp_command_t* command) {
   if(operand.requested_data_length <= 0)
     return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific error + move to fs_read_file?
 
+  if(fifo_get_size(&command->alp_response_fifo) + 4 + operand.requested_data_length > command->alp_response_fifo.max_size) {
+    DPRINT("READ FILE response does not fit");
+    return ALP_STATUS_UNKNOWN_ERROR;
+  }
+
   uint8_t data[operand.requested_data_length];
   alp_status_codes_t alp_status = fs_read_file(operand.file_offset.file_id, operand.file_offset.offset, data, operand.requested_data_length);
   if(alp_status == ALP_STATUS_FILE_ID_NOT_EXISTS) {
@@ -236,11 +240,12 @@ void alp_process_command_result_on_d7asp(d7asp_master_session_config_t* session_
   // TODO refactor
   alp_command_t* command = alloc_command();
   assert(command != NULL);
-  alp_process_command(alp_command, alp_command_length, command->alp_command, &alp_result_length, origin);
+  alp_process_command(alp_command, alp_command_length, command->alp_response, &alp_result_length, origin);
   d7asp_master_session_t* session = d7asp_master_session_create(session_config);
-  uint8_t expected_response_length = alp_get_expected_response_length(command->alp_command, alp_result_length);
-  d7asp_queue_result_t result = d7asp_queue_alp_actions(session, command->alp_command, alp_result_length, expected_response_length);
+  uint8_t expected_response_length = alp_get_expected_response_length(command->alp_response, alp_result_length);
+  d7asp_queue_result_t result = d7asp_queue_alp_actions(session, command->alp_response, alp_result_length, expected_response_length);
   command->fifo_token = result.fifo_token;
+  fifo_init(&(command->alp_response_fifo), command->alp_response, ALP_PAYLOAD_MAX_SIZE); // the result is queued, reuse the buffer for the response
 }
 
 void alp_process_command_console_output(uint8_t* alp_command, uint8_t alp_command_length) {
@@ -317,9 +322,11 @@ bool alp_process_command(uint8_t* alp_command, uint8_t alp_command_length, uint8
   alp_command_t* command = alloc_command();
   assert(command != NULL); // TODO return error
 
-  memcpy(command->alp_command, alp_command, alp_command_length); // TODO not needed to store this
-  fifo_init_filled(&(command->alp_command_fifo), command->alp_command, alp_command_length, ALP_PAYLOAD_MAX_SIZE);
-  fifo_init(&(command->alp_response_fifo), command->alp_response, ALP_PAYLOAD_MAX_SIZE);
+  // the command is parsed from the caller's buffer, the response is only copied to alp_response after the command is
+  // consumed so both may point to the same buffer
+  fifo_init_filled(&(command->alp_command_fifo), alp_command, alp_command_length, alp_command_length);
+  // a response to a D7ASP request is written in place in the frame of the request, so it is limited to what fits in a frame
+  fifo_init(&(command->alp_response_fifo), command->alp_response, origin == ALP_CMD_ORIGIN_D7ASP ? PACKET_MAX_PAYLOAD_SIZE : ALP_PAYLOAD_MAX_SIZE);
   command->origin = origin;
 
   (*alp_response_length) = 0;
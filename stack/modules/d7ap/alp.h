@@ -87,6 +87,7 @@ typedef enum {
   ALP_STATUS_PARTIALLY_COMPLETED = 0x01,
   ALP_STATUS_UNKNOWN_ERROR = 0x80,
   ALP_STATUS_UNKNOWN_OPERATION = 0xF6,
+  ALP_STATUS_FILE_ALLOCATION_OVERFLOW = 0xFA,
   ALP_STATUS_INSUFFICIENT_PERMISSIONS = 0xFC,
   // TODO others
   ALP_STATUS_FILE_ID_ALREADY_EXISTS = 0xFE,
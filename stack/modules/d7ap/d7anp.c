@@ -21,6 +21,7 @@
 
 #include "debug.h"
 #include "d7anp.h"
+#include "d7anp_trusted_nodes.h"
 #include "packet.h"
 #include "fs.h"
 #include "ng.h"
@@ -62,7 +63,120 @@ static d7anp_node_security_t NGDEF(_node_security_state);
 static d7anp_trusted_node_t* NGDEF(_latest_node);
 #define latest_node NG(_latest_node)
 
-static inline uint8_t get_auth_len(uint8_t nls_method)
+#if MODULE_D7AP_TRUSTED_NODE_TABLE_SIZE > 255
+#error "the number of trusted nodes is stored in one byte of the security state register file"
+#endif
+
+// open addressing index of the trusted node table on the UID, with linear probing.
+// A slot holds the table index + 1, or 0 when empty. It is never more than half full.
+#define TRUSTED_NODE_HASH_SIZE D7ANP_TRUSTED_NODE_HASH_SIZE
+
+static uint8_t NGDEF(_trusted_node_hash)[TRUSTED_NODE_HASH_SIZE];
+#define trusted_node_hash NG(_trusted_node_hash)
+
+// incremented on every lookup, used to find the least recently used node
+static uint32_t NGDEF(_trusted_node_clock);
+#define trusted_node_clock NG(_trusted_node_clock)
+
+// the expanded network layer security key
+static aes_ctx_t NGDEF(_aes_ctx);
+#define aes_ctx NG(_aes_ctx)
+
+static uint16_t trusted_node_hash_slot(const uint8_t *address)
+{
+    uint32_t hash = 2166136261UL; // FNV-1a
+
+    for(uint8_t i = 0; i < 8; i++)
+        hash = (hash ^ address[i]) * 16777619UL;
+
+    return hash % TRUSTED_NODE_HASH_SIZE;
+}
+
+static void trusted_node_hash_insert(uint8_t index)
+{
+    uint16_t slot = trusted_node_hash_slot(node_security_state.trusted_node_table[index].addr);
+
+    while(trusted_node_hash[slot])
+        slot = (slot + 1) % TRUSTED_NODE_HASH_SIZE;
+
+    trusted_node_hash[slot] = index + 1;
+}
+
+static void trusted_node_hash_remove(uint8_t index)
+{
+    uint16_t slot = trusted_node_hash_slot(node_security_state.trusted_node_table[index].addr);
+    uint16_t next;
+
+    while(trusted_node_hash[slot] != index + 1)
+        slot = (slot + 1) % TRUSTED_NODE_HASH_SIZE;
+
+    // shift back the following entries of the probe sequence which would no longer be found across the gap
+    next = slot;
+    while(true)
+    {
+        next = (next + 1) % TRUSTED_NODE_HASH_SIZE;
+        if(!trusted_node_hash[next])
+            break;
+
+        uint16_t home = trusted_node_hash_slot(node_security_state.trusted_node_table[trusted_node_hash[next] - 1].addr);
+        if((next > slot && (home <= slot || home > next)) || (next < slot && (home <= slot && home > next)))
+        {
+            trusted_node_hash[slot] = trusted_node_hash[next];
+            slot = next;
+        }
+    }
+
+    trusted_node_hash[slot] = 0;
+}
+
+/* Writes the frame counters updated since the last run back to the FS, in one batch once the stack is idle */
+static void flush_trusted_nodes()
+{
+    for(uint8_t i = 0; i < node_security_state.trusted_node_nb; i++)
+    {
+        d7anp_trusted_node_t *node = &node_security_state.trusted_node_table[i];
+
+        if(node->dirty)
+        {
+            fs_update_nwl_security_state_register(node, i + 1);
+            node->dirty = false;
+        }
+    }
+}
+
+static void update_trusted_node(d7anp_trusted_node_t *node, uint32_t frame_counter)
+{
+    node->frame_counter = frame_counter;
+    node->dirty = true;
+    sched_post_task_prio(&flush_trusted_nodes, MIN_PRIORITY);
+}
+
+void d7anp_load_trusted_nodes()
+{
+    fs_read_nwl_security_state_register(&node_security_state);
+    latest_node = NULL;
+    trusted_node_clock = 0;
+    memset(trusted_node_hash, 0, sizeof(trusted_node_hash));
+    for(uint8_t i = 0; i < node_security_state.trusted_node_nb; i++)
+        trusted_node_hash_insert(i);
+}
+
+uint16_t d7anp_get_trusted_node_hash_slot(const uint8_t *address)
+{
+    return trusted_node_hash_slot(address);
+}
+
+const uint8_t* d7anp_get_trusted_node_hash()
+{
+    return trusted_node_hash;
+}
+
+const d7anp_node_security_t* d7anp_get_trusted_nodes()
+{
+    return &node_security_state;
+}
+
+uint8_t d7anp_get_auth_len(uint8_t nls_method)
 {
     switch(nls_method)
     {
@@ -197,15 +311,16 @@ void d7anp_init()
     assert (fs_read_nwl_security_key(key) == ALP_STATUS_OK); // TODO permission
     DPRINT("KEY");
     DPRINT_DATA(key, AES_BLOCK_SIZE);
-    AES128_init(key);
+    AES128_init(&aes_ctx, key);
 
     /* Read the NWL security parameters */
     fs_read_nwl_security(&security_state);
     DPRINT("Initial Key counter %d", security_state.key_counter);
     DPRINT("Initial Frame counter %ld", security_state.frame_counter);
     /* Read the NWL security state of the successfully decrypted and authenticated devices */
-    fs_read_nwl_security_state_register(&node_security_state);
-    latest_node = NULL;
+    d7anp_load_trusted_nodes();
+
+    sched_register_task(&flush_trusted_nodes);
 #endif
 }
 
@@ -344,7 +459,7 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
     uint8_t add_len = 0;
 
     nls_method = packet->d7anp_ctrl.nls_method;
-    auth_len = get_auth_len(nls_method);
+    auth_len = d7anp_get_auth_len(nls_method);
 
     /* When unicast access, add the auxiliary authentication data composed of the destination address */
     if(auth_len && !ID_TYPE_IS_BROADCAST(packet->d7anp_addressee->ctrl.id_type))
@@ -360,7 +475,7 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
         build_iv(packet, payload_len, ctr_blk);
 
         // the encrypted payload replaces the plaintext
-        AES128_CTR_encrypt(payload, payload, payload_len, ctr_blk);
+        AES128_CTR_encrypt(&aes_ctx, payload, payload, payload_len, ctr_blk);
         break;
     case AES_CBC_MAC_128:
     case AES_CBC_MAC_64:
@@ -372,7 +487,7 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
         header[0] |= ( add_len > 0 );
 
         /* Compute the CBC-MAC */
-        AES128_CBC_MAC(auth, payload, payload_len, header, add, add_len, auth_len);
+        AES128_CBC_MAC(&aes_ctx, auth, payload, payload_len, header, add, add_len, auth_len);
 
         /* Insert the authentication Tag */
         memcpy(payload + payload_len, auth, auth_len);
@@ -391,7 +506,7 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
         header[0] |= ( add_len > 0 );
 
         // TODO check that the payload length does not exceed the maximum size
-        AES128_CCM_encrypt(payload, payload_len, header, add, add_len, ctr_blk, auth_len);
+        AES128_CCM_encrypt(&aes_ctx, payload, payload_len, header, add, add_len, ctr_blk, auth_len);
         break;
     }
 
@@ -412,15 +527,15 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
 
     nls_method = packet->d7anp_ctrl.nls_method;
 
-    payload_len = packet->hw_radio_packet.length + 1 - index - 2; // exclude the headers CRC bytes // TODO exclude footers
-    auth_len = get_auth_len(nls_method); // the authentication length is given in bytes
+    payload_len = packet->hw_radio_packet->length + 1 - index - 2; // exclude the headers CRC bytes // TODO exclude footers
+    auth_len = d7anp_get_auth_len(nls_method); // the authentication length is given in bytes
 
     /* remove the authentication tag from the payload length if relevant */
     payload_len -= auth_len;
 
     if (auth_len)
     {
-        tag = packet->hw_radio_packet.data + index + payload_len;
+        tag = packet->hw_radio_packet->data + index + payload_len;
         DPRINT("Tag  <%d>", auth_len);
         DPRINT_DATA(tag, auth_len);
 
@@ -444,8 +559,8 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
         build_iv(packet, payload_len, ctr_blk);
 
         // the decrypted payload replaces the encrypted data
-        AES128_CTR_encrypt(packet->hw_radio_packet.data + index,
-                           packet->hw_radio_packet.data + index,
+        AES128_CTR_encrypt(&aes_ctx, packet->hw_radio_packet->data + index,
+                           packet->hw_radio_packet->data + index,
                            payload_len, ctr_blk);
         break;
     case AES_CBC_MAC_128:
@@ -458,7 +573,7 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
         header[0] |= ( add_len > 0 );
 
         /* Compute the CBC-MAC and check the authentication Tag */
-        AES128_CBC_MAC(auth, packet->hw_radio_packet.data + index,
+        AES128_CBC_MAC(&aes_ctx, auth, packet->hw_radio_packet->data + index,
                        payload_len, header, add, add_len, auth_len);
 
         if (memcmp(auth, tag, auth_len) != 0)
@@ -467,7 +582,7 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
             return false;
         }
         /* remove the authentication Tag */
-        packet->hw_radio_packet.length -= auth_len;
+        packet->hw_radio_packet->length -= auth_len;
 
         break;
     case AES_CCM_128:
@@ -480,13 +595,13 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
         /* Set Header flags */
         header[0] |= ( add_len > 0 );
 
-        if (AES128_CCM_decrypt(packet->hw_radio_packet.data + index,
+        if (AES128_CCM_decrypt(&aes_ctx, packet->hw_radio_packet->data + index,
                                payload_len, header, add, add_len, ctr_blk,
                                tag, auth_len) != 0)
             return false;
 
         /* remove the authentication Tag */
-        packet->hw_radio_packet.length -= auth_len;
+        packet->hw_radio_packet->length -= auth_len;
     }
 
     return true;
@@ -541,10 +656,19 @@ uint8_t d7anp_assemble_packet_header(packet_t *packet, uint8_t *data_ptr)
 d7anp_trusted_node_t *get_trusted_node(uint8_t *address)
 {
     //look up the sender's address in the trusted node table
-    for(uint8_t i = 0; i < node_security_state.trusted_node_nb; i++)
+    uint16_t slot = trusted_node_hash_slot(address);
+
+    while(trusted_node_hash[slot])
     {
-        if(memcmp(node_security_state.trusted_node_table[i].addr, address, 8) == 0)
-            return &(node_security_state.trusted_node_table[i]);
+        d7anp_trusted_node_t *node = &node_security_state.trusted_node_table[trusted_node_hash[slot] - 1];
+
+        if(memcmp(node->addr, address, 8) == 0)
+        {
+            node->last_used = ++trusted_node_clock;
+            return node;
+        }
+
+        slot = (slot + 1) % TRUSTED_NODE_HASH_SIZE;
     }
 
     return NULL;
@@ -554,43 +678,60 @@ d7anp_trusted_node_t *add_trusted_node(uint8_t *address, uint32_t frame_counter,
                                        uint8_t key_counter)
 {
     uint8_t index = node_security_state.trusted_node_nb;
+    bool evict = node_security_state.trusted_node_nb == MODULE_D7AP_TRUSTED_NODE_TABLE_SIZE;
     d7anp_trusted_node_t *node;
 
-    if (node_security_state.trusted_node_nb < MODULE_D7AP_TRUSTED_NODE_TABLE_SIZE)
+    if (!evict)
         node_security_state.trusted_node_nb++;
     else
     {
-        DPRINT("SSR is full !");
-        return NULL;
+        // evict the least recently used node
+        index = 0;
+        for(uint8_t i = 1; i < MODULE_D7AP_TRUSTED_NODE_TABLE_SIZE; i++)
+        {
+            if(node_security_state.trusted_node_table[i].last_used < node_security_state.trusted_node_table[index].last_used)
+                index = i;
+        }
+
+        DPRINT("SSR is full, evict node %d", index);
+        trusted_node_hash_remove(index);
+        if(latest_node == &node_security_state.trusted_node_table[index])
+            latest_node = NULL;
     }
 
     node = &node_security_state.trusted_node_table[index];
     memcpy(node->addr, address, 8);
     node->frame_counter = frame_counter;
     node->key_counter = key_counter;
+    node->last_used = ++trusted_node_clock;
+    node->dirty = false;
+    trusted_node_hash_insert(index);
 
     DPRINT("Add node <%p> total number <%d>", node, node_security_state.trusted_node_nb);
     /* Update the FS */
-    fs_add_nwl_security_state_register_entry(node, node_security_state.trusted_node_nb);
+    if (evict)
+        fs_update_nwl_security_state_register(node, index + 1);
+    else
+        fs_add_nwl_security_state_register_entry(node, node_security_state.trusted_node_nb);
     return node;
 }
 
 bool d7anp_disassemble_packet_header(packet_t* packet, uint8_t *data_idx)
 {
-    packet->d7anp_ctrl.raw = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
+    packet->d7anp_ctrl.raw = packet->hw_radio_packet->data[(*data_idx)]; (*data_idx)++;
 
     if (!packet->d7anp_ctrl.origin_void)
     {
-        packet->origin_access_class = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
+        packet->origin_access_class = packet->hw_radio_packet->data[(*data_idx)]; (*data_idx)++;
 
         if (!ID_TYPE_IS_BROADCAST(packet->d7anp_ctrl.origin_id_type))
         {
             uint8_t origin_access_id_size = packet->d7anp_ctrl.origin_id_type == ID_TYPE_VID? 2 : 8;
-            memcpy(packet->origin_access_id, packet->hw_radio_packet.data + (*data_idx), origin_access_id_size); (*data_idx) += origin_access_id_size;
+            memcpy(packet->origin_access_id, packet->hw_radio_packet->data + (*data_idx), origin_access_id_size); (*data_idx) += origin_access_id_size;
         }
         else if (packet->d7anp_ctrl.origin_id_type == ID_TYPE_NBID)
         {
-            packet->origin_access_id[0] = packet->hw_radio_packet.data[(*data_idx)];
+            packet->origin_access_id[0] = packet->hw_radio_packet->data[(*data_idx)];
             (*data_idx)++;
         }
     }
@@ -610,8 +751,8 @@ bool d7anp_disassemble_packet_header(packet_t* packet, uint8_t *data_idx)
             nls_method == AES_CCM_64 || nls_method == AES_CCM_128)
         {
             // extract the key counter and the frame counter
-            packet->d7anp_security.key_counter = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
-            packet->d7anp_security.frame_counter = read_be32(packet->hw_radio_packet.data + (*data_idx));
+            packet->d7anp_security.key_counter = packet->hw_radio_packet->data[(*data_idx)]; (*data_idx)++;
+            packet->d7anp_security.frame_counter = read_be32(packet->hw_radio_packet->data + (*data_idx));
             (*data_idx) += sizeof(uint32_t);
 
             DPRINT("Received key counter <%d>, frame counter <%ld>", packet->d7anp_security.key_counter, packet->d7anp_security.frame_counter);
@@ -643,7 +784,7 @@ bool d7anp_disassemble_packet_header(packet_t* packet, uint8_t *data_idx)
 
             // update the node
             if (node)
-                node->frame_counter = packet->d7anp_security.frame_counter;
+                update_trusted_node(node, packet->d7anp_security.frame_counter);
             else
             {
                 if (ID_TYPE_IS_BROADCAST(packet->dll_header.control_target_id_type) &&
@@ -711,7 +852,7 @@ void d7anp_process_received_packet(packet_t* packet, bool background_frame)
             DPRINT("Received a background frame)");
 
             assert(packet->payload_length == sizeof(timer_tick_t));
-            memcpy(&eta, packet->payload, sizeof(timer_tick_t));
+            memcpy(&eta, packet_payload(packet), sizeof(timer_tick_t));
             //TODO decode the D7A Background Network Protocols Frame in order to trigger the foreground scan after the advertising period
             schedule_foreground_scan_after_D7AAdvP(eta);
             return;
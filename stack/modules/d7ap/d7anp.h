@@ -112,7 +112,8 @@ typedef struct {
     uint8_t key_counter;
     uint32_t frame_counter;
     uint8_t addr[8];
-    //bool used;  /* to be used if it is possible to remove a trusted node from the table */
+    uint32_t last_used; // value of the trusted node clock at the last lookup, the oldest node is evicted when the table is full
+    bool dirty; // the frame counter is not yet written back to the security state register file
 } d7anp_trusted_node_t;
 
 typedef struct {
@@ -133,5 +134,6 @@ void d7anp_set_foreground_scan_timeout(timer_tick_t timeout);
 void d7anp_start_foreground_scan();
 void d7anp_stop_foreground_scan(bool auto_scan);
 uint8_t d7anp_secure_payload(packet_t* packet, uint8_t* payload, uint8_t payload_len);
+uint8_t d7anp_get_auth_len(uint8_t nls_method);
 
 #endif /* D7ANP_H_ */
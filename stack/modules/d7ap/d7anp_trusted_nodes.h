@@ -0,0 +1,52 @@
+/*! \file d7anp_trusted_nodes.h
+ *
+
+ *  \copyright (C) Copyright 2016 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * The trusted node table of the network layer, the nodes of which the frame counter is kept in the security state
+ * register file. This interface is internal to d7anp.c and is only meant for unit tests, the rest of the stack
+ * uses d7anp.h.
+ */
+
+#ifndef D7ANP_TRUSTED_NODES_H_
+#define D7ANP_TRUSTED_NODES_H_
+
+#include "d7anp.h"
+
+// the number of slots of the open addressing index on the UID, which is never more than half full
+#define D7ANP_TRUSTED_NODE_HASH_SIZE (2 * MODULE_D7AP_TRUSTED_NODE_TABLE_SIZE)
+
+/*! \brief Loads the table from the security state register file and rebuilds the index, as done by d7anp_init() */
+void d7anp_load_trusted_nodes();
+
+/*! \brief Looks up a node on its 8 byte UID, and marks it as the most recently used one. Returns NULL if not found */
+d7anp_trusted_node_t* get_trusted_node(uint8_t* address);
+
+/*! \brief Adds a node which is not yet in the table. When the table is full the least recently used node is evicted */
+d7anp_trusted_node_t* add_trusted_node(uint8_t* address, uint32_t frame_counter, uint8_t key_counter);
+
+/*! \brief Returns the slot of the index where the lookup of the UID starts */
+uint16_t d7anp_get_trusted_node_hash_slot(const uint8_t* address);
+
+/*! \brief Returns the index, a slot holds the table index of a node + 1, or 0 when empty */
+const uint8_t* d7anp_get_trusted_node_hash();
+
+/*! \brief Returns the table of trusted nodes */
+const d7anp_node_security_t* d7anp_get_trusted_nodes();
+
+#endif /* D7ANP_TRUSTED_NODES_H_ */
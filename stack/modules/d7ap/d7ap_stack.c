@@ -25,7 +25,7 @@
 void d7ap_stack_init(fs_init_args_t* fs_init_args, alp_init_args_t* alp_init_args, bool enable_shell, alp_cmd_handler_appl_itf_callback alp_cmd_handler_appl_itf_cb)
 {
     assert(fs_init_args != NULL);
-    assert(fs_init_args->access_profiles_count > 0); // there should be at least one access profile defined
+    assert(fs_init_args->image != NULL || fs_init_args->access_profiles_count > 0); // there should be at least one access profile defined
 
     fs_init(fs_init_args);
     d7asp_init();
@@ -151,9 +151,6 @@ static void flush_fifos()
         packet_queue_mark_processing(current_request_packet);
         current_request_packet->d7anp_addressee = &(current_master_session.config.addressee); // TODO explicitly pass addressee down the stack layers?
 
-        memcpy(current_request_packet->payload, current_master_session.request_buffer + current_master_session.requests_indices[current_request_id], current_master_session.requests_lengths[current_request_id]);
-        current_request_packet->payload_length = current_master_session.requests_lengths[current_request_id];
-
         // TODO calculate Tl
         // Tl should correspond to the maximum time needed to send the remaining requests in the FIFO including the RETRY parameter
     }
@@ -176,6 +173,11 @@ static void flush_fifos()
         // TODO stop on error
     }
 
+    // the request is copied straight into the frame, for every retry as well since packet_assemble() secures the payload in place
+    current_request_packet->payload_offset = PACKET_TX_PAYLOAD_OFFSET;
+    current_request_packet->payload_length = current_master_session.requests_lengths[current_request_id];
+    memcpy(packet_payload(current_request_packet), current_master_session.request_buffer + current_master_session.requests_indices[current_request_id], current_request_packet->payload_length);
+
     uint8_t listen_timeout = 0; // TODO calculate timeout (and update during transaction lifetime) (based on Tc, channel, cs, payload size, # msgs, # retries)
     ret = d7atp_send_request(current_master_session.token, current_request_id, (current_request_id == current_master_session.next_request_id - 1),
                        current_request_packet, &current_master_session.config.qos, listen_timeout, current_master_session.response_lengths[current_request_id]);
@@ -288,6 +290,7 @@ d7asp_queue_result_t d7asp_queue_alp_actions(d7asp_master_session_t* session, ui
     // TODO can be called in all session states?
     assert(session == &current_master_session); // TODO tmp
     assert(session->request_buffer_tail_idx + alp_payload_length < MODULE_D7AP_FIFO_COMMAND_BUFFER_SIZE);
+    assert(alp_payload_length <= PACKET_MAX_PAYLOAD_SIZE); // the request has to fit in a single frame
     assert(session->next_request_id < MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT); // TODO do not assert but let upper layer handle this
     assert(!(expected_alp_response_length > 0 &&
              (session->config.qos.qos_resp_mode == SESSION_RESP_MODE_NO || session->config.qos.qos_resp_mode == SESSION_RESP_MODE_NO_RPT))); // TODO return error
@@ -321,9 +324,9 @@ bool d7asp_process_received_packet(packet_t* packet, bool extension)
 {
     hw_watchdog_feed(); // TODO do here?
     d7asp_result_t result = {
-        .channel = packet->hw_radio_packet.rx_meta.rx_cfg.channel_id,
-        .rx_level =  - packet->hw_radio_packet.rx_meta.rssi,
-        .link_budget = (packet->dll_header.control_eirp_index - 32) - packet->hw_radio_packet.rx_meta.rssi,
+        .channel = packet->hw_radio_packet->rx_meta.rx_cfg.channel_id,
+        .rx_level =  - packet->hw_radio_packet->rx_meta.rssi,
+        .link_budget = (packet->dll_header.control_eirp_index - 32) - packet->hw_radio_packet->rx_meta.rssi,
         .target_rx_level = 80, // TODO not implemented yet, use default for now
         .status = {
             .ucast = 0, // TODO
@@ -356,7 +359,11 @@ bool d7asp_process_received_packet(packet_t* packet, bool extension)
             assert(packet != current_request_packet);
         }
 
-        alp_process_d7asp_result(packet->payload, packet->payload_length, packet->payload, &packet->payload_length, result);
+        // an unsolicited response is processed as a request, of which the response is written in place in the frame
+        if (packet->payload_length > 0)
+            packet_queue_reserve_tx_buffer(packet);
+
+        alp_process_d7asp_result(packet_payload(packet), packet->payload_length, packet_payload(packet), &packet->payload_length, result);
 
         packet_queue_free_packet(packet); // ACK can be cleaned
 
@@ -407,7 +414,9 @@ bool d7asp_process_received_packet(packet_t* packet, bool extension)
 
         if (packet->payload_length > 0)
         {
-            alp_process_d7asp_result(packet->payload, packet->payload_length, packet->payload, &packet->payload_length, result);
+            // the response is written in place in the frame of the request, make sure it is stored in a buffer large enough
+            packet_queue_reserve_tx_buffer(packet);
+            alp_process_d7asp_result(packet_payload(packet), packet->payload_length, packet_payload(packet), &packet->payload_length, result);
         }
 
         // execute slave transaction
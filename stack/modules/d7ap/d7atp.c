@@ -384,33 +384,33 @@ uint8_t d7atp_assemble_packet_header(packet_t* packet, uint8_t* data_ptr)
 
 bool d7atp_disassemble_packet_header(packet_t *packet, uint8_t *data_idx)
 {
-    packet->d7atp_ctrl.ctrl_raw = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
-    packet->d7atp_dialog_id = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
-    packet->d7atp_transaction_id = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
+    packet->d7atp_ctrl.ctrl_raw = packet->hw_radio_packet->data[(*data_idx)]; (*data_idx)++;
+    packet->d7atp_dialog_id = packet->hw_radio_packet->data[(*data_idx)]; (*data_idx)++;
+    packet->d7atp_transaction_id = packet->hw_radio_packet->data[(*data_idx)]; (*data_idx)++;
     if (packet->d7atp_ctrl.ctrl_agc) {
-        packet->d7atp_target_rx_level_i = packet->hw_radio_packet.data[(*data_idx)];
+        packet->d7atp_target_rx_level_i = packet->hw_radio_packet->data[(*data_idx)];
         (*data_idx)++;
     }
 
     if (packet->d7atp_ctrl.ctrl_tl) {
-        packet->d7atp_tl = packet->hw_radio_packet.data[(*data_idx)];
+        packet->d7atp_tl = packet->hw_radio_packet->data[(*data_idx)];
         (*data_idx)++;
     }
 
     if (packet->d7atp_ctrl.ctrl_te) {
-        packet->d7atp_te = packet->hw_radio_packet.data[(*data_idx)];
+        packet->d7atp_te = packet->hw_radio_packet->data[(*data_idx)];
         (*data_idx)++;
     }
 
     if ((d7atp_state != D7ATP_STATE_MASTER_TRANSACTION_RESPONSE_PERIOD) && (packet->d7atp_ctrl.ctrl_is_ack_requested)) {
-      packet->d7atp_tc = packet->hw_radio_packet.data[(*data_idx)];
+      packet->d7atp_tc = packet->hw_radio_packet->data[(*data_idx)];
       (*data_idx)++;
     }
 
     if (packet->d7atp_ctrl.ctrl_is_ack_requested && packet->d7atp_ctrl.ctrl_ack_not_void)
     {
-        packet->d7atp_ack_template.ack_transaction_id_start = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
-        packet->d7atp_ack_template.ack_transaction_id_stop = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
+        packet->d7atp_ack_template.ack_transaction_id_start = packet->hw_radio_packet->data[(*data_idx)]; (*data_idx)++;
+        packet->d7atp_ack_template.ack_transaction_id_stop = packet->hw_radio_packet->data[(*data_idx)]; (*data_idx)++;
         // TODO ACK bitmap, support for multiple segments to ack not implemented yet
     }
 
@@ -427,7 +427,7 @@ void d7atp_signal_packet_transmitted(packet_t* packet)
 
         if (packet->d7atp_ctrl.ctrl_is_ack_requested)
         {
-            timer_tick_t Tc = adjust_timeout_value(CT_DECOMPRESS(packet->d7atp_tc), packet->hw_radio_packet.tx_meta.timestamp);
+            timer_tick_t Tc = adjust_timeout_value(CT_DECOMPRESS(packet->d7atp_tc), packet->hw_radio_packet->tx_meta.timestamp);
             d7anp_set_foreground_scan_timeout(Tc + 2); // we include Tt here for now
             d7anp_start_foreground_scan();
         }
@@ -505,7 +505,7 @@ void d7atp_process_received_packet(packet_t* packet)
             // TODO validate this is still working now we don't have the stop bit any more
             if (!ID_TYPE_IS_BROADCAST(packet->dll_header.control_target_id_type))
             {
-                Tl = adjust_timeout_value(Tl, packet->hw_radio_packet.rx_meta.timestamp);
+                Tl = adjust_timeout_value(Tl, packet->hw_radio_packet->rx_meta.timestamp);
                 DPRINT("Adjusted Tl=%i (Ti) ", Tl);
                 DPRINT("Responder wants to append a new dialog");
                 d7anp_set_foreground_scan_timeout(Tl);
@@ -553,7 +553,7 @@ void d7atp_process_received_packet(packet_t* packet)
             timer_tick_t Tc = CT_DECOMPRESS(packet->d7atp_tc);
 
             DPRINT("Tc=%i (CT) -> %i (Ti) ", packet->d7atp_tc, Tc);
-            Tc = adjust_timeout_value(Tc, packet->hw_radio_packet.rx_meta.timestamp);
+            Tc = adjust_timeout_value(Tc, packet->hw_radio_packet->rx_meta.timestamp);
 
             if (Tc <= 0)
             {
@@ -577,7 +577,7 @@ void d7atp_process_received_packet(packet_t* packet)
         {
             if (packet->d7anp_listen_timeout)
             {
-                Tl = adjust_timeout_value(packet->d7anp_listen_timeout, packet->hw_radio_packet.rx_meta.timestamp); // TODO decompress
+                Tl = adjust_timeout_value(packet->d7anp_listen_timeout, packet->hw_radio_packet->rx_meta.timestamp); // TODO decompress
                 d7anp_set_foreground_scan_timeout(Tl);
                 d7anp_start_foreground_scan();
             }
@@ -591,7 +591,7 @@ void d7atp_process_received_packet(packet_t* packet)
         // store the received timestamp for later usage (eg CCA). the rx_meta.timestamp can be
         // overwritten since it is stored in a union with tx_meta and can thus be changed when
         // trying to transmit
-        packet->request_received_timestamp = packet->hw_radio_packet.rx_meta.timestamp;
+        packet->request_received_timestamp = packet->hw_radio_packet->rx_meta.timestamp;
 
         // set active_addressee_access_profile to the access_profile supplied by the requester
         if (current_access_class != current_addressee.access_class)
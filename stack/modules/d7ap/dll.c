@@ -114,6 +114,19 @@ static uint8_t NGDEF(_tx_nf_method);
 static int16_t NGDEF(_E_CCA);
 #define E_CCA NG(_E_CCA)
 
+// the handles of the tasks which are posted from the radio interrupts
+static task_handle_t NGDEF(_process_received_packets_task);
+#define process_received_packets_task NG(_process_received_packets_task)
+
+static task_handle_t NGDEF(_notify_transmitted_packet_task);
+#define notify_transmitted_packet_task NG(_notify_transmitted_packet_task)
+
+static task_handle_t NGDEF(_execute_cca_task);
+#define execute_cca_task NG(_execute_cca_task)
+
+static task_handle_t NGDEF(_execute_csma_ca_task);
+#define execute_csma_ca_task NG(_execute_csma_ca_task)
+
 // TODO defined somewhere?
 #define t_g	5
 
@@ -121,11 +134,12 @@ static void execute_cca();
 static void execute_csma_ca();
 static void start_foreground_scan();
 
-static hw_radio_packet_t* alloc_new_packet(uint8_t length)
+static hw_radio_packet_t* alloc_new_packet(uint16_t length)
 {
-    // note we don't use length because in the current implementation the packets in the queue are of
-    // fixed (maximum) size
-    return &(packet_queue_alloc_packet()->hw_radio_packet);
+    // returning NULL makes the radio driver drop the frame, this way the received packets which are not processed yet
+    // can not exhaust the packet queue during a burst
+    packet_t* packet = packet_queue_alloc_rx_packet(length);
+    return packet == NULL ? NULL : packet->hw_radio_packet;
 }
 
 static void release_packet(hw_radio_packet_t* hw_radio_packet)
@@ -264,22 +278,30 @@ static void schedule_background_scan(timer_tick_t tsched)
 
 static void process_received_packets()
 {
-    if (is_tx_busy())
+    // drain the received packets in the order they were received, but yield to other tasks after the budget is used
+    for(uint8_t i = 0; i < MODULE_D7AP_DLL_RX_PROCESS_BUDGET; i++)
     {
-        // this task might be scheduled while a TX is busy (for example after scheduling an execute_cca()).
-        // make sure we don't start processing this packet before the TX is completed.
-        // will be rescheduled by packet_transmitted() or an CSMA failed.
-        process_received_packets_after_tx = true;
-        return;
-    }
+        if (is_tx_busy())
+        {
+            // this task might be scheduled while a TX is busy (for example after scheduling an execute_cca()),
+            // or processing the previous packet started a TX.
+            // make sure we don't start processing this packet before the TX is completed.
+            // will be rescheduled by packet_transmitted() or an CSMA failed.
+            process_received_packets_after_tx = true;
+            return;
+        }
 
-    packet_t* packet = packet_queue_get_received_packet();
-    assert(packet != NULL);
-    DPRINT("Processing received packet");
-    packet_queue_mark_processing(packet);
-    packet_disassemble(packet);
+        packet_t* packet = packet_queue_get_received_packet();
+        if (packet == NULL)
+            return; // all received packets are processed
 
-    // TODO check if more received packets are pending
+        DPRINT("Processing received packet");
+        packet_queue_mark_processing(packet);
+        packet_disassemble(packet);
+    }
+
+    if (packet_queue_get_received_packet() != NULL)
+        sched_post_handle_prio(process_received_packets_task, MAX_PRIORITY);
 }
 
 void packet_received(hw_radio_packet_t* hw_radio_packet)
@@ -292,7 +314,7 @@ void packet_received(hw_radio_packet_t* hw_radio_packet)
     packet_queue_mark_received(hw_radio_packet);
 
     /* the received packet needs to be handled in priority */
-    sched_post_task_prio(&process_received_packets, MAX_PRIORITY);
+    sched_post_handle_prio(process_received_packets_task, MAX_PRIORITY);
 }
 
 static void notify_transmitted_packet()
@@ -304,7 +326,7 @@ static void notify_transmitted_packet()
 
     if (process_received_packets_after_tx)
     {
-        sched_post_task_prio(&process_received_packets, MAX_PRIORITY);
+        sched_post_handle_prio(process_received_packets_task, MAX_PRIORITY);
         process_received_packets_after_tx = false;
     }
 
@@ -324,7 +346,7 @@ void packet_transmitted(hw_radio_packet_t* hw_radio_packet)
     packet_queue_mark_transmitted(hw_radio_packet);
 
     /* the notification task needs to be handled in priority */
-    sched_post_task_prio(&notify_transmitted_packet, MAX_PRIORITY);
+    sched_post_handle_prio(notify_transmitted_packet_task, MAX_PRIORITY);
 }
 
 static void discard_tx()
@@ -341,15 +363,15 @@ static void discard_tx()
     if ((dll_state == DLL_STATE_CCA1) || (dll_state == DLL_STATE_CCA2))
     {
         timer_cancel_task(&execute_cca);
-        sched_cancel_task(&execute_cca);
+        sched_cancel_handle(execute_cca_task);
     }
     else if ((dll_state == DLL_STATE_CCA_FAIL) || (dll_state == DLL_STATE_CSMA_CA_RETRY))
     {
         timer_cancel_task(&execute_csma_ca);
-        sched_cancel_task(&execute_csma_ca);
+        sched_cancel_handle(execute_csma_ca_task);
     }
     else if (dll_state == DLL_STATE_TX_FOREGROUND_COMPLETED)
-        sched_cancel_task(&notify_transmitted_packet);
+        sched_cancel_handle(notify_transmitted_packet_task);
 
     switch_state(DLL_STATE_IDLE);
 }
@@ -378,10 +400,10 @@ static void cca_rssi_valid(int16_t cur_rssi)
             // OK, send packet
             DPRINT("CCA2 RSSI: %d", cur_rssi);
             DPRINT("CCA2 succeeded, transmitting ...");
-            // log_print_data(current_packet->hw_radio_packet.data, current_packet->hw_radio_packet.length + 1); // TODO tmp
+            // log_print_data(current_packet->hw_radio_packet->data, current_packet->hw_radio_packet->length + 1); // TODO tmp
 
             switch_state(DLL_STATE_TX_FOREGROUND);
-            error_t err = hw_radio_send_packet(&current_packet->hw_radio_packet, &packet_transmitted);
+            error_t err = hw_radio_send_packet(current_packet->hw_radio_packet, &packet_transmitted);
             assert(err == SUCCESS);
             return;
         }
@@ -431,7 +453,7 @@ static void execute_csma_ca()
     //hw_radio_set_rx(NULL, NULL, NULL); // put radio in RX but disable callbacks to make sure we don't receive packets when in this state
                                         // TODO use correct rx cfg + it might be interesting to switch to idle first depending on calculated offset
     // TODO select correct subband
-    uint16_t tx_duration = dll_calculate_tx_duration(current_channel_id.channel_header.ch_class, current_packet->hw_radio_packet.length);
+    uint16_t tx_duration = dll_calculate_tx_duration(current_channel_id.channel_header.ch_class, current_packet->hw_radio_packet->length);
 
     switch (dll_state)
     {
@@ -520,7 +542,7 @@ static void execute_csma_ca()
             else
             {
                 switch_state(DLL_STATE_CCA1);
-                sched_post_task_prio(&execute_cca, MAX_PRIORITY);
+                sched_post_handle_prio(execute_cca_task, MAX_PRIORITY);
             }
 
             break;
@@ -534,7 +556,7 @@ static void execute_csma_ca()
             {
                 DPRINT("CCA fail because dll_to = %i < %i ", dll_to, t_g);
                 switch_state(DLL_STATE_CCA_FAIL);
-                sched_post_task_prio(&execute_csma_ca, MAX_PRIORITY);
+                sched_post_handle_prio(execute_csma_ca_task, MAX_PRIORITY);
                 break;
             }
 
@@ -589,7 +611,7 @@ static void execute_csma_ca()
             else
             {
                 switch_state(DLL_STATE_CCA1);
-                sched_post_task_prio(&execute_cca, MAX_PRIORITY);
+                sched_post_handle_prio(execute_cca_task, MAX_PRIORITY);
             }
 
             break;
@@ -601,7 +623,7 @@ static void execute_csma_ca()
             d7anp_signal_transmission_failure();
             if (process_received_packets_after_tx)
             {
-                sched_post_task_prio(&process_received_packets, MAX_PRIORITY);
+                sched_post_handle_prio(process_received_packets_task, MAX_PRIORITY);
                 process_received_packets_after_tx = false;
             }
 
@@ -698,10 +720,10 @@ void dll_init()
 {
     uint8_t nf_ctrl;
 
-    sched_register_task(&process_received_packets);
-    sched_register_task(&notify_transmitted_packet);
-    sched_register_task(&execute_cca);
-    sched_register_task(&execute_csma_ca);
+    process_received_packets_task = sched_register_task_handle(&process_received_packets);
+    notify_transmitted_packet_task = sched_register_task_handle(&notify_transmitted_packet);
+    execute_cca_task = sched_register_task_handle(&execute_cca);
+    execute_csma_ca_task = sched_register_task_handle(&execute_csma_ca);
     sched_register_task(&dll_execute_scan_automation);
 
     hw_radio_init(&alloc_new_packet, &release_packet);
@@ -726,6 +748,9 @@ void dll_tx_frame(packet_t* packet)
     else
         resume_fg_scan = true;
 
+    // a received packet which is reused for the response may be stored in a buffer which is too small for the response
+    packet_queue_reserve_tx_buffer(packet);
+
     dll_header_t* dll_header = &(packet->dll_header);
     dll_header->subnet = packet->d7anp_addressee->access_class;
     DPRINT("TX with subnet=0x%02x", dll_header->subnet);
@@ -743,7 +768,7 @@ void dll_tx_frame(packet_t* packet)
     {
         dll_header->control_eirp_index = current_eirp + 32;
 
-        packet->hw_radio_packet.tx_meta.tx_cfg = (hw_tx_cfg_t){
+        packet->hw_radio_packet->tx_meta.tx_cfg = (hw_tx_cfg_t){
             .channel_id = current_channel_id,
             .syncword_class = PHY_SYNCWORD_CLASS1,
             .eirp = current_eirp
@@ -753,9 +778,9 @@ void dll_tx_frame(packet_t* packet)
     {
         dll_header->control_eirp_index = current_eirp + 32;
 
-        packet->hw_radio_packet.tx_meta.tx_cfg = (hw_tx_cfg_t){
-                .channel_id = packet->hw_radio_packet.rx_meta.rx_cfg.channel_id,
-                .syncword_class = packet->hw_radio_packet.rx_meta.rx_cfg.syncword_class,
+        packet->hw_radio_packet->tx_meta.tx_cfg = (hw_tx_cfg_t){
+                .channel_id = packet->hw_radio_packet->rx_meta.rx_cfg.channel_id,
+                .syncword_class = packet->hw_radio_packet->rx_meta.rx_cfg.syncword_class,
                 .eirp = current_eirp
             };
     }
@@ -774,7 +799,7 @@ void dll_tx_frame(packet_t* packet)
                          current_access_profile.subbands[0].channel_index_start);
         dll_header->control_eirp_index = current_access_profile.subbands[0].eirp + 32;
 
-        packet->hw_radio_packet.tx_meta.tx_cfg = (hw_tx_cfg_t){
+        packet->hw_radio_packet->tx_meta.tx_cfg = (hw_tx_cfg_t){
             .channel_id.channel_header = current_access_profile.channel_header,
             .channel_id.center_freq_index = current_access_profile.subbands[0].channel_index_start,
             .syncword_class = PHY_SYNCWORD_CLASS1,
@@ -783,7 +808,7 @@ void dll_tx_frame(packet_t* packet)
 
         // store the channel id and eirp
         current_eirp = current_access_profile.subbands[0].eirp;
-        current_channel_id = packet->hw_radio_packet.tx_meta.tx_cfg.channel_id;
+        current_channel_id = packet->hw_radio_packet->tx_meta.tx_cfg.channel_id;
 
         // compute Ecca = NF + Eccao
         if (tx_nf_method == D7ADLL_FIXED_NOISE_FLOOR)
@@ -890,7 +915,7 @@ uint8_t dll_assemble_packet_header(packet_t* packet, uint8_t* data_ptr, bool bac
 
 bool dll_disassemble_packet_header(packet_t* packet, uint8_t* data_idx, bool background)
 {
-    packet->dll_header.subnet = packet->hw_radio_packet.data[(*data_idx)]; (*data_idx)++;
+    packet->dll_header.subnet = packet->hw_radio_packet->data[(*data_idx)]; (*data_idx)++;
     uint8_t FSS = ACCESS_SPECIFIER(packet->dll_header.subnet);
     uint8_t FSM = ACCESS_MASK(packet->dll_header.subnet);
     uint8_t address_len;
@@ -908,16 +933,16 @@ bool dll_disassemble_packet_header(packet_t* packet, uint8_t* data_idx, bool bac
         return false;
     }
 
-    packet->dll_header.control_target_id_type  = packet->hw_radio_packet.data[(*data_idx)] >> 6 ;
+    packet->dll_header.control_target_id_type  = packet->hw_radio_packet->data[(*data_idx)] >> 6 ;
 
     if (background)
     {
-        packet->dll_header.control_identifier_tag = packet->hw_radio_packet.data[(*data_idx)] & 0x3F;
+        packet->dll_header.control_identifier_tag = packet->hw_radio_packet->data[(*data_idx)] & 0x3F;
         DPRINT("control_target_id_type 0x%02x Identifier Tag 0x%02x", packet->dll_header.control_target_id_type, packet->dll_header.control_identifier_tag);
     }
     else
     {
-        packet->dll_header.control_eirp_index = packet->hw_radio_packet.data[(*data_idx)] & 0x3F;
+        packet->dll_header.control_eirp_index = packet->hw_radio_packet->data[(*data_idx)] & 0x3F;
         DPRINT("control_target_id_type 0x%02x EIRP index %d", packet->dll_header.control_target_id_type, packet->dll_header.control_eirp_index);
     }
 
@@ -950,13 +975,13 @@ bool dll_disassemble_packet_header(packet_t* packet, uint8_t* data_idx, bool bac
         }
         else
         {
-            if (memcmp(packet->hw_radio_packet.data + (*data_idx), id, address_len) != 0)
+            if (memcmp(packet->hw_radio_packet->data + (*data_idx), id, address_len) != 0)
             {
                 DPRINT("Device ID filtering failed, skipping packet");
                 DPRINT("OUR DEVICE ID");
                 DPRINT_DATA(id, address_len);
                 DPRINT("TARGET DEVICE ID");
-                DPRINT_DATA(packet->hw_radio_packet.data + (*data_idx), address_len);
+                DPRINT_DATA(packet->hw_radio_packet->data + (*data_idx), address_len);
                 return false;
             }
             (*data_idx) += address_len;
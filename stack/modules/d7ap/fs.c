@@ -23,6 +23,7 @@
 #include "string.h"
 #include "debug.h"
 #include "fs.h"
+#include "fs_layout.h"
 #include "ng.h"
 #include "hwsystem.h"
 #include "alp.h"
@@ -31,6 +32,10 @@
 #include "version.h"
 #include "dll.h"
 #include "key.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "bitmap.h"
+#include "fs_journal.h"
 
 #define D7A_PROTOCOL_VERSION_MAJOR 1
 #define D7A_PROTOCOL_VERSION_MINOR 1
@@ -50,11 +55,411 @@ static uint16_t NGDEF(_file_offsets)[MODULE_D7AP_FS_FILE_COUNT] = { 0 };
 static bool NGDEF(_is_fs_init_completed);
 #define is_fs_init_completed NG(_is_fs_init_completed)
 
+// the number of bytes reserved for each file in data, at least the file length
+static uint16_t NGDEF(_file_allocated_lengths)[MODULE_D7AP_FS_FILE_COUNT] = { 0 };
+#define file_allocated_lengths NG(_file_allocated_lengths)
+
+// the number of holes left by deleted or shrunk files which are remembered for reuse. The space of holes which do not
+// fit in the list any more is only recovered by the next compaction.
+#define FS_FREE_EXTENT_COUNT 8
+
+typedef struct
+{
+    uint16_t offset;
+    uint16_t length;
+} fs_extent_t;
+
+// the free space below current_data_offset, the space above it is free as well
+static fs_extent_t NGDEF(_free_extents)[FS_FREE_EXTENT_COUNT];
+#define free_extents NG(_free_extents)
+
+static uint8_t NGDEF(_free_extent_count);
+#define free_extent_count NG(_free_extent_count)
+
+static blockdevice_t* NGDEF(_nvm_device);
+#define nvm_device NG(_nvm_device)
+
+// the files which changed since they were last written to nvm
+static uint8_t NGDEF(_dirty_files)[(MODULE_D7AP_FS_FILE_COUNT + 7) / 8];
+#define dirty_files NG(_dirty_files)
+
+// the files which have a record in the active block of the journal, these are copied when the journal moves to the next block
+static uint8_t NGDEF(_journaled_files)[(MODULE_D7AP_FS_FILE_COUNT + 7) / 8];
+#define journaled_files NG(_journaled_files)
+
+// the files defined by the firmware before the journal is replayed, a deletion of these has to be journaled as well
+static uint8_t NGDEF(_firmware_files)[(MODULE_D7AP_FS_FILE_COUNT + 7) / 8];
+#define firmware_files NG(_firmware_files)
+
+// the frame counter stored in nvm is ahead of the one in use, so a frame counter is never reused after a reset
+// even though the frame counter is not stored for every transmitted frame
+#define NVM_FRAME_COUNTER_RESERVE 256
+
+static uint32_t NGDEF(_nvm_frame_counter);
+#define nvm_frame_counter NG(_nvm_frame_counter)
+
 static inline bool is_file_defined(uint8_t file_id)
 {
     return file_headers[file_id].length != 0;
 }
 
+// files of which the content is generated when read, these do not take space in data
+static inline bool is_generated_file(uint8_t file_id)
+{
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+    return file_id == D7A_FILE_SCHEDULER_STATS_FILE_ID;
+#else
+    return false;
+#endif
+}
+
+static void remove_free_extent(uint8_t index)
+{
+    free_extent_count--;
+    free_extents[index] = free_extents[free_extent_count];
+}
+
+// returns the number of files stored in data, with their IDs in file_ids ordered by offset
+static uint8_t sort_files_by_offset(uint8_t* file_ids)
+{
+    uint8_t count = 0;
+
+    for(uint16_t file_id = 0; file_id < MODULE_D7AP_FS_FILE_COUNT; file_id++)
+    {
+        if(!is_file_defined(file_id) || is_generated_file(file_id))
+            continue;
+
+        // insertion sort, there are only a few files
+        uint8_t i = count++;
+        while(i > 0 && file_offsets[file_ids[i - 1]] > file_offsets[file_id])
+        {
+            file_ids[i] = file_ids[i - 1];
+            i--;
+        }
+
+        file_ids[i] = file_id;
+    }
+
+    return count;
+}
+
+// moves all files down so all free space ends up above current_data_offset
+static void compact()
+{
+    uint8_t file_ids[MODULE_D7AP_FS_FILE_COUNT];
+    uint8_t count = sort_files_by_offset(file_ids);
+
+    current_data_offset = 0;
+    for(uint8_t i = 0; i < count; i++)
+    {
+        uint8_t file_id = file_ids[i];
+
+        if(file_offsets[file_id] != current_data_offset)
+        {
+            memmove(data + current_data_offset, data + file_offsets[file_id], file_allocated_lengths[file_id]);
+            file_offsets[file_id] = current_data_offset;
+        }
+
+        current_data_offset += file_allocated_lengths[file_id];
+    }
+
+    free_extent_count = 0;
+}
+
+// returns the offset of length free bytes, or -1 when there is not enough space
+static int32_t allocate(uint16_t length)
+{
+    int32_t offset;
+
+    // first fit in the holes
+    for(uint8_t i = 0; i < free_extent_count; i++)
+    {
+        if(free_extents[i].length >= length)
+        {
+            offset = free_extents[i].offset;
+            free_extents[i].offset += length;
+            free_extents[i].length -= length;
+            if(free_extents[i].length == 0)
+                remove_free_extent(i);
+
+            return offset;
+        }
+    }
+
+    if(current_data_offset + length > MODULE_D7AP_FS_FILESYSTEM_SIZE)
+    {
+        compact();
+        if(current_data_offset + length > MODULE_D7AP_FS_FILESYSTEM_SIZE)
+            return -1;
+    }
+
+    offset = current_data_offset;
+    current_data_offset += length;
+    return offset;
+}
+
+static void release(uint16_t offset, uint16_t length)
+{
+    uint8_t i = 0;
+
+    // merge with the adjacent holes
+    while(i < free_extent_count)
+    {
+        if(free_extents[i].offset + free_extents[i].length == offset)
+        {
+            offset = free_extents[i].offset;
+            length += free_extents[i].length;
+            remove_free_extent(i);
+            i = 0;
+        }
+        else if(offset + length == free_extents[i].offset)
+        {
+            length += free_extents[i].length;
+            remove_free_extent(i);
+            i = 0;
+        }
+        else
+            i++;
+    }
+
+    if(offset + length == current_data_offset)
+        current_data_offset = offset;
+    else if(free_extent_count < FS_FREE_EXTENT_COUNT)
+        free_extents[free_extent_count++] = (fs_extent_t){ .offset = offset, .length = length };
+}
+
+// only content which can be changed at runtime is stored, the UID and firmware version are always taken from the firmware
+static bool is_persistent(uint8_t file_id, fs_storage_class_t storage_class)
+{
+    return (storage_class == FS_STORAGE_PERMANENT || storage_class == FS_STORAGE_RESTORABLE) && !is_generated_file(file_id)
+            && file_id != D7A_FILE_UID_FILE_ID && file_id != D7A_FILE_FIRMWARE_VERSION_FILE_ID;
+}
+
+static inline bool is_persistent_file(uint8_t file_id)
+{
+    return is_persistent(file_id, file_headers[file_id].file_properties.storage_class);
+}
+
+// returns true when a snapshot has to contain a record for the file: its content, or a deletion of a file defined by
+// the firmware (or a file of which the content is not stored any more) which has to be repeated at the next mount
+static bool needs_record(uint8_t file_id)
+{
+    if(is_file_defined(file_id) && is_persistent_file(file_id))
+        return true;
+
+    return bitmap_get(firmware_files, file_id)
+            && (bitmap_get(journaled_files, file_id) || (!is_file_defined(file_id) && bitmap_get(dirty_files, file_id)));
+}
+
+// returns the size of a snapshot in which file_id has file_header (length 0 when deleted), an upper bound since the
+// deletion of a file defined by the firmware is counted even when it was not journaled
+static uint32_t snapshot_size(uint8_t file_id, const fs_file_header_t* file_header)
+{
+    uint32_t size = 0;
+
+    for(uint16_t id = 0; id < MODULE_D7AP_FS_FILE_COUNT; id++)
+    {
+        const fs_file_header_t* header = id == file_id ? file_header : &file_headers[id];
+        if(header->length != 0 && is_persistent(id, header->file_properties.storage_class))
+            size += fs_journal_record_size(header->length);
+        else if(bitmap_get(firmware_files, id) && (header->length == 0 || bitmap_get(journaled_files, id)))
+            size += fs_journal_record_size(0);
+    }
+
+    return size;
+}
+
+// returns false when file_header would make the snapshot too large for an erase block of the nvm
+static bool fits_in_journal(uint8_t file_id, const fs_file_header_t* file_header)
+{
+    return nvm_device == NULL || snapshot_size(file_id, file_header) <= fs_journal_block_capacity();
+}
+
+// appends the current state of the file to the journal
+static error_t persist_file(uint8_t file_id)
+{
+    uint8_t* file = data + file_offsets[file_id];
+
+    // a deleted file, or a file which is not stored any more, is removed at the next mount
+    if(!is_file_defined(file_id) || !is_persistent_file(file_id))
+        return fs_journal_append(file_id, NULL, NULL, 0);
+
+    if(file_id == D7A_FILE_NWL_SECURITY)
+    {
+        uint8_t nwl_security[D7A_FILE_NWL_SECURITY_SIZE];
+        uint32_t frame_counter;
+        error_t e;
+
+        memcpy(&frame_counter, file + 1, sizeof(uint32_t));
+        frame_counter = __builtin_bswap32(frame_counter);
+        frame_counter = frame_counter < UINT32_MAX - NVM_FRAME_COUNTER_RESERVE ? frame_counter + NVM_FRAME_COUNTER_RESERVE : UINT32_MAX;
+
+        nwl_security[0] = file[0];
+        uint32_t frame_counter_be = __builtin_bswap32(frame_counter);
+        memcpy(nwl_security + 1, &frame_counter_be, sizeof(uint32_t));
+        e = fs_journal_append(file_id, &file_headers[file_id].file_properties, nwl_security, D7A_FILE_NWL_SECURITY_SIZE);
+        if(e == SUCCESS)
+            nvm_frame_counter = frame_counter;
+
+        return e;
+    }
+
+    return fs_journal_append(file_id, &file_headers[file_id].file_properties, file, file_headers[file_id].length);
+}
+
+// writes the files which need a record to the next block of the journal, used when the active block is full
+static error_t write_snapshot()
+{
+    uint8_t snapshot_files[sizeof(journaled_files)] = { 0 };
+    error_t e = fs_journal_start_block();
+    if(e != SUCCESS)
+        return e;
+
+    for(uint16_t file_id = 0; file_id < MODULE_D7AP_FS_FILE_COUNT; file_id++)
+    {
+        if(!needs_record(file_id))
+            continue;
+
+        e = persist_file(file_id);
+        assert(e != ENOMEM); // prevented by fits_in_journal()
+        if(e != SUCCESS)
+            return e; // the previous block stays in use
+
+        bitmap_set(snapshot_files, file_id);
+    }
+
+    e = fs_journal_commit_block();
+    if(e == SUCCESS)
+    {
+        // the records of the previous block are gone, only the files in the snapshot are journaled now
+        memcpy(journaled_files, snapshot_files, sizeof(journaled_files));
+        memset(dirty_files, 0, sizeof(dirty_files));
+    }
+
+    return e;
+}
+
+static void flush_files()
+{
+    for(uint16_t file_id = 0; file_id < MODULE_D7AP_FS_FILE_COUNT; file_id++)
+    {
+        if(!bitmap_get(dirty_files, file_id))
+            continue;
+
+        // a record in the active block has to be overridden, even when the file does not need a record any more
+        if(needs_record(file_id) || bitmap_get(journaled_files, file_id))
+        {
+            if(persist_file(file_id) != SUCCESS)
+            {
+                // the files which are still dirty are written again after the next change, when writing the snapshot failed
+                write_snapshot();
+                return;
+            }
+
+            bitmap_set(journaled_files, file_id);
+        }
+
+        bitmap_clear(dirty_files, file_id);
+    }
+}
+
+void fs_flush()
+{
+    if(nvm_device == NULL)
+        return;
+
+    timer_cancel_task(&flush_files);
+    flush_files();
+}
+
+// the changes to the file are written to nvm after MODULE_D7AP_FS_NVM_FLUSH_DELAY, together with all changes made
+// in the meantime, or as soon as possible when urgent
+static void mark_dirty(uint8_t file_id, bool urgent)
+{
+    if(nvm_device == NULL || !is_fs_init_completed)
+        return;
+
+    bitmap_set(dirty_files, file_id);
+    if(urgent)
+        timer_post_task_prio_delay(&flush_files, 0, MIN_PRIORITY);
+    else if(!timer_is_task_scheduled(&flush_files))
+        timer_post_task_prio_delay(&flush_files, MODULE_D7AP_FS_NVM_FLUSH_DELAY * TIMER_TICKS_PER_SEC, MIN_PRIORITY);
+}
+
+// restores a file from a journal record, records which do not fit the files defined by the firmware are ignored
+static void replay_file(uint8_t file_id, const fs_file_properties_t* file_properties, uint16_t length, uint32_t address)
+{
+    if(file_id >= MODULE_D7AP_FS_FILE_COUNT || is_generated_file(file_id))
+        return;
+
+    if(length == 0)
+    {
+        if(fs_delete_file(file_id) != ALP_STATUS_INSUFFICIENT_PERMISSIONS)
+            bitmap_set(journaled_files, file_id);
+
+        return;
+    }
+
+    if(!is_file_defined(file_id))
+    {
+        fs_file_header_t file_header = { .file_properties = *file_properties, .length = length };
+        if(fs_create_file(file_id, &file_header, NULL) != ALP_STATUS_OK)
+            return;
+    }
+    else if(file_headers[file_id].length != length && fs_resize_file(file_id, length) != ALP_STATUS_OK)
+        return;
+
+    if(file_id >= 0x40)
+        file_headers[file_id].file_properties = *file_properties;
+
+    if(fs_journal_read(address, data + file_offsets[file_id], length) == SUCCESS)
+        bitmap_set(journaled_files, file_id);
+}
+
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+static uint8_t* write_be(uint8_t* ptr, uint32_t value, uint8_t size)
+{
+    for(int8_t i = size - 1; i >= 0; i--)
+    {
+        ptr[i] = value & 0xFF;
+        value >>= 8;
+    }
+
+    return ptr + size;
+}
+
+static inline uint16_t saturate_u16(uint32_t value)
+{
+    return value > UINT16_MAX ? UINT16_MAX : value;
+}
+
+static void read_scheduler_stats_file(uint8_t offset, uint8_t* buffer, uint8_t length)
+{
+    // the file is not stored in the filesystem but generated from the current statistics
+    uint8_t file[D7A_FILE_SCHEDULER_STATS_SIZE] = { 0 };
+    uint8_t* ptr = file;
+    uint8_t task_count = sched_get_registered_task_count();
+    if(task_count > D7A_FILE_SCHEDULER_STATS_MAX_TASKS)
+        task_count = D7A_FILE_SCHEDULER_STATS_MAX_TASKS;
+
+    ptr = write_be(ptr, sched_get_stats_elapsed_time(), 4);
+    ptr = write_be(ptr, sched_get_lowpower_time(), 4);
+    (*ptr) = task_count; ptr++;
+    for(task_handle_t handle = 0; handle < task_count; handle++)
+    {
+        sched_task_stats_t stats;
+        sched_get_task_stats(handle, &stats);
+        ptr = write_be(ptr, saturate_u16(stats.post_count), 2);
+        ptr = write_be(ptr, saturate_u16(stats.run_count), 2);
+        ptr = write_be(ptr, stats.total_run_time, 4);
+        ptr = write_be(ptr, saturate_u16(stats.max_run_time), 2);
+        ptr = write_be(ptr, saturate_u16(stats.max_latency), 2);
+    }
+
+    memcpy(buffer, file + offset, length);
+}
+#endif
+
 static void execute_alp_command(uint8_t command_file_id)
 {
     assert(is_file_defined(command_file_id));
@@ -78,12 +483,51 @@ static void execute_alp_command(uint8_t command_file_id)
 }
 
 
-void fs_init(fs_init_args_t* init_args)
+// the content of these files is only known at runtime, in a filesystem image the content of these files is left empty
+static void init_runtime_content()
 {
-    // TODO store as big endian!
-    is_fs_init_completed = false;
-    current_data_offset = 0;
+    uint64_t id = hw_get_unique_id();
+    uint64_t id_be = __builtin_bswap64(id);
+    memcpy(data + file_offsets[D7A_FILE_UID_FILE_ID], &id_be, D7A_FILE_UID_SIZE);
 
+    uint8_t* data_ptr = data + file_offsets[D7A_FILE_FIRMWARE_VERSION_FILE_ID];
+    (*data_ptr) = D7A_PROTOCOL_VERSION_MAJOR; data_ptr++;
+    (*data_ptr) = D7A_PROTOCOL_VERSION_MINOR; data_ptr++;
+    memcpy(data_ptr, _APP_NAME, D7A_FILE_FIRMWARE_VERSION_APP_NAME_SIZE);
+    data_ptr += D7A_FILE_FIRMWARE_VERSION_APP_NAME_SIZE;
+    memcpy(data_ptr, _GIT_SHA1, D7A_FILE_FIRMWARE_VERSION_GIT_SHA1_SIZE);
+
+    memcpy(data + file_offsets[D7A_FILE_NWL_SECURITY_KEY], AES128_key, D7A_FILE_NWL_SECURITY_KEY_SIZE);
+}
+
+static void load_image(const fs_image_t* image)
+{
+    assert(image->content_size <= MODULE_D7AP_FS_FILESYSTEM_SIZE);
+    memcpy(data, image->content, image->content_size);
+    current_data_offset = image->content_size;
+
+    for(uint8_t i = 0; i < image->file_count; i++)
+    {
+        const fs_image_file_t* file = &image->files[i];
+        assert(file->file_id < MODULE_D7AP_FS_FILE_COUNT);
+        assert(file->offset + file->file_header.length <= image->content_size);
+        file_offsets[file->file_id] = file->offset;
+        file_headers[file->file_id] = file->file_header;
+    }
+
+    // the image should be generated with the file sizes of this build
+    assert(file_headers[D7A_FILE_UID_FILE_ID].length == D7A_FILE_UID_SIZE);
+    assert(file_headers[D7A_FILE_FIRMWARE_VERSION_FILE_ID].length == D7A_FILE_FIRMWARE_VERSION_SIZE);
+    assert(file_headers[D7A_FILE_DLL_CONF_FILE_ID].length == D7A_FILE_DLL_CONF_SIZE);
+    assert(file_headers[D7A_FILE_ACCESS_PROFILE_ID].length == D7A_FILE_ACCESS_PROFILE_SIZE);
+    assert(file_headers[D7A_FILE_NWL_SECURITY].length == D7A_FILE_NWL_SECURITY_SIZE);
+    assert(file_headers[D7A_FILE_NWL_SECURITY_KEY].length == D7A_FILE_NWL_SECURITY_KEY_SIZE);
+    assert(file_headers[D7A_FILE_NWL_SECURITY_STATE_REG].length == 1
+           || file_headers[D7A_FILE_NWL_SECURITY_STATE_REG].length == D7A_FILE_NWL_SECURITY_STATE_REG_SIZE);
+}
+
+static void init_system_files(fs_init_args_t* init_args)
+{
     // 0x00 - UID
     file_offsets[D7A_FILE_UID_FILE_ID] = current_data_offset;
     file_headers[D7A_FILE_UID_FILE_ID] = (fs_file_header_t){
@@ -93,12 +537,8 @@ void fs_init(fs_init_args_t* init_args)
         .length = D7A_FILE_UID_SIZE
     };
 
-    uint64_t id = hw_get_unique_id();
-    uint64_t id_be = __builtin_bswap64(id);
-    memcpy(data + current_data_offset, &id_be, D7A_FILE_UID_SIZE);
     current_data_offset += D7A_FILE_UID_SIZE;
 
-
     // 0x02 - Firmware version
     file_offsets[D7A_FILE_FIRMWARE_VERSION_FILE_ID] = current_data_offset;
     file_headers[D7A_FILE_FIRMWARE_VERSION_FILE_ID] = (fs_file_header_t){
@@ -108,12 +548,7 @@ void fs_init(fs_init_args_t* init_args)
         .length = D7A_FILE_FIRMWARE_VERSION_SIZE
     };
 
-    memset(data + current_data_offset, D7A_PROTOCOL_VERSION_MAJOR, 1); current_data_offset++;
-    memset(data + current_data_offset, D7A_PROTOCOL_VERSION_MINOR, 1); current_data_offset++;
-    memcpy(data + current_data_offset, _APP_NAME, D7A_FILE_FIRMWARE_VERSION_APP_NAME_SIZE);
-    current_data_offset += D7A_FILE_FIRMWARE_VERSION_APP_NAME_SIZE;
-    memcpy(data + current_data_offset, _GIT_SHA1, D7A_FILE_FIRMWARE_VERSION_GIT_SHA1_SIZE);
-    current_data_offset += D7A_FILE_FIRMWARE_VERSION_GIT_SHA1_SIZE;
+    current_data_offset += D7A_FILE_FIRMWARE_VERSION_SIZE;
 
     // 0x0A - DLL Configuration
     file_offsets[D7A_FILE_DLL_CONF_FILE_ID] = current_data_offset;
@@ -126,6 +561,7 @@ void fs_init(fs_init_args_t* init_args)
 
     data[current_data_offset] = init_args->access_class; current_data_offset += 1; // active access class
     memset(data + current_data_offset, 0xFF, 2); current_data_offset += 2; // VID; 0xFFFF means not valid
+    memset(data + current_data_offset, 0, D7A_FILE_DLL_CONF_SIZE - 3); current_data_offset += D7A_FILE_DLL_CONF_SIZE - 3; // RFU
 
     // 0x20+n - Access Profiles
     assert(init_args->access_profiles_count > 0 && init_args->access_profiles_count < 16);
@@ -134,6 +570,7 @@ void fs_init(fs_init_args_t* init_args)
         dae_access_profile_t* access_class = &(init_args->access_profiles[i]);
         file_offsets[D7A_FILE_ACCESS_PROFILE_ID + i] = current_data_offset;
         fs_write_access_class(i, access_class);
+        current_data_offset += D7A_FILE_ACCESS_PROFILE_SIZE;
         file_headers[D7A_FILE_ACCESS_PROFILE_ID + i] = (fs_file_header_t){
             .file_properties.action_protocol_enabled = 0,
             .file_properties.storage_class = FS_STORAGE_PERMANENT,
@@ -163,7 +600,6 @@ void fs_init(fs_init_args_t* init_args)
         .length = D7A_FILE_NWL_SECURITY_KEY_SIZE
     };
 
-    memcpy(data + current_data_offset, AES128_key, D7A_FILE_NWL_SECURITY_KEY_SIZE);
     current_data_offset += D7A_FILE_NWL_SECURITY_KEY_SIZE;
 
     // 0x0F - Network security state register
@@ -178,13 +614,81 @@ void fs_init(fs_init_args_t* init_args)
     data[current_data_offset] = init_args->ssr_filter_mode; current_data_offset++;
     data[current_data_offset] = 0; current_data_offset++;
     if (init_args->ssr_filter_mode & ENABLE_SSR_FILTER)
+    {
+        memset(data + current_data_offset, 0, D7A_FILE_NWL_SECURITY_STATE_REG_SIZE - 2);
         current_data_offset += D7A_FILE_NWL_SECURITY_STATE_REG_SIZE - 2;
+    }
+}
+
+void fs_init(fs_init_args_t* init_args)
+{
+    // TODO store as big endian!
+    is_fs_init_completed = false;
+    current_data_offset = 0;
+    free_extent_count = 0;
+    memset(file_headers, 0, sizeof(file_headers));
+
+    if(init_args->image != NULL)
+        load_image(init_args->image);
+    else
+        init_system_files(init_args);
+
+    init_runtime_content();
+
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+    // Scheduler statistics, a user file ID, no data is allocated since the file is generated when read
+    assert(!is_file_defined(D7A_FILE_SCHEDULER_STATS_FILE_ID)); // not taken by a user file of the image
+    file_headers[D7A_FILE_SCHEDULER_STATS_FILE_ID] = (fs_file_header_t){
+        .file_properties.action_protocol_enabled = 0,
+        .file_properties.storage_class = FS_STORAGE_VOLATILE,
+        .file_properties.permissions = 0, // TODO
+        .length = D7A_FILE_SCHEDULER_STATS_SIZE
+    };
+#endif
 
     // init user files
     if(init_args->fs_user_files_init_cb)
         init_args->fs_user_files_init_cb();
 
     assert(current_data_offset <= MODULE_D7AP_FS_FILESYSTEM_SIZE);
+
+    // the files are stored back to back, some system files use more space than their length
+    uint8_t file_ids[MODULE_D7AP_FS_FILE_COUNT];
+    uint8_t count = sort_files_by_offset(file_ids);
+    memset(file_allocated_lengths, 0, sizeof(file_allocated_lengths));
+    for(uint8_t i = 0; i < count; i++)
+    {
+        uint16_t end = i + 1 < count ? file_offsets[file_ids[i + 1]] : current_data_offset;
+        file_allocated_lengths[file_ids[i]] = end - file_offsets[file_ids[i]];
+    }
+
+    // the content stored in nvm replaces the initial content
+    nvm_device = init_args->nvm;
+    memset(dirty_files, 0, sizeof(dirty_files));
+    memset(journaled_files, 0, sizeof(journaled_files));
+    memset(firmware_files, 0, sizeof(firmware_files));
+    for(uint16_t file_id = 0; file_id < MODULE_D7AP_FS_FILE_COUNT; file_id++)
+    {
+        if(is_file_defined(file_id))
+            bitmap_set(firmware_files, file_id);
+    }
+
+    if(nvm_device != NULL)
+    {
+        // fs_init() is called again when the filesystem is reinitialized
+        if(sched_get_task_handle(&flush_files) == INVALID_TASK_HANDLE)
+            sched_register_task(&flush_files);
+
+        error_t e = fs_journal_mount(nvm_device, &replay_file);
+        assert(e == SUCCESS);
+        // the persistent files defined by the firmware have to fit in an erase block
+        assert(fits_in_journal(D7A_FILE_UID_FILE_ID, &file_headers[D7A_FILE_UID_FILE_ID]));
+
+        d7anp_security_t nwl_security;
+        fs_read_nwl_security(&nwl_security);
+        nvm_frame_counter = nwl_security.frame_counter;
+    }
+
     is_fs_init_completed = true;
 }
 
@@ -193,6 +697,7 @@ void fs_init_file(uint8_t file_id, const fs_file_header_t* file_header, const ui
     assert(!is_fs_init_completed); // initing files not allowed after fs_init() completed (for now?)
     assert(file_id < MODULE_D7AP_FS_FILE_COUNT);
     assert(file_id >= 0x40); // system files may not be inited
+    assert(!is_file_defined(file_id)); // the ID is taken by another user file or by the scheduler statistics
     assert(current_data_offset + file_header->length <= MODULE_D7AP_FS_FILESYSTEM_SIZE);
 
     file_offsets[file_id] = current_data_offset;
@@ -227,11 +732,124 @@ void fs_init_file_with_D7AActP(uint8_t file_id, const d7asp_master_session_confi
     fs_init_file(file_id, &action_file_header, alp_command_buffer);
 }
 
+alp_status_codes_t fs_create_file(uint8_t file_id, const fs_file_header_t* file_header, const uint8_t* initial_data)
+{
+    if(file_id >= MODULE_D7AP_FS_FILE_COUNT) return ALP_STATUS_FILE_ID_NOT_EXISTS;
+    if(file_id < 0x40) return ALP_STATUS_INSUFFICIENT_PERMISSIONS; // system files can not be created
+    if(is_file_defined(file_id)) return ALP_STATUS_FILE_ID_ALREADY_EXISTS;
+    if(file_header->length == 0 || file_header->length > MODULE_D7AP_FS_FILESYSTEM_SIZE) return ALP_STATUS_FILE_ALLOCATION_OVERFLOW;
+    if(!fits_in_journal(file_id, file_header)) return ALP_STATUS_FILE_ALLOCATION_OVERFLOW;
+
+    int32_t offset = allocate(file_header->length);
+    if(offset < 0) return ALP_STATUS_FILE_ALLOCATION_OVERFLOW;
+
+    file_offsets[file_id] = offset;
+    file_allocated_lengths[file_id] = file_header->length;
+    memcpy(file_headers + file_id, file_header, sizeof(fs_file_header_t));
+    if(initial_data != NULL)
+        memcpy(data + offset, initial_data, file_header->length);
+    else
+        memset(data + offset, 0, file_header->length);
+
+    mark_dirty(file_id, false);
+    return ALP_STATUS_OK;
+}
+
+alp_status_codes_t fs_delete_file(uint8_t file_id)
+{
+    if(file_id >= MODULE_D7AP_FS_FILE_COUNT || !is_file_defined(file_id)) return ALP_STATUS_FILE_ID_NOT_EXISTS;
+    if(file_id < 0x40 || is_generated_file(file_id)) return ALP_STATUS_INSUFFICIENT_PERMISSIONS; // system and generated files can not be deleted
+
+    if(is_persistent_file(file_id) || bitmap_get(journaled_files, file_id))
+        mark_dirty(file_id, false);
+
+    release(file_offsets[file_id], file_allocated_lengths[file_id]);
+    memset(file_headers + file_id, 0, sizeof(fs_file_header_t));
+    file_allocated_lengths[file_id] = 0;
+    return ALP_STATUS_OK;
+}
+
+alp_status_codes_t fs_resize_file(uint8_t file_id, uint32_t length)
+{
+    if(file_id >= MODULE_D7AP_FS_FILE_COUNT || !is_file_defined(file_id)) return ALP_STATUS_FILE_ID_NOT_EXISTS;
+    if(file_id < 0x40 || is_generated_file(file_id)) return ALP_STATUS_INSUFFICIENT_PERMISSIONS; // the layout of system and generated files is fixed
+    if(length == 0 || length > MODULE_D7AP_FS_FILESYSTEM_SIZE) return ALP_STATUS_FILE_ALLOCATION_OVERFLOW;
+
+    fs_file_header_t file_header = file_headers[file_id];
+    file_header.length = length;
+    if(length > file_headers[file_id].length && !fits_in_journal(file_id, &file_header)) return ALP_STATUS_FILE_ALLOCATION_OVERFLOW;
+
+    uint16_t allocated_length = file_allocated_lengths[file_id];
+    uint16_t end = file_offsets[file_id] + allocated_length;
+
+    if(length < allocated_length)
+    {
+        release(file_offsets[file_id] + length, allocated_length - length);
+    }
+    else if(length > allocated_length)
+    {
+        uint16_t extra = length - allocated_length;
+        uint8_t i;
+
+        for(i = 0; i < free_extent_count; i++)
+        {
+            if(free_extents[i].offset == end)
+                break;
+        }
+
+        if(end == current_data_offset && current_data_offset + extra <= MODULE_D7AP_FS_FILESYSTEM_SIZE)
+        {
+            // the last file, grow in place
+            current_data_offset += extra;
+        }
+        else if(i < free_extent_count && free_extents[i].length >= extra)
+        {
+            // followed by a large enough hole, grow in place
+            free_extents[i].offset += extra;
+            free_extents[i].length -= extra;
+            if(free_extents[i].length == 0)
+                remove_free_extent(i);
+        }
+        else
+        {
+            // make room behind the file by moving all following files up into the free space
+            compact();
+            if(current_data_offset + extra > MODULE_D7AP_FS_FILESYSTEM_SIZE)
+                return ALP_STATUS_FILE_ALLOCATION_OVERFLOW;
+
+            end = file_offsets[file_id] + allocated_length;
+            memmove(data + end + extra, data + end, current_data_offset - end);
+            for(uint16_t id = 0; id < MODULE_D7AP_FS_FILE_COUNT; id++)
+            {
+                if(is_file_defined(id) && !is_generated_file(id) && file_offsets[id] >= end && id != file_id)
+                    file_offsets[id] += extra;
+            }
+
+            current_data_offset += extra;
+        }
+
+        memset(data + end, 0, extra);
+    }
+
+    file_allocated_lengths[file_id] = length;
+    file_headers[file_id].length = length;
+    mark_dirty(file_id, false);
+    return ALP_STATUS_OK;
+}
+
 alp_status_codes_t fs_read_file(uint8_t file_id, uint8_t offset, uint8_t* buffer, uint8_t length)
 {
     if(!is_file_defined(file_id)) return ALP_STATUS_FILE_ID_NOT_EXISTS;
     if(file_headers[file_id].length < offset + length) return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific error (wait for spec discussion)
 
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+    if(file_id == D7A_FILE_SCHEDULER_STATS_FILE_ID)
+    {
+        read_scheduler_stats_file(offset, buffer, length);
+        return ALP_STATUS_OK;
+    }
+#endif
+
     memcpy(buffer, data + file_offsets[file_id] + offset, length);
     return ALP_STATUS_OK;
 }
@@ -241,7 +859,16 @@ alp_status_codes_t fs_write_file(uint8_t file_id, uint8_t offset, const uint8_t*
     if(!is_file_defined(file_id)) return ALP_STATUS_FILE_ID_NOT_EXISTS;
     if(file_headers[file_id].length < offset + length) return ALP_STATUS_UNKNOWN_ERROR; // TODO more specific error (wait for spec discussion)
 
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+    if(file_id == D7A_FILE_SCHEDULER_STATS_FILE_ID)
+    {
+        sched_reset_stats();
+        return ALP_STATUS_OK;
+    }
+#endif
+
     memcpy(data + file_offsets[file_id] + offset, buffer, length);
+    mark_dirty(file_id, false);
 
     if(file_headers[file_id].file_properties.action_protocol_enabled == true
             && file_headers[file_id].file_properties.action_condition == ALP_ACT_COND_WRITE) // TODO ALP_ACT_COND_WRITEFLUSH?
@@ -301,9 +928,17 @@ alp_status_codes_t fs_write_nwl_security(d7anp_security_t *nwl_security)
 
     if(!is_file_defined(D7A_FILE_NWL_SECURITY)) return ALP_STATUS_FILE_ID_NOT_EXISTS;
 
+    // this is called for every transmitted frame, the frame counter stored in nvm only has to be advanced
+    // before the reserved frame counters run out
+    bool is_urgent = (*data_ptr) != nwl_security->key_counter
+            || (uint64_t)nwl_security->frame_counter + NVM_FRAME_COUNTER_RESERVE / 2 >= nvm_frame_counter;
+
     (*data_ptr) = nwl_security->key_counter; data_ptr++;
     frame_counter = __builtin_bswap32(nwl_security->frame_counter);
     memcpy(data_ptr, &frame_counter, sizeof(uint32_t));
+    if(is_urgent)
+        mark_dirty(D7A_FILE_NWL_SECURITY, true);
+
     return ALP_STATUS_OK;
 }
 
@@ -323,6 +958,8 @@ alp_status_codes_t fs_read_nwl_security_state_register(d7anp_node_security_t *no
         memcpy(&frame_counter, data_ptr, sizeof(uint32_t)); data_ptr += sizeof(uint32_t);
         node_security_state->trusted_node_table[i].frame_counter = (uint32_t)__builtin_bswap32(frame_counter);
         memcpy(node_security_state->trusted_node_table[i].addr, data_ptr, 8); data_ptr += 8;
+        node_security_state->trusted_node_table[i].last_used = 0;
+        node_security_state->trusted_node_table[i].dirty = false;
     }
     return ALP_STATUS_OK;
 }
@@ -345,6 +982,7 @@ alp_status_codes_t fs_add_nwl_security_state_register_entry(d7anp_trusted_node_t
     memcpy(data_ptr, &frame_counter, sizeof(uint32_t));
     data_ptr += sizeof(uint32_t);
     memcpy(data_ptr, trusted_node->addr, 8);
+    mark_dirty(D7A_FILE_NWL_SECURITY_STATE_REG, false);
     return ALP_STATUS_OK;
 }
 
@@ -360,6 +998,10 @@ alp_status_codes_t fs_update_nwl_security_state_register(d7anp_trusted_node_t *t
     (*data_ptr) = trusted_node->key_counter; data_ptr++;
     frame_counter = __builtin_bswap32(trusted_node->frame_counter);
     memcpy(data_ptr, &frame_counter, sizeof(uint32_t));
+    data_ptr += sizeof(uint32_t);
+    // the entry might have been taken over by another node
+    memcpy(data_ptr, trusted_node->addr, 8);
+    mark_dirty(D7A_FILE_NWL_SECURITY_STATE_REG, false);
     return ALP_STATUS_OK;
 }
 
@@ -390,23 +1032,25 @@ void fs_read_access_class(uint8_t access_class_index, dae_access_profile_t *acce
 void fs_write_access_class(uint8_t access_class_index, dae_access_profile_t* access_class)
 {
     assert(access_class_index < 15);
-    current_data_offset = file_offsets[D7A_FILE_ACCESS_PROFILE_ID + access_class_index];
-    memcpy(data + current_data_offset, &(access_class->channel_header), 1); current_data_offset++;
+    uint8_t* data_ptr = data + file_offsets[D7A_FILE_ACCESS_PROFILE_ID + access_class_index];
+    memcpy(data_ptr, &(access_class->channel_header), 1); data_ptr++;
 
     for(uint8_t i = 0; i < SUBPROFILES_NB; i++)
     {
-        memcpy(data + current_data_offset, &(access_class->subprofiles[i].subband_bitmap), 1); current_data_offset++;
-        memcpy(data + current_data_offset, &(access_class->subprofiles[i].scan_automation_period), 1); current_data_offset++;
+        memcpy(data_ptr, &(access_class->subprofiles[i].subband_bitmap), 1); data_ptr++;
+        memcpy(data_ptr, &(access_class->subprofiles[i].scan_automation_period), 1); data_ptr++;
     }
 
     for(uint8_t i = 0; i < SUBBANDS_NB; i++)
     {
-        memcpy(data + current_data_offset, &(access_class->subbands[i].channel_index_start), 2); current_data_offset += 2;
-        memcpy(data + current_data_offset, &(access_class->subbands[i].channel_index_end), 2); current_data_offset += 2;
-        data[current_data_offset] = access_class->subbands[i].eirp; current_data_offset++;
-        data[current_data_offset] = access_class->subbands[i].cca; current_data_offset++;
-        data[current_data_offset] = access_class->subbands[i].duty; current_data_offset++;
+        memcpy(data_ptr, &(access_class->subbands[i].channel_index_start), 2); data_ptr += 2;
+        memcpy(data_ptr, &(access_class->subbands[i].channel_index_end), 2); data_ptr += 2;
+        (*data_ptr) = access_class->subbands[i].eirp; data_ptr++;
+        (*data_ptr) = access_class->subbands[i].cca; data_ptr++;
+        (*data_ptr) = access_class->subbands[i].duty; data_ptr++;
     }
+
+    mark_dirty(D7A_FILE_ACCESS_PROFILE_ID + access_class_index, false);
 }
 
 uint8_t fs_read_dll_conf_active_access_class()
@@ -426,3 +1070,12 @@ uint8_t fs_get_file_length(uint8_t file_id)
   assert(is_file_defined(file_id));
   return file_headers[file_id].length;
 }
+
+void fs_get_layout(fs_layout_t* layout)
+{
+    layout->content = data;
+    layout->size = current_data_offset;
+    layout->headers = file_headers;
+    layout->offsets = file_offsets;
+    layout->allocated_lengths = file_allocated_lengths;
+}
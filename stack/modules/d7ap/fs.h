@@ -27,7 +27,9 @@
 
 #include "dae.h"
 #include "alp.h"
+#include "blockdevice.h"
 #include "MODULE_D7AP_defs.h"
+#include "framework_defs.h"
 
 #define D7A_FILE_UID_FILE_ID 0x00
 #define D7A_FILE_UID_SIZE 8
@@ -52,6 +54,21 @@
 #define D7A_FILE_NWL_SECURITY_STATE_REG			0x0F
 #define D7A_FILE_NWL_SECURITY_STATE_REG_SIZE	2 + (MODULE_D7AP_TRUSTED_NODE_TABLE_SIZE)*(D7A_FILE_NWL_SECURITY_SIZE + D7A_FILE_UID_SIZE)
 
+#ifdef FRAMEWORK_SCHEDULER_PROFILING_ENABLED
+// proprietary file containing the scheduler statistics, generated when read. Writing to the file resets the statistics.
+// It takes a user file ID (MODULE_D7AP_FS_SCHEDULER_STATS_FILE_ID), the system file IDs below 0x40 are reserved by the spec.
+// Layout (big endian): elapsed ticks (4), low power ticks (4), task count (1) and per task handle:
+// posts (2), runs (2), total run time (4), max run time (2), max latency (2). The 16 bit fields saturate.
+#define D7A_FILE_SCHEDULER_STATS_FILE_ID		MODULE_D7AP_FS_SCHEDULER_STATS_FILE_ID
+#if D7A_FILE_SCHEDULER_STATS_FILE_ID < 0x40 || D7A_FILE_SCHEDULER_STATS_FILE_ID >= MODULE_D7AP_FS_FILE_COUNT
+#error "MODULE_D7AP_FS_SCHEDULER_STATS_FILE_ID has to be a user file ID below MODULE_D7AP_FS_FILE_COUNT"
+#endif
+#define D7A_FILE_SCHEDULER_STATS_MAX_TASKS		(FRAMEWORK_SCHEDULER_MAX_TASKS < 20 ? FRAMEWORK_SCHEDULER_MAX_TASKS : 20)
+#define D7A_FILE_SCHEDULER_STATS_HEADER_SIZE	9
+#define D7A_FILE_SCHEDULER_STATS_TASK_SIZE		12
+#define D7A_FILE_SCHEDULER_STATS_SIZE			(D7A_FILE_SCHEDULER_STATS_HEADER_SIZE + D7A_FILE_SCHEDULER_STATS_MAX_TASKS * D7A_FILE_SCHEDULER_STATS_TASK_SIZE)
+#endif
+
 typedef enum
 {
     FS_STORAGE_TRANSIENT = 0,
@@ -94,6 +111,27 @@ typedef struct
 typedef void (*fs_user_files_init_callback)(void);
 
 
+/*! \brief A file in a filesystem image */
+typedef struct
+{
+    uint8_t file_id;
+    uint16_t offset; /**< The offset of the file in the content of the image */
+    fs_file_header_t file_header;
+} fs_image_file_t;
+
+/*! \brief The system files and the user files of an application, built by tools/general/generate_fs_image.py.
+ *
+ * The image is generated at build time with the same layout fs_init() builds, so the filesystem only has to be copied
+ * at boot. The content of the UID, firmware version and security key files is filled in by fs_init().
+ */
+typedef struct
+{
+    uint8_t file_count;
+    uint16_t content_size;
+    const fs_image_file_t* files;
+    const uint8_t* content;
+} fs_image_t;
+
 /**
  * \brief Arguments used by the stack for filesystem initialization
  */
@@ -103,10 +141,24 @@ typedef struct {
     dae_access_profile_t* access_profiles; /**< The access profiles to be written to the filesystem (using increasing fileID starting from0x20) during init.  */    
     uint8_t access_class; /* The Active Access Class to be written in the DLL configuration file */
     uint8_t ssr_filter_mode; /* Initialise the SSR filter mode used to maintain the SSR */
+    const fs_image_t* image; /**< The filesystem image to copy, or NULL to build the system files from the other members. When set, the access profiles, access class and SSR filter mode are taken from the image. */
+    blockdevice_t* nvm; /**< The block device on which the permanent and restorable files are stored, or NULL to keep all files in RAM only. The content stored on the device replaces the initial content of the files. */
 } fs_init_args_t;
 
 void fs_init(fs_init_args_t* init_args);
 void fs_init_file(uint8_t file_id, const fs_file_header_t* file_header, const uint8_t* initial_data);
+/*! \brief Creates a user file at runtime, the space is taken from the holes left by deleted files first.
+ * The content is zeroed when initial_data is NULL.
+ * \return ALP_STATUS_FILE_ALLOCATION_OVERFLOW when the filesystem is full, even after compaction, or when the
+ * stored files would not fit in an erase block of the nvm any more.
+ */
+alp_status_codes_t fs_create_file(uint8_t file_id, const fs_file_header_t* file_header, const uint8_t* initial_data);
+/*! \brief Deletes a user file, its space can be reused by the following fs_create_file() or fs_resize_file() */
+alp_status_codes_t fs_delete_file(uint8_t file_id);
+/*! \brief Changes the length of a user file, keeping its content. Added bytes are zeroed.
+ * \return ALP_STATUS_FILE_ALLOCATION_OVERFLOW in the same cases as fs_create_file().
+ */
+alp_status_codes_t fs_resize_file(uint8_t file_id, uint32_t length);
 void fs_init_file_with_D7AActP(uint8_t file_id, const d7asp_master_session_config_t* fifo_config, const uint8_t* alp_command, const uint8_t alp_command_len);
 alp_status_codes_t fs_read_file(uint8_t file_id, uint8_t offset, uint8_t* buffer, uint8_t length);
 alp_status_codes_t fs_write_file(uint8_t file_id, uint8_t offset, const uint8_t* buffer, uint8_t length);
@@ -124,5 +176,7 @@ alp_status_codes_t fs_read_nwl_security_state_register(d7anp_node_security_t *no
 alp_status_codes_t fs_add_nwl_security_state_register_entry(d7anp_trusted_node_t *trusted_node, uint8_t trusted_node_nb);
 alp_status_codes_t fs_update_nwl_security_state_register(d7anp_trusted_node_t *trusted_node, uint8_t trusted_node_index);
 uint8_t fs_get_file_length(uint8_t file_id);
+/*! \brief Writes the changed files to the nvm now instead of after MODULE_D7AP_FS_NVM_FLUSH_DELAY, e.g. before a planned reset */
+void fs_flush();
 
 #endif /* FS_H_ */
@@ -0,0 +1,327 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "string.h"
+#include "debug.h"
+#include "fs_journal.h"
+#include "ng.h"
+#include "crc.h"
+#include "MODULE_D7AP_defs.h"
+
+#if MODULE_D7AP_FS_FILE_COUNT > 255
+#error "file ID 0xFF marks the erased space after the last record"
+#endif
+
+// block header: magic (4), sequence (4), erase count (4), 0xFFFF (2), CRC (2), all little endian
+#define BLOCK_MAGIC 0x44374653 // "D7FS"
+#define BLOCK_HEADER_SIZE 16
+
+// record header: file ID (1), length (2), action file ID (1), flags (1), permissions (1), CRC (2), followed by the content
+#define RECORD_HEADER_SIZE 8
+#define RECORD_FILE_ID_ERASED 0xFF
+
+// the number of bytes staged before they are programmed or checked, a multiple of the program unit
+#define CHUNK_SIZE 32
+
+static blockdevice_t* NGDEF(_bd);
+#define bd NG(_bd)
+
+// the block which is used after a reset, or erase_block_count - 1 when the device is empty
+static uint16_t NGDEF(_committed_block);
+#define committed_block NG(_committed_block)
+
+static uint32_t NGDEF(_committed_sequence);
+#define committed_sequence NG(_committed_sequence)
+
+// the block records are appended to, differs from committed_block between start and commit
+static uint16_t NGDEF(_block);
+#define block NG(_block)
+
+static uint32_t NGDEF(_block_erase_count);
+#define block_erase_count NG(_block_erase_count)
+
+// the offset of the erased space in block
+static uint32_t NGDEF(_write_offset);
+#define write_offset NG(_write_offset)
+
+// no more records can be appended to block, because it is full or contains a partially written record
+static bool NGDEF(_is_block_closed);
+#define is_block_closed NG(_is_block_closed)
+
+static void write_le(uint8_t* ptr, uint32_t value, uint8_t size)
+{
+    for(uint8_t i = 0; i < size; i++)
+    {
+        ptr[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+static uint32_t read_le(const uint8_t* ptr, uint8_t size)
+{
+    uint32_t value = 0;
+    for(int8_t i = size - 1; i >= 0; i--)
+        value = (value << 8) | ptr[i];
+
+    return value;
+}
+
+static inline uint32_t block_address(uint16_t block_index)
+{
+    return (uint32_t)block_index * bd->erase_block_size;
+}
+
+static inline uint32_t record_size(uint16_t length)
+{
+    return (RECORD_HEADER_SIZE + length + bd->program_unit - 1) & ~(uint32_t)(bd->program_unit - 1);
+}
+
+// returns true when block_index starts with a valid header, sequence and erase_count are only set in that case
+static bool read_block_header(uint16_t block_index, uint32_t* sequence, uint32_t* erase_count)
+{
+    uint8_t header[BLOCK_HEADER_SIZE];
+
+    if(blockdevice_read(bd, header, block_address(block_index), BLOCK_HEADER_SIZE) != SUCCESS)
+        return false;
+
+    if(read_le(header, 4) != BLOCK_MAGIC || read_le(header + 14, 2) != crc_calculate(header, 14))
+        return false;
+
+    *sequence = read_le(header + 4, 4);
+    *erase_count = read_le(header + 8, 4);
+    return true;
+}
+
+// returns true when the content of the record at address matches the CRC in its header
+static bool check_record(uint32_t address, const uint8_t* header, uint16_t length)
+{
+    uint8_t chunk[CHUNK_SIZE];
+    uint16_t crc = crc_update(crc_init(), header, RECORD_HEADER_SIZE - 2);
+
+    address += RECORD_HEADER_SIZE;
+    while(length > 0)
+    {
+        uint16_t chunk_length = length < CHUNK_SIZE ? length : CHUNK_SIZE;
+        if(blockdevice_read(bd, chunk, address, chunk_length) != SUCCESS)
+            return false;
+
+        crc = crc_update(crc, chunk, chunk_length);
+        address += chunk_length;
+        length -= chunk_length;
+    }
+
+    return crc_final(crc) == read_le(header + RECORD_HEADER_SIZE - 2, 2);
+}
+
+static void replay_block(fs_journal_replay_callback_t replay_cb)
+{
+    uint8_t header[RECORD_HEADER_SIZE];
+    uint8_t erased[RECORD_HEADER_SIZE];
+    memset(erased, 0xFF, RECORD_HEADER_SIZE);
+
+    write_offset = BLOCK_HEADER_SIZE;
+    while(write_offset + RECORD_HEADER_SIZE <= bd->erase_block_size)
+    {
+        uint32_t address = block_address(block) + write_offset;
+        if(blockdevice_read(bd, header, address, RECORD_HEADER_SIZE) != SUCCESS)
+            break;
+
+        if(memcmp(header, erased, RECORD_HEADER_SIZE) == 0)
+            return; // the end of the journal
+
+        uint16_t length = read_le(header + 1, 2);
+        if(header[0] == RECORD_FILE_ID_ERASED || write_offset + record_size(length) > bd->erase_block_size
+                || !check_record(address, header, length))
+            break; // a reset while writing this record, the space after it can not be programmed safely
+
+        fs_file_properties_t file_properties = {
+            .action_file_id = header[3],
+            ._flags = header[4],
+            .permissions = header[5]
+        };
+
+        replay_cb(header[0], &file_properties, length, address + RECORD_HEADER_SIZE);
+        write_offset += record_size(length);
+    }
+
+    is_block_closed = true;
+}
+
+error_t fs_journal_mount(blockdevice_t* device, fs_journal_replay_callback_t replay_cb)
+{
+    uint32_t sequence;
+    uint32_t erase_count;
+    bool found = false;
+
+    if(device->erase_block_count < 2 || device->program_unit > BLOCK_HEADER_SIZE
+            || device->erase_block_size < BLOCK_HEADER_SIZE + RECORD_HEADER_SIZE)
+        return ESIZE;
+
+    bd = device;
+    committed_block = bd->erase_block_count - 1;
+    committed_sequence = 0;
+    for(uint16_t i = 0; i < bd->erase_block_count; i++)
+    {
+        if(read_block_header(i, &sequence, &erase_count) && (!found || sequence > committed_sequence))
+        {
+            found = true;
+            committed_block = i;
+            committed_sequence = sequence;
+            block_erase_count = erase_count;
+        }
+    }
+
+    block = committed_block;
+    is_block_closed = !found; // an empty device is formatted by starting the first block
+    if(found)
+        replay_block(replay_cb);
+
+    return SUCCESS;
+}
+
+error_t fs_journal_read(uint32_t address, uint8_t* buffer, uint16_t length)
+{
+    return blockdevice_read(bd, buffer, address, length);
+}
+
+error_t fs_journal_append(uint8_t file_id, const fs_file_properties_t* file_properties, const uint8_t* buffer, uint16_t length)
+{
+    uint8_t chunk[CHUNK_SIZE];
+    uint8_t chunk_length = RECORD_HEADER_SIZE;
+    uint32_t size = record_size(length);
+    uint32_t next_write_offset = write_offset + size;
+    uint32_t address = block_address(block) + write_offset;
+    error_t e;
+
+    assert(file_id != RECORD_FILE_ID_ERASED);
+    if(is_block_closed || next_write_offset > bd->erase_block_size)
+    {
+        is_block_closed = true;
+        return ENOMEM;
+    }
+
+    chunk[0] = file_id;
+    write_le(chunk + 1, length, 2);
+    if(length > 0)
+    {
+        chunk[3] = file_properties->action_file_id;
+        chunk[4] = file_properties->_flags;
+        chunk[5] = file_properties->permissions;
+    }
+    else
+        memset(chunk + 3, 0, 3);
+
+    uint16_t crc = crc_update(crc_update(crc_init(), chunk, RECORD_HEADER_SIZE - 2), buffer, length);
+    write_le(chunk + RECORD_HEADER_SIZE - 2, crc_final(crc), 2);
+
+    // the header and the content are programmed in chunks, the last one padded with erased bytes
+    while(size > 0)
+    {
+        uint8_t copy_length = CHUNK_SIZE - chunk_length;
+        if(copy_length > length)
+            copy_length = length;
+
+        if(copy_length > 0)
+            memcpy(chunk + chunk_length, buffer, copy_length);
+
+        buffer += copy_length;
+        length -= copy_length;
+        chunk_length += copy_length;
+
+        if(length == 0)
+        {
+            uint8_t padded_length = size < CHUNK_SIZE ? size : CHUNK_SIZE;
+            memset(chunk + chunk_length, 0xFF, padded_length - chunk_length);
+            chunk_length = padded_length;
+        }
+
+        if(chunk_length == CHUNK_SIZE || length == 0)
+        {
+            e = blockdevice_program(bd, chunk, address, chunk_length);
+            if(e != SUCCESS)
+            {
+                is_block_closed = true;
+                return e;
+            }
+
+            address += chunk_length;
+            size -= chunk_length;
+            chunk_length = 0;
+        }
+    }
+
+    write_offset = next_write_offset;
+    return SUCCESS;
+}
+
+uint32_t fs_journal_record_size(uint16_t length)
+{
+    return record_size(length);
+}
+
+uint32_t fs_journal_block_capacity()
+{
+    return bd->erase_block_size - BLOCK_HEADER_SIZE;
+}
+
+error_t fs_journal_start_block()
+{
+    uint32_t sequence;
+    uint32_t erase_count = 0;
+    uint16_t next_block = (committed_block + 1) % bd->erase_block_count;
+    error_t e;
+
+    // keep the erase count of the block, to be able to inspect the wear
+    read_block_header(next_block, &sequence, &erase_count);
+
+    block = next_block;
+    block_erase_count = erase_count + 1;
+    write_offset = BLOCK_HEADER_SIZE;
+    is_block_closed = true;
+
+    e = blockdevice_erase(bd, block_address(block));
+    if(e != SUCCESS)
+        return e;
+
+    is_block_closed = false;
+    return SUCCESS;
+}
+
+error_t fs_journal_commit_block()
+{
+    uint8_t header[BLOCK_HEADER_SIZE];
+    error_t e;
+
+    assert(block != committed_block);
+    write_le(header, BLOCK_MAGIC, 4);
+    write_le(header + 4, committed_sequence + 1, 4);
+    write_le(header + 8, block_erase_count, 4);
+    write_le(header + 12, 0xFFFF, 2);
+    write_le(header + 14, crc_calculate(header, 14), 2);
+
+    e = blockdevice_program(bd, header, block_address(block), BLOCK_HEADER_SIZE);
+    if(e != SUCCESS)
+    {
+        is_block_closed = true;
+        return e;
+    }
+
+    committed_block = block;
+    committed_sequence++;
+    return SUCCESS;
+}
@@ -0,0 +1,67 @@
+/* * OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+ * lowpower wireless sensor communication
+ *
+ * Copyright 2015 University of Antwerp
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file fs_journal.h
+ * \ingroup D7AP
+ * @{
+ * \brief Log structured storage of the persistent files on a block device
+ *
+ * Every change to a file is appended as a record (file properties and the complete content) to the active erase
+ * block, so a file can be written many times before a block has to be erased. A record with length 0 marks a
+ * deleted file. When the active block is full, the filesystem writes a snapshot of all journaled files to the next
+ * block (fs_journal_start_block(), fs_journal_append(), fs_journal_commit_block()), the blocks are used round robin
+ * so all blocks wear evenly. The header of a block is written last, after the snapshot, so a reset while rotating
+ * leaves the previous block in use. A record which was only partially written is detected by its CRC.
+ */
+
+#ifndef OSS_7_FS_JOURNAL_H
+#define OSS_7_FS_JOURNAL_H
+
+#include "blockdevice.h"
+#include "fs.h"
+
+/*! \brief Called for every valid record in the active block, in the order the records were written.
+ *  The content of the file is read using fs_journal_read() with the given address, length is 0 for a deleted file. */
+typedef void (*fs_journal_replay_callback_t)(uint8_t file_id, const fs_file_properties_t* file_properties, uint16_t length, uint32_t address);
+
+/*! \brief Finds the most recent block on bd and replays its records, an empty device is formatted on the first append.
+ *  \return ESIZE when the geometry of the device is not supported (less than 2 erase blocks or a program unit larger than 16 bytes) */
+error_t fs_journal_mount(blockdevice_t* bd, fs_journal_replay_callback_t replay_cb);
+
+/*! \brief Reads the content of a file, see fs_journal_replay_callback_t */
+error_t fs_journal_read(uint32_t address, uint8_t* buffer, uint16_t length);
+
+/*! \brief Appends a record for the file to the active block, file_properties and buffer are not used when length is 0.
+ *  \return ENOMEM when the record does not fit in the block, the next block has to be started first */
+error_t fs_journal_append(uint8_t file_id, const fs_file_properties_t* file_properties, const uint8_t* buffer, uint16_t length);
+
+/*! \brief Returns the number of bytes the record of a file with the given length takes in a block, after mounting */
+uint32_t fs_journal_record_size(uint16_t length);
+
+/*! \brief Returns the number of bytes available for records in a block, a snapshot has to fit in this, after mounting */
+uint32_t fs_journal_block_capacity();
+
+/*! \brief Erases the next block, the following appends go to this block but it is only used after fs_journal_commit_block() */
+error_t fs_journal_start_block();
+
+/*! \brief Writes the header of the block started by fs_journal_start_block(), which makes it the active block */
+error_t fs_journal_commit_block();
+
+#endif //OSS_7_FS_JOURNAL_H
+
+/** @}*/
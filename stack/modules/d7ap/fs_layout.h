@@ -0,0 +1,42 @@
+/*! \file fs_layout.h
+ *
+
+ *  \copyright (C) Copyright 2016 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * The layout of the files in the filesystem. This interface is internal to fs.c and is only meant for
+ * unit tests, the rest of the stack uses fs.h.
+ */
+
+#ifndef FS_LAYOUT_H_
+#define FS_LAYOUT_H_
+
+#include "fs.h"
+
+typedef struct
+{
+    const uint8_t* content;
+    uint16_t size; // the number of bytes in use
+    const fs_file_header_t* headers; // indexed on file ID, the length of an undefined file is 0
+    const uint16_t* offsets; // indexed on file ID
+    const uint16_t* allocated_lengths; // indexed on file ID, some files use more space than their length
+} fs_layout_t;
+
+/*! \brief Returns the data of the filesystem and the position of all files in it */
+void fs_get_layout(fs_layout_t* layout);
+
+#endif /* FS_LAYOUT_H_ */
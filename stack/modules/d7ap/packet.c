@@ -16,6 +16,8 @@
  * limitations under the License.
  */
 
+#include "string.h"
+#include "debug.h"
 #include "packet.h"
 #include "packet_queue.h"
 #include "crc.h"
@@ -51,87 +53,112 @@ void packet_init(packet_t* packet)
 
 void packet_assemble(packet_t* packet)
 {
-    uint8_t* data_ptr = packet->hw_radio_packet.data + 1; // skip length field for now, we fill this later
-    bool background_frame = (packet->hw_radio_packet.tx_meta.tx_cfg.syncword_class == PHY_SYNCWORD_CLASS0);
-    uint8_t* nwl_payload;
+    uint8_t* data_ptr = packet->hw_radio_packet->data + 1; // skip length field for now, we fill this later
+    bool background_frame = (packet->hw_radio_packet->tx_meta.tx_cfg.syncword_class == PHY_SYNCWORD_CLASS0);
 
-    data_ptr += dll_assemble_packet_header(packet, data_ptr, background_frame);
+    // the headers are assembled aside first, since they may overlap the payload which is already stored in the frame
+    uint8_t headers[PACKET_MAX_HEADERS_SIZE];
+    uint8_t headers_len = dll_assemble_packet_header(packet, headers, background_frame);
 
-    if (!background_frame)
+    if (background_frame)
+    {
+        memcpy(data_ptr, headers, headers_len); data_ptr += headers_len;
+    }
+    else
     {
-        data_ptr += d7anp_assemble_packet_header(packet, data_ptr);
-        nwl_payload = data_ptr;
+        uint8_t nwl_payload_offset = headers_len + d7anp_assemble_packet_header(packet, headers + headers_len);
+        headers_len = nwl_payload_offset + d7atp_assemble_packet_header(packet, headers + nwl_payload_offset);
+        assert(headers_len <= PACKET_MAX_HEADERS_SIZE);
 
-        data_ptr += d7atp_assemble_packet_header(packet, data_ptr);
+        // the frame buffer of a packet to be transmitted holds a frame of any length, check the frame fits before moving the payload
+        uint8_t auth_len = packet->d7anp_ctrl.nls_method ? d7anp_get_auth_len(packet->d7anp_ctrl.nls_method) : 0;
+        assert(headers_len + packet->payload_length + auth_len + 2 <= PACKET_MAX_FRAME_SIZE);
+
+        // move the payload right behind the headers, this is a no-op when the headers of the received frame which is
+        // reused for the response have the same length
+        if (packet->payload_offset != 1 + headers_len)
+        {
+            memmove(data_ptr + headers_len, packet_payload(packet), packet->payload_length);
+            packet->payload_offset = 1 + headers_len;
+        }
 
-        // add payload
-        memcpy(data_ptr, packet->payload, packet->payload_length); data_ptr += packet->payload_length;
+        memcpy(data_ptr, headers, headers_len); data_ptr += headers_len + packet->payload_length;
 
-        /* Encrypt/authenticate nwl_payload if needed */
+        /* Encrypt/authenticate nwl_payload in place if needed */
         if (packet->d7anp_ctrl.nls_method)
+        {
+            uint8_t* nwl_payload = packet->hw_radio_packet->data + 1 + nwl_payload_offset;
             data_ptr += d7anp_secure_payload(packet, nwl_payload, data_ptr - nwl_payload);
+        }
     }
 
-    packet->hw_radio_packet.length = data_ptr - packet->hw_radio_packet.data - 1 + 2; // exclude the length byte and add CRC bytes
-    packet->hw_radio_packet.data[0] = packet->hw_radio_packet.length;
+    packet->hw_radio_packet->length = data_ptr - packet->hw_radio_packet->data - 1 + 2; // exclude the length byte and add CRC bytes
+    packet->hw_radio_packet->data[0] = packet->hw_radio_packet->length;
 
     // TODO network protocol footer
 
     // add CRC - SW CRC when using FEC
-    if (!has_hardware_crc || packet->hw_radio_packet.tx_meta.tx_cfg.channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (!has_hardware_crc || packet->hw_radio_packet->tx_meta.tx_cfg.channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
     {
-        uint16_t crc = __builtin_bswap16(crc_calculate(packet->hw_radio_packet.data, packet->hw_radio_packet.length + 1 - 2));
+        uint16_t crc = __builtin_bswap16(crc_calculate(packet->hw_radio_packet->data, packet->hw_radio_packet->length + 1 - 2));
         memcpy(data_ptr, &crc, 2);
     }
 
 }
 
-void packet_disassemble(packet_t* packet)
+bool packet_parse(packet_t* packet)
 {
-    bool background_frame = (packet->hw_radio_packet.rx_meta.rx_cfg.syncword_class == PHY_SYNCWORD_CLASS0);
+    bool background_frame = (packet->hw_radio_packet->rx_meta.rx_cfg.syncword_class == PHY_SYNCWORD_CLASS0);
 
-    if (packet->hw_radio_packet.rx_meta.crc_status == HW_CRC_UNAVAILABLE)
+    if (packet->hw_radio_packet->rx_meta.crc_status == HW_CRC_UNAVAILABLE)
     {
-        uint16_t crc = __builtin_bswap16(crc_calculate(packet->hw_radio_packet.data, packet->hw_radio_packet.length + 1 - 2));
-        if(memcmp(&crc, packet->hw_radio_packet.data + packet->hw_radio_packet.length + 1 - 2, 2) != 0)
+        uint16_t crc = __builtin_bswap16(crc_calculate(packet->hw_radio_packet->data, packet->hw_radio_packet->length + 1 - 2));
+        if(memcmp(&crc, packet->hw_radio_packet->data + packet->hw_radio_packet->length + 1 - 2, 2) != 0)
         {
             DPRINT_DLL("CRC invalid");
-            goto cleanup;
+            return false;
         }
     }
-    else if (packet->hw_radio_packet.rx_meta.crc_status == HW_CRC_INVALID)
+    else if (packet->hw_radio_packet->rx_meta.crc_status == HW_CRC_INVALID)
     {
         DPRINT_DLL("CRC invalid");
-        goto cleanup;
+        return false;
     }
 
     uint8_t data_idx = 1;
 
     if(!dll_disassemble_packet_header(packet, &data_idx, background_frame))
-        goto cleanup;
+        return false;
 
     if (!background_frame)
     {
         if(!d7anp_disassemble_packet_header(packet, &data_idx))
-            goto cleanup;
+            return false;
 
         if(!d7atp_disassemble_packet_header(packet, &data_idx))
-            goto cleanup;
+            return false;
     }
     // TODO footers
 
-    // extract payload
-    packet->payload_length = packet->hw_radio_packet.length + 1 - data_idx - 2; // exclude the headers CRC bytes // TODO exclude footers
-    memcpy(packet->payload, packet->hw_radio_packet.data + data_idx, packet->payload_length);
-
-    DPRINT_FWK("Done disassembling packet");
+    // the payload is left in place in the frame
+    packet->payload_offset = data_idx;
+    packet->payload_length = packet->hw_radio_packet->length + 1 - data_idx - 2; // exclude the headers CRC bytes // TODO exclude footers
 
-    d7anp_process_received_packet(packet, background_frame);
+    return true;
+}
 
-    return;
+void packet_disassemble(packet_t* packet)
+{
+    bool background_frame = (packet->hw_radio_packet->rx_meta.rx_cfg.syncword_class == PHY_SYNCWORD_CLASS0);
 
-    cleanup:
+    if (!packet_parse(packet))
+    {
         DPRINT_FWK("Skipping packet");
         packet_queue_free_packet(packet);
         return;
+    }
+
+    DPRINT_FWK("Done disassembling packet");
+
+    d7anp_process_received_packet(packet, background_frame);
 }
@@ -62,21 +62,47 @@ struct packet
     uint8_t d7atp_target_rx_level_i;
     packet_type type;
     // TODO d7atp ack template
+    uint8_t payload_offset; // the payload is not copied out of the frame, it is stored at hw_radio_packet->data + payload_offset
     uint8_t payload_length;
-    uint8_t payload[239]; // TODO make max size configurable using cmake
-                            // TODO store payload here or only pointer to file where we need to fetch it? can we assume data will not be changed in between
 
-    hw_radio_packet_t hw_radio_packet; // TODO we might not need all metadata included in hw_radio_packet_t. If not copy needed data fields
-    uint8_t __data[255];    // reserves space for hw_radio_packet_t.data flexible array member,
-                            // do not use this directly but use hw_radio_packet_t.data instead, which contains the length byte
-                            // TODO configure max length from cmake
+    hw_radio_packet_t* hw_radio_packet; // the frame and its radio metadata, stored in a buffer of the packet queue pool
+                                        // which is sized for the frame (see packet_queue_alloc_rx_packet())
 };
 
 
+/*! \brief The maximum total size of the DLL (10 bytes), D7ANP (15 bytes) and D7ATP (8 bytes) headers */
+#define PACKET_MAX_HEADERS_SIZE 33
+
+/*! \brief The maximum length of a frame, excluding the length byte */
+#define PACKET_MAX_FRAME_SIZE 255
+
+/*! \brief The largest payload which fits in a frame with the largest possible headers, authentication tag (16 bytes) and CRC */
+#define PACKET_MAX_PAYLOAD_SIZE (PACKET_MAX_FRAME_SIZE - PACKET_MAX_HEADERS_SIZE - 16 - 2)
+
+/*! \brief The offset in the frame at which a new payload is written before the headers are known.
+ *
+ * Leaves room for the largest possible DLL, D7ANP and D7ATP headers, packet_assemble() moves the payload
+ * towards the headers when these are shorter.
+ */
+#define PACKET_TX_PAYLOAD_OFFSET (1 + PACKET_MAX_HEADERS_SIZE)
+
+/*! \brief Returns a pointer to the payload of the packet, which is stored in place in the frame */
+static inline uint8_t* packet_payload(packet_t* packet)
+{
+    return packet->hw_radio_packet->data + packet->payload_offset;
+}
+
 void packet_init(packet_t*);
 void packet_assemble(packet_t*);
 void packet_disassemble(packet_t*);
 
+/*! \brief Checks the CRC and parses the headers and payload of a received frame, without passing the packet to the upper layers.
+ *
+ * Used by packet_disassemble() and by benchmarks which need to decode the same frame repeatedly.
+ * \returns false when the frame is invalid or is filtered out by one of the layers
+ */
+bool packet_parse(packet_t*);
+
 #endif //OSS_7_PACKET_H
 
 /** @}*/
@@ -22,6 +22,8 @@
 #include "packet.h"
 #include "ng.h"
 #include "log.h"
+#include "hwatomic.h"
+#include <string.h>
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_D7AP_MISC_LOG_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_FWK, __VA_ARGS__)
@@ -35,135 +37,424 @@ typedef enum
     PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED,  /*! The element is allocated and passed to hwradio for filling */
     PACKET_QUEUE_ELEMENT_STATUS_RECEIVED,   /*! The element contains a successfully received packet, ready for further processing */
     PACKET_QUEUE_ELEMENT_STATUS_TRANSMITTED,/*! The element contains a successfully transmitted packet */
-    PACKET_QUEUE_ELEMENT_STATUS_PROCESSING  /*! Indicates the supplied packet is being processed */
+    PACKET_QUEUE_ELEMENT_STATUS_PROCESSING, /*! Indicates the supplied packet is being processed */
+    PACKET_QUEUE_ELEMENT_STATUS_COUNT
 } packet_queue_element_status_t;
 
+#if MODULE_D7AP_PACKET_QUEUE_SIZE >= 0xFF
+    #error the packet queue size should be smaller than 255
+#endif
+
+#define NO_ELEMENT 0xFF
+
+// Every element is linked in the list of its status, in the order the elements entered that status.
+// The lists are linked through the next/prev index of the element, so moving an element to another status is O(1)
+// and the received (and transmitted) packets are processed in the order they were received.
+typedef struct
+{
+    uint8_t head;
+    uint8_t tail;
+    uint8_t count;
+} element_list_t;
+
+typedef struct
+{
+    packet_queue_element_status_t status;
+    uint8_t next;
+    uint8_t prev;
+    bool tx; // allocated using packet_queue_alloc_packet()
+} element_t;
+
 static packet_t NGDEF(_packet_queue)[MODULE_D7AP_PACKET_QUEUE_SIZE];
 #define packet_queue NG(_packet_queue)
-static packet_queue_element_status_t NGDEF(_packet_queue_element_status)[MODULE_D7AP_PACKET_QUEUE_SIZE];
-#define packet_queue_element_status NG(_packet_queue_element_status)
+static element_t NGDEF(_elements)[MODULE_D7AP_PACKET_QUEUE_SIZE];
+#define elements NG(_elements)
+static element_list_t NGDEF(_element_lists)[PACKET_QUEUE_ELEMENT_STATUS_COUNT];
+#define element_lists NG(_element_lists)
+static packet_queue_stats_t NGDEF(_stats);
+#define stats NG(_stats)
+static uint8_t NGDEF(_tx_packet_count);
+#define tx_packet_count NG(_tx_packet_count)
 
-void packet_queue_init()
+// The frames are not stored in the packet_t itself but in a pool of buffers of different size classes,
+// so short frames (which are the majority) do not occupy a buffer large enough for the largest frame.
+// Frames to be transmitted always use a large buffer since their length is not known in advance.
+typedef enum
 {
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
+    BUFFER_CLASS_SMALL,
+    BUFFER_CLASS_MEDIUM,
+    BUFFER_CLASS_LARGE,
+    BUFFER_CLASS_COUNT
+} buffer_class_t;
+
+// the size of the data of the buffers of each class, including the length byte
+#define PACKET_BUFFER_SMALL_SIZE    64
+#define PACKET_BUFFER_MEDIUM_SIZE   128
+#define PACKET_BUFFER_LARGE_SIZE    256
+
+#if MODULE_D7AP_PACKET_BUFFER_SMALL_COUNT > 32 || MODULE_D7AP_PACKET_BUFFER_MEDIUM_COUNT > 32 || MODULE_D7AP_PACKET_BUFFER_LARGE_COUNT > 32
+    #error the number of packet buffers of a size class should not exceed 32
+#endif
+
+#if MODULE_D7AP_PACKET_BUFFER_LARGE_COUNT == 0
+    #error at least one large packet buffer is required for transmitting
+#endif
+
+// received frames may not take the last free large buffer, and not the last free packet as long as no packet is
+// allocated for transmitting a request. These are kept for transmitting so a burst of received frames can not prevent
+// the stack from responding or sending requests.
+#define RX_RESERVED_PACKETS         1
+#define RX_RESERVED_LARGE_BUFFERS   1
+
+#if MODULE_D7AP_PACKET_QUEUE_SIZE <= RX_RESERVED_PACKETS
+    #error the packet queue should contain at least 2 packets
+#endif
+
+typedef struct
+{
+    hw_radio_packet_t hw_radio_packet;
+    uint8_t __data[PACKET_BUFFER_SMALL_SIZE]; // reserves space for the hw_radio_packet_t.data flexible array member
+} small_buffer_t;
+
+typedef struct
+{
+    hw_radio_packet_t hw_radio_packet;
+    uint8_t __data[PACKET_BUFFER_MEDIUM_SIZE];
+} medium_buffer_t;
+
+typedef struct
+{
+    hw_radio_packet_t hw_radio_packet;
+    uint8_t __data[PACKET_BUFFER_LARGE_SIZE];
+} large_buffer_t;
+
+static const uint16_t buffer_class_size[BUFFER_CLASS_COUNT] = { PACKET_BUFFER_SMALL_SIZE, PACKET_BUFFER_MEDIUM_SIZE, PACKET_BUFFER_LARGE_SIZE };
+static const uint8_t buffer_class_count[BUFFER_CLASS_COUNT] = {
+    MODULE_D7AP_PACKET_BUFFER_SMALL_COUNT, MODULE_D7AP_PACKET_BUFFER_MEDIUM_COUNT, MODULE_D7AP_PACKET_BUFFER_LARGE_COUNT
+};
+
+static small_buffer_t NGDEF(_small_buffers)[MODULE_D7AP_PACKET_BUFFER_SMALL_COUNT];
+#define small_buffers NG(_small_buffers)
+static medium_buffer_t NGDEF(_medium_buffers)[MODULE_D7AP_PACKET_BUFFER_MEDIUM_COUNT];
+#define medium_buffers NG(_medium_buffers)
+static large_buffer_t NGDEF(_large_buffers)[MODULE_D7AP_PACKET_BUFFER_LARGE_COUNT];
+#define large_buffers NG(_large_buffers)
+
+// bitmap of the free buffers of each class
+static uint32_t NGDEF(_free_buffers)[BUFFER_CLASS_COUNT];
+#define free_buffers NG(_free_buffers)
+
+// the index of the element which owns each buffer, so the packet of a frame passed back by hwradio is found in O(1)
+static uint8_t NGDEF(_buffer_owners)[MODULE_D7AP_PACKET_BUFFER_SMALL_COUNT + MODULE_D7AP_PACKET_BUFFER_MEDIUM_COUNT + MODULE_D7AP_PACKET_BUFFER_LARGE_COUNT];
+#define buffer_owners NG(_buffer_owners)
+
+static hw_radio_packet_t* get_buffer(buffer_class_t buffer_class, uint8_t index)
+{
+    switch(buffer_class)
     {
-        packet_init(&(packet_queue[i]));
-        packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_FREE;
+        case BUFFER_CLASS_SMALL: return &(small_buffers[index].hw_radio_packet);
+        case BUFFER_CLASS_MEDIUM: return &(medium_buffers[index].hw_radio_packet);
+        default: return &(large_buffers[index].hw_radio_packet);
     }
 }
 
-packet_t* packet_queue_alloc_packet()
+static buffer_class_t get_buffer_class(hw_radio_packet_t* buffer, uint8_t* index)
 {
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
+    if((void*)buffer >= (void*)small_buffers && (void*)buffer < (void*)(small_buffers + MODULE_D7AP_PACKET_BUFFER_SMALL_COUNT))
+    {
+        *index = (small_buffer_t*)buffer - small_buffers;
+        return BUFFER_CLASS_SMALL;
+    }
+
+    if((void*)buffer >= (void*)medium_buffers && (void*)buffer < (void*)(medium_buffers + MODULE_D7AP_PACKET_BUFFER_MEDIUM_COUNT))
     {
-        if(packet_queue_element_status[i] == PACKET_QUEUE_ELEMENT_STATUS_FREE)
-        {
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED;
-            DPRINT("Packet queue alloc %p", &(packet_queue[i]));
-            return &(packet_queue[i]);
-        }
+        *index = (medium_buffer_t*)buffer - medium_buffers;
+        return BUFFER_CLASS_MEDIUM;
     }
 
-    assert(false); // should not happen, possible to small PACKET_QUEUE_SIZE or not always free()-ed correctly?
+    assert((void*)buffer >= (void*)large_buffers && (void*)buffer < (void*)(large_buffers + MODULE_D7AP_PACKET_BUFFER_LARGE_COUNT));
+    *index = (large_buffer_t*)buffer - large_buffers;
+    return BUFFER_CLASS_LARGE;
 }
 
-void packet_queue_free_packet(packet_t* packet)
+static uint8_t* get_buffer_owner(hw_radio_packet_t* buffer)
 {
-    DPRINT("Packet queue mark free %p", packet);
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
+    uint8_t index;
+    switch(get_buffer_class(buffer, &index))
     {
-        if(packet == &(packet_queue[i]))
-        {
-            assert(packet_queue_element_status[i] >= PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED);
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_FREE;
-            packet_init(&(packet_queue[i]));
-            return;
-        }
+        case BUFFER_CLASS_SMALL: return &(buffer_owners[index]);
+        case BUFFER_CLASS_MEDIUM: return &(buffer_owners[MODULE_D7AP_PACKET_BUFFER_SMALL_COUNT + index]);
+        default: return &(buffer_owners[MODULE_D7AP_PACKET_BUFFER_SMALL_COUNT + MODULE_D7AP_PACKET_BUFFER_MEDIUM_COUNT + index]);
     }
-
-    assert(false); // should never happen
 }
 
-packet_t* packet_queue_find_packet(hw_radio_packet_t* hw_radio_packet)
+// returns the smallest free buffer which can hold size bytes of data, or NULL if there is none.
+// For received frames the reserved large buffers are not used.
+static hw_radio_packet_t* alloc_buffer(uint16_t size, bool rx)
 {
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
+    hw_radio_packet_t* buffer = NULL;
+    start_atomic();
+    for(buffer_class_t buffer_class = BUFFER_CLASS_SMALL; buffer_class < BUFFER_CLASS_COUNT; buffer_class++)
     {
-        if(&(packet_queue[i].hw_radio_packet) == hw_radio_packet)
-            return &(packet_queue[i]);
+        if(buffer_class_size[buffer_class] < size || free_buffers[buffer_class] == 0)
+            continue;
+
+        if(rx && buffer_class == BUFFER_CLASS_LARGE && __builtin_popcount(free_buffers[buffer_class]) <= RX_RESERVED_LARGE_BUFFERS)
+            continue;
+
+        uint8_t index = __builtin_ctz(free_buffers[buffer_class]);
+        free_buffers[buffer_class] &= ~(1UL << index);
+        buffer = get_buffer(buffer_class, index);
+        break;
     }
+    end_atomic();
+
+    if(buffer != NULL)
+        memset(buffer, 0, sizeof(hw_radio_packet_t));
 
-    return NULL;
+    return buffer;
 }
 
-void packet_queue_mark_received(hw_radio_packet_t* hw_radio_packet)
+static void free_buffer(hw_radio_packet_t* buffer)
 {
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
-    {
-        if(&(packet_queue[i].hw_radio_packet) == hw_radio_packet)
-        {
-            assert(packet_queue_element_status[i] == PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED);
-            DPRINT("Packet queue mark received %p", &(packet_queue[i].hw_radio_packet));
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_RECEIVED;
-            return;
-        }
-    }
+    uint8_t index;
+    buffer_class_t buffer_class = get_buffer_class(buffer, &index);
+    start_atomic();
+    assert((free_buffers[buffer_class] & (1UL << index)) == 0);
+    free_buffers[buffer_class] |= (1UL << index);
+    end_atomic();
+}
 
-    assert(false);
+static uint8_t get_element_index(packet_t* packet)
+{
+    assert(packet >= packet_queue && packet < packet_queue + MODULE_D7AP_PACKET_QUEUE_SIZE);
+    return packet - packet_queue;
 }
 
-void packet_queue_mark_transmitted(hw_radio_packet_t* hw_radio_packet)
+// moves the element to the tail of the list of the new status, should be called in an atomic section
+static void set_element_status(uint8_t index, packet_queue_element_status_t status)
 {
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
-    {
-        if(&(packet_queue[i].hw_radio_packet) == hw_radio_packet)
-        {
-            assert(packet_queue_element_status[i] == PACKET_QUEUE_ELEMENT_STATUS_PROCESSING);
-            DPRINT("Packet queue mark transmitted %p", &(packet_queue[i].hw_radio_packet));
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_TRANSMITTED;
-            return;
-        }
-    }
+    element_t* element = &(elements[index]);
+    element_list_t* list = &(element_lists[element->status]);
 
-    assert(false);
+    // unlink from the list of the current status
+    if(element->prev == NO_ELEMENT)
+        list->head = element->next;
+    else
+        elements[element->prev].next = element->next;
+
+    if(element->next == NO_ELEMENT)
+        list->tail = element->prev;
+    else
+        elements[element->next].prev = element->prev;
+
+    list->count--;
+
+    // append to the list of the new status
+    list = &(element_lists[status]);
+    element->status = status;
+    element->next = NO_ELEMENT;
+    element->prev = list->tail;
+    if(list->tail == NO_ELEMENT)
+        list->head = index;
+    else
+        elements[list->tail].next = index;
+
+    list->tail = index;
+    list->count++;
 }
 
-packet_t* packet_queue_get_received_packet()
+void packet_queue_init()
 {
-    // note: we return the first found received packet, this may not be the oldest one
+    for(packet_queue_element_status_t status = PACKET_QUEUE_ELEMENT_STATUS_FREE; status < PACKET_QUEUE_ELEMENT_STATUS_COUNT; status++)
+        element_lists[status] = (element_list_t){ .head = NO_ELEMENT, .tail = NO_ELEMENT, .count = 0 };
+
     for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
     {
-        if(packet_queue_element_status[i] == PACKET_QUEUE_ELEMENT_STATUS_RECEIVED)
-            return &(packet_queue[i]);
+        packet_init(&(packet_queue[i]));
+        elements[i] = (element_t){
+            .status = PACKET_QUEUE_ELEMENT_STATUS_FREE,
+            .next = i + 1 < MODULE_D7AP_PACKET_QUEUE_SIZE ? i + 1 : NO_ELEMENT,
+            .prev = i > 0 ? i - 1 : NO_ELEMENT
+        };
     }
 
-    return NULL;
+    element_lists[PACKET_QUEUE_ELEMENT_STATUS_FREE] = (element_list_t){
+        .head = 0,
+        .tail = MODULE_D7AP_PACKET_QUEUE_SIZE - 1,
+        .count = MODULE_D7AP_PACKET_QUEUE_SIZE
+    };
+
+    for(buffer_class_t buffer_class = BUFFER_CLASS_SMALL; buffer_class < BUFFER_CLASS_COUNT; buffer_class++)
+        free_buffers[buffer_class] = buffer_class_count[buffer_class] == 32 ? UINT32_MAX : (1UL << buffer_class_count[buffer_class]) - 1;
+
+    tx_packet_count = 0;
+    packet_queue_reset_stats();
 }
 
-packet_t* packet_queue_get_transmitted_packet()
+static packet_t* alloc_packet(uint16_t buffer_size, bool rx)
 {
-    // note: we return the first found transmitted packet but it is not expected to find more than one entry
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
+    hw_radio_packet_t* buffer = alloc_buffer(buffer_size, rx);
+    if(buffer == NULL)
+    {
+        start_atomic();
+        stats.dropped_count++;
+        end_atomic();
+        return NULL;
+    }
+
+    packet_t* packet = NULL;
+    start_atomic();
+    uint8_t index = element_lists[PACKET_QUEUE_ELEMENT_STATUS_FREE].head;
+    if(rx && tx_packet_count == 0 && element_lists[PACKET_QUEUE_ELEMENT_STATUS_FREE].count <= RX_RESERVED_PACKETS)
+        index = NO_ELEMENT;
+
+    if(index != NO_ELEMENT)
+    {
+        set_element_status(index, PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED);
+        elements[index].tx = !rx;
+        if(!rx)
+            tx_packet_count++;
+
+        *get_buffer_owner(buffer) = index;
+        packet = &(packet_queue[index]);
+
+        uint8_t allocated_count = MODULE_D7AP_PACKET_QUEUE_SIZE - element_lists[PACKET_QUEUE_ELEMENT_STATUS_FREE].count;
+        if(allocated_count > stats.allocated_high_water_mark)
+            stats.allocated_high_water_mark = allocated_count;
+    }
+    else
+        stats.dropped_count++;
+
+    end_atomic();
+
+    if(packet == NULL)
     {
-        if(packet_queue_element_status[i] == PACKET_QUEUE_ELEMENT_STATUS_TRANSMITTED)
-            return &(packet_queue[i]);
+        free_buffer(buffer);
+        return NULL;
     }
 
-    return NULL;
+    packet->hw_radio_packet = buffer;
+    DPRINT("Packet queue alloc %p", packet);
+    return packet;
+}
+
+packet_t* packet_queue_alloc_packet()
+{
+    packet_t* packet = alloc_packet(PACKET_BUFFER_LARGE_SIZE, false);
+    assert(packet != NULL); // should not happen, possible to small PACKET_QUEUE_SIZE or not always free()-ed correctly?
+    return packet;
+}
+
+packet_t* packet_queue_alloc_rx_packet(uint16_t length)
+{
+    // the buffer has to fit the frame and the length byte
+    packet_t* packet = alloc_packet(length + 1, true);
+    if(packet == NULL)
+        DPRINT("Packet queue full, dropping received frame");
+
+    return packet;
+}
+
+void packet_queue_reserve_tx_buffer(packet_t* packet)
+{
+    uint8_t index;
+    if(get_buffer_class(packet->hw_radio_packet, &index) == BUFFER_CLASS_LARGE)
+        return;
+
+    // move the frame (and the metadata of the received frame) to a buffer which is large enough for any frame
+    hw_radio_packet_t* buffer = alloc_buffer(PACKET_BUFFER_LARGE_SIZE, false);
+    assert(buffer != NULL); // should not happen, possible to small PACKET_BUFFER_LARGE_COUNT?
+    memcpy(buffer, packet->hw_radio_packet, sizeof(hw_radio_packet_t) + packet->hw_radio_packet->length + 1);
+    *get_buffer_owner(buffer) = get_element_index(packet);
+    free_buffer(packet->hw_radio_packet);
+    packet->hw_radio_packet = buffer;
+}
+
+void packet_queue_free_packet(packet_t* packet)
+{
+    DPRINT("Packet queue mark free %p", packet);
+    uint8_t index = get_element_index(packet);
+    assert(elements[index].status != PACKET_QUEUE_ELEMENT_STATUS_FREE);
+    free_buffer(packet->hw_radio_packet);
+    packet_init(packet);
+    start_atomic();
+    if(elements[index].tx)
+        tx_packet_count--;
+
+    set_element_status(index, PACKET_QUEUE_ELEMENT_STATUS_FREE);
+    end_atomic();
+}
+
+packet_t* packet_queue_find_packet(hw_radio_packet_t* hw_radio_packet)
+{
+    uint8_t index = *get_buffer_owner(hw_radio_packet);
+    if(elements[index].status == PACKET_QUEUE_ELEMENT_STATUS_FREE || packet_queue[index].hw_radio_packet != hw_radio_packet)
+        return NULL;
+
+    return &(packet_queue[index]);
+}
+
+void packet_queue_mark_received(hw_radio_packet_t* hw_radio_packet)
+{
+    uint8_t index = *get_buffer_owner(hw_radio_packet);
+    assert(packet_queue[index].hw_radio_packet == hw_radio_packet);
+    assert(elements[index].status == PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED);
+    DPRINT("Packet queue mark received %p", hw_radio_packet);
+    start_atomic();
+    set_element_status(index, PACKET_QUEUE_ELEMENT_STATUS_RECEIVED);
+    if(element_lists[PACKET_QUEUE_ELEMENT_STATUS_RECEIVED].count > stats.received_high_water_mark)
+        stats.received_high_water_mark = element_lists[PACKET_QUEUE_ELEMENT_STATUS_RECEIVED].count;
+
+    end_atomic();
+}
+
+void packet_queue_mark_transmitted(hw_radio_packet_t* hw_radio_packet)
+{
+    uint8_t index = *get_buffer_owner(hw_radio_packet);
+    assert(packet_queue[index].hw_radio_packet == hw_radio_packet);
+    assert(elements[index].status == PACKET_QUEUE_ELEMENT_STATUS_PROCESSING);
+    DPRINT("Packet queue mark transmitted %p", hw_radio_packet);
+    start_atomic();
+    set_element_status(index, PACKET_QUEUE_ELEMENT_STATUS_TRANSMITTED);
+    end_atomic();
+}
+
+packet_t* packet_queue_get_received_packet()
+{
+    // the oldest received packet
+    uint8_t index = element_lists[PACKET_QUEUE_ELEMENT_STATUS_RECEIVED].head;
+    return index == NO_ELEMENT ? NULL : &(packet_queue[index]);
+}
+
+packet_t* packet_queue_get_transmitted_packet()
+{
+    uint8_t index = element_lists[PACKET_QUEUE_ELEMENT_STATUS_TRANSMITTED].head;
+    return index == NO_ELEMENT ? NULL : &(packet_queue[index]);
 }
 
 void packet_queue_mark_processing(packet_t* packet)
 {
     DPRINT("Packet queue mark processing %p", packet);
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
-    {
-        if(packet == &(packet_queue[i]))
-        {
-            assert(packet_queue_element_status[i] != PACKET_QUEUE_ELEMENT_STATUS_FREE);
+    uint8_t index = get_element_index(packet);
+    assert(elements[index].status != PACKET_QUEUE_ELEMENT_STATUS_FREE);
+    start_atomic();
+    set_element_status(index, PACKET_QUEUE_ELEMENT_STATUS_PROCESSING);
+    end_atomic();
+}
 
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_PROCESSING;
-            return;
-        }
-    }
+void packet_queue_get_stats(packet_queue_stats_t* queue_stats)
+{
+    start_atomic();
+    *queue_stats = stats;
+    queue_stats->allocated_count = MODULE_D7AP_PACKET_QUEUE_SIZE - element_lists[PACKET_QUEUE_ELEMENT_STATUS_FREE].count;
+    queue_stats->received_count = element_lists[PACKET_QUEUE_ELEMENT_STATUS_RECEIVED].count;
+    end_atomic();
+}
 
-    assert(false);
+void packet_queue_reset_stats()
+{
+    start_atomic();
+    stats = (packet_queue_stats_t){ 0 };
+    end_atomic();
 }
@@ -28,13 +28,32 @@
 
 #include "packet.h"
 
+/*! \brief Statistics of the packet queue, used to dimension MODULE_D7AP_PACKET_QUEUE_SIZE and the frame buffer pool */
+typedef struct
+{
+    uint8_t allocated_count;            /*! The number of packets currently in use */
+    uint8_t allocated_high_water_mark;  /*! The maximum number of packets in use at the same time */
+    uint8_t received_count;             /*! The number of received packets currently waiting to be processed */
+    uint8_t received_high_water_mark;   /*! The maximum number of received packets waiting to be processed at the same time */
+    uint16_t dropped_count;             /*! The number of packets which could not be allocated because no packet or frame buffer was free */
+} packet_queue_stats_t;
+
 /*! Initializes the packet queue */
 void packet_queue_init();
 
-/*! Returns the first free packet buffer in the queue and marks this as used until this is free()-ed again */
+/*! Returns the first free packet in the queue, with a frame buffer large enough for any frame, and marks this as used until this is free()-ed again */
 packet_t* packet_queue_alloc_packet();
 
-/*! Marks the packet buffer as free again */
+/*! Returns a free packet with the smallest free frame buffer which can hold a received frame of length bytes (excluding the length byte),
+ *  and marks this as used until this is free()-ed again. Returns NULL when the queue is full, the last free packet and large
+ *  frame buffer are kept for transmitting so the frame is dropped by the radio driver instead. */
+packet_t* packet_queue_alloc_rx_packet(uint16_t length);
+
+/*! Makes sure the frame buffer of the packet can hold any frame to be transmitted, by moving the frame to a large buffer if needed.
+ *  Used when a received packet is reused for transmitting the response */
+void packet_queue_reserve_tx_buffer(packet_t*);
+
+/*! Marks the packet and its frame buffer as free again */
 void packet_queue_free_packet(packet_t*);
 
 /*! Finds the packet_t corresponding to the supplied hw_radio_packet_t */
@@ -49,11 +68,19 @@ void packet_queue_mark_transmitted(hw_radio_packet_t*);
 /*! Indicates the supplied packet is being processed */
 void packet_queue_mark_processing(packet_t*);
 
-/*! Get a received packet for further processing. Returns NULL if no received packet queued. */
+/*! Get the oldest received packet for further processing. Returns NULL if no received packet queued. */
 packet_t* packet_queue_get_received_packet();
 
 /*! Get a transmitted packet for further processing. Returns NULL if no transmitted packet queued. */
 packet_t* packet_queue_get_transmitted_packet();
+
+/*! Returns the current statistics of the packet queue. The high-water marks and drop counter are kept since packet_queue_init()
+ *  or the last packet_queue_reset_stats() */
+void packet_queue_get_stats(packet_queue_stats_t* stats);
+
+/*! Resets the high-water marks and the drop counter */
+void packet_queue_reset_stats();
+
 #endif //OSS_7_PACKET_QUEUE_H
 
 /** @}*/
@@ -26,7 +26,7 @@
  * correctly implemented AES-ECB, AES-CBC, AES-CTR and AES-CCM mode. All the
  * test vectors use AES with a 128 bit key;
  *
- * The AES-ECB, AES-CBC, AES-CBC-MAC modes are implicitly tested through the
+ * The AES-CBC, AES-CBC-MAC modes are implicitly tested through the
  * testing of the AES-CTR and AES-CCM mode
  */
 
@@ -44,6 +44,41 @@ void print_array(uint8_t* buffer, uint8_t length)
     printf("\n");
 }
 
+/*
+ * AES-ECB test vectors from:
+ *
+ * National Institute of Standards and Technology Special Publication 800-38A 2001 ED
+ */
+
+#define ECB_TEST_VECTORS_NB 4
+
+static const uint8_t ecb_key[AES_BLOCK_SIZE] = {
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+    0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+static const uint8_t ecb_pt[ECB_TEST_VECTORS_NB][AES_BLOCK_SIZE] = {
+    { 0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+      0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A },
+    { 0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+      0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51 },
+    { 0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11,
+      0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF },
+    { 0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17,
+      0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10 }
+};
+
+static const uint8_t ecb_ct[ECB_TEST_VECTORS_NB][AES_BLOCK_SIZE] = {
+    { 0x3A, 0xD7, 0x7B, 0xB4, 0x0D, 0x7A, 0x36, 0x60,
+      0xA8, 0x9E, 0xCA, 0xF3, 0x24, 0x66, 0xEF, 0x97 },
+    { 0xF5, 0xD3, 0xD5, 0x85, 0x03, 0xB9, 0x69, 0x9D,
+      0xE7, 0x85, 0x89, 0x5A, 0x96, 0xFD, 0xBA, 0xAF },
+    { 0x43, 0xB1, 0xCD, 0x7F, 0x59, 0x8E, 0xCE, 0x23,
+      0x88, 0x1B, 0x00, 0xE3, 0xED, 0x03, 0x06, 0x88 },
+    { 0x7B, 0x0C, 0x78, 0x5E, 0x27, 0xE8, 0xAD, 0x3F,
+      0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5D, 0xD4 }
+};
+
 /*
  * AES-CCM test vectors from:
  *
@@ -213,6 +248,7 @@ int main(int argc, char *argv[])
     error_t ret;
     uint8_t ctr[AES_BLOCK_SIZE];
     uint8_t payload[AES_BLOCK_SIZE * 3];
+    aes_ctx_t ctx;
 
     DPRINT("Unit-tests for AES-CTR / AES-CCM mode \n");
 
@@ -220,15 +256,41 @@ int main(int argc, char *argv[])
     // TODO set a minimal platform configuration to enable the AES hardware module
 #endif
 
+    /* test AES-ECB mode, the block cipher itself */
+    AES128_init(&ctx, ecb_key);
+
+    for (i = 0; i < ECB_TEST_VECTORS_NB; i++)
+    {
+        AES128_ECB_encrypt(&ctx, (uint8_t *)ecb_pt[i], payload);
+        if (memcmp(payload, ecb_ct[i], AES_BLOCK_SIZE) != 0)
+        {
+            DPRINT("AES-ECB encryption output \n");
+            DPRINT_DATA(payload, AES_BLOCK_SIZE);
+            DPRINT("AES-ECB encryption #%d failed\n", i + 1);
+            return -1;
+        }
+
+        AES128_ECB_decrypt(&ctx, (uint8_t *)ecb_ct[i], payload);
+        if (memcmp(payload, ecb_pt[i], AES_BLOCK_SIZE) != 0)
+        {
+            DPRINT("AES-ECB decryption output \n");
+            DPRINT_DATA(payload, AES_BLOCK_SIZE);
+            DPRINT("AES-ECB decryption #%d failed\n", i + 1);
+            return -1;
+        }
+
+        DPRINT("AES-ECB test vector #%d passed\n", i + 1);
+    }
+
     /* test AES-CTR mode*/
     for (i = 0; i < CTR_TEST_VECTORS_NB; i++)
     {
-        AES128_init(ctr_key[i]);
+        AES128_init(&ctx, ctr_key[i]);
 
         memcpy(payload, ctr_pt[i], ctr_len[i]);
         memcpy(ctr, ctr_blk[i], AES_BLOCK_SIZE);
 
-        AES128_CTR_encrypt(payload, payload, ctr_len[i], ctr);
+        AES128_CTR_encrypt(&ctx, payload, payload, ctr_len[i], ctr);
         if (memcmp(payload, ctr_ct[i], ctr_len[i] ) != 0)
         {
             DPRINT("AES-CTR encryption output \n");
@@ -240,7 +302,7 @@ int main(int argc, char *argv[])
         /* ctr has been incremented by the previous encryption, recover the original ctr block */
         memcpy(ctr, ctr_blk[i], AES_BLOCK_SIZE);
 
-        AES128_CTR_encrypt(payload, payload, ctr_len[i], ctr);
+        AES128_CTR_encrypt(&ctx, payload, payload, ctr_len[i], ctr);
         if (memcmp(payload, ctr_pt[i], ctr_len[i]) != 0)
         {
             DPRINT("AES-CTR encryption output \n");
@@ -253,7 +315,7 @@ int main(int argc, char *argv[])
     }
 
     // The key is the same for all the ccm test vectors */
-    AES128_init(ccm_key);
+    AES128_init(&ctx, ccm_key);
 
     /* test AES-CCM mode*/
     for (i = 0; i < CCM_TEST_VECTORS_NB; i++)
@@ -262,7 +324,7 @@ int main(int argc, char *argv[])
         memcpy(ctr, ccm_ctr[i], AES_BLOCK_SIZE);
 
         // the auth_len is always set to 32 bits
-        ret = AES128_CCM_encrypt(payload, ccm_len[i], ccm_iv[i], ad, add_len[i],
+        ret = AES128_CCM_encrypt(&ctx, payload, ccm_len[i], ccm_iv[i], ad, add_len[i],
                                  ctr, CCM_AUTH_LEN);
         if (ret != 0 || memcmp(payload, ccm_ct[i], ccm_len[i] + CCM_AUTH_LEN) != 0)
         {
@@ -275,7 +337,7 @@ int main(int argc, char *argv[])
         /* ctr has been incremented by the previous encryption, recover the original ctr block */
         memcpy(ctr, ccm_ctr[i], AES_BLOCK_SIZE);
 
-        ret = AES128_CCM_decrypt(payload, ccm_len[i], ccm_iv[i], ad, add_len[i],
+        ret = AES128_CCM_decrypt(&ctx, payload, ccm_len[i], ccm_iv[i], ad, add_len[i],
                                  ctr, payload + ccm_len[i], CCM_AUTH_LEN);
         if (ret != 0 || memcmp(payload, ccm_pt + ccm_offset[i], ccm_len[i]) != 0)
         {
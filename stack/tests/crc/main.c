@@ -0,0 +1,170 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2016 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "crc.h"
+#include "framework_defs.h"
+
+/*
+ * This unit-test application checks the CRC implementation selected by the FRAMEWORK_CRC_IMPLEMENTATION CMake
+ * property (BITWISE, TABLE or SLICING_BY_4), so it has to be built and run once for each of them.
+ *
+ * The CRC is checked against known check values and against a bitwise reference for all lengths up to
+ * MAX_LENGTH, calculated in one go and split over several crc_update() calls: in chunks of 1 to 7 bytes, at every
+ * split point of the lengths below MAX_SPLIT_LENGTH, and starting at an unaligned address, so the 4 bytes steps of
+ * SLICING_BY_4 are crossed by the splits in every possible way.
+ */
+
+#define MAX_LENGTH 600
+#define MAX_SPLIT_LENGTH 64
+
+#define STRINGIFY2(x) #x
+#define STRINGIFY(x) STRINGIFY2(x)
+
+// CRC-CCITT check values: polynomial 0x1021, initial value 0xFFFF, no final XOR
+static const struct
+{
+    const char* data;
+    uint16_t length;
+    uint16_t crc;
+} check_values[] = {
+    { "", 0, 0xFFFF },
+    { "A", 1, 0xB915 },
+    { "123456789", 9, 0x29B1 },
+    { "\xFF\xFF\xFF\xFF", 4, 0x1D0F },
+    { "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+      "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", 32, 0xF14C },
+};
+
+// the input data, with room to start at an unaligned address
+static uint8_t buffer[MAX_LENGTH + 3];
+
+// one bit at a time, following the definition of the CRC
+static uint16_t reference_crc(const uint8_t* data, uint16_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    while(length--)
+    {
+        crc ^= *data++ << 8;
+        for(uint8_t bit = 0; bit < 8; bit++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+    return crc;
+}
+
+static uint16_t crc_in_chunks(const uint8_t* data, uint16_t length, uint16_t chunk_length)
+{
+    uint16_t crc = crc_init();
+
+    for(uint16_t offset = 0; offset < length; offset += chunk_length)
+        crc = crc_update(crc, data + offset, length - offset < chunk_length ? length - offset : chunk_length);
+
+    return crc_final(crc);
+}
+
+static int test_check_values()
+{
+    uint8_t data[32];
+
+    for(uint8_t i = 0; i < sizeof(check_values) / sizeof(check_values[0]); i++)
+    {
+        memcpy(data, check_values[i].data, check_values[i].length);
+        uint16_t crc = crc_calculate(data, check_values[i].length);
+        if(crc != check_values[i].crc)
+        {
+            printf("The CRC of check value #%d is 0x%04X instead of 0x%04X\n", i + 1, crc, check_values[i].crc);
+            return -1;
+        }
+    }
+
+    // 0..255
+    for(uint16_t i = 0; i < 256; i++)
+        buffer[i] = i;
+
+    if(crc_calculate(buffer, 256) != 0x3FBD)
+    {
+        printf("The CRC of the bytes 0 to 255 is 0x%04X instead of 0x3FBD\n", crc_calculate(buffer, 256));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int test_reference()
+{
+    uint32_t random_state = 0x12345678;
+
+    for(uint16_t i = 0; i < sizeof(buffer); i++)
+    {
+        // xorshift32
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        buffer[i] = random_state;
+    }
+
+    for(uint8_t start = 0; start < 4; start++)
+    {
+        uint8_t* data = buffer + start;
+
+        for(uint16_t length = 0; length < MAX_LENGTH; length++)
+        {
+            uint16_t expected = reference_crc(data, length);
+
+            if(crc_calculate(data, length) != expected)
+            {
+                printf("The CRC of %d bytes at offset %d differs from the reference\n", length, start);
+                return -1;
+            }
+
+            for(uint16_t chunk_length = 1; chunk_length < 8; chunk_length++)
+            {
+                if(crc_in_chunks(data, length, chunk_length) != expected)
+                {
+                    printf("The CRC of %d bytes at offset %d in chunks of %d bytes differs from the reference\n",
+                           length, start, chunk_length);
+                    return -1;
+                }
+            }
+
+            for(uint16_t split = 0; split <= length && length < MAX_SPLIT_LENGTH; split++)
+            {
+                uint16_t crc = crc_update(crc_init(), data, split);
+                if(crc_final(crc_update(crc, data + split, length - split)) != expected)
+                {
+                    printf("The CRC of %d bytes at offset %d split after %d bytes differs from the reference\n",
+                           length, start, split);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main()
+{
+    if(test_check_values() != 0 || test_reference() != 0)
+        return -1;
+
+    printf("CRC (" STRINGIFY(FRAMEWORK_CRC_IMPLEMENTATION) ") all unit tests OK !\n");
+    return 0;
+}
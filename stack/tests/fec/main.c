@@ -3,10 +3,20 @@
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <math.h>
 #include "fec.h"
+#include "reference_fec.h"
 
 #define BINARY 0
 
+#define SOFT_TEST_FRAMES 2000
+#define SOFT_TEST_FRAME_LENGTH 32
+
+#define REFERENCE_TEST_FRAMES 20000
+
+#define BATCH_TEST_FRAMES 100
+#define BATCH_TEST_ROUNDS 200
+
 
 const char *byte_to_binary(uint8_t x)
 {
@@ -22,6 +32,25 @@ const char *byte_to_binary(uint8_t x)
     return b;
 }
 
+void print_array(uint8_t* buffer, uint8_t length, uint8_t binary)
+{
+	int i = 0;
+	for (; i < length; i++)
+	{
+	    printf("%02X", buffer[i]);
+	}
+
+	if (binary)
+	{
+		printf(" ");
+
+		for (i = 0; i < length; i++)
+		{
+			printf("%s", byte_to_binary(buffer[i]));
+		}
+	}
+}
+
 unsigned char Partab[] = { 0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0
 ,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1
 ,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,};
@@ -82,6 +111,220 @@ void test_interleaver()
 
 }
 
+// all path costs have to be reduced by the minimum cost after every decoded byte. When the states above the state with
+// the minimum cost kept their cost, this frame with 2 bit errors was not recovered.
+int test_normalization()
+{
+	uint8_t input[] = {0xA5, 0xBC};
+	uint8_t encoded[8];
+
+	memcpy(encoded, input, sizeof(input));
+	uint16_t encoded_length = fec_encode(encoded, sizeof(input));
+	encoded[1] ^= 0x80;
+	encoded[3] ^= 0x80;
+
+	fec_decode_packet(encoded, encoded_length, encoded_length);
+	if (memcmp(input, encoded, sizeof(input)) != 0)
+	{
+		printf("Viterbi cost normalization failed\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+// gaussian noise with unit variance (Box-Muller)
+double gaussian_noise()
+{
+	double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979323846 * u2);
+}
+
+// sends random frames over a simulated BPSK/AWGN channel and counts the frames the hard and soft decision decoders
+// fail to recover
+void compare_hard_soft(double ebn0_db, int* hard_errors, int* soft_errors)
+{
+	uint8_t input[SOFT_TEST_FRAME_LENGTH];
+	uint8_t encoded[2 * SOFT_TEST_FRAME_LENGTH + 8];
+	uint8_t received[sizeof(encoded)];
+	uint8_t decoded[sizeof(encoded)];
+	uint8_t soft[sizeof(encoded) * 8];
+	// rate 1/2 code: the energy per encoded bit is half the energy per data bit
+	double sigma = sqrt(1.0 / (2.0 * 0.5 * pow(10.0, ebn0_db / 10.0)));
+	int frame, i, b;
+
+	*hard_errors = 0;
+	*soft_errors = 0;
+
+	for (frame = 0; frame < SOFT_TEST_FRAMES; frame++)
+	{
+		for (i = 0; i < SOFT_TEST_FRAME_LENGTH; i++)
+			input[i] = rand();
+
+		memcpy(encoded, input, SOFT_TEST_FRAME_LENGTH);
+		uint16_t encoded_length = fec_encode(encoded, SOFT_TEST_FRAME_LENGTH);
+
+		for (i = 0; i < encoded_length; i++)
+		{
+			received[i] = 0;
+			for (b = 7; b >= 0; b--)
+			{
+				double sample = (((encoded[i] >> b) & 1) ? 1.0 : -1.0) + sigma * gaussian_noise();
+				received[i] |= (sample > 0) << b;
+
+				// quantize -1 .. 1 to 0 .. FEC_SOFT_MAX
+				int value = (int) lround((sample + 1.0) * FEC_SOFT_MAX / 2.0);
+				soft[i * 8 + 7 - b] = value < 0 ? 0 : (value > FEC_SOFT_MAX ? FEC_SOFT_MAX : value);
+			}
+		}
+
+		fec_decode_packet(received, encoded_length, sizeof(received));
+		if (memcmp(input, received, SOFT_TEST_FRAME_LENGTH) != 0)
+			(*hard_errors)++;
+
+		fec_decode_packet_soft(soft, decoded, encoded_length, sizeof(decoded));
+		if (memcmp(input, decoded, SOFT_TEST_FRAME_LENGTH) != 0)
+			(*soft_errors)++;
+	}
+}
+
+// encodes and decodes frames of random lengths with random bit errors and checks the results against the original
+// implementation in reference_fec.c
+int test_reference()
+{
+	uint8_t encoded[255];
+	uint8_t reference[255];
+	uint8_t soft[255 * 8];
+	uint8_t decoded[255];
+	int frame, i;
+
+	for (frame = 0; frame < REFERENCE_TEST_FRAMES; frame++)
+	{
+		int length = 1 + rand() % 120;
+		for (i = 0; i < length; i++)
+			encoded[i] = rand();
+
+		memcpy(reference, encoded, length);
+		uint16_t encoded_length = fec_encode(encoded, length);
+		if (reference_fec_encode(reference, length) != encoded_length || memcmp(encoded, reference, encoded_length) != 0)
+		{
+			printf("Encoding differs from the reference for a frame of %d bytes\n", length);
+			return 1;
+		}
+
+		for (i = rand() % 16; i > 0; i--)
+		{
+			int bit = rand() % (encoded_length * 8);
+			encoded[bit / 8] ^= 1 << (bit % 8);
+		}
+
+		// soft values without any uncertainty, for which the soft decoder should decide the same as the hard decoder
+		for (i = 0; i < encoded_length * 8; i++)
+			soft[i] = ((encoded[i / 8] >> (7 - i % 8)) & 1) ? FEC_SOFT_MAX : 0;
+
+		memcpy(reference, encoded, encoded_length);
+		uint8_t decoded_length = fec_decode_packet(encoded, encoded_length, encoded_length);
+		// the bytes behind the frame are the decoded trellis terminator, which the reference does not output
+		if (reference_fec_decode_packet(reference, encoded_length, encoded_length) != decoded_length
+				|| memcmp(encoded, reference, length) != 0)
+		{
+			printf("Decoding differs from the reference for a frame of %d bytes\n", encoded_length);
+			return 1;
+		}
+
+		if (fec_decode_packet_soft(soft, decoded, encoded_length, encoded_length) != decoded_length
+				|| memcmp(decoded, reference, length) != 0)
+		{
+			printf("Soft decision decoding differs from the reference for a frame of %d bytes\n", encoded_length);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+#ifdef FRAMEWORK_FEC_BATCH_ENABLED
+// decodes frames of random lengths with random bit errors with the batch decoder and checks the results against
+// the reference decoder, then measures the throughput of the batch decoder and fec_decode_packet()
+int test_batch()
+{
+	static uint8_t reference[BATCH_TEST_FRAMES][255];
+	static uint8_t batch[BATCH_TEST_FRAMES][255];
+	uint8_t* frames[BATCH_TEST_FRAMES];
+	uint8_t lengths[BATCH_TEST_FRAMES];
+	uint8_t packet_lengths[BATCH_TEST_FRAMES];
+	uint8_t decoded_lengths[BATCH_TEST_FRAMES];
+	int round, frame, i;
+
+	for (round = 0; round < BATCH_TEST_ROUNDS; round++)
+	{
+		int count = 1 + rand() % BATCH_TEST_FRAMES;
+		for (frame = 0; frame < count; frame++)
+		{
+			lengths[frame] = 1 + rand() % 120;
+			for (i = 0; i < lengths[frame]; i++)
+				reference[frame][i] = rand();
+
+			packet_lengths[frame] = reference_fec_encode(reference[frame], lengths[frame]);
+			for (i = rand() % 8; i > 0; i--)
+			{
+				int bit = rand() % (packet_lengths[frame] * 8);
+				reference[frame][bit / 8] ^= 1 << (bit % 8);
+			}
+
+			memcpy(batch[frame], reference[frame], packet_lengths[frame]);
+			frames[frame] = batch[frame];
+		}
+
+		fec_decode_packet_batch(frames, packet_lengths, decoded_lengths, count);
+
+		for (frame = 0; frame < count; frame++)
+		{
+			uint8_t length = reference_fec_decode_packet(reference[frame], packet_lengths[frame], packet_lengths[frame]);
+			if (length != decoded_lengths[frame] || memcmp(reference[frame], batch[frame], lengths[frame]) != 0)
+			{
+				printf("Batch decoding differs from the reference for a frame of %d bytes\n", packet_lengths[frame]);
+				return 1;
+			}
+		}
+	}
+
+	uint8_t pn9[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	const uint8_t pn9_expected[8] = {0xFF, 0xE1, 0x1D, 0x9A, 0xED, 0x85, 0x33, 0x24};
+	fec_pn9(pn9, sizeof(pn9));
+	if (memcmp(pn9, pn9_expected, sizeof(pn9)) != 0)
+	{
+		printf("Unexpected PN9 sequence\n");
+		return 1;
+	}
+
+	for (frame = 0; frame < BATCH_TEST_FRAMES; frame++)
+	{
+		frames[frame] = batch[frame];
+		packet_lengths[frame] = 64;
+	}
+
+	clock_t start = clock();
+	for (round = 0; round < BATCH_TEST_ROUNDS * 10; round++)
+		fec_decode_packet_batch(frames, packet_lengths, decoded_lengths, BATCH_TEST_FRAMES);
+
+	double batch_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	start = clock();
+	for (round = 0; round < BATCH_TEST_ROUNDS * 10; round++)
+		for (frame = 0; frame < BATCH_TEST_FRAMES; frame++)
+			fec_decode_packet(batch[frame], 64, 64);
+
+	double scalar_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	printf("Frames of 64 encoded bytes decoded per second, batch / scalar: %.0f / %.0f\n",
+		   BATCH_TEST_ROUNDS * 10 * BATCH_TEST_FRAMES / batch_time, BATCH_TEST_ROUNDS * 10 * BATCH_TEST_FRAMES / scalar_time);
+
+	return 0;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
 	//test_interleaver();
@@ -115,6 +358,44 @@ int main(int argc, char *argv[])
 	print_array(decoded, length_decoded, BINARY);
 	printf("\n");
 
+	if (memcmp(input, decoded, input_length) != 0)
+	{
+		printf("Hard decision decoding failed\n");
+		return 1;
+	}
+
+	uint8_t soft[255 * 8];
+	int i;
+	for (i = 0; i < lenght_encoded * 8; i++)
+		soft[i] = ((encoded[i / 8] >> (7 - i % 8)) & 1) ? FEC_SOFT_MAX : 0;
+
+	if (fec_decode_packet_soft(soft, decoded, lenght_encoded, 255) != length_decoded || memcmp(input, decoded, input_length) != 0)
+	{
+		printf("Soft decision decoding failed\n");
+		return 1;
+	}
+
+	if (test_normalization() != 0)
+		return 1;
+
+	printf("Frame error rate of %d frames of %d bytes, hard / soft decision:\n", SOFT_TEST_FRAMES, SOFT_TEST_FRAME_LENGTH);
+	srand(0);
+	double ebn0_db;
+	for (ebn0_db = 2.0; ebn0_db <= 7.0; ebn0_db += 1.0)
+	{
+		int hard_errors, soft_errors;
+		compare_hard_soft(ebn0_db, &hard_errors, &soft_errors);
+		printf(" Eb/N0 %.1f dB: %5.1f%% / %5.1f%%\n", ebn0_db, hard_errors * 100.0 / SOFT_TEST_FRAMES, soft_errors * 100.0 / SOFT_TEST_FRAMES);
+	}
+
+	if (test_reference() != 0)
+		return 1;
+
+#ifdef FRAMEWORK_FEC_BATCH_ENABLED
+	if (test_batch() != 0)
+		return 1;
+#endif
+
 	int nr_errors = 1;
 	int notrecovered = 0;
 	srand(time(NULL));
@@ -1,4 +1,4 @@
-/*! \file fec.c
+/*! \file reference_fec.c
  *
  *  \copyright (C) Copyright 2015 University of Antwerp and others (http://oss-7.cosys.be)
  *
@@ -20,6 +20,12 @@
  *
  */
 
+/*
+ * The FEC implementation as it was before the encoder and decoder of the framework were reworked, kept as an
+ * independent reference for tests/fec. Apart from its symbol names and debug output, the only change is the fix
+ * of the Viterbi cost normalization which was also applied to the framework decoder.
+ */
+
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -27,7 +33,7 @@
 #include <stdint.h>
 #include <string.h>
 
-#include "fec.h"
+#include "reference_fec.h"
 
 #define INITIAL_FECSTATE 0x00
 #define TRELLIS_TERMINATOR 0x0B
@@ -37,6 +43,19 @@
 
 //#ifdef D7_PHY_USE_FEC
 
+typedef struct {
+	uint8_t cost;
+	uint16_t path;
+} VITERBIPATH;
+
+typedef struct {
+	uint8_t path_size;
+	VITERBIPATH* old;
+	VITERBIPATH* new;
+	VITERBIPATH states1[8];
+	VITERBIPATH states2[8];
+} VITERBISTATE;
+
 const static uint8_t fec_lut[16] = {0, 3, 1, 2, 3, 0, 2, 1, 3, 0, 2, 1, 0, 3, 1, 2};
 const static uint8_t trellis0_lut[8] = {0, 1, 3, 2, 3, 2, 0, 1};
 const static uint8_t trellis1_lut[8] = {3, 2, 0, 1, 0, 1, 3, 2};
@@ -59,67 +78,9 @@ static VITERBISTATE vstate;
 static bool fec_decode(uint8_t* input);
 
 #define DPRINT(...) printf(__VA_ARGS__)
-#define DPRINT_DATA(...) print_array(__VA_ARGS__)
-
-void print_array(uint8_t* buffer, uint8_t length, uint8_t binary)
-{
-	int i = 0;
-	for (; i < length; i++)
-	{
-	    printf("%02X", buffer[i]);
-	}
-
-	if (binary)
-	{
-		printf(" ");
-
-		for (i = 0; i < length; i++)
-		{
-			printf("%s", byte_to_binary(buffer[i]));
-		}
-	}
-}
-
-const char *int_to_binary(uint16_t x)
-{
-    static char b[17];
-    b[0] = '\0';
-
-    uint16_t z;
-    for (z = 0x8000; z > 0; z >>= 1)
-    {
-        strcat(b, ((x & z) == z) ? "1" : "0");
-    }
-
-    return b;
-}
-
-static void print_vstate()
-{
-//	typedef struct {
-//		uint8_t cost;
-//		uint16_t path;
-//	} VITERBIPATH;
-//	typedef struct {
-//		uint8_t path_size;
-//		VITERBIPATH* old;
-//		VITERBIPATH* new;
-//		VITERBIPATH states1[8];
-//		VITERBIPATH states2[8];
-//	} VITERBISTATE;
-
-	printf("VSTATE:\n");
-	printf(" - path_size: %d\n", vstate.path_size);
-	//printf(" - old: %03d - %s\n", vstate.old->cost, int_to_binary(vstate.old->path));
-	//printf(" - new: %03d - %s\n", vstate.new->cost, int_to_binary(vstate.new->path));
-	int i;
-	for (i=0;i<8;i++)
-		printf(" - states - %d: %03d - %s\n", i, vstate.old[i].cost, int_to_binary(vstate.old[i].path));
-
-}
 
 /* Convolutional encoder */
-uint16_t fec_encode(uint8_t *data, uint16_t nbytes)
+uint16_t reference_fec_encode(uint8_t *data, uint16_t nbytes)
 {
 	memcpy(data_buffer, data, nbytes);
 	uint8_t *input = data_buffer;
@@ -203,7 +164,7 @@ uint16_t fec_encode(uint8_t *data, uint16_t nbytes)
 	return length;
 }
 
-uint8_t fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_length)
+uint8_t reference_fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_length)
 {
 	uint8_t* output = data_buffer;
 	if(output_length < packet_length)
@@ -373,8 +334,9 @@ static bool fec_decode(uint8_t* input)
 			}
 
 	        //Normalize costs
-			if (vstate.old[min_state].cost > 0)
-				for (j = 0; j < 8; j++) vstate.old[j].cost -= vstate.old[min_state].cost;
+			uint8_t min_cost = vstate.old[min_state].cost;
+			if (min_cost > 0)
+				for (j = 0; j < 8; j++) vstate.old[j].cost -= min_cost;
 
 			*output_buffer++ = vstate.old[min_state].path >> 8;
 			vstate.path_size--;
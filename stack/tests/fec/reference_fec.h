@@ -1,4 +1,4 @@
-/*! \file fec.h
+/*! \file reference_fec.h
  *
  *  \copyright (C) Copyright 2015 University of Antwerp and others (http://oss-7.cosys.be)
  *
@@ -20,8 +20,8 @@
  *
  */
 
-#ifndef FEC_H_
-#define FEC_H_
+#ifndef REFERENCE_FEC_H_
+#define REFERENCE_FEC_H_
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,27 +30,14 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 
-typedef struct {
-	uint8_t cost;
-	uint16_t path;
-} VITERBIPATH;
+/*! \brief Encodes the data in place with the original FEC encoder, returns the encoded length */
+uint16_t reference_fec_encode(uint8_t *data, uint16_t nbytes);
 
-typedef struct {
-	uint8_t path_size;
-	VITERBIPATH* old;
-	VITERBIPATH* new;
-	VITERBIPATH states1[8];
-	VITERBIPATH states2[8];
-} VITERBISTATE;
-
-void print_array(uint8_t* buffer, uint8_t length, uint8_t binary);
-
-uint16_t fec_encode(uint8_t *data, uint16_t nbytes);
-uint8_t fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_length);
-uint16_t fec_calculated_decoded_length(uint8_t packet_length);
+/*! \brief Decodes the packet in place with the original hard decision Viterbi decoder, returns the decoded length */
+uint8_t reference_fec_decode_packet(uint8_t* data, uint8_t packet_length, uint8_t output_length);
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif /* FEC_H_ */
+#endif /* REFERENCE_FEC_H_ */
@@ -0,0 +1,384 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2016 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fs.h"
+#include "MODULE_D7AP_defs.h"
+
+/*
+ * This unit-test application checks the allocation of user files created, deleted and resized at runtime against a
+ * model of the filesystem. After every operation all user files have to hold their expected content, and an
+ * allocation only fails when the free space (the space left by the system files minus the user files) is too small,
+ * so the holes are reused, merged and recovered by compaction correctly.
+ *
+ * The directed tests fragment the filesystem on purpose: adjacent holes which have to be merged, more holes than the
+ * filesystem remembers, and files which grow in place or by moving the files behind them. The random test runs a
+ * long sequence of operations with a fixed seed.
+ */
+
+#define FIRST_FILE_ID 0x40
+#define FILE_COUNT (MODULE_D7AP_FS_FILE_COUNT - FIRST_FILE_ID)
+#define MAX_FILE_LENGTH 128
+#define RANDOM_OPERATIONS 100000
+#define RANDOM_MAX_FILE_LENGTH 64
+
+// the number of holes which are remembered by the filesystem
+#define FREE_EXTENT_COUNT 8
+
+// the firmware version file refers to the version of the application
+const char _GIT_SHA1[] = "0000000";
+const char _APP_NAME[] = "fs_alloc";
+
+typedef struct
+{
+    uint8_t length; // 0 when the file does not exist
+    uint8_t content[MAX_FILE_LENGTH];
+} file_model_t;
+
+static file_model_t files[FILE_COUNT];
+
+// the number of bytes available for user files, and the number of bytes used by them
+static uint16_t capacity;
+static uint16_t used;
+
+static uint32_t random_state = 1;
+static uint32_t operation_count;
+
+static uint32_t next_random()
+{
+    // xorshift32
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void init_fs()
+{
+    dae_access_profile_t access_profiles[1] = {
+        {
+            .channel_header = {
+                .ch_coding = PHY_CODING_PN9,
+                .ch_class = PHY_CLASS_NORMAL_RATE,
+                .ch_freq_band = PHY_BAND_868
+            },
+            .subprofiles[0] = {
+                .subband_bitmap = 0x01,
+                .scan_automation_period = 0,
+            },
+            .subbands[0] = (subband_t){
+                .channel_index_start = 0,
+                .channel_index_end = 0,
+                .eirp = 10,
+                .cca = -86,
+                .duty = 0,
+            }
+        }
+    };
+
+    fs_init_args_t fs_init_args = (fs_init_args_t){
+        .fs_user_files_init_cb = NULL,
+        .access_profiles_count = 1,
+        .access_profiles = access_profiles,
+        .access_class = 0x01
+    };
+
+    fs_init(&fs_init_args);
+    memset(files, 0, sizeof(files));
+    used = 0;
+}
+
+// the free space after fs_init() is the largest file which can be created
+static uint16_t measure_capacity()
+{
+    fs_file_header_t header = { .file_properties.storage_class = FS_STORAGE_VOLATILE };
+    uint16_t low = 0;
+    uint16_t high = MODULE_D7AP_FS_FILESYSTEM_SIZE;
+
+    while(low < high)
+    {
+        header.length = (low + high + 1) / 2;
+        if(fs_create_file(FIRST_FILE_ID, &header, NULL) == ALP_STATUS_OK)
+        {
+            fs_delete_file(FIRST_FILE_ID);
+            low = header.length;
+        }
+        else
+            high = header.length - 1;
+    }
+
+    return low;
+}
+
+static bool check_files()
+{
+    uint8_t buffer[MAX_FILE_LENGTH];
+
+    for(uint8_t i = 0; i < FILE_COUNT; i++)
+    {
+        uint8_t file_id = FIRST_FILE_ID + i;
+        bool exists = fs_read_file(file_id, 0, buffer, 0) != ALP_STATUS_FILE_ID_NOT_EXISTS;
+        if(exists != (files[i].length != 0))
+        {
+            printf("Operation %u: file 0x%02X %s\n", operation_count, file_id, exists ? "exists" : "does not exist");
+            return false;
+        }
+
+        if(!exists)
+            continue;
+
+        if(fs_get_file_length(file_id) != files[i].length
+                || fs_read_file(file_id, 0, buffer, files[i].length) != ALP_STATUS_OK
+                || memcmp(buffer, files[i].content, files[i].length) != 0)
+        {
+            printf("Operation %u: the content of file 0x%02X is corrupted\n", operation_count, file_id);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool check_status(const char* operation, uint8_t index, alp_status_codes_t status, alp_status_codes_t expected)
+{
+    operation_count++;
+    if(status != expected)
+    {
+        printf("Operation %u: %s of file 0x%02X returned %d instead of %d (%u of %u bytes used)\n",
+               operation_count, operation, FIRST_FILE_ID + index, status, expected, used, capacity);
+        return false;
+    }
+
+    return check_files();
+}
+
+static void fill_content(uint8_t index, uint8_t offset)
+{
+    for(uint8_t i = offset; i < files[index].length; i++)
+        files[index].content[i] = next_random();
+}
+
+static bool create_file(uint8_t index, uint8_t length)
+{
+    fs_file_header_t header = {
+        .file_properties.storage_class = FS_STORAGE_VOLATILE,
+        .length = length
+    };
+    alp_status_codes_t expected = ALP_STATUS_OK;
+
+    if(files[index].length != 0)
+        expected = ALP_STATUS_FILE_ID_ALREADY_EXISTS;
+    else if(used + length > capacity)
+        expected = ALP_STATUS_FILE_ALLOCATION_OVERFLOW;
+
+    uint8_t content[MAX_FILE_LENGTH];
+    for(uint8_t i = 0; i < length; i++)
+        content[i] = next_random();
+
+    alp_status_codes_t status = fs_create_file(FIRST_FILE_ID + index, &header, content);
+    if(status == ALP_STATUS_OK && expected == ALP_STATUS_OK)
+    {
+        files[index].length = length;
+        memcpy(files[index].content, content, length);
+        used += length;
+    }
+
+    return check_status("creating", index, status, expected);
+}
+
+static bool delete_file(uint8_t index)
+{
+    alp_status_codes_t expected = files[index].length != 0 ? ALP_STATUS_OK : ALP_STATUS_FILE_ID_NOT_EXISTS;
+    alp_status_codes_t status = fs_delete_file(FIRST_FILE_ID + index);
+    if(status == ALP_STATUS_OK && expected == ALP_STATUS_OK)
+    {
+        used -= files[index].length;
+        files[index].length = 0;
+    }
+
+    return check_status("deleting", index, status, expected);
+}
+
+static bool resize_file(uint8_t index, uint8_t length)
+{
+    uint8_t old_length = files[index].length;
+    alp_status_codes_t expected = ALP_STATUS_OK;
+
+    if(old_length == 0)
+        expected = ALP_STATUS_FILE_ID_NOT_EXISTS;
+    else if(length > old_length && used + length - old_length > capacity)
+        expected = ALP_STATUS_FILE_ALLOCATION_OVERFLOW;
+
+    alp_status_codes_t status = fs_resize_file(FIRST_FILE_ID + index, length);
+    if(status == ALP_STATUS_OK && expected == ALP_STATUS_OK)
+    {
+        // the added bytes are zeroed
+        if(length > old_length)
+            memset(files[index].content + old_length, 0, length - old_length);
+
+        files[index].length = length;
+        used = used + length - old_length;
+    }
+
+    return check_status("resizing", index, status, expected);
+}
+
+static bool write_file(uint8_t index)
+{
+    if(files[index].length == 0)
+        return true;
+
+    fill_content(index, 0);
+    return check_status("writing", index,
+                        fs_write_file(FIRST_FILE_ID + index, 0, files[index].content, files[index].length), ALP_STATUS_OK);
+}
+
+// deleting neighbours leaves holes which are merged, so a file as large as the holes together fits without moving
+static bool test_coalescing()
+{
+    init_fs();
+    for(uint8_t i = 0; i < 5; i++)
+    {
+        if(!create_file(i, 20))
+            return false;
+    }
+
+    // the middle hole is merged with the holes on both sides, in both orders
+    if(!delete_file(1) || !delete_file(3) || !delete_file(2) || !create_file(5, 60))
+        return false;
+
+    // a hole next to the end of the used space is given back to the free space at the end
+    return delete_file(4) && delete_file(5) && create_file(6, 80);
+}
+
+// more holes than the filesystem remembers, the space of the forgotten holes is recovered by compaction
+static bool test_fragmentation()
+{
+    uint8_t count = FILE_COUNT - 2;
+    uint8_t length = capacity / count < MAX_FILE_LENGTH / 2 ? capacity / count : MAX_FILE_LENGTH / 2;
+
+    init_fs();
+    for(uint8_t i = 0; i < count; i++)
+    {
+        if(!create_file(i, length))
+            return false;
+    }
+
+    // shrinking every file leaves a hole behind each of them, so the holes can not be merged
+    for(uint8_t i = 0; i < count; i++)
+    {
+        if(!resize_file(i, length / 2))
+            return false;
+    }
+
+    // a file larger than any hole
+    if(!create_file(count, 2 * length))
+        return false;
+
+    // the files grow back into their holes, in place while the hole is remembered, by moving the following files
+    // otherwise, until the filesystem is full
+    for(uint8_t i = 0; i < count; i++)
+    {
+        if(!resize_file(i, length))
+            return false;
+    }
+
+    if(!delete_file(count))
+        return false;
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+        if(!resize_file(i, length))
+            return false;
+    }
+
+    // the last file takes exactly the remaining space
+    uint16_t remaining = capacity - used;
+    if(remaining >= MAX_FILE_LENGTH)
+        return true;
+
+    if(!create_file(count + 1, remaining + 1))
+        return false;
+
+    return remaining == 0 || create_file(count + 1, remaining);
+}
+
+// files grow at the end of the used space, into a following hole, or by moving the following files
+static bool test_resize()
+{
+    init_fs();
+    for(uint8_t i = 0; i < 4; i++)
+    {
+        if(!create_file(i, 16))
+            return false;
+    }
+
+    if(!resize_file(3, 40) || !delete_file(2) || !resize_file(1, 24) || !resize_file(1, 32)
+            || !resize_file(0, 48) || !resize_file(0, 8) || !resize_file(1, 4))
+        return false;
+
+    return resize_file(3, MAX_FILE_LENGTH) && write_file(0) && write_file(1) && write_file(3);
+}
+
+static bool test_random()
+{
+    init_fs();
+    random_state = 0x12345678;
+    for(uint32_t i = 0; i < RANDOM_OPERATIONS; i++)
+    {
+        uint8_t index = next_random() % FILE_COUNT;
+        uint8_t length = 1 + next_random() % RANDOM_MAX_FILE_LENGTH;
+        bool result;
+
+        switch(next_random() % 4)
+        {
+            case 0: result = create_file(index, length); break;
+            case 1: result = delete_file(index); break;
+            case 2: result = resize_file(index, length); break;
+            default: result = write_file(index); break;
+        }
+
+        if(!result)
+            return false;
+    }
+
+    return true;
+}
+
+static int run_tests()
+{
+    init_fs();
+    capacity = measure_capacity();
+    if(capacity < 4 * RANDOM_MAX_FILE_LENGTH)
+    {
+        printf("Only %u bytes are available for user files\n", capacity);
+        return 1;
+    }
+
+    if(!test_coalescing() || !test_fragmentation() || !test_resize() || !test_random())
+        return 1;
+
+    printf("%u operations on %u bytes available for user files\n", operation_count, capacity);
+    return 0;
+}
+
+void bootstrap()
+{
+    exit(run_tests());
+}
@@ -0,0 +1,284 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2016 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fs_layout.h"
+
+/*
+ * This unit-test application checks that a filesystem image generated by tools/general/generate_fs_image.py gives
+ * exactly the same filesystem as the procedural fs_init() with the same access profiles and user files: the content,
+ * the file headers, the offsets and the allocated lengths of all files.
+ *
+ * The layout of the filesystem after both ways of initializing it is compared through fs_layout.h.
+ * fs_image.json and fs_image_ssr.json have to be kept in sync with the arguments below.
+ */
+
+// the firmware version file refers to the version of the application
+const char _GIT_SHA1[] = "0000000";
+const char _APP_NAME[] = "fs_img";
+
+// generated from fs_image.json and fs_image_ssr.json
+extern const fs_image_t test_fs_image;
+extern const fs_image_t test_fs_image_ssr;
+
+typedef struct
+{
+    uint16_t size;
+    uint8_t content[MODULE_D7AP_FS_FILESYSTEM_SIZE];
+    fs_file_header_t headers[MODULE_D7AP_FS_FILE_COUNT];
+    uint16_t offsets[MODULE_D7AP_FS_FILE_COUNT];
+    uint16_t allocated_lengths[MODULE_D7AP_FS_FILE_COUNT];
+} fs_state_t;
+
+static fs_state_t image_state;
+static fs_state_t procedural_state;
+
+static void init_user_files()
+{
+    fs_file_header_t header = {
+        .file_properties.storage_class = FS_STORAGE_PERMANENT,
+        .length = 8
+    };
+    uint8_t content[20] = { 0x01, 0x02 };
+
+    fs_init_file(0x40, &header, content);
+
+    header = (fs_file_header_t){
+        .file_properties.storage_class = FS_STORAGE_RESTORABLE,
+        .file_properties.action_protocol_enabled = true,
+        .file_properties.action_condition = ALP_ACT_COND_READ,
+        .file_properties.action_file_id = 0x40,
+        .file_properties.permissions = 0x12,
+        .length = 3
+    };
+    memcpy(content, (uint8_t[]){ 0xA1, 0xA2, 0xA3 }, 3);
+    fs_init_file(0x41, &header, content);
+
+    header = (fs_file_header_t){
+        .file_properties.storage_class = FS_STORAGE_VOLATILE,
+        .length = 20
+    };
+    memset(content, 0, sizeof(content));
+    fs_init_file(0x45, &header, content);
+}
+
+static void init_user_files_ssr()
+{
+    fs_file_header_t header = {
+        .file_properties.storage_class = FS_STORAGE_TRANSIENT,
+        .length = 10
+    };
+
+    fs_init_file(0x4F, &header, (uint8_t[]){ 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99 });
+}
+
+static void save_state(fs_state_t* state)
+{
+    fs_layout_t layout;
+
+    fs_get_layout(&layout);
+    memset(state, 0, sizeof(fs_state_t));
+    state->size = layout.size;
+    memcpy(state->content, layout.content, layout.size);
+    memcpy(state->offsets, layout.offsets, sizeof(state->offsets));
+    memcpy(state->allocated_lengths, layout.allocated_lengths, sizeof(state->allocated_lengths));
+
+    // field by field, the padding of the headers is not defined
+    for(uint16_t file_id = 0; file_id < MODULE_D7AP_FS_FILE_COUNT; file_id++)
+    {
+        state->headers[file_id].file_properties.action_file_id = layout.headers[file_id].file_properties.action_file_id;
+        state->headers[file_id].file_properties._flags = layout.headers[file_id].file_properties._flags;
+        state->headers[file_id].file_properties.permissions = layout.headers[file_id].file_properties.permissions;
+        state->headers[file_id].length = layout.headers[file_id].length;
+    }
+}
+
+static int compare_states(const char* name)
+{
+    if(image_state.size != procedural_state.size)
+    {
+        printf("%s: the image takes %u bytes instead of %u\n", name, image_state.size, procedural_state.size);
+        return 1;
+    }
+
+    for(uint16_t file_id = 0; file_id < MODULE_D7AP_FS_FILE_COUNT; file_id++)
+    {
+        if(memcmp(&image_state.headers[file_id], &procedural_state.headers[file_id], sizeof(fs_file_header_t)) != 0)
+        {
+            printf("%s: the header of file 0x%02X differs\n", name, file_id);
+            return 1;
+        }
+
+        if(image_state.headers[file_id].length == 0)
+            continue;
+
+        if(image_state.offsets[file_id] != procedural_state.offsets[file_id]
+                || image_state.allocated_lengths[file_id] != procedural_state.allocated_lengths[file_id])
+        {
+            printf("%s: file 0x%02X is at offset %u with %u bytes allocated instead of offset %u with %u bytes\n", name,
+                   file_id, image_state.offsets[file_id], image_state.allocated_lengths[file_id],
+                   procedural_state.offsets[file_id], procedural_state.allocated_lengths[file_id]);
+            return 1;
+        }
+    }
+
+    for(uint16_t i = 0; i < image_state.size; i++)
+    {
+        if(image_state.content[i] != procedural_state.content[i])
+        {
+            printf("%s: the content differs at offset %u: 0x%02X instead of 0x%02X\n", name, i,
+                   image_state.content[i], procedural_state.content[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int test_image()
+{
+    dae_access_profile_t access_profiles[2] = {
+        {
+            .channel_header = {
+                .ch_coding = PHY_CODING_FEC_PN9,
+                .ch_class = PHY_CLASS_NORMAL_RATE,
+                .ch_freq_band = PHY_BAND_868
+            },
+            .subprofiles[0] = {
+                .subband_bitmap = 0x01,
+                .scan_automation_period = 0,
+            },
+            .subprofiles[1] = {
+                .subband_bitmap = 0x06,
+                .scan_automation_period = 16,
+            },
+            .subbands[0] = (subband_t){
+                .channel_index_start = 0,
+                .channel_index_end = 270,
+                .eirp = 14,
+                .cca = -86,
+                .duty = 0,
+            },
+            .subbands[1] = (subband_t){
+                .channel_index_start = 300,
+                .channel_index_end = 310,
+                .eirp = -5,
+                .cca = -100,
+                .duty = 20,
+            }
+        },
+        {
+            .channel_header = {
+                .ch_coding = PHY_CODING_PN9,
+                .ch_class = PHY_CLASS_LO_RATE,
+                .ch_freq_band = PHY_BAND_433
+            },
+            .subprofiles[0] = {
+                .subband_bitmap = 0x01,
+                .scan_automation_period = 0,
+            },
+            .subbands[0] = (subband_t){
+                .channel_index_start = 10,
+                .channel_index_end = 10,
+                .eirp = 10,
+                .cca = -80,
+                .duty = 0,
+            }
+        }
+    };
+
+    fs_init_args_t fs_init_args = (fs_init_args_t){
+        .fs_user_files_init_cb = &init_user_files,
+        .access_profiles_count = 2,
+        .access_profiles = access_profiles,
+        .access_class = 0x21,
+        .ssr_filter_mode = 0
+    };
+
+    fs_init(&fs_init_args);
+    save_state(&procedural_state);
+
+    // the user files are a part of the image
+    fs_init_args = (fs_init_args_t){
+        .fs_user_files_init_cb = NULL,
+        .image = &test_fs_image
+    };
+
+    fs_init(&fs_init_args);
+    save_state(&image_state);
+    return compare_states("fs_image.json");
+}
+
+static int test_image_ssr()
+{
+    dae_access_profile_t access_profiles[1] = {
+        {
+            .channel_header = {
+                .ch_coding = PHY_CODING_PN9,
+                .ch_class = PHY_CLASS_HI_RATE,
+                .ch_freq_band = PHY_BAND_915
+            },
+            .subprofiles[0] = {
+                .subband_bitmap = 0x01,
+                .scan_automation_period = 0,
+            },
+            .subbands[0] = (subband_t){
+                .channel_index_start = 0,
+                .channel_index_end = 0,
+                .eirp = 10,
+                .cca = -86,
+                .duty = 0,
+            }
+        }
+    };
+
+    fs_init_args_t fs_init_args = (fs_init_args_t){
+        .fs_user_files_init_cb = &init_user_files_ssr,
+        .access_profiles_count = 1,
+        .access_profiles = access_profiles,
+        .access_class = 0x01,
+        .ssr_filter_mode = ENABLE_SSR_FILTER
+    };
+
+    fs_init(&fs_init_args);
+    save_state(&procedural_state);
+
+    fs_init_args = (fs_init_args_t){
+        .fs_user_files_init_cb = NULL,
+        .image = &test_fs_image_ssr
+    };
+
+    fs_init(&fs_init_args);
+    save_state(&image_state);
+    return compare_states("fs_image_ssr.json");
+}
+
+static int run_tests()
+{
+    if(test_image() != 0 || test_image_ssr() != 0)
+        return 1;
+
+    printf("The generated images match the filesystem built by fs_init()\n");
+    return 0;
+}
+
+void bootstrap()
+{
+    exit(run_tests());
+}
@@ -0,0 +1,414 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2016 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fs.h"
+#include "file_blockdevice.h"
+
+/*
+ * This unit-test application stores the filesystem on a file_blockdevice and simulates a reset at every program
+ * and erase of the nvm: the interrupted operation is only done partially and the following operations are lost.
+ * After remounting, every file has to hold the content of the last completed flush, or the content of the flush
+ * which was interrupted. The journal also has to accept new records after the reset.
+ *
+ * The files are changed in generations, every generation is flushed. The erase blocks are small so the journal
+ * moves to the next block (writing a snapshot) several times.
+ */
+
+#define NVM_PATH "test_fs_nvm.nvm"
+#define ERASE_BLOCK_SIZE 256
+#define ERASE_BLOCK_COUNT 3
+
+#define GENERATIONS 16
+#define MAX_FILE_LENGTH 48
+
+#define COUNTER_FILE_ID 0x40 // permanent, written every generation
+#define LOG_FILE_ID 0x41 // restorable, resized in generation 5 and 9
+#define CREATED_FILE_ID 0x42 // permanent, created in generation 3 and deleted in generation 8
+#define VOLATILE_FILE_ID 0x43 // volatile, never stored
+#define LARGE_FILE_ID 0x44 // created by test_overflow()
+
+// the firmware version file refers to the version of the application
+const char _GIT_SHA1[] = "0000000";
+const char _APP_NAME[] = "fs_nvm";
+
+typedef struct
+{
+    blockdevice_t base;
+    blockdevice_t* target;
+    uint32_t operation_count;
+    uint32_t erase_count;
+    uint32_t reset_at; // the operation which is interrupted, 0 to never reset
+} faulty_blockdevice_t;
+
+typedef struct
+{
+    uint8_t length; // 0 when the file does not exist
+    uint8_t content[MAX_FILE_LENGTH];
+} file_state_t;
+
+static const uint8_t file_ids[] = { COUNTER_FILE_ID, LOG_FILE_ID, CREATED_FILE_ID, VOLATILE_FILE_ID };
+
+static file_blockdevice_t file_bd;
+static faulty_blockdevice_t faulty_bd;
+
+static inline bool is_reset(faulty_blockdevice_t* bd)
+{
+    return bd->reset_at != 0 && bd->operation_count >= bd->reset_at;
+}
+
+static error_t faulty_read(blockdevice_t* bd, uint8_t* data, uint32_t address, uint32_t length)
+{
+    return blockdevice_read(((faulty_blockdevice_t*)bd)->target, data, address, length);
+}
+
+static error_t faulty_program(blockdevice_t* bd, const uint8_t* data, uint32_t address, uint32_t length)
+{
+    faulty_blockdevice_t* faulty = (faulty_blockdevice_t*)bd;
+
+    if(is_reset(faulty))
+        return FAIL;
+
+    faulty->operation_count++;
+    if(is_reset(faulty))
+    {
+        // only the first half is programmed before the reset
+        length /= 2;
+        if(length > 0)
+            blockdevice_program(faulty->target, data, address, length);
+
+        return FAIL;
+    }
+
+    return blockdevice_program(faulty->target, data, address, length);
+}
+
+static error_t faulty_erase(blockdevice_t* bd, uint32_t address)
+{
+    faulty_blockdevice_t* faulty = (faulty_blockdevice_t*)bd;
+    uint8_t block[ERASE_BLOCK_SIZE];
+
+    if(is_reset(faulty))
+        return FAIL;
+
+    faulty->operation_count++;
+    if(is_reset(faulty))
+    {
+        // only the first half is erased before the reset
+        address -= address % ERASE_BLOCK_SIZE;
+        blockdevice_read(faulty->target, block, address, ERASE_BLOCK_SIZE);
+        blockdevice_erase(faulty->target, address);
+        blockdevice_program(faulty->target, block + ERASE_BLOCK_SIZE / 2, address + ERASE_BLOCK_SIZE / 2, ERASE_BLOCK_SIZE / 2);
+        return FAIL;
+    }
+
+    faulty->erase_count++;
+    return blockdevice_erase(faulty->target, address);
+}
+
+static const blockdevice_driver_t faulty_blockdevice_driver = {
+    .read = faulty_read,
+    .program = faulty_program,
+    .erase = faulty_erase
+};
+
+static void init_user_files()
+{
+    fs_file_header_t header = {
+        .file_properties.action_protocol_enabled = 0,
+        .file_properties.storage_class = FS_STORAGE_PERMANENT,
+        .length = 4
+    };
+
+    fs_init_file(COUNTER_FILE_ID, &header, NULL);
+
+    header.file_properties.storage_class = FS_STORAGE_RESTORABLE;
+    header.length = 32;
+    fs_init_file(LOG_FILE_ID, &header, NULL);
+
+    header.file_properties.storage_class = FS_STORAGE_VOLATILE;
+    header.length = 4;
+    fs_init_file(VOLATILE_FILE_ID, &header, NULL);
+}
+
+// initializes the filesystem as after a reset, with the content stored on the nvm
+static void mount()
+{
+    dae_access_profile_t access_profiles[1] = {
+        {
+            .channel_header = {
+                .ch_coding = PHY_CODING_PN9,
+                .ch_class = PHY_CLASS_NORMAL_RATE,
+                .ch_freq_band = PHY_BAND_868
+            },
+            .subprofiles[0] = {
+                .subband_bitmap = 0x01,
+                .scan_automation_period = 0,
+            },
+            .subbands[0] = (subband_t){
+                .channel_index_start = 0,
+                .channel_index_end = 0,
+                .eirp = 10,
+                .cca = -86,
+                .duty = 0,
+            }
+        }
+    };
+
+    fs_init_args_t fs_init_args = (fs_init_args_t){
+        .fs_user_files_init_cb = &init_user_files,
+        .access_profiles_count = 1,
+        .access_profiles = access_profiles,
+        .access_class = 0x01,
+        .nvm = &faulty_bd.base
+    };
+
+    fs_init(&fs_init_args);
+}
+
+static void open_nvm(uint32_t reset_at)
+{
+    remove(NVM_PATH);
+    if(file_blockdevice_init(&file_bd, NVM_PATH, ERASE_BLOCK_SIZE, ERASE_BLOCK_COUNT) != SUCCESS)
+    {
+        printf("Opening %s failed\n", NVM_PATH);
+        exit(1);
+    }
+
+    faulty_bd = (faulty_blockdevice_t){
+        .base = file_bd.base,
+        .target = &file_bd.base,
+        .reset_at = reset_at
+    };
+    faulty_bd.base.driver = &faulty_blockdevice_driver;
+}
+
+static void close_nvm()
+{
+    fclose(file_bd.file);
+    remove(NVM_PATH);
+}
+
+// the content of the file after a reset, when generations 1 to generation were flushed
+static void get_expected_state(uint8_t file_id, uint8_t generation, file_state_t* state)
+{
+    memset(state, 0, sizeof(file_state_t));
+
+    switch(file_id)
+    {
+        case COUNTER_FILE_ID:
+            state->length = 4;
+            state->content[3] = generation;
+            break;
+        case LOG_FILE_ID:
+            state->length = generation >= 9 ? 16 : generation >= 5 ? MAX_FILE_LENGTH : 32;
+            memset(state->content, generation, state->length);
+            break;
+        case CREATED_FILE_ID:
+            if(generation >= 3 && generation < 8)
+            {
+                state->length = 20;
+                memset(state->content, generation, state->length);
+            }
+            break;
+        case VOLATILE_FILE_ID:
+            state->length = 4;
+            break;
+    }
+}
+
+static void get_state(uint8_t file_id, file_state_t* state)
+{
+    memset(state, 0, sizeof(file_state_t));
+    if(fs_read_file(file_id, 0, state->content, 0) == ALP_STATUS_FILE_ID_NOT_EXISTS)
+        return;
+
+    state->length = fs_get_file_length(file_id);
+    fs_read_file(file_id, 0, state->content, state->length);
+}
+
+static bool is_state_equal(const file_state_t* a, const file_state_t* b)
+{
+    return a->length == b->length && memcmp(a->content, b->content, a->length) == 0;
+}
+
+// applies the changes of the generation and flushes them, applying a generation again leads to the same state
+static void apply_generation(uint8_t generation)
+{
+    uint8_t buffer[MAX_FILE_LENGTH];
+    memset(buffer, generation, sizeof(buffer));
+
+    uint8_t counter[4] = { 0, 0, 0, generation };
+    fs_write_file(COUNTER_FILE_ID, 0, counter, sizeof(counter));
+
+    if(generation == 5)
+        fs_resize_file(LOG_FILE_ID, MAX_FILE_LENGTH);
+    else if(generation == 9)
+        fs_resize_file(LOG_FILE_ID, 16);
+
+    fs_write_file(LOG_FILE_ID, 0, buffer, fs_get_file_length(LOG_FILE_ID));
+
+    if(generation == 3)
+    {
+        fs_file_header_t header = {
+            .file_properties.storage_class = FS_STORAGE_PERMANENT,
+            .length = 20
+        };
+
+        fs_create_file(CREATED_FILE_ID, &header, NULL);
+    }
+
+    if(generation == 8)
+        fs_delete_file(CREATED_FILE_ID);
+    else if(generation >= 3 && generation < 8)
+        fs_write_file(CREATED_FILE_ID, 0, buffer, 20);
+
+    fs_write_file(VOLATILE_FILE_ID, 0, buffer, 4);
+    fs_flush();
+}
+
+// returns true when every file has the content of one of the generations
+static bool check_files(uint32_t reset_at, uint8_t generation, uint8_t other_generation)
+{
+    file_state_t state;
+    file_state_t expected;
+    file_state_t other_expected;
+
+    for(uint8_t i = 0; i < sizeof(file_ids); i++)
+    {
+        get_state(file_ids[i], &state);
+        get_expected_state(file_ids[i], generation, &expected);
+        get_expected_state(file_ids[i], other_generation, &other_expected);
+        if(!is_state_equal(&state, &expected) && !is_state_equal(&state, &other_expected))
+        {
+            printf("Reset at operation %u: file 0x%02X does not match generation %u or %u\n",
+                   reset_at, file_ids[i], generation, other_generation);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// runs all generations with a reset at operation reset_at, returns the number of operations when reset_at is 0
+static int test_reset(uint32_t reset_at, uint32_t* operation_count)
+{
+    uint8_t generation;
+
+    open_nvm(reset_at);
+    mount();
+    for(generation = 1; generation <= GENERATIONS; generation++)
+    {
+        apply_generation(generation);
+        if(is_reset(&faulty_bd))
+            break;
+    }
+
+    *operation_count = faulty_bd.operation_count;
+
+    // the reset, the nvm can be used again
+    faulty_bd.reset_at = 0;
+    mount();
+    if(generation > GENERATIONS)
+    {
+        if(!check_files(reset_at, GENERATIONS, GENERATIONS))
+            return 1;
+    }
+    else
+    {
+        if(!check_files(reset_at, generation - 1, generation))
+            return 1;
+
+        // the journal recovers from the interrupted operation
+        apply_generation(generation);
+        mount();
+        if(!check_files(reset_at, generation, generation))
+            return 1;
+    }
+
+    close_nvm();
+    return 0;
+}
+
+// a permanent file which would make the snapshot too large for an erase block is refused
+static int test_overflow()
+{
+    fs_file_header_t header = {
+        .file_properties.storage_class = FS_STORAGE_PERMANENT,
+        .length = ERASE_BLOCK_SIZE
+    };
+
+    open_nvm(0);
+    mount();
+    if(fs_create_file(LARGE_FILE_ID, &header, NULL) != ALP_STATUS_FILE_ALLOCATION_OVERFLOW)
+    {
+        printf("Creating a permanent file larger than an erase block did not fail\n");
+        return 1;
+    }
+
+    if(fs_resize_file(LOG_FILE_ID, ERASE_BLOCK_SIZE) != ALP_STATUS_FILE_ALLOCATION_OVERFLOW)
+    {
+        printf("Resizing a restorable file to the size of an erase block did not fail\n");
+        return 1;
+    }
+
+    // a volatile file is not stored on the nvm
+    header.file_properties.storage_class = FS_STORAGE_VOLATILE;
+    if(fs_create_file(LARGE_FILE_ID, &header, NULL) != ALP_STATUS_OK)
+    {
+        printf("Creating a volatile file larger than an erase block failed\n");
+        return 1;
+    }
+
+    fs_delete_file(LARGE_FILE_ID);
+    close_nvm();
+    return 0;
+}
+
+static int run_tests()
+{
+    uint32_t operation_count;
+    uint32_t count;
+
+    if(test_reset(0, &operation_count) != 0)
+        return 1;
+
+    if(faulty_bd.erase_count <= ERASE_BLOCK_COUNT)
+    {
+        printf("Only %u erases, the journal did not use every block more than once\n", faulty_bd.erase_count);
+        return 1;
+    }
+
+    for(uint32_t reset_at = 1; reset_at <= operation_count; reset_at++)
+    {
+        if(test_reset(reset_at, &count) != 0)
+            return 1;
+    }
+
+    if(test_overflow() != 0)
+        return 1;
+
+    printf("Remounted after a reset at each of the %u program and erase operations\n", operation_count);
+    return 0;
+}
+
+void bootstrap()
+{
+    exit(run_tests());
+}
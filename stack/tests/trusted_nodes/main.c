@@ -0,0 +1,443 @@
+/*! \file main.c
+ *
+ *  \copyright (C) Copyright 2016 University of Antwerp and others (http://oss-7.cosys.be)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "fs.h"
+#include "d7anp_trusted_nodes.h"
+
+/*
+ * This unit-test application checks the trusted node table of the network layer against a model: the lookups on the
+ * UID, the insertion of new nodes and the eviction of the least recently used node once the table is full. After
+ * every operation the open addressing index has to hold every node exactly once, reachable from the home slot of its
+ * UID without crossing an empty slot, and the security state register file has to hold the same nodes as the table.
+ *
+ * The directed test builds probe sequences which wrap around the end of the index and evicts nodes out of them, so
+ * the entries are shifted back across the wrap around. The random test runs a long sequence of lookups and
+ * insertions with a fixed seed, on UIDs which mostly collide near the end of the index. Both reload the table from
+ * the register file from time to time, as after a reboot.
+ *
+ * The index is inspected and the UIDs are chosen by their home slot through d7anp_trusted_nodes.h.
+ */
+
+#define TABLE_SIZE MODULE_D7AP_TRUSTED_NODE_TABLE_SIZE
+#define HASH_SIZE D7ANP_TRUSTED_NODE_HASH_SIZE
+#define ADDRESS_POOL_SIZE (3 * TABLE_SIZE)
+#define RANDOM_OPERATIONS 100000
+#define RELOAD_PERIOD 1000
+
+// the wrap around probe sequence of the directed test takes 8 nodes
+#if TABLE_SIZE < 8
+#error "the trusted node table is too small for this test"
+#endif
+
+// the firmware version file refers to the version of the application
+const char _GIT_SHA1[] = "0000000";
+const char _APP_NAME[] = "trusted";
+
+typedef struct
+{
+    uint8_t addr[8];
+    bool present;
+    uint32_t last_used;
+    uint32_t frame_counter;
+    uint8_t key_counter;
+} node_model_t;
+
+static node_model_t pool[ADDRESS_POOL_SIZE];
+static uint8_t pool_size;
+static uint8_t present_count;
+static uint32_t model_clock;
+
+static const d7anp_node_security_t* nodes;
+static const uint8_t* hash;
+
+static uint32_t address_counter;
+static uint32_t random_state = 1;
+static uint32_t operation_count;
+
+static uint32_t next_random()
+{
+    // xorshift32
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void reset_table()
+{
+    dae_access_profile_t access_profiles[1] = {
+        {
+            .channel_header = {
+                .ch_coding = PHY_CODING_PN9,
+                .ch_class = PHY_CLASS_NORMAL_RATE,
+                .ch_freq_band = PHY_BAND_868
+            },
+            .subprofiles[0] = {
+                .subband_bitmap = 0x01,
+                .scan_automation_period = 0,
+            },
+            .subbands[0] = (subband_t){
+                .channel_index_start = 0,
+                .channel_index_end = 0,
+                .eirp = 10,
+                .cca = -86,
+                .duty = 0,
+            }
+        }
+    };
+
+    fs_init_args_t fs_init_args = (fs_init_args_t){
+        .fs_user_files_init_cb = NULL,
+        .access_profiles_count = 1,
+        .access_profiles = access_profiles,
+        .access_class = 0x01,
+        .ssr_filter_mode = ENABLE_SSR_FILTER
+    };
+
+    // an empty security state register file
+    fs_init(&fs_init_args);
+    d7anp_load_trusted_nodes();
+    nodes = d7anp_get_trusted_nodes();
+    hash = d7anp_get_trusted_node_hash();
+
+    memset(pool, 0, sizeof(pool));
+    pool_size = 0;
+    present_count = 0;
+    model_clock = 0;
+}
+
+// adds a new UID to the pool, with the given home slot in the index
+static uint8_t new_address(uint16_t home)
+{
+    uint8_t* address = pool[pool_size].addr;
+
+    assert(pool_size < ADDRESS_POOL_SIZE);
+    do
+    {
+        address_counter++;
+        memcpy(address, (uint8_t[]){ 0x4C, 0x61, 0x6E, 0x63 }, 4);
+        address[4] = address_counter >> 24;
+        address[5] = address_counter >> 16;
+        address[6] = address_counter >> 8;
+        address[7] = address_counter;
+    } while(d7anp_get_trusted_node_hash_slot(address) != home);
+
+    return pool_size++;
+}
+
+static int find_node(const uint8_t* address)
+{
+    for(uint8_t i = 0; i < nodes->trusted_node_nb; i++)
+    {
+        if(memcmp(nodes->trusted_node_table[i].addr, address, 8) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static bool check_index()
+{
+    uint8_t found[TABLE_SIZE] = { 0 };
+    uint8_t used_slots = 0;
+
+    for(uint16_t slot = 0; slot < HASH_SIZE; slot++)
+    {
+        if(!hash[slot])
+            continue;
+
+        uint8_t index = hash[slot] - 1;
+        if(index >= nodes->trusted_node_nb || found[index]++)
+        {
+            printf("Operation %u: slot %u holds node %u, which is unknown or already indexed\n", operation_count, slot, index);
+            return false;
+        }
+
+        // a lookup stops at the first empty slot after the home slot
+        for(uint16_t probe = d7anp_get_trusted_node_hash_slot(nodes->trusted_node_table[index].addr); probe != slot;
+            probe = (probe + 1) % HASH_SIZE)
+        {
+            if(!hash[probe])
+            {
+                printf("Operation %u: node %u in slot %u is behind the empty slot %u\n", operation_count, index, slot, probe);
+                return false;
+            }
+        }
+
+        used_slots++;
+    }
+
+    if(used_slots != nodes->trusted_node_nb)
+    {
+        printf("Operation %u: %u slots are used for %u nodes\n", operation_count, used_slots, nodes->trusted_node_nb);
+        return false;
+    }
+
+    return true;
+}
+
+static bool check_table()
+{
+    static d7anp_node_security_t stored;
+
+    if(nodes->trusted_node_nb != present_count)
+    {
+        printf("Operation %u: the table holds %u nodes instead of %u\n", operation_count, nodes->trusted_node_nb,
+               present_count);
+        return false;
+    }
+
+    for(uint8_t i = 0; i < pool_size; i++)
+    {
+        int index = find_node(pool[i].addr);
+        if((index >= 0) != pool[i].present)
+        {
+            printf("Operation %u: node %u %s\n", operation_count, i, index >= 0 ? "was not evicted" : "is missing");
+            return false;
+        }
+
+        if(index < 0)
+            continue;
+
+        const d7anp_trusted_node_t* node = &nodes->trusted_node_table[index];
+        if(node->last_used != pool[i].last_used || node->frame_counter != pool[i].frame_counter
+                || node->key_counter != pool[i].key_counter)
+        {
+            printf("Operation %u: the state of node %u is wrong\n", operation_count, i);
+            return false;
+        }
+    }
+
+    if(!check_index())
+        return false;
+
+    fs_read_nwl_security_state_register(&stored);
+    if(stored.trusted_node_nb != nodes->trusted_node_nb)
+    {
+        printf("Operation %u: the register file holds %u nodes instead of %u\n", operation_count, stored.trusted_node_nb,
+               nodes->trusted_node_nb);
+        return false;
+    }
+
+    for(uint8_t i = 0; i < stored.trusted_node_nb; i++)
+    {
+        if(memcmp(stored.trusted_node_table[i].addr, nodes->trusted_node_table[i].addr, 8) != 0
+                || stored.trusted_node_table[i].frame_counter != nodes->trusted_node_table[i].frame_counter
+                || stored.trusted_node_table[i].key_counter != nodes->trusted_node_table[i].key_counter)
+        {
+            printf("Operation %u: entry %u of the register file differs from the table\n", operation_count, i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool lookup_node(uint8_t i)
+{
+    d7anp_trusted_node_t* node = get_trusted_node(pool[i].addr);
+
+    operation_count++;
+    if((node != NULL) != pool[i].present || (node && memcmp(node->addr, pool[i].addr, 8) != 0))
+    {
+        printf("Operation %u: the lookup of node %u returned the wrong node\n", operation_count, i);
+        return false;
+    }
+
+    if(node)
+        pool[i].last_used = ++model_clock;
+
+    return check_table();
+}
+
+static bool add_node(uint8_t i)
+{
+    assert(!pool[i].present);
+
+    if(present_count == TABLE_SIZE)
+    {
+        // the least recently used node is replaced, after a reload the first one in the table
+        uint8_t oldest = 0;
+        for(uint8_t j = 0; j < pool_size; j++)
+        {
+            if(pool[j].present && (!pool[oldest].present || pool[j].last_used < pool[oldest].last_used
+                                   || (pool[j].last_used == pool[oldest].last_used
+                                       && find_node(pool[j].addr) < find_node(pool[oldest].addr))))
+                oldest = j;
+        }
+
+        pool[oldest].present = false;
+        present_count--;
+    }
+
+    pool[i].present = true;
+    pool[i].last_used = ++model_clock;
+    pool[i].frame_counter = next_random();
+    pool[i].key_counter = next_random();
+    present_count++;
+
+    operation_count++;
+    d7anp_trusted_node_t* node = add_trusted_node(pool[i].addr, pool[i].frame_counter, pool[i].key_counter);
+    if(memcmp(node->addr, pool[i].addr, 8) != 0)
+    {
+        printf("Operation %u: node %u was not added\n", operation_count, i);
+        return false;
+    }
+
+    return check_table();
+}
+
+// loads the table from the register file, the nodes are found at the same slots and have not been used yet
+static bool reload_table()
+{
+    d7anp_load_trusted_nodes();
+    for(uint8_t i = 0; i < pool_size; i++)
+        pool[i].last_used = 0;
+
+    model_clock = 0;
+    operation_count++;
+    return check_table();
+}
+
+// evicts the given node by using all others, the new node continues the probe sequence at the end of the index
+static bool evict_node(uint8_t victim)
+{
+    for(uint8_t i = 0; i < pool_size; i++)
+    {
+        if(i != victim && pool[i].present && !lookup_node(i))
+            return false;
+    }
+
+    return add_node(new_address(HASH_SIZE - 1)) && lookup_node(victim);
+}
+
+static bool test_hash()
+{
+    // FNV-1a of "01234567"
+    uint16_t slot = d7anp_get_trusted_node_hash_slot((const uint8_t*)"01234567");
+    if(slot != 0xD97F649DUL % HASH_SIZE)
+    {
+        printf("The UID is hashed to slot %u instead of %lu\n", slot, 0xD97F649DUL % HASH_SIZE);
+        return false;
+    }
+
+    return true;
+}
+
+static bool test_wrap_around()
+{
+    const uint16_t last = HASH_SIZE - 1;
+
+    // the home slots of the nodes, and the slots they end up in
+    const uint16_t homes[8] = { last - 1, last, last, last, 0, last, 0, 1 };
+    const uint16_t slots[8] = { last - 1, last, 0, 1, 2, 3, 4, 5 };
+
+    reset_table();
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        if(!add_node(new_address(homes[i])))
+            return false;
+
+        if(hash[slots[i]] != i + 1)
+        {
+            printf("Node %u with home slot %u is not in slot %u\n", i, homes[i], slots[i]);
+            return false;
+        }
+    }
+
+    // fill the table with nodes outside of the probe sequence
+    for(uint8_t i = 8; i < TABLE_SIZE; i++)
+    {
+        if(!add_node(new_address(6 + i - 8)))
+            return false;
+    }
+
+    // the index is rebuilt in the same order
+    if(!reload_table())
+        return false;
+
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        if(!lookup_node(i))
+            return false;
+    }
+
+    // the first node of the sequence at the end of the index, a node moved to the start of the index and shifted
+    // back across the wrap around, nodes at their home slot at the start of the index, and the last node
+    const uint8_t victims[] = { 1, 2, 4, 0, 7, 3, 5, 6 };
+    for(uint8_t i = 0; i < sizeof(victims); i++)
+    {
+        if(!evict_node(victims[i]))
+            return false;
+    }
+
+    // the table is full with new nodes, the evicted nodes take the places of the first ones in the table
+    if(!reload_table())
+        return false;
+
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        if(!add_node(i))
+            return false;
+    }
+
+    return true;
+}
+
+static bool test_random()
+{
+    reset_table();
+    random_state = 0x12345678;
+
+    // most nodes collide around the end of the index
+    for(uint8_t i = 0; i < ADDRESS_POOL_SIZE; i++)
+    {
+        uint16_t home = next_random() % 4 != 0 ? (HASH_SIZE - 2 + next_random() % 4) % HASH_SIZE : next_random() % HASH_SIZE;
+        new_address(home);
+    }
+
+    for(uint32_t i = 0; i < RANDOM_OPERATIONS; i++)
+    {
+        // the stack adds a node after its lookup failed
+        uint8_t index = next_random() % pool_size;
+        if(!lookup_node(index) || (!pool[index].present && !add_node(index)))
+            return false;
+
+        if(i % RELOAD_PERIOD == RELOAD_PERIOD - 1 && !reload_table())
+            return false;
+    }
+
+    return true;
+}
+
+static int run_tests()
+{
+    if(!test_hash() || !test_wrap_around() || !test_random())
+        return 1;
+
+    printf("%u operations on a table of %u trusted nodes\n", operation_count, TABLE_SIZE);
+    return 0;
+}
+
+void bootstrap()
+{
+    exit(run_tests());
+}
@@ -0,0 +1,289 @@
+#!/usr/bin/env python3
+#
+# OSS-7 - An opensource implementation of the DASH7 Alliance Protocol for ultra
+# lowpower wireless sensor communication
+#
+# Copyright 2015 University of Antwerp
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Generates a C source file containing a filesystem image (a const fs_image_t) from a JSON description of the
+# access profiles and user files of an application, so fs_init() can copy the image instead of building every
+# file at boot. The layout matches the one built by fs_init(), the UID, firmware version and security key are
+# left empty and filled in by fs_init() since these are only known at runtime. The generated source checks the
+# constants below against the headers of the build, so the build fails when the generator is out of date.
+#
+# The description is a JSON object, numbers can be given as strings to use hex notation ("0x40"):
+# {
+#   "access_class": 1,                      # the active access class written in the DLL configuration file
+#   "ssr_filter_mode": 0,                   # the filter mode of the network security state register
+#   "access_profiles": [                    # stored in file 0x20 and up
+#     {
+#       "channel_header": { "coding": "PN9", "class": "NORMAL_RATE", "band": "868" },
+#       "subprofiles": [ { "subband_bitmap": 1, "scan_automation_period": 0 } ],
+#       "subbands": [ { "channel_index_start": 0, "channel_index_end": 0, "eirp": 10, "cca": -86, "duty": 0 } ]
+#     }
+#   ],
+#   "user_files": [
+#     {
+#       "file_id": "0x40", "length": 8, "data": "0102",   # data is zero padded to length, length defaults to the data length
+#       "storage_class": "PERMANENT",                     # TRANSIENT (default), VOLATILE, RESTORABLE or PERMANENT
+#       "action_protocol_enabled": false, "action_condition": "WRITE", "action_file_id": 0, "permissions": 0
+#     }
+#   ]
+# }
+
+import argparse
+import json
+import os
+import sys
+
+# file IDs and sizes, see fs.h, dae.h and d7anp.h
+UID_FILE_ID = 0x00
+UID_SIZE = 8
+FIRMWARE_VERSION_FILE_ID = 0x02
+FIRMWARE_VERSION_SIZE = 2 + 6 + 7
+DLL_CONF_FILE_ID = 0x0A
+DLL_CONF_SIZE = 6
+ACCESS_PROFILE_ID = 0x20
+ACCESS_PROFILE_SIZE = 65
+NWL_SECURITY_FILE_ID = 0x0D
+NWL_SECURITY_SIZE = 5
+NWL_SECURITY_KEY_FILE_ID = 0x0E
+NWL_SECURITY_KEY_SIZE = 16
+NWL_SECURITY_STATE_REG_FILE_ID = 0x0F
+ENABLE_SSR_FILTER = 0x01
+USER_FILE_ID = 0x40
+
+SUBPROFILES_NB = 4
+SUBBANDS_NB = 8
+
+STORAGE_CLASSES = { "TRANSIENT": 0, "VOLATILE": 1, "RESTORABLE": 2, "PERMANENT": 3 }
+ACTION_CONDITIONS = { "LIST": 0, "READ": 1, "WRITE": 2, "WRITEFLUSH": 3 }
+CODINGS = { "PN9": 0x00, "FEC_PN9": 0x02 }
+CLASSES = { "LO_RATE": 0x00, "NORMAL_RATE": 0x02, "HI_RATE": 0x03 }
+BANDS = { "433": 0x02, "868": 0x03, "915": 0x04 }
+
+# the names in the headers of the constants above, checked at build time
+CHECKED_CONSTANTS = [
+  ("D7A_FILE_UID_FILE_ID", UID_FILE_ID),
+  ("D7A_FILE_UID_SIZE", UID_SIZE),
+  ("D7A_FILE_FIRMWARE_VERSION_FILE_ID", FIRMWARE_VERSION_FILE_ID),
+  ("D7A_FILE_FIRMWARE_VERSION_SIZE", FIRMWARE_VERSION_SIZE),
+  ("D7A_FILE_DLL_CONF_FILE_ID", DLL_CONF_FILE_ID),
+  ("D7A_FILE_DLL_CONF_SIZE", DLL_CONF_SIZE),
+  ("D7A_FILE_ACCESS_PROFILE_ID", ACCESS_PROFILE_ID),
+  ("D7A_FILE_ACCESS_PROFILE_SIZE", ACCESS_PROFILE_SIZE),
+  ("D7A_FILE_NWL_SECURITY", NWL_SECURITY_FILE_ID),
+  ("D7A_FILE_NWL_SECURITY_SIZE", NWL_SECURITY_SIZE),
+  ("D7A_FILE_NWL_SECURITY_KEY", NWL_SECURITY_KEY_FILE_ID),
+  ("D7A_FILE_NWL_SECURITY_KEY_SIZE", NWL_SECURITY_KEY_SIZE),
+  ("D7A_FILE_NWL_SECURITY_STATE_REG", NWL_SECURITY_STATE_REG_FILE_ID),
+  ("ENABLE_SSR_FILTER", ENABLE_SSR_FILTER),
+  ("SUBPROFILES_NB", SUBPROFILES_NB),
+  ("SUBBANDS_NB", SUBBANDS_NB)
+] + [("FS_STORAGE_" + name, value) for name, value in sorted(STORAGE_CLASSES.items())] \
+  + [("ALP_ACT_COND_" + name, value) for name, value in sorted(ACTION_CONDITIONS.items())] \
+  + [("PHY_CODING_" + name, value) for name, value in sorted(CODINGS.items())] \
+  + [("PHY_CLASS_" + name, value) for name, value in sorted(CLASSES.items())] \
+  + [("PHY_BAND_" + name, value) for name, value in sorted(BANDS.items())]
+
+
+def number(value, minimum, maximum, name):
+  if isinstance(value, str):
+    value = int(value, 0)
+
+  if not isinstance(value, int) or value < minimum or value > maximum:
+    raise ValueError("{0} should be between {1} and {2}".format(name, minimum, maximum))
+
+  return value
+
+
+def lookup(table, value, name):
+  if str(value) not in table:
+    raise ValueError("{0} should be one of {1}".format(name, ", ".join(sorted(table))))
+
+  return table[str(value)]
+
+
+def le16(value):
+  return [value & 0xFF, (value >> 8) & 0xFF]
+
+
+def properties(storage_class, action_protocol_enabled=False, action_condition=0, action_file_id=0, permissions=0):
+  # the _flags byte of fs_file_properties_t: action protocol enabled (bit 0), action condition (bits 1-3),
+  # storage class (bits 6-7)
+  flags = (1 if action_protocol_enabled else 0) | (action_condition << 1) | (storage_class << 6)
+  return { "action_file_id": action_file_id, "flags": flags, "permissions": permissions }
+
+
+def access_profile(description):
+  header = description.get("channel_header", {})
+  content = [
+    lookup(CODINGS, header.get("coding", "PN9"), "coding")
+    | (lookup(CLASSES, header.get("class", "LO_RATE"), "class") << 2)
+    | (lookup(BANDS, header.get("band", "433"), "band") << 4)
+  ]
+
+  subprofiles = description.get("subprofiles", [])
+  if len(subprofiles) > SUBPROFILES_NB:
+    raise ValueError("an access profile has at most {0} subprofiles".format(SUBPROFILES_NB))
+
+  for i in range(SUBPROFILES_NB):
+    subprofile = subprofiles[i] if i < len(subprofiles) else {}
+    content += [
+      number(subprofile.get("subband_bitmap", 0), 0, 0xFF, "subband_bitmap"),
+      number(subprofile.get("scan_automation_period", 0), 0, 0xFF, "scan_automation_period")
+    ]
+
+  subbands = description.get("subbands", [])
+  if len(subbands) > SUBBANDS_NB:
+    raise ValueError("an access profile has at most {0} subbands".format(SUBBANDS_NB))
+
+  for i in range(SUBBANDS_NB):
+    subband = subbands[i] if i < len(subbands) else {}
+    content += le16(number(subband.get("channel_index_start", 0), 0, 0xFFFF, "channel_index_start"))
+    content += le16(number(subband.get("channel_index_end", 0), 0, 0xFFFF, "channel_index_end"))
+    content += [
+      number(subband.get("eirp", 0), -128, 127, "eirp") & 0xFF,
+      number(subband.get("cca", 0), -128, 127, "cca") & 0xFF,
+      number(subband.get("duty", 0), 0, 0xFF, "duty")
+    ]
+
+  assert len(content) == ACCESS_PROFILE_SIZE
+  return content
+
+
+def build_image(description, trusted_node_table_size, file_count, filesystem_size):
+  files = []
+  data = []
+
+  def add_file(file_id, file_properties, length, content):
+    # content can be longer than length, some system files reserve more space than their length
+    files.append({ "file_id": file_id, "offset": len(data), "properties": file_properties, "length": length })
+    data.extend(content)
+
+  permanent = properties(STORAGE_CLASSES["PERMANENT"])
+
+  # filled in at runtime
+  add_file(UID_FILE_ID, permanent, UID_SIZE, [0] * UID_SIZE)
+  add_file(FIRMWARE_VERSION_FILE_ID, permanent, FIRMWARE_VERSION_SIZE, [0] * FIRMWARE_VERSION_SIZE)
+
+  access_class = number(description.get("access_class", 0), 0, 0xFF, "access_class")
+  dll_conf = [access_class, 0xFF, 0xFF] + [0] * (DLL_CONF_SIZE - 3) # VID 0xFFFF means not valid
+  add_file(DLL_CONF_FILE_ID, properties(STORAGE_CLASSES["RESTORABLE"]), DLL_CONF_SIZE, dll_conf)
+
+  access_profiles = description.get("access_profiles", [])
+  if len(access_profiles) == 0 or len(access_profiles) >= 16:
+    raise ValueError("between 1 and 15 access profiles should be defined")
+
+  for i, profile in enumerate(access_profiles):
+    add_file(ACCESS_PROFILE_ID + i, permanent, ACCESS_PROFILE_SIZE, access_profile(profile))
+
+  add_file(NWL_SECURITY_FILE_ID, permanent, NWL_SECURITY_SIZE, [0] * NWL_SECURITY_SIZE)
+  add_file(NWL_SECURITY_KEY_FILE_ID, permanent, NWL_SECURITY_KEY_SIZE, [0] * NWL_SECURITY_KEY_SIZE) # filled in at runtime
+
+  ssr_filter_mode = number(description.get("ssr_filter_mode", 0), 0, 0xFF, "ssr_filter_mode")
+  if ssr_filter_mode & ENABLE_SSR_FILTER:
+    ssr_size = 2 + trusted_node_table_size * (NWL_SECURITY_SIZE + UID_SIZE)
+    add_file(NWL_SECURITY_STATE_REG_FILE_ID, permanent, ssr_size, [ssr_filter_mode] + [0] * (ssr_size - 1))
+  else:
+    add_file(NWL_SECURITY_STATE_REG_FILE_ID, permanent, 1, [ssr_filter_mode, 0])
+
+  for user_file in description.get("user_files", []):
+    file_id = number(user_file["file_id"], USER_FILE_ID, file_count - 1, "file_id")
+    if any(f["file_id"] == file_id for f in files):
+      raise ValueError("file 0x{0:02X} is defined twice".format(file_id))
+
+    content = bytearray.fromhex(user_file.get("data", ""))
+    length = number(user_file.get("length", len(content)), 1, filesystem_size, "length")
+    if len(content) > length:
+      raise ValueError("the data of file 0x{0:02X} is longer than the file".format(file_id))
+
+    file_properties = properties(
+      lookup(STORAGE_CLASSES, user_file.get("storage_class", "TRANSIENT"), "storage_class"),
+      bool(user_file.get("action_protocol_enabled", False)),
+      lookup(ACTION_CONDITIONS, user_file.get("action_condition", "LIST"), "action_condition"),
+      number(user_file.get("action_file_id", 0), 0, 0xFF, "action_file_id"),
+      number(user_file.get("permissions", 0), 0, 0xFF, "permissions"))
+
+    add_file(file_id, file_properties, length, list(content) + [0] * (length - len(content)))
+
+  if len(data) > filesystem_size:
+    raise ValueError("the image takes {0} bytes, the filesystem can only hold {1}".format(len(data), filesystem_size))
+
+  return files, data
+
+
+def write_source(output, name, source, files, data, config):
+  generator = os.path.basename(sys.argv[0])
+  output.write("// generated by {0} from {1}, do not edit\n\n".format(generator, os.path.basename(source)))
+  output.write("#include \"fs.h\"\n")
+  output.write("#include \"dae.h\"\n")
+  output.write("#include \"d7anp.h\"\n")
+  output.write("#include \"alp.h\"\n")
+  output.write("#include \"hwradio.h\"\n\n")
+
+  # the image is only valid for the headers and the module parameters it was generated for
+  checks = CHECKED_CONSTANTS + [
+    ("D7A_FILE_NWL_SECURITY_STATE_REG_SIZE", 2 + config.trusted_node_table_size * (NWL_SECURITY_SIZE + UID_SIZE)),
+    ("MODULE_D7AP_FS_FILE_COUNT", config.file_count),
+    ("MODULE_D7AP_FS_FILESYSTEM_SIZE", config.filesystem_size)
+  ]
+  for constant, value in checks:
+    output.write("_Static_assert(({0}) == {1}, \"{0} does not match {2}\");\n".format(constant, value, generator))
+  output.write("\n")
+
+  output.write("static const fs_image_file_t files[] = {\n")
+  for f in files:
+    output.write("    {{ .file_id = 0x{0:02X}, .offset = {1}, .file_header = {{ .file_properties = {{ .action_file_id = 0x{2:02X}, "
+                 "._flags = 0x{3:02X}, .permissions = 0x{4:02X} }}, .length = {5} }} }},\n".format(
+                 f["file_id"], f["offset"], f["properties"]["action_file_id"], f["properties"]["flags"],
+                 f["properties"]["permissions"], f["length"]))
+  output.write("};\n\n")
+
+  output.write("static const uint8_t content[] = {\n")
+  for i in range(0, len(data), 16):
+    output.write("    " + " ".join("0x{0:02X},".format(b) for b in data[i:i + 16]) + "\n")
+  output.write("};\n\n")
+
+  output.write("const fs_image_t {0} = {{\n".format(name))
+  output.write("    .file_count = sizeof(files) / sizeof(files[0]),\n")
+  output.write("    .content_size = sizeof(content),\n")
+  output.write("    .files = files,\n")
+  output.write("    .content = content\n")
+  output.write("};\n")
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Generates a filesystem image to be passed to fs_init().")
+  parser.add_argument("description", help="the JSON description of the access profiles and user files")
+  parser.add_argument("output", help="the C source file to generate")
+  parser.add_argument("-n", "--name", default="fs_image", help="the name of the generated fs_image_t")
+  parser.add_argument("--trusted-node-table-size", type=int, default=16, help="MODULE_D7AP_TRUSTED_NODE_TABLE_SIZE")
+  parser.add_argument("--file-count", type=int, default=80, help="MODULE_D7AP_FS_FILE_COUNT")
+  parser.add_argument("--filesystem-size", type=int, default=512, help="MODULE_D7AP_FS_FILESYSTEM_SIZE")
+  config = parser.parse_args()
+
+  try:
+    with open(config.description) as f:
+      description = json.load(f)
+
+    files, data = build_image(description, config.trusted_node_table_size, config.file_count, config.filesystem_size)
+  except (ValueError, KeyError) as e:
+    sys.stderr.write("{0}: {1}\n".format(config.description, e))
+    sys.exit(1)
+
+  with open(config.output, "w") as output:
+    write_source(output, config.name, config.description, files, data, config)